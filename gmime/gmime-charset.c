@@ -44,6 +44,7 @@
 #include "gmime-table-private.h"
 #include "gmime-charset.h"
 #include "gmime-iconv.h"
+#include "gmime-internal.h"
 
 #ifdef HAVE_ICONV_DETECT_H
 #include "iconv-detect.h"
@@ -171,6 +172,11 @@ static char *locale_charset = NULL;
 static char *locale_lang = NULL;
 static int initialized = 0;
 
+/* TRUE if the charset mask of each 7-bit character is a subset of the
+ * masks of all of the characters before it, in which case the mask of
+ * a run of 7-bit text is simply the mask of its largest character */
+static gboolean ascii_masks_nested = FALSE;
+
 #ifdef G_THREADS_ENABLED
 static GMutex lock;
 #define CHARSET_UNLOCK() g_mutex_unlock (&lock);
@@ -180,6 +186,61 @@ static GMutex lock;
 #define CHARSET_LOCK()
 #endif /* G_THREADS_ENABLED */
 
+/* A read-mostly, open-addressed table of resolved iconv names that can be
+ * consulted without taking the lock. Entries are only ever added (while
+ * holding the lock) and never modified or removed until shutdown; the
+ * strings themselves are owned by the iconv_charsets hash table. Once the
+ * table is full, new names are only remembered by iconv_charsets. */
+#define ICONV_NAME_CACHE_SIZE 256
+#define ICONV_NAME_CACHE_MAX  ((ICONV_NAME_CACHE_SIZE * 3) / 4)
+
+typedef struct {
+	gpointer name;
+	const char *iconv_name;
+} IconvNameCacheEntry;
+
+static IconvNameCacheEntry iconv_name_cache[ICONV_NAME_CACHE_SIZE];
+static guint iconv_name_cache_count = 0;
+
+
+static const char *
+iconv_name_cache_lookup (const char *name)
+{
+	guint i = g_str_hash (name) & (ICONV_NAME_CACHE_SIZE - 1);
+	const char *key;
+	
+	while ((key = g_atomic_pointer_get (&iconv_name_cache[i].name)) != NULL) {
+		if (!strcmp (key, name))
+			return iconv_name_cache[i].iconv_name;
+		
+		i = (i + 1) & (ICONV_NAME_CACHE_SIZE - 1);
+	}
+	
+	return NULL;
+}
+
+/* Note: must be called while holding the lock (or during init) */
+static void
+iconv_name_cache_add (const char *name, const char *iconv_name)
+{
+	guint i = g_str_hash (name) & (ICONV_NAME_CACHE_SIZE - 1);
+	
+	if (iconv_name_cache_count >= ICONV_NAME_CACHE_MAX)
+		return;
+	
+	while (iconv_name_cache[i].name != NULL) {
+		if (!strcmp (iconv_name_cache[i].name, name))
+			return;
+		
+		i = (i + 1) & (ICONV_NAME_CACHE_SIZE - 1);
+	}
+	
+	/* the value must be visible to readers before the key is */
+	iconv_name_cache[i].iconv_name = iconv_name;
+	g_atomic_pointer_set (&iconv_name_cache[i].name, (gpointer) name);
+	iconv_name_cache_count++;
+}
+
 
 /**
  * g_mime_charset_map_shutdown:
@@ -203,6 +264,9 @@ g_mime_charset_map_shutdown (void)
 	}
 #endif
 	
+	memset (iconv_name_cache, 0, sizeof (iconv_name_cache));
+	iconv_name_cache_count = 0;
+	
 	g_hash_table_destroy (iconv_charsets);
 	iconv_charsets = NULL;
 	
@@ -282,10 +346,24 @@ g_mime_charset_map_init (void)
 	
 	iconv_charsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	
+	ascii_masks_nested = TRUE;
+	for (i = 1; i < 128; i++) {
+		unsigned int prev = charset_mask (i - 1);
+		unsigned int mask = charset_mask (i);
+		
+		if ((mask & ~prev) != 0) {
+			ascii_masks_nested = FALSE;
+			break;
+		}
+	}
+	
 	for (i = 0; known_iconv_charsets[i].charset != NULL; i++) {
 		charset = g_ascii_strdown (known_iconv_charsets[i].charset, -1);
 		iconv_name = g_strdup (known_iconv_charsets[i].iconv_name);
 		g_hash_table_insert (iconv_charsets, charset, iconv_name);
+		
+		if (iconv_name != NULL)
+			iconv_name_cache_add (charset, iconv_name);
 	}
 	
 #ifndef WIN32
@@ -458,6 +536,9 @@ g_mime_charset_iconv_name (const char *charset)
 	strcpy (name, charset);
 	strdown (name);
 	
+	if ((iconv_name = (char *) iconv_name_cache_lookup (name)))
+		return iconv_name;
+	
 	CHARSET_LOCK ();
 	
 	iconv_name = g_hash_table_lookup (iconv_charsets, name);
@@ -523,7 +604,9 @@ g_mime_charset_iconv_name (const char *charset)
 		iconv_name = g_strdup (charset);
 	}
 	
-	g_hash_table_insert (iconv_charsets, g_strdup (name), iconv_name);
+	buf = g_strdup (name);
+	g_hash_table_replace (iconv_charsets, buf, iconv_name);
+	iconv_name_cache_add (buf, iconv_name);
 	
 	CHARSET_UNLOCK ();
 	
@@ -753,7 +836,19 @@ g_mime_charset_step (GMimeCharset *charset, const char *inbuf, size_t inlen)
 	
 	while (inptr < inend) {
 		const char *newinptr;
+		unsigned char max;
 		gunichar c;
+		size_t n;
+		
+		if (_g_mime_simd_ascii_span && ascii_masks_nested && !(*inptr & 0x80)) {
+			/* skip over the run of 7-bit text, none of which affects the level */
+			n = _g_mime_simd_ascii_span ((const unsigned char *) inptr, inend - inptr, &max);
+			mask &= charset_mask (max);
+			inptr += n;
+			
+			if (inptr == inend)
+				break;
+		}
 		
 		newinptr = g_utf8_next_char (inptr);
 		c = g_utf8_get_char (inptr);
@@ -191,16 +191,14 @@ g_mime_content_type_parse (GMimeParserOptions *options, const char *str)
 	return _g_mime_content_type_parse (options, str, -1);
 }
 
-GMimeContentType *
-_g_mime_content_type_parse (GMimeParserOptions *options, const char *str, gint64 offset)
+static GMimeContentType *
+content_type_parse (GMimeParserOptions *options, const char *str, gint64 offset)
 {
 	GMimeContentType *content_type;
 	const char *inptr = str;
 	GMimeParamList *params;
 	char *type, *subtype;
 	
-	g_return_val_if_fail (str != NULL, NULL);
-	
 	if (!g_mime_parse_content_type (&inptr, &type, &subtype)) {
 		_g_mime_parser_options_warn (options, offset, GMIME_WARN_INVALID_CONTENT_TYPE, str);
 		return g_mime_content_type_new ("application", "octet-stream");
@@ -224,6 +222,44 @@ _g_mime_content_type_parse (GMimeParserOptions *options, const char *str, gint64
 	return content_type;
 }
 
+GMimeContentType *
+_g_mime_content_type_copy (GMimeContentType *content_type)
+{
+	GMimeContentType *copy;
+	
+	copy = g_object_new (GMIME_TYPE_CONTENT_TYPE, NULL);
+	copy->subtype = g_strdup (content_type->subtype);
+	copy->type = g_strdup (content_type->type);
+	_g_mime_param_list_copy (copy->params, content_type->params);
+	
+	return copy;
+}
+
+GMimeContentType *
+_g_mime_content_type_parse (GMimeParserOptions *options, const char *str, gint64 offset)
+{
+	GMimeContentType *content_type;
+	GObject *cached;
+	
+	g_return_val_if_fail (str != NULL, NULL);
+	
+	if (!_g_mime_param_cache_can_cache (options, str))
+		return content_type_parse (options, str, offset);
+	
+	/* the cached instance is shared, so only ever hand out copies of it */
+	if ((cached = _g_mime_param_cache_lookup (GMIME_TYPE_CONTENT_TYPE, options, str))) {
+		content_type = _g_mime_content_type_copy ((GMimeContentType *) cached);
+		g_object_unref (cached);
+		
+		return content_type;
+	}
+	
+	content_type = content_type_parse (options, str, offset);
+	_g_mime_param_cache_add (options, str, (GObject *) _g_mime_content_type_copy (content_type));
+	
+	return content_type;
+}
+
 
 /**
  * g_mime_content_type_get_mime_type:
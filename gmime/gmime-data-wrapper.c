@@ -23,9 +23,18 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
+#include <sys/types.h>
+#include <unistd.h>
+
 #include "gmime-data-wrapper.h"
 #include "gmime-stream-filter.h"
+#include "gmime-stream-file.h"
+#include "gmime-stream-fs.h"
+#include "gmime-stream-mem.h"
+#include "gmime-stream-mmap.h"
 #include "gmime-filter-basic.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -38,8 +47,31 @@
  * allowing clients to read the content from the backing stream
  * without having to know whether it is encoded/compressed/etc and not
  * neding to know how to undo said encoding(s).
+ *
+ * When caching is enabled with g_mime_data_wrapper_set_caching(), the
+ * transfer-encoded form of the content is kept after it has been
+ * written once, so that writing the same #GMimePart again (e.g. once
+ * per recipient) becomes a plain copy.
  **/
 
+/* cached content that would exceed this size (worst-case) is spilled to disk */
+#define CACHE_MEMORY_LIMIT (1024 * 1024)
+
+typedef struct {
+	GMimeContentEncoding encoding;
+	GMimeNewLineFormat newline;
+	gboolean ensure_newline;
+	GMimeStream *stream;
+} CachedContent;
+
+typedef struct {
+	GPtrArray *cache;
+	gboolean caching;
+	gboolean frozen;
+} GMimeDataWrapperPrivate;
+
+#define GET_PRIVATE(wrapper) ((GMimeDataWrapperPrivate *) G_STRUCT_MEMBER_P (wrapper, private_offset))
+
 
 static void g_mime_data_wrapper_class_init (GMimeDataWrapperClass *klass);
 static void g_mime_data_wrapper_init (GMimeDataWrapper *wrapper, GMimeDataWrapperClass *klass);
@@ -49,6 +81,7 @@ static ssize_t write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *stream);
 
 
 static GObject *parent_class = NULL;
+static gint private_offset = 0;
 
 
 GType
@@ -70,6 +103,7 @@ g_mime_data_wrapper_get_type (void)
 		};
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeDataWrapper", &info, 0);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeDataWrapperPrivate));
 	}
 	
 	return type;
@@ -82,6 +116,7 @@ g_mime_data_wrapper_class_init (GMimeDataWrapperClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (G_TYPE_OBJECT);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	object_class->finalize = g_mime_data_wrapper_finalize;
 	
@@ -99,6 +134,12 @@ static void
 g_mime_data_wrapper_finalize (GObject *object)
 {
 	GMimeDataWrapper *wrapper = (GMimeDataWrapper *) object;
+	GMimeDataWrapperPrivate *priv = GET_PRIVATE (wrapper);
+	
+	g_mime_data_wrapper_clear_cache (wrapper);
+	
+	if (priv->cache)
+		g_ptr_array_free (priv->cache, TRUE);
 	
 	if (wrapper->stream)
 		g_object_unref (wrapper->stream);
@@ -107,6 +148,18 @@ g_mime_data_wrapper_finalize (GObject *object)
 }
 
 
+static gboolean
+check_mutable (GMimeDataWrapper *wrapper)
+{
+	if (G_UNLIKELY (GET_PRIVATE (wrapper)->frozen)) {
+		g_critical ("GMimeDataWrapper %p is frozen and must not be modified", (void *) wrapper);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+
 /**
  * g_mime_data_wrapper_new:
  *
@@ -168,6 +221,9 @@ g_mime_data_wrapper_set_stream (GMimeDataWrapper *wrapper, GMimeStream *stream)
 	g_return_if_fail (GMIME_IS_DATA_WRAPPER (wrapper));
 	g_return_if_fail (GMIME_IS_STREAM (stream));
 	
+	if (!check_mutable (wrapper))
+		return;
+	
 	if (stream)
 		g_object_ref (stream);
 	
@@ -175,6 +231,8 @@ g_mime_data_wrapper_set_stream (GMimeDataWrapper *wrapper, GMimeStream *stream)
 		g_object_unref (wrapper->stream);
 	
 	wrapper->stream = stream;
+	
+	g_mime_data_wrapper_clear_cache (wrapper);
 }
 
 
@@ -207,6 +265,12 @@ g_mime_data_wrapper_set_encoding (GMimeDataWrapper *wrapper, GMimeContentEncodin
 {
 	g_return_if_fail (GMIME_IS_DATA_WRAPPER (wrapper));
 	
+	if (!check_mutable (wrapper))
+		return;
+	
+	if (wrapper->encoding != encoding)
+		g_mime_data_wrapper_clear_cache (wrapper);
+	
 	wrapper->encoding = encoding;
 }
 
@@ -228,34 +292,162 @@ g_mime_data_wrapper_get_encoding (GMimeDataWrapper *wrapper)
 }
 
 
+/* checks whether separate substreams of @stream can be read from
+ * multiple threads at once without copying the content */
+static gboolean
+stream_is_shareable (GMimeStream *stream)
+{
+	if (GMIME_IS_STREAM_MEM (stream) || GMIME_IS_STREAM_MMAP (stream))
+		return TRUE;
+	
+#ifdef HAVE_PREAD
+	/* GMimeStreamFs reads with pread() */
+	if (GMIME_IS_STREAM_FS (stream))
+		return lseek (GMIME_STREAM_FS (stream)->fd, (off_t) 0, SEEK_CUR) != -1;
+#endif
+	
+#ifdef HAVE_FLOCKFILE
+	/* GMimeStreamFile locks the FILE around each seek + read */
+	if (GMIME_IS_STREAM_FILE (stream))
+		return GMIME_STREAM_FILE (stream)->fp && ftell (GMIME_STREAM_FILE (stream)->fp) != -1;
+#endif
+	
+	return FALSE;
+}
+
+/**
+ * _g_mime_data_wrapper_freeze:
+ * @wrapper: a #GMimeDataWrapper
+ *
+ * Prepares @wrapper to be read from multiple threads at once: caching
+ * is disabled and, unless substreams of the content stream can already
+ * be read concurrently, the content is copied into a #GMimeStreamMem so
+ * that every reader can be handed its own substream (see
+ * _g_mime_data_wrapper_open_stream()).
+ **/
+void
+_g_mime_data_wrapper_freeze (GMimeDataWrapper *wrapper)
+{
+	GMimeDataWrapperPrivate *priv = GET_PRIVATE (wrapper);
+	GMimeStream *mem;
+	
+	if (priv->frozen)
+		return;
+	
+	g_mime_data_wrapper_set_caching (wrapper, FALSE);
+	
+	if (wrapper->stream && !stream_is_shareable (wrapper->stream)) {
+		mem = g_mime_stream_mem_new ();
+		
+		g_mime_stream_reset (wrapper->stream);
+		if (g_mime_stream_write_to_stream (wrapper->stream, mem) != -1) {
+			g_object_unref (wrapper->stream);
+			wrapper->stream = mem;
+		} else {
+			g_object_unref (mem);
+		}
+		
+		g_mime_stream_reset (wrapper->stream);
+	}
+	
+	priv->frozen = TRUE;
+}
+
+/**
+ * _g_mime_data_wrapper_is_frozen:
+ * @wrapper: a #GMimeDataWrapper
+ *
+ * Gets whether or not @wrapper has been frozen with
+ * _g_mime_data_wrapper_freeze().
+ *
+ * Returns: %TRUE if @wrapper is frozen or %FALSE otherwise.
+ **/
+gboolean
+_g_mime_data_wrapper_is_frozen (GMimeDataWrapper *wrapper)
+{
+	return GET_PRIVATE (wrapper)->frozen;
+}
+
+/**
+ * _g_mime_data_wrapper_open_stream:
+ * @wrapper: a #GMimeDataWrapper
+ *
+ * Gets a stream for reading the (still encoded) content of @wrapper,
+ * positioned at the beginning of the content. If @wrapper is frozen,
+ * this is a private substream so that concurrent readers do not share
+ * a stream position.
+ *
+ * Returns: a new reference to the stream.
+ **/
+GMimeStream *
+_g_mime_data_wrapper_open_stream (GMimeDataWrapper *wrapper)
+{
+	GMimeStream *stream = wrapper->stream;
+	
+	if (GET_PRIVATE (wrapper)->frozen)
+		return g_mime_stream_substream (stream, stream->bound_start, stream->bound_end);
+	
+	g_mime_stream_reset (stream);
+	g_object_ref (stream);
+	
+	return stream;
+}
+
+/**
+ * _g_mime_data_wrapper_clone:
+ * @wrapper: a #GMimeDataWrapper
+ *
+ * Creates a data wrapper for a cloned #GMimePart. The content is not
+ * copied: the clone reads it through its own substream of @wrapper's
+ * stream, so the two never share a stream position. The cache is not
+ * shared. A frozen @wrapper is immutable, so it is simply shared.
+ *
+ * Returns: (transfer full): a data wrapper with the same content as @wrapper.
+ **/
+GMimeDataWrapper *
+_g_mime_data_wrapper_clone (GMimeDataWrapper *wrapper)
+{
+	GMimeStream *stream = wrapper->stream;
+	GMimeDataWrapper *clone;
+	
+	if (GET_PRIVATE (wrapper)->frozen)
+		return g_object_ref (wrapper);
+	
+	clone = g_object_new (G_OBJECT_TYPE (wrapper), NULL);
+	clone->encoding = wrapper->encoding;
+	GET_PRIVATE (clone)->caching = GET_PRIVATE (wrapper)->caching;
+	
+	if (stream)
+		clone->stream = g_mime_stream_substream (stream, stream->bound_start, stream->bound_end);
+	
+	return clone;
+}
+
 static ssize_t
 write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *stream)
 {
-	GMimeStream *filtered_stream;
-	GMimeFilter *filter;
+	GMimeStream *filtered_stream, *content;
 	ssize_t written;
 	
-	g_mime_stream_reset (wrapper->stream);
+	content = _g_mime_data_wrapper_open_stream (wrapper);
 	
 	switch (wrapper->encoding) {
 	case GMIME_CONTENT_ENCODING_BASE64:
 	case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
 	case GMIME_CONTENT_ENCODING_UUENCODE:
-		filter = g_mime_filter_basic_new (wrapper->encoding, FALSE);
-		filtered_stream = g_mime_stream_filter_new (wrapper->stream);
-		g_mime_stream_filter_add (GMIME_STREAM_FILTER (filtered_stream), filter);
-		g_object_unref (filter);
+		filtered_stream = _g_mime_stream_filter_get_pipeline (content, wrapper->encoding, FALSE, NULL, FALSE);
+		written = g_mime_stream_write_to_stream (filtered_stream, stream);
+		_g_mime_stream_filter_release_pipeline (filtered_stream);
 		break;
 	default:
-		filtered_stream = wrapper->stream;
-		g_object_ref (wrapper->stream);
+		written = g_mime_stream_write_to_stream (content, stream);
 		break;
 	}
 	
-	written = g_mime_stream_write_to_stream (filtered_stream, stream);
-	g_object_unref (filtered_stream);
+	if (!GET_PRIVATE (wrapper)->frozen)
+		g_mime_stream_reset (content);
 	
-	g_mime_stream_reset (wrapper->stream);
+	g_object_unref (content);
 	
 	return written;
 }
@@ -279,3 +471,148 @@ g_mime_data_wrapper_write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *str
 	
 	return GMIME_DATA_WRAPPER_GET_CLASS (wrapper)->write_to_stream (wrapper, stream);
 }
+
+
+/**
+ * g_mime_data_wrapper_set_caching:
+ * @wrapper: a #GMimeDataWrapper
+ * @caching: %TRUE if the encoded content should be cached
+ *
+ * Sets whether or not the transfer-encoded representation of the
+ * content should be cached once it has been written by a #GMimePart.
+ *
+ * The cache is keyed by the Content-Transfer-Encoding and the new-line
+ * format used when writing, so a part written repeatedly with the same
+ * #GMimeFormatOptions only needs to be encoded once. Large content is
+ * cached in a temporary file rather than in memory.
+ *
+ * The cache is invalidated when the stream or encoding of @wrapper is
+ * changed. If the contents of the underlying stream are modified
+ * directly, g_mime_data_wrapper_clear_cache() must be called.
+ *
+ * Disabling caching also clears the cache.
+ *
+ * Caching is disabled when the #GMimePart containing @wrapper is frozen
+ * with g_mime_object_freeze() and can no longer be changed afterwards.
+ **/
+void
+g_mime_data_wrapper_set_caching (GMimeDataWrapper *wrapper, gboolean caching)
+{
+	g_return_if_fail (GMIME_IS_DATA_WRAPPER (wrapper));
+	
+	/* a frozen wrapper may be read from several threads at once */
+	if (!check_mutable (wrapper))
+		return;
+	
+	if (!caching)
+		g_mime_data_wrapper_clear_cache (wrapper);
+	
+	GET_PRIVATE (wrapper)->caching = caching;
+}
+
+
+/**
+ * g_mime_data_wrapper_get_caching:
+ * @wrapper: a #GMimeDataWrapper
+ *
+ * Gets whether or not the transfer-encoded representation of the
+ * content is cached.
+ *
+ * Returns: %TRUE if caching is enabled or %FALSE otherwise.
+ **/
+gboolean
+g_mime_data_wrapper_get_caching (GMimeDataWrapper *wrapper)
+{
+	g_return_val_if_fail (GMIME_IS_DATA_WRAPPER (wrapper), FALSE);
+	
+	return GET_PRIVATE (wrapper)->caching;
+}
+
+
+/**
+ * g_mime_data_wrapper_clear_cache:
+ * @wrapper: a #GMimeDataWrapper
+ *
+ * Discards any cached transfer-encoded representations of the content.
+ **/
+void
+g_mime_data_wrapper_clear_cache (GMimeDataWrapper *wrapper)
+{
+	GMimeDataWrapperPrivate *priv;
+	CachedContent *cached;
+	guint i;
+	
+	g_return_if_fail (GMIME_IS_DATA_WRAPPER (wrapper));
+	
+	priv = GET_PRIVATE (wrapper);
+	
+	if (priv->cache == NULL)
+		return;
+	
+	for (i = 0; i < priv->cache->len; i++) {
+		cached = priv->cache->pdata[i];
+		g_object_unref (cached->stream);
+		g_slice_free (CachedContent, cached);
+	}
+	
+	g_ptr_array_set_size (priv->cache, 0);
+}
+
+
+GMimeStream *
+_g_mime_data_wrapper_get_cached_stream (GMimeDataWrapper *wrapper, GMimeContentEncoding encoding,
+					GMimeNewLineFormat newline, gboolean ensure_newline)
+{
+	GMimeDataWrapperPrivate *priv = GET_PRIVATE (wrapper);
+	CachedContent *cached;
+	guint i;
+	
+	if (priv->cache == NULL)
+		return NULL;
+	
+	for (i = 0; i < priv->cache->len; i++) {
+		cached = priv->cache->pdata[i];
+		
+		if (cached->encoding == encoding && cached->newline == newline &&
+		    cached->ensure_newline == ensure_newline)
+			return cached->stream;
+	}
+	
+	return NULL;
+}
+
+GMimeStream *
+_g_mime_data_wrapper_new_cache_stream (GMimeDataWrapper *wrapper)
+{
+	gint64 length;
+	FILE *fp;
+	
+	/* quoted-printable can triple the size of the content */
+	length = g_mime_stream_length (wrapper->stream);
+	
+	if ((length == -1 || length > CACHE_MEMORY_LIMIT / 3) && (fp = tmpfile ()) != NULL)
+		return g_mime_stream_file_new (fp);
+	
+	return g_mime_stream_mem_new ();
+}
+
+void
+_g_mime_data_wrapper_set_cached_stream (GMimeDataWrapper *wrapper, GMimeContentEncoding encoding,
+					GMimeNewLineFormat newline, gboolean ensure_newline,
+					GMimeStream *stream)
+{
+	GMimeDataWrapperPrivate *priv = GET_PRIVATE (wrapper);
+	CachedContent *cached;
+	
+	if (priv->cache == NULL)
+		priv->cache = g_ptr_array_new ();
+	
+	cached = g_slice_new (CachedContent);
+	cached->ensure_newline = ensure_newline;
+	cached->encoding = encoding;
+	cached->newline = newline;
+	cached->stream = stream;
+	g_object_ref (stream);
+	
+	g_ptr_array_add (priv->cache, cached);
+}
@@ -78,6 +78,10 @@ GMimeContentEncoding g_mime_data_wrapper_get_encoding (GMimeDataWrapper *wrapper
 
 ssize_t g_mime_data_wrapper_write_to_stream (GMimeDataWrapper *wrapper, GMimeStream *stream);
 
+void g_mime_data_wrapper_set_caching (GMimeDataWrapper *wrapper, gboolean caching);
+gboolean g_mime_data_wrapper_get_caching (GMimeDataWrapper *wrapper);
+void g_mime_data_wrapper_clear_cache (GMimeDataWrapper *wrapper);
+
 G_END_DECLS
 
 #endif /* __GMIME_DATA_WRAPPER_H__ */
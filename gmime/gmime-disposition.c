@@ -152,17 +152,14 @@ g_mime_content_disposition_parse (GMimeParserOptions *options, const char *str)
 	return _g_mime_content_disposition_parse (options, str, -1);
 }
 
-GMimeContentDisposition *
-_g_mime_content_disposition_parse (GMimeParserOptions *options, const char *str, gint64 offset)
+static GMimeContentDisposition *
+content_disposition_parse (GMimeParserOptions *options, const char *str, gint64 offset)
 {
 	GMimeContentDisposition *disposition;
 	const char *inptr = str;
 	GMimeParamList *params;
 	char *value;
 	
-	if (str == NULL)
-		return g_mime_content_disposition_new ();
-	
 	disposition = g_object_new (GMIME_TYPE_CONTENT_DISPOSITION, NULL);
 	
 	/* get content disposition part */
@@ -184,6 +181,44 @@ _g_mime_content_disposition_parse (GMimeParserOptions *options, const char *str,
 	return disposition;
 }
 
+static GMimeContentDisposition *
+content_disposition_copy (GMimeContentDisposition *disposition)
+{
+	GMimeContentDisposition *copy;
+	
+	copy = g_object_new (GMIME_TYPE_CONTENT_DISPOSITION, NULL);
+	copy->disposition = g_strdup (disposition->disposition);
+	_g_mime_param_list_copy (copy->params, disposition->params);
+	
+	return copy;
+}
+
+GMimeContentDisposition *
+_g_mime_content_disposition_parse (GMimeParserOptions *options, const char *str, gint64 offset)
+{
+	GMimeContentDisposition *disposition;
+	GObject *cached;
+	
+	if (str == NULL)
+		return g_mime_content_disposition_new ();
+	
+	if (!_g_mime_param_cache_can_cache (options, str))
+		return content_disposition_parse (options, str, offset);
+	
+	/* the cached instance is shared, so only ever hand out copies of it */
+	if ((cached = _g_mime_param_cache_lookup (GMIME_TYPE_CONTENT_DISPOSITION, options, str))) {
+		disposition = content_disposition_copy ((GMimeContentDisposition *) cached);
+		g_object_unref (cached);
+		
+		return disposition;
+	}
+	
+	disposition = content_disposition_parse (options, str, offset);
+	_g_mime_param_cache_add (options, str, (GObject *) content_disposition_copy (disposition));
+	
+	return disposition;
+}
+
 
 /**
  * g_mime_content_disposition_set_disposition:
@@ -29,6 +29,7 @@
 
 #include "gmime-table-private.h"
 #include "gmime-encodings.h"
+#include "gmime-internal.h"
 
 
 #ifdef ENABLE_WARNINGS
@@ -51,6 +52,9 @@
  **/
 
 
+/* minimum amount of input worth handing off to a SIMD kernel */
+#define SIMD_BLOCK_SIZE 16
+
 #define GMIME_UUENCODE_CHAR(c) ((c) ? (c) + ' ' : '`')
 #define	GMIME_UUDECODE_CHAR(c) (((c) - ' ') & 077)
 
@@ -434,9 +438,9 @@ g_mime_encoding_base64_encode_close (const unsigned char *inbuf, size_t inlen, u
 size_t
 g_mime_encoding_base64_encode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf, int *state, guint32 *save)
 {
-	register const unsigned char *inptr;
+	const unsigned char *inptr;
 	register unsigned char *outptr;
-	register int quartets;
+	int quartets;
 	unsigned char *saved;
 	size_t remaining;
 
@@ -472,6 +476,13 @@ g_mime_encoding_base64_encode_step (const unsigned char *inbuf, size_t inlen, un
 		if (inptr >= inend)
 			goto loop_exit;
 
+		if (_g_mime_simd_base64_encode && (inend + 2) - inptr >= SIMD_BLOCK_SIZE) {
+			/* the kernel only consumes whole triplets */
+			outptr += _g_mime_simd_base64_encode (&inptr, inend + 2, outptr, &quartets);
+			if (inptr >= inend)
+				goto loop_exit;
+		}
+		
 		c1 = *inptr++;
 		c2 = *inptr++;
 		c3 = *inptr++;
@@ -523,7 +534,7 @@ g_mime_encoding_base64_encode_step (const unsigned char *inbuf, size_t inlen, un
 size_t
 g_mime_encoding_base64_decode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf, int *state, guint32 *save)
 {
-	register const unsigned char *inptr;
+	const unsigned char *inptr;
 	register unsigned char *outptr;
 	const unsigned char *inend;
 	register guint32 saved;
@@ -549,6 +560,35 @@ g_mime_encoding_base64_decode_step (const unsigned char *inbuf, size_t inlen, un
 	
 	/* convert 4 base64 bytes to 3 normal bytes */
 	while (inptr < inend) {
+		if (n == 0 && _g_mime_simd_base64_decode && inend - inptr >= SIMD_BLOCK_SIZE) {
+			size_t nout;
+			
+			if ((nout = _g_mime_simd_base64_decode (&inptr, inend, outptr)) > 0) {
+				const unsigned char *p = inptr;
+				int i;
+				
+				/* resync our saved bits with the last 6 valid characters decoded */
+				for (i = 0; i < 6; i++) {
+					do {
+						c = *--p;
+					} while (gmime_base64_rank[c] == 0xff);
+				}
+				
+				while (p < inptr) {
+					if ((rank = gmime_base64_rank[(c = *p++)]) != 0xff) {
+						saved = (saved << 6) | rank;
+						last[1] = last[0];
+						last[0] = c;
+					}
+				}
+				
+				outptr += nout;
+			}
+			
+			if (inptr == inend)
+				break;
+		}
+		
 		rank = gmime_base64_rank[(c = *inptr++)];
 		if (rank != 0xff) {
 			saved = (saved << 6) | rank;
@@ -936,14 +976,22 @@ g_mime_encoding_quoted_encode_close (const unsigned char *inbuf, size_t inlen, u
 size_t
 g_mime_encoding_quoted_encode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf, int *state, guint32 *save)
 {
-	register const unsigned char *inptr = inbuf;
+	const unsigned char *inptr = inbuf;
 	const unsigned char *inend = inbuf + inlen;
 	register unsigned char *outptr = outbuf;
-	register guint32 sofar = *save;  /* keeps track of how many chars on a line */
+	guint32 sofar = *save;  /* keeps track of how many chars on a line */
 	register int last = *state;  /* keeps track if last char to end was a space cr etc */
 	unsigned char c;
 	
 	while (inptr < inend) {
+		if (last == -1 && _g_mime_simd_quoted_encode && inend - inptr > SIMD_BLOCK_SIZE &&
+		    is_qpsafe (*inptr) && !is_blank (*inptr)) {
+			/* pass runs of safe characters through in bulk */
+			outptr += _g_mime_simd_quoted_encode (&inptr, inend, outptr, &sofar);
+			if (inptr == inend)
+				break;
+		}
+		
 		c = *inptr++;
 		if (c == '\r') {
 			if (last != -1) {
@@ -1036,7 +1084,7 @@ g_mime_encoding_quoted_decode_step (const unsigned char *inbuf, size_t inlen, un
 	 * Note: Trailing rubbish (at the end of input), like = or =x
 	 * or =\r will be lost.
 	 */
-	const register unsigned char *inptr = inbuf;
+	const unsigned char *inptr = inbuf;
 	const unsigned char *inend = inbuf + inlen;
 	register unsigned char *outptr = outbuf;
 	guint32 isave = *save;
@@ -1048,6 +1096,9 @@ g_mime_encoding_quoted_decode_step (const unsigned char *inbuf, size_t inlen, un
 	while (inptr < inend) {
 		switch (istate) {
 		case 0:
+			if (_g_mime_simd_quoted_decode && inend - inptr >= SIMD_BLOCK_SIZE)
+				outptr += _g_mime_simd_quoted_decode (&inptr, inend, outptr);
+			
 			while (inptr < inend) {
 				c = *inptr++;
 				/* FIXME: use a specials table to avoid 3 comparisons for the common case */
@@ -71,7 +71,7 @@ g_mime_event_new (gpointer owner)
 	GMimeEvent *event;
 	
 	event = g_slice_new (GMimeEvent);
-	event->array = g_ptr_array_new ();
+	event->array = NULL;
 	event->owner = owner;
 	
 	return event;
@@ -89,9 +89,11 @@ g_mime_event_free (GMimeEvent *event)
 {
 	guint i;
 	
-	for (i = 0; i < event->array->len; i++)
-		event_listener_free (event->array->pdata[i]);
-	g_ptr_array_free (event->array, TRUE);
+	if (event->array != NULL) {
+		for (i = 0; i < event->array->len; i++)
+			event_listener_free (event->array->pdata[i]);
+		g_ptr_array_free (event->array, TRUE);
+	}
 	
 	g_slice_free (GMimeEvent, event);
 }
@@ -103,6 +105,9 @@ g_mime_event_index_of (GMimeEvent *event, GMimeEventCallback callback, gpointer
 	EventListener *listener;
 	int i;
 	
+	if (event->array == NULL)
+		return -1;
+	
 	for (i = 0; i < event->array->len; i++) {
 		listener = (EventListener *) event->array->pdata[i];
 		if (listener->callback == callback && listener->user_data == user_data)
@@ -172,6 +177,10 @@ g_mime_event_add (GMimeEvent *event, GMimeEventCallback callback, gpointer user_
 {
 	EventListener *listener;
 	
+	/* most events never get a listener, so only allocate the array on demand */
+	if (event->array == NULL)
+		event->array = g_ptr_array_new ();
+	
 	listener = event_listener_new (callback, user_data);
 	g_ptr_array_add (event->array, listener);
 }
@@ -215,6 +224,9 @@ g_mime_event_emit (GMimeEvent *event, gpointer args)
 	EventListener *listener;
 	guint i;
 	
+	if (event->array == NULL)
+		return;
+	
 	for (i = 0; i < event->array->len; i++) {
 		listener = (EventListener *) event->array->pdata[i];
 		if (listener->blocked <= 0)
@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "gmime-filter-best.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -138,7 +139,26 @@ filter_filter (GMimeFilter *filter, char *inbuf, size_t inlen, size_t prespace,
 		while (inptr < inend) {
 			c = 0;
 			
-			if (best->midline) {
+			if (best->midline && _g_mime_simd_count_8bit && (best->fromlen == 0 || best->fromlen >= 5)) {
+				unsigned char *eoln = memchr (inptr, '\n', inend - inptr);
+				size_t count0 = 0, count8 = 0;
+				size_t n;
+				
+				n = (eoln ? eoln : inend) - inptr;
+				_g_mime_simd_count_8bit (inptr, n, &count0, &count8);
+				best->count0 += count0;
+				best->count8 += count8;
+				best->linelen += n;
+				inptr += n;
+				
+				if (eoln) {
+					inptr++;
+					best->maxline = MAX (best->maxline, best->linelen);
+					best->startline = TRUE;
+					best->midline = FALSE;
+					best->linelen = 0;
+				}
+			} else if (best->midline) {
 				while (inptr < inend && (c = *inptr++) != '\n') {
 					if (c == 0)
 						best->count0++;
@@ -28,6 +28,7 @@
 #include "gmime-filter-charset.h"
 #include "gmime-charset.h"
 #include "gmime-iconv.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -147,7 +148,7 @@ filter_filter (GMimeFilter *filter, char *in, size_t len, size_t prespace,
 	inleft = len;
 	
 	do {
-		converted = iconv (charset->cd, &inbuf, &inleft, &outbuf, &outleft);
+		converted = _g_mime_iconv (charset->cd, &inbuf, &inleft, &outbuf, &outleft);
 		if (converted == (size_t) -1) {
 			if (errno == E2BIG || errno == EINVAL)
 				break;
@@ -215,7 +216,7 @@ filter_complete (GMimeFilter *filter, char *in, size_t len, size_t prespace,
 	
 	if (inleft > 0) {
 		do {
-			converted = iconv (charset->cd, &inbuf, &inleft, &outbuf, &outleft);
+			converted = _g_mime_iconv (charset->cd, &inbuf, &inleft, &outbuf, &outleft);
 			if (converted != (size_t) -1)
 				continue;
 			
@@ -258,7 +259,7 @@ filter_complete (GMimeFilter *filter, char *in, size_t len, size_t prespace,
 	}
 	
 	/* flush the iconv conversion */
-	while (iconv (charset->cd, NULL, NULL, &outbuf, &outleft) == (size_t) -1) {
+	while (_g_mime_iconv (charset->cd, NULL, NULL, &outbuf, &outleft) == (size_t) -1) {
 		if (errno != E2BIG)
 			break;
 		
@@ -287,7 +288,7 @@ filter_reset (GMimeFilter *filter)
 	GMimeFilterCharset *charset = (GMimeFilterCharset *) filter;
 	
 	if (charset->cd != (iconv_t) -1)
-		iconv (charset->cd, NULL, NULL, NULL, NULL);
+		_g_mime_iconv (charset->cd, NULL, NULL, NULL, NULL);
 }
 
 
@@ -307,7 +308,7 @@ g_mime_filter_charset_new (const char *from_charset, const char *to_charset)
 	GMimeFilterCharset *charset;
 	iconv_t cd;
 	
-	cd = g_mime_iconv_open (to_charset, from_charset);
+	cd = _g_mime_iconv_open (to_charset, from_charset);
 	if (cd == (iconv_t) -1)
 		return NULL;
 	
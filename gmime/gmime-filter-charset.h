@@ -45,6 +45,10 @@ typedef struct _GMimeFilterCharsetClass GMimeFilterCharsetClass;
  * @cd: (type gpointer): charset conversion state
  *
  * A filter to convert between charsets.
+ *
+ * Note: For common single-byte charsets, @cd may be one of GMime's
+ * built-in converters rather than a descriptor returned by
+ * iconv_open(). It must not be passed to iconv() or iconv_close().
  **/
 struct _GMimeFilterCharset {
 	GMimeFilter parent_object;
@@ -0,0 +1,411 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <errno.h>
+
+#include "gmime-filter-dos2unix.h"
+#include "gmime-filter-charset.h"
+#include "gmime-filter-basic.h"
+#include "gmime-internal.h"
+
+
+/*
+ * GMimeFilterFused is a private filter used by GMimeStreamFilter in
+ * place of a GMimeFilterBasic decoder that is immediately followed by
+ * a GMimeFilterCharset and/or a GMimeFilterDos2Unix filter.
+ *
+ * Instead of each filter copying the data into its own output buffer,
+ * the decoder writes straight into the fused filter's output buffer
+ * (or, if charset conversion is needed, into a scratch buffer that
+ * iconv then reads from) and line endings are converted in-place.
+ *
+ * All of the decoder, charset and newline state lives in the original
+ * filters, so the output is identical to that of the unfused chain.
+ */
+
+#define GMIME_TYPE_FILTER_FUSED (g_mime_filter_fused_get_type ())
+
+typedef struct _GMimeFilterFused {
+	GMimeFilter parent_object;
+	
+	GMimeFilterBasic *decoder;
+	GMimeFilterCharset *charset;
+	GMimeFilterDos2Unix *dos2unix;
+	
+	char *scratch;       /* decoded data waiting to be charset converted */
+	size_t scratchsize;
+	size_t pendinglen;   /* incomplete multibyte sequence at the start of @scratch */
+} GMimeFilterFused;
+
+typedef struct _GMimeFilterFusedClass {
+	GMimeFilterClass parent_class;
+
+} GMimeFilterFusedClass;
+
+
+static void g_mime_filter_fused_class_init (GMimeFilterFusedClass *klass);
+static void g_mime_filter_fused_init (GMimeFilterFused *filter, GMimeFilterFusedClass *klass);
+static void g_mime_filter_fused_finalize (GObject *object);
+
+static GMimeFilter *g_mime_filter_fused_new (GMimeFilter *decoder, GMimeFilter *charset, GMimeFilter *dos2unix);
+
+static GMimeFilter *filter_copy (GMimeFilter *filter);
+static void filter_filter (GMimeFilter *filter, char *in, size_t len, size_t prespace,
+			   char **out, size_t *outlen, size_t *outprespace);
+static void filter_complete (GMimeFilter *filter, char *in, size_t len, size_t prespace,
+			     char **out, size_t *outlen, size_t *outprespace);
+static void filter_reset (GMimeFilter *filter);
+
+
+static GMimeFilterClass *parent_class = NULL;
+
+
+static GType
+g_mime_filter_fused_get_type (void)
+{
+	static GType type = 0;
+	
+	if (!type) {
+		static const GTypeInfo info = {
+			sizeof (GMimeFilterFusedClass),
+			NULL, /* base_class_init */
+			NULL, /* base_class_finalize */
+			(GClassInitFunc) g_mime_filter_fused_class_init,
+			NULL, /* class_finalize */
+			NULL, /* class_data */
+			sizeof (GMimeFilterFused),
+			0,    /* n_preallocs */
+			(GInstanceInitFunc) g_mime_filter_fused_init,
+		};
+		
+		type = g_type_register_static (GMIME_TYPE_FILTER, "GMimeFilterFused", &info, 0);
+	}
+	
+	return type;
+}
+
+
+static void
+g_mime_filter_fused_class_init (GMimeFilterFusedClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	GMimeFilterClass *filter_class = GMIME_FILTER_CLASS (klass);
+	
+	parent_class = g_type_class_ref (GMIME_TYPE_FILTER);
+	
+	object_class->finalize = g_mime_filter_fused_finalize;
+	
+	filter_class->copy = filter_copy;
+	filter_class->filter = filter_filter;
+	filter_class->complete = filter_complete;
+	filter_class->reset = filter_reset;
+}
+
+static void
+g_mime_filter_fused_init (GMimeFilterFused *filter, GMimeFilterFusedClass *klass)
+{
+	filter->decoder = NULL;
+	filter->charset = NULL;
+	filter->dos2unix = NULL;
+	filter->scratch = NULL;
+	filter->scratchsize = 0;
+	filter->pendinglen = 0;
+}
+
+static void
+g_mime_filter_fused_finalize (GObject *object)
+{
+	GMimeFilterFused *fused = (GMimeFilterFused *) object;
+	
+	g_object_unref (fused->decoder);
+	if (fused->charset)
+		g_object_unref (fused->charset);
+	if (fused->dos2unix)
+		g_object_unref (fused->dos2unix);
+	g_free (fused->scratch);
+	
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static GMimeFilter *
+filter_copy (GMimeFilter *filter)
+{
+	GMimeFilterFused *fused = (GMimeFilterFused *) filter;
+	GMimeFilter *decoder, *charset = NULL, *dos2unix = NULL;
+	GMimeFilter *copy;
+	
+	decoder = g_mime_filter_copy ((GMimeFilter *) fused->decoder);
+	if (fused->charset)
+		charset = g_mime_filter_copy ((GMimeFilter *) fused->charset);
+	if (fused->dos2unix)
+		dos2unix = g_mime_filter_copy ((GMimeFilter *) fused->dos2unix);
+	
+	copy = g_mime_filter_fused_new (decoder, charset, dos2unix);
+	
+	g_object_unref (decoder);
+	if (charset)
+		g_object_unref (charset);
+	if (dos2unix)
+		g_object_unref (dos2unix);
+	
+	return copy;
+}
+
+/* converts @inlen bytes of @scratch into @filter's outbuf, returns the number of bytes output */
+static size_t
+convert_charset (GMimeFilterFused *fused, size_t inlen, gboolean flush)
+{
+	GMimeFilter *filter = (GMimeFilter *) fused;
+	iconv_t cd = fused->charset->cd;
+	size_t inleft, outleft, converted;
+	char *inbuf, *outbuf;
+	
+	/* leave room for the newline that dos2unix may need to append */
+	g_mime_filter_set_size (filter, inlen * 5 + 17, FALSE);
+	outbuf = filter->outbuf;
+	outleft = filter->outsize - 1;
+	
+	inbuf = fused->scratch;
+	inleft = inlen;
+	
+	while (inleft > 0) {
+		if (_g_mime_iconv (cd, &inbuf, &inleft, &outbuf, &outleft) != (size_t) -1)
+			continue;
+		
+		if (errno == E2BIG) {
+			converted = outbuf - filter->outbuf;
+			g_mime_filter_set_size (filter, inleft * 5 + filter->outsize + 16, TRUE);
+			outbuf = filter->outbuf + converted;
+			outleft = filter->outsize - converted - 1;
+		} else if (errno == EILSEQ || errno == ERANGE) {
+			/* eat the invalid bytes in the sequence and continue */
+			inbuf++;
+			inleft--;
+		} else if (errno == EINVAL) {
+			/* incomplete multibyte sequence */
+			break;
+		} else {
+			/* unknown error condition: pass the data through as-is like GMimeFilterCharset */
+			g_mime_filter_set_size (filter, inlen + 1, FALSE);
+			memcpy (filter->outbuf, fused->scratch, inlen);
+			fused->pendinglen = 0;
+			
+			return inlen;
+		}
+	}
+	
+	if (flush) {
+		/* flush the iconv conversion, any incomplete sequence gets dropped */
+		while (_g_mime_iconv (cd, NULL, NULL, &outbuf, &outleft) == (size_t) -1) {
+			if (errno != E2BIG)
+				break;
+			
+			converted = outbuf - filter->outbuf;
+			g_mime_filter_set_size (filter, filter->outsize + 16, TRUE);
+			outbuf = filter->outbuf + converted;
+			outleft = filter->outsize - converted - 1;
+		}
+		
+		fused->pendinglen = 0;
+	} else {
+		/* save the incomplete sequence for next time */
+		memmove (fused->scratch, inbuf, inleft);
+		fused->pendinglen = inleft;
+	}
+	
+	return outbuf - filter->outbuf;
+}
+
+/* converts CRLF to LF in-place, the output may start 1 byte before @inbuf */
+static char *
+convert_newlines (GMimeFilterDos2Unix *dos2unix, char *inbuf, size_t *len, gboolean flush)
+{
+	register const char *inptr = inbuf;
+	const char *inend = inbuf + *len;
+	char *outptr, *outbuf;
+	char c;
+	
+	/* a CR held back from the previous buffer needs to be output if not followed by a LF */
+	outbuf = outptr = dos2unix->pc == '\r' ? inbuf - 1 : inbuf;
+	
+	while (inptr < inend) {
+		c = *inptr++;
+		
+		if (c == '\n') {
+			*outptr++ = c;
+		} else {
+			if (dos2unix->pc == '\r')
+				*outptr++ = dos2unix->pc;
+			
+			if (c != '\r')
+				*outptr++ = c;
+		}
+		
+		dos2unix->pc = c;
+	}
+	
+	if (flush && dos2unix->ensure_newline && dos2unix->pc != '\n')
+		dos2unix->pc = *outptr++ = '\n';
+	
+	*len = outptr - outbuf;
+	
+	return outbuf;
+}
+
+static void
+fused_filter (GMimeFilter *filter, char *in, size_t len, char **out, size_t *outlen,
+	      size_t *outprespace, gboolean flush)
+{
+	GMimeFilterFused *fused = (GMimeFilterFused *) filter;
+	GMimeEncoding *encoder = &fused->decoder->encoder;
+	size_t outsize, n;
+	char *outbuf;
+	
+	outsize = g_mime_encoding_outlen (encoder, len);
+	
+	if (fused->charset != NULL) {
+		/* decode after any incomplete multibyte sequence left over from the last time */
+		if (fused->scratchsize < fused->pendinglen + outsize) {
+			fused->scratchsize = fused->pendinglen + outsize;
+			fused->scratch = g_realloc (fused->scratch, fused->scratchsize);
+		}
+		
+		if (flush)
+			n = g_mime_encoding_flush (encoder, in, len, fused->scratch + fused->pendinglen);
+		else
+			n = g_mime_encoding_step (encoder, in, len, fused->scratch + fused->pendinglen);
+		
+		n = convert_charset (fused, fused->pendinglen + n, flush);
+	} else {
+		g_mime_filter_set_size (filter, outsize + 1, FALSE);
+		
+		if (flush)
+			n = g_mime_encoding_flush (encoder, in, len, filter->outbuf);
+		else
+			n = g_mime_encoding_step (encoder, in, len, filter->outbuf);
+	}
+	
+	outbuf = filter->outbuf;
+	
+	/* note: the filter always has some prespace in front of outbuf */
+	if (fused->dos2unix != NULL)
+		outbuf = convert_newlines (fused->dos2unix, outbuf, &n, flush);
+	
+	*outprespace = filter->outpre - (filter->outbuf - outbuf);
+	*out = outbuf;
+	*outlen = n;
+}
+
+static void
+filter_filter (GMimeFilter *filter, char *in, size_t len, size_t prespace,
+	       char **out, size_t *outlen, size_t *outprespace)
+{
+	fused_filter (filter, in, len, out, outlen, outprespace, FALSE);
+}
+
+static void
+filter_complete (GMimeFilter *filter, char *in, size_t len, size_t prespace,
+		 char **out, size_t *outlen, size_t *outprespace)
+{
+	fused_filter (filter, in, len, out, outlen, outprespace, TRUE);
+}
+
+static void
+filter_reset (GMimeFilter *filter)
+{
+	GMimeFilterFused *fused = (GMimeFilterFused *) filter;
+	
+	g_mime_filter_reset ((GMimeFilter *) fused->decoder);
+	if (fused->charset)
+		g_mime_filter_reset ((GMimeFilter *) fused->charset);
+	if (fused->dos2unix)
+		g_mime_filter_reset ((GMimeFilter *) fused->dos2unix);
+	
+	fused->pendinglen = 0;
+}
+
+
+static GMimeFilter *
+g_mime_filter_fused_new (GMimeFilter *decoder, GMimeFilter *charset, GMimeFilter *dos2unix)
+{
+	GMimeFilterFused *fused;
+	
+	fused = g_object_new (GMIME_TYPE_FILTER_FUSED, NULL);
+	fused->decoder = g_object_ref (decoder);
+	fused->charset = charset ? g_object_ref (charset) : NULL;
+	fused->dos2unix = dos2unix ? g_object_ref (dos2unix) : NULL;
+	
+	return (GMimeFilter *) fused;
+}
+
+
+/**
+ * _g_mime_filter_fuse:
+ * @decoder: the first #GMimeFilter of the chain
+ * @next: (nullable): the #GMimeFilter following @decoder or %NULL
+ * @last: (nullable): the #GMimeFilter following @next or %NULL
+ * @nfused: the number of filters replaced by the fused filter
+ *
+ * Checks whether a base64 or quoted-printable decoding
+ * #GMimeFilterBasic followed by a #GMimeFilterCharset and/or a
+ * #GMimeFilterDos2Unix can be replaced by a single fused filter that
+ * produces the same output in a single pass and, if so, creates it.
+ *
+ * Returns: a new fused filter or %NULL if the filters cannot be fused.
+ **/
+GMimeFilter *
+_g_mime_filter_fuse (GMimeFilter *decoder, GMimeFilter *next, GMimeFilter *last, int *nfused)
+{
+	GMimeFilter *charset = NULL, *dos2unix = NULL;
+	GMimeEncoding *encoder;
+	
+	*nfused = 0;
+	
+	if (G_OBJECT_TYPE (decoder) != GMIME_TYPE_FILTER_BASIC || decoder->backlen > 0)
+		return NULL;
+	
+	encoder = &((GMimeFilterBasic *) decoder)->encoder;
+	if (encoder->encode || (encoder->encoding != GMIME_CONTENT_ENCODING_BASE64 &&
+				encoder->encoding != GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE))
+		return NULL;
+	
+	if (next != NULL && G_OBJECT_TYPE (next) == GMIME_TYPE_FILTER_CHARSET &&
+	    ((GMimeFilterCharset *) next)->cd != (iconv_t) -1 && next->backlen == 0) {
+		charset = next;
+		next = last;
+	}
+	
+	if (next != NULL && G_OBJECT_TYPE (next) == GMIME_TYPE_FILTER_DOS2UNIX)
+		dos2unix = next;
+	
+	if (charset == NULL && dos2unix == NULL)
+		return NULL;
+	
+	*nfused = 1 + (charset ? 1 : 0) + (dos2unix ? 1 : 0);
+	
+	return g_mime_filter_fused_new (decoder, charset, dos2unix);
+}
@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "gmime-filter-yenc.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -422,6 +423,28 @@ static const int yenc_crc_table[256] = {
 
 #define YENC_NEWLINE_ESCAPE (GMIME_YDECODE_STATE_EOLN | GMIME_YDECODE_STATE_ESCAPE)
 
+#define SIMD_BLOCK_SIZE 16
+
+static guint32
+yenc_crc_update (guint32 crc, const unsigned char *inbuf, size_t inlen)
+{
+	const unsigned char *inend = inbuf + inlen;
+	size_t n;
+	
+	if (_g_mime_simd_crc32 && inlen >= 64) {
+		n = inlen & ~((size_t) 15);
+		crc = _g_mime_simd_crc32 (crc, inbuf, n);
+		inbuf += n;
+	}
+	
+	while (inbuf < inend) {
+		crc = yenc_crc_add (crc, *inbuf);
+		inbuf++;
+	}
+	
+	return crc;
+}
+
 
 /**
  * g_mime_ydecode_step:
@@ -448,7 +471,7 @@ size_t
 g_mime_ydecode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf,
 		     int *state, guint32 *pcrc, guint32 *crc)
 {
-	register const unsigned char *inptr;
+	const unsigned char *inptr;
 	register unsigned char *outptr;
 	const unsigned char *inend;
 	unsigned char c;
@@ -464,6 +487,14 @@ g_mime_ydecode_step (const unsigned char *inbuf, size_t inlen, unsigned char *ou
 	
 	inptr = inbuf;
 	while (inptr < inend) {
+		if (_g_mime_simd_ydecode && !(ystate & YENC_NEWLINE_ESCAPE) && inend - inptr >= SIMD_BLOCK_SIZE) {
+			/* decode the bulk of the line; the kernel leaves
+			 * anything that affects our state up to us */
+			outptr += _g_mime_simd_ydecode (&inptr, inend, outptr);
+			if (inptr == inend)
+				break;
+		}
+		
 		c = *inptr++;
 		
 		if ((ystate & YENC_NEWLINE_ESCAPE) == YENC_NEWLINE_ESCAPE) {
@@ -491,12 +522,12 @@ g_mime_ydecode_step (const unsigned char *inbuf, size_t inlen, unsigned char *ou
 		
 		ystate &= ~GMIME_YDECODE_STATE_EOLN;
 		
-		*outptr++ = c -= 42;
-		
-		*pcrc = yenc_crc_add (*pcrc, c);
-		*crc = yenc_crc_add (*crc, c);
+		*outptr++ = c - 42;
 	}
 	
+	*pcrc = yenc_crc_update (*pcrc, outbuf, outptr - outbuf);
+	*crc = yenc_crc_update (*crc, outbuf, outptr - outbuf);
+	
 	*state = ystate;
 	
 	return outptr - outbuf;
@@ -528,10 +559,10 @@ size_t
 g_mime_yencode_step (const unsigned char *inbuf, size_t inlen, unsigned char *outbuf,
 		     int *state, guint32 *pcrc, guint32 *crc)
 {
-	register const unsigned char *inptr;
+	const unsigned char *inptr;
 	register unsigned char *outptr;
 	const unsigned char *inend;
-	register int already;
+	int already;
 	unsigned char c;
 	
 	inend = inbuf + inlen;
@@ -539,13 +570,16 @@ g_mime_yencode_step (const unsigned char *inbuf, size_t inlen, unsigned char *ou
 	
 	already = *state;
 	
+	*pcrc = yenc_crc_update (*pcrc, inbuf, inlen);
+	*crc = yenc_crc_update (*crc, inbuf, inlen);
+	
 	inptr = inbuf;
+	if (_g_mime_simd_yencode)
+		outptr += _g_mime_simd_yencode (&inptr, inend, outptr, &already);
+	
 	while (inptr < inend) {
 		c = *inptr++;
 		
-		*pcrc = yenc_crc_add (*pcrc, c);
-		*crc = yenc_crc_add (*crc, c);
-		
 		c += 42;
 		
 		if (c == '\0' || c == '\t' || c == '\r' || c == '\n' || c == '=') {
@@ -26,6 +26,7 @@
 #include <string.h> /* for memcpy */
 
 #include "gmime-filter.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -42,6 +43,8 @@
 struct _GMimeFilterPrivate {
 	char *inbuf;
 	size_t inlen;
+	
+	size_t headroom;	/* prespace the next filter needs in front of our output */
 };
 
 #define PRE_HEAD (64)
@@ -164,7 +167,12 @@ filter_run (GMimeFilter *filter, char *inbuf, size_t inlen, size_t prespace,
 				char **outbuf, size_t *outlen, size_t *outprespace))
 {
 	/* here we take a performance hit, if the input buffer doesn't
-	   have the pre-space required.  We make a buffer that does... */
+	   have the pre-space required.  We make a buffer that does...
+	
+	   GMimeStreamFilter tries hard to avoid this by reserving
+	   enough headroom in front of each filter's input (see
+	   _g_mime_filter_reserve_headroom), so this should only
+	   happen for caller-supplied buffers. */
 	if (prespace < filter->backlen) {
 		struct _GMimeFilterPrivate *p = _PRIVATE (filter);
 		size_t newlen = inlen + prespace + filter->backlen;
@@ -322,25 +330,61 @@ g_mime_filter_backup (GMimeFilter *filter, const char *data, size_t length)
 void
 g_mime_filter_set_size (GMimeFilter *filter, size_t size, gboolean keep)
 {
+	size_t outpre;
+	
 	g_return_if_fail (GMIME_IS_FILTER (filter));
 	
-	if (!filter->outreal || filter->outsize < size) {
-		size_t offset = filter->outptr - filter->outreal;
+	outpre = MAX (PRE_HEAD * 4, filter->priv->headroom);
+	
+	if (!filter->outreal || filter->outsize < size || filter->outpre < outpre) {
+		size_t offset = filter->outptr - filter->outbuf;
+		
+		size = MAX (size, filter->outsize);
 		
-		if (keep) {
-			filter->outreal = g_realloc (filter->outreal, size + PRE_HEAD * 4);
+		if (keep && filter->outreal && filter->outpre != outpre) {
+			/* the prespace moved, so the existing data has to move with it */
+			char *outreal = g_malloc (size + outpre);
+			
+			memcpy (outreal + outpre, filter->outbuf, filter->outsize);
+			g_free (filter->outreal);
+			filter->outreal = outreal;
+		} else if (keep) {
+			filter->outreal = g_realloc (filter->outreal, size + outpre);
 		} else {
 			g_free (filter->outreal);
-			filter->outreal = g_malloc (size + PRE_HEAD * 4);
+			filter->outreal = g_malloc (size + outpre);
 		}
 		
-		filter->outptr = filter->outreal + offset;
-		filter->outbuf = filter->outreal + PRE_HEAD * 4;
+		filter->outbuf = filter->outreal + outpre;
+		filter->outptr = filter->outbuf + offset;
 		filter->outsize = size;
 		
 		/* this could be offset from the end of the structure, but 
 		   this should be good enough */
 		
-		filter->outpre = PRE_HEAD * 4;
+		filter->outpre = outpre;
 	}
 }
+
+
+/**
+ * _g_mime_filter_reserve_headroom:
+ * @filter: filter
+ * @headroom: number of bytes of prespace needed
+ *
+ * Requests that the output buffer of @filter always be preceded by
+ * at least @headroom bytes of prespace so that the filter consuming
+ * its output can preload its backed up data in place rather than
+ * having to copy the entire buffer.
+ **/
+void
+_g_mime_filter_reserve_headroom (GMimeFilter *filter, size_t headroom)
+{
+	struct _GMimeFilterPrivate *p = _PRIVATE (filter);
+	
+	if (headroom <= p->headroom)
+		return;
+	
+	/* round up to avoid creeping reallocations */
+	p->headroom = (headroom + (PRE_HEAD - 1)) & ~((size_t) PRE_HEAD - 1);
+}
@@ -225,15 +225,10 @@ g_mime_header_get_name (GMimeHeader *header)
 const char *
 g_mime_header_get_value (GMimeHeader *header)
 {
-	char *buf;
-	
 	g_return_val_if_fail (GMIME_IS_HEADER (header), NULL);
 	
-	if (!header->value && header->raw_value) {
-		buf = g_mime_utils_header_unfold (header->raw_value);
-		header->value = _g_mime_utils_header_decode_text (header->options, buf, NULL, header->offset);
-		g_free (buf);
-	}
+	if (!header->value && header->raw_value)
+		header->value = _g_mime_utils_header_unfold_decode_text (header->options, header->raw_value, NULL, header->offset);
 	
 	return header->value;
 }
@@ -1192,6 +1187,38 @@ _g_mime_header_list_append (GMimeHeaderList *headers, const char *name, const ch
 }
 
 
+/**
+ * _g_mime_header_list_append_copy:
+ * @headers: a #GMimeHeaderList
+ * @header: the #GMimeHeader to copy
+ *
+ * Appends a copy of @header, including its decoded value, so that
+ * neither the raw nor the decoded value need to be parsed again.
+ **/
+void
+_g_mime_header_list_append_copy (GMimeHeaderList *headers, GMimeHeader *header)
+{
+	GMimeHeaderListChangedEventArgs args;
+	GMimeHeader *copy;
+	
+	copy = g_mime_header_new (headers->options, header->name, header->value, header->raw_name,
+				  header->raw_value, header->charset, header->offset);
+	copy->formatter = header->formatter;
+	copy->reformat = header->reformat;
+	
+	g_mime_event_add (copy->changed, (GMimeEventCallback) header_changed, headers);
+	g_ptr_array_add (headers->array, copy);
+	
+	if (!g_hash_table_lookup (headers->hash, copy->name))
+		g_hash_table_insert (headers->hash, copy->name, copy);
+	
+	args.action = GMIME_HEADER_LIST_CHANGED_ACTION_ADDED;
+	args.header = copy;
+	
+	g_mime_event_emit (headers->changed, &args);
+}
+
+
 /**
  * g_mime_header_list_append:
  * @headers: a #GMimeHeaderList
@@ -1536,3 +1563,63 @@ g_mime_header_list_to_string (GMimeHeaderList *headers, GMimeFormatOptions *opti
 	
 	return str;
 }
+
+
+/**
+ * g_mime_header_list_decode_values:
+ * @headers: a #GMimeHeaderList
+ *
+ * Decodes the values of all of the headers in @headers at once. The
+ * returned vector and all of the decoded strings it points to are
+ * allocated as a single block, so the whole thing can be released
+ * with a single call to g_free().
+ *
+ * The value at index i corresponds to the header returned by
+ * g_mime_header_list_get_header_at() for the same index and is
+ * identical to what g_mime_header_get_value() would return for it.
+ *
+ * Returns: (array zero-terminated=1) (transfer container): a
+ * %NULL-terminated vector of decoded header values.
+ **/
+char **
+g_mime_header_list_decode_values (GMimeHeaderList *headers)
+{
+	GMimeHeader *header;
+	gsize *offsets;
+	GString *arena;
+	char **values;
+	char *strings;
+	gsize size;
+	guint i;
+	
+	g_return_val_if_fail (GMIME_IS_HEADER_LIST (headers), NULL);
+	
+	offsets = g_new (gsize, headers->array->len + 1);
+	arena = g_string_sized_new (1024);
+	
+	for (i = 0; i < headers->array->len; i++) {
+		header = (GMimeHeader *) headers->array->pdata[i];
+		offsets[i] = arena->len;
+		
+		if (header->value)
+			g_string_append (arena, header->value);
+		else if (header->raw_value)
+			_g_mime_utils_header_unfold_decode_text_append (header->options, header->raw_value, NULL, header->offset, arena);
+		
+		g_string_append_c (arena, '\0');
+	}
+	
+	size = sizeof (char *) * (headers->array->len + 1);
+	values = g_malloc (size + arena->len);
+	strings = ((char *) values) + size;
+	memcpy (strings, arena->str, arena->len);
+	g_string_free (arena, TRUE);
+	
+	for (i = 0; i < headers->array->len; i++)
+		values[i] = strings + offsets[i];
+	
+	values[i] = NULL;
+	g_free (offsets);
+	
+	return values;
+}
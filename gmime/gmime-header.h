@@ -158,6 +158,8 @@ void g_mime_header_list_remove_at (GMimeHeaderList *headers, int index);
 ssize_t g_mime_header_list_write_to_stream (GMimeHeaderList *headers, GMimeFormatOptions *options, GMimeStream *stream);
 char *g_mime_header_list_to_string (GMimeHeaderList *headers, GMimeFormatOptions *options);
 
+char **g_mime_header_list_decode_values (GMimeHeaderList *headers);
+
 G_END_DECLS
 
 #endif /* __GMIME_HEADER_H__ */
@@ -0,0 +1,534 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "gmime-charset.h"
+#include "gmime-internal.h"
+
+
+/*
+ * Built-in converters between UTF-8 and the most common single-byte
+ * charsets, plus a validating UTF-8 to UTF-8 copy.
+ *
+ * The converters follow the iconv(3) calling convention (including
+ * the E2BIG, EILSEQ and EINVAL error conditions) so that they can be
+ * used anywhere an iconv descriptor is expected internally, see
+ * _g_mime_iconv_open(). Since none of these charsets are stateful,
+ * the descriptors are shared and never need to be reset or closed.
+ *
+ * The byte to code point tables match glibc's CP1251, CP1252,
+ * ISO-8859-15 and KOI8-R converters; unmapped bytes are 0.
+ */
+
+
+static const guint16 iso_8859_15_table[128] = {
+	0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,
+	0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,
+	0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,
+	0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,
+	0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20ac, 0x00a5, 0x0160, 0x00a7,
+	0x0161, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+	0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x017d, 0x00b5, 0x00b6, 0x00b7,
+	0x017e, 0x00b9, 0x00ba, 0x00bb, 0x0152, 0x0153, 0x0178, 0x00bf,
+	0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+	0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+	0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+	0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+	0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+	0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+	0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+	0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff
+};
+
+static const guint16 windows_1251_table[128] = {
+	0x0402, 0x0403, 0x201a, 0x0453, 0x201e, 0x2026, 0x2020, 0x2021,
+	0x20ac, 0x2030, 0x0409, 0x2039, 0x040a, 0x040c, 0x040b, 0x040f,
+	0x0452, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+	0x0000, 0x2122, 0x0459, 0x203a, 0x045a, 0x045c, 0x045b, 0x045f,
+	0x00a0, 0x040e, 0x045e, 0x0408, 0x00a4, 0x0490, 0x00a6, 0x00a7,
+	0x0401, 0x00a9, 0x0404, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x0407,
+	0x00b0, 0x00b1, 0x0406, 0x0456, 0x0491, 0x00b5, 0x00b6, 0x00b7,
+	0x0451, 0x2116, 0x0454, 0x00bb, 0x0458, 0x0405, 0x0455, 0x0457,
+	0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+	0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,
+	0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+	0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,
+	0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+	0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+	0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+	0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f
+};
+
+static const guint16 windows_1252_table[128] = {
+	0x20ac, 0x0000, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+	0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x0000, 0x017d, 0x0000,
+	0x0000, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+	0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x0000, 0x017e, 0x0178,
+	0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,
+	0x00a8, 0x00a9, 0x00aa, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,
+	0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,
+	0x00b8, 0x00b9, 0x00ba, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,
+	0x00c0, 0x00c1, 0x00c2, 0x00c3, 0x00c4, 0x00c5, 0x00c6, 0x00c7,
+	0x00c8, 0x00c9, 0x00ca, 0x00cb, 0x00cc, 0x00cd, 0x00ce, 0x00cf,
+	0x00d0, 0x00d1, 0x00d2, 0x00d3, 0x00d4, 0x00d5, 0x00d6, 0x00d7,
+	0x00d8, 0x00d9, 0x00da, 0x00db, 0x00dc, 0x00dd, 0x00de, 0x00df,
+	0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+	0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+	0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x00f7,
+	0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff
+};
+
+static const guint16 koi8_r_table[128] = {
+	0x2500, 0x2502, 0x250c, 0x2510, 0x2514, 0x2518, 0x251c, 0x2524,
+	0x252c, 0x2534, 0x253c, 0x2580, 0x2584, 0x2588, 0x258c, 0x2590,
+	0x2591, 0x2592, 0x2593, 0x2320, 0x25a0, 0x2219, 0x221a, 0x2248,
+	0x2264, 0x2265, 0x00a0, 0x2321, 0x00b0, 0x00b2, 0x00b7, 0x00f7,
+	0x2550, 0x2551, 0x2552, 0x0451, 0x2553, 0x2554, 0x2555, 0x2556,
+	0x2557, 0x2558, 0x2559, 0x255a, 0x255b, 0x255c, 0x255d, 0x255e,
+	0x255f, 0x2560, 0x2561, 0x0401, 0x2562, 0x2563, 0x2564, 0x2565,
+	0x2566, 0x2567, 0x2568, 0x2569, 0x256a, 0x256b, 0x256c, 0x00a9,
+	0x044e, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433,
+	0x0445, 0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e,
+	0x043f, 0x044f, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432,
+	0x044c, 0x044b, 0x0437, 0x0448, 0x044d, 0x0449, 0x0447, 0x044a,
+	0x042e, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413,
+	0x0425, 0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e,
+	0x041f, 0x042f, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412,
+	0x042c, 0x042b, 0x0417, 0x0428, 0x042d, 0x0429, 0x0427, 0x042a
+};
+
+typedef struct {
+	guint16 c;
+	guint8 byte;
+} UnicodeMapping;
+
+typedef struct {
+	const char *name;
+	const guint16 *table;
+	UnicodeMapping reverse[128];
+	guint nreverse;
+} BuiltinCharset;
+
+typedef struct {
+	BuiltinCharset *charset;
+	gboolean to_utf8;
+} BuiltinConverter;
+
+static guint16 iso_8859_1_table[128];
+static guint16 us_ascii_table[128];
+
+static BuiltinCharset builtin_charsets[] = {
+	{ "us-ascii",       us_ascii_table,     },
+	{ "iso-8859-1",     iso_8859_1_table,   },
+	{ "iso-8859-15",    iso_8859_15_table,  },
+	{ "windows-cp1251", windows_1251_table, },
+	{ "windows-cp1252", windows_1252_table, },
+	{ "koi8-r",         koi8_r_table,       },
+};
+
+/* the first 2 * G_N_ELEMENTS (builtin_charsets) converters are the
+ * single-byte converters, the last one is the UTF-8 copy */
+static BuiltinConverter builtin_converters[2 * G_N_ELEMENTS (builtin_charsets) + 1];
+
+#define UTF8_CONVERTER (&builtin_converters[G_N_ELEMENTS (builtin_converters) - 1])
+
+static int
+unicode_mapping_compare (const void *a, const void *b)
+{
+	const UnicodeMapping *ma = a, *mb = b;
+	
+	return (int) ma->c - (int) mb->c;
+}
+
+
+/**
+ * g_mime_iconv_builtin_init:
+ *
+ * Initializes the reverse (code point to byte) tables for the
+ * built-in charset converters.
+ **/
+void
+g_mime_iconv_builtin_init (void)
+{
+	BuiltinCharset *charset;
+	guint i, j;
+	
+	for (i = 0; i < 128; i++)
+		iso_8859_1_table[i] = 128 + i;
+	
+	for (i = 0; i < G_N_ELEMENTS (builtin_charsets); i++) {
+		charset = &builtin_charsets[i];
+		charset->nreverse = 0;
+		
+		for (j = 0; j < 128; j++) {
+			if (charset->table[j] == 0)
+				continue;
+			
+			charset->reverse[charset->nreverse].c = charset->table[j];
+			charset->reverse[charset->nreverse].byte = 128 + j;
+			charset->nreverse++;
+		}
+		
+		qsort (charset->reverse, charset->nreverse, sizeof (UnicodeMapping), unicode_mapping_compare);
+		
+		builtin_converters[i * 2].charset = charset;
+		builtin_converters[i * 2].to_utf8 = TRUE;
+		builtin_converters[i * 2 + 1].charset = charset;
+		builtin_converters[i * 2 + 1].to_utf8 = FALSE;
+	}
+	
+	UTF8_CONVERTER->charset = NULL;
+	UTF8_CONVERTER->to_utf8 = TRUE;
+}
+
+static BuiltinCharset *
+builtin_charset_lookup (const char *name)
+{
+	guint i;
+	
+	name = g_mime_charset_canon_name (name);
+	
+	for (i = 0; i < G_N_ELEMENTS (builtin_charsets); i++) {
+		if (!g_ascii_strcasecmp (builtin_charsets[i].name, name))
+			return &builtin_charsets[i];
+	}
+	
+	return NULL;
+}
+
+static gboolean
+is_utf8 (const char *name)
+{
+	return !g_ascii_strcasecmp (g_mime_charset_iconv_name (name), "UTF-8");
+}
+
+
+/**
+ * _g_mime_iconv_builtin_open:
+ * @to: charset to convert to
+ * @from: charset to convert from
+ *
+ * Looks up a built-in converter for converting from charset @from to
+ * charset @to.
+ *
+ * Returns: the built-in converter or (iconv_t) %-1 if there isn't one.
+ **/
+iconv_t
+_g_mime_iconv_builtin_open (const char *to, const char *from)
+{
+	BuiltinCharset *charset;
+	guint i;
+	
+	if (builtin_converters[0].charset == NULL)
+		return (iconv_t) -1;
+	
+	if (is_utf8 (to)) {
+		if (is_utf8 (from))
+			return (iconv_t) UTF8_CONVERTER;
+		
+		if (!(charset = builtin_charset_lookup (from)))
+			return (iconv_t) -1;
+		
+		i = charset - builtin_charsets;
+		
+		return (iconv_t) &builtin_converters[i * 2];
+	} else if (is_utf8 (from)) {
+		if (!(charset = builtin_charset_lookup (to)))
+			return (iconv_t) -1;
+		
+		i = charset - builtin_charsets;
+		
+		return (iconv_t) &builtin_converters[i * 2 + 1];
+	}
+	
+	return (iconv_t) -1;
+}
+
+
+/**
+ * _g_mime_iconv_is_builtin:
+ * @cd: conversion descriptor
+ *
+ * Checks whether @cd is one of the built-in converters.
+ *
+ * Returns: %TRUE if @cd is a built-in converter or %FALSE otherwise.
+ **/
+gboolean
+_g_mime_iconv_is_builtin (iconv_t cd)
+{
+	BuiltinConverter *converter = (BuiltinConverter *) cd;
+	
+	return converter >= builtin_converters && converter < builtin_converters + G_N_ELEMENTS (builtin_converters);
+}
+
+/* copies the run of 7-bit characters at the start of the input */
+static size_t
+ascii_copy (const unsigned char **inbuf, size_t inleft, unsigned char **outbuf, size_t outleft)
+{
+	size_t n = MIN (inleft, outleft);
+	const unsigned char *inptr;
+	unsigned char max;
+	
+	if (_g_mime_simd_ascii_span) {
+		n = _g_mime_simd_ascii_span (*inbuf, n, &max);
+	} else {
+		for (inptr = *inbuf; inptr < *inbuf + n && *inptr < 128; inptr++)
+			;
+		
+		n = inptr - *inbuf;
+	}
+	
+	memcpy (*outbuf, *inbuf, n);
+	*outbuf += n;
+	*inbuf += n;
+	
+	return n;
+}
+
+/* decodes a single UTF-8 encoded character, returning its length, 0
+ * if the sequence is incomplete or -1 if the sequence is invalid */
+static int
+utf8_decode (const unsigned char *inptr, size_t inleft, gunichar *u)
+{
+	unsigned char min = 0x80, max = 0xbf;
+	size_t len, i;
+	gunichar c;
+	
+	c = *inptr;
+	
+	if (c < 0x80) {
+		*u = c;
+		return 1;
+	} else if (c < 0xc2) {
+		return -1;
+	} else if (c < 0xe0) {
+		c &= 0x1f;
+		len = 2;
+	} else if (c < 0xf0) {
+		if (c == 0xe0)
+			min = 0xa0;
+		else if (c == 0xed)
+			max = 0x9f;
+		c &= 0x0f;
+		len = 3;
+	} else if (c < 0xf5) {
+		if (c == 0xf0)
+			min = 0x90;
+		else if (c == 0xf4)
+			max = 0x8f;
+		c &= 0x07;
+		len = 4;
+	} else {
+		return -1;
+	}
+	
+	for (i = 1; i < len; i++) {
+		if (i == inleft)
+			return 0;
+		
+		if (inptr[i] < min || inptr[i] > max)
+			return -1;
+		
+		c = (c << 6) | (inptr[i] & 0x3f);
+		min = 0x80;
+		max = 0xbf;
+	}
+	
+	*u = c;
+	
+	return (int) len;
+}
+
+static size_t
+utf8_encode (gunichar c, unsigned char *outbuf)
+{
+	if (c < 0x800) {
+		outbuf[0] = 0xc0 | (c >> 6);
+		outbuf[1] = 0x80 | (c & 0x3f);
+		return 2;
+	}
+	
+	outbuf[0] = 0xe0 | (c >> 12);
+	outbuf[1] = 0x80 | ((c >> 6) & 0x3f);
+	outbuf[2] = 0x80 | (c & 0x3f);
+	
+	return 3;
+}
+
+static size_t
+convert_to_utf8 (BuiltinCharset *charset, const unsigned char **in, size_t *inleft,
+		 unsigned char **out, size_t *outleft)
+{
+	const unsigned char *inptr = *in, *inend = inptr + *inleft;
+	unsigned char *outptr = *out, *outend = outptr + *outleft;
+	unsigned char utf8[3];
+	int err = 0;
+	size_t n;
+	
+	while (inptr < inend) {
+		if (*inptr < 128) {
+			if (outptr == outend) {
+				err = E2BIG;
+				break;
+			}
+			
+			ascii_copy (&inptr, inend - inptr, &outptr, outend - outptr);
+			continue;
+		}
+		
+		if (charset == NULL) {
+			/* UTF-8 */
+			gunichar c;
+			int len;
+			
+			if ((len = utf8_decode (inptr, inend - inptr, &c)) <= 0) {
+				err = len == 0 ? EINVAL : EILSEQ;
+				break;
+			}
+			
+			if (outend - outptr < len) {
+				err = E2BIG;
+				break;
+			}
+			
+			memcpy (outptr, inptr, len);
+			outptr += len;
+			inptr += len;
+			continue;
+		}
+		
+		if (charset->table[*inptr - 128] == 0) {
+			err = EILSEQ;
+			break;
+		}
+		
+		n = utf8_encode (charset->table[*inptr - 128], utf8);
+		if ((size_t) (outend - outptr) < n) {
+			err = E2BIG;
+			break;
+		}
+		
+		memcpy (outptr, utf8, n);
+		outptr += n;
+		inptr++;
+	}
+	
+	*inleft = inend - inptr;
+	*outleft = outend - outptr;
+	*out = outptr;
+	*in = inptr;
+	
+	if (err != 0) {
+		errno = err;
+		return (size_t) -1;
+	}
+	
+	return 0;
+}
+
+static size_t
+convert_from_utf8 (BuiltinCharset *charset, const unsigned char **in, size_t *inleft,
+		   unsigned char **out, size_t *outleft)
+{
+	const unsigned char *inptr = *in, *inend = inptr + *inleft;
+	unsigned char *outptr = *out, *outend = outptr + *outleft;
+	UnicodeMapping key, *mapping;
+	gunichar c;
+	int err = 0;
+	int len;
+	
+	while (inptr < inend) {
+		if (outptr == outend) {
+			err = E2BIG;
+			break;
+		}
+		
+		if (*inptr < 128) {
+			ascii_copy (&inptr, inend - inptr, &outptr, outend - outptr);
+			continue;
+		}
+		
+		if ((len = utf8_decode (inptr, inend - inptr, &c)) <= 0) {
+			err = len == 0 ? EINVAL : EILSEQ;
+			break;
+		}
+		
+		key.c = (guint16) c;
+		if (c > 0xffff || !(mapping = bsearch (&key, charset->reverse, charset->nreverse,
+						       sizeof (UnicodeMapping), unicode_mapping_compare))) {
+			/* not representable in this charset */
+			err = EILSEQ;
+			break;
+		}
+		
+		*outptr++ = mapping->byte;
+		inptr += len;
+	}
+	
+	*inleft = inend - inptr;
+	*outleft = outend - outptr;
+	*out = outptr;
+	*in = inptr;
+	
+	if (err != 0) {
+		errno = err;
+		return (size_t) -1;
+	}
+	
+	return 0;
+}
+
+
+/**
+ * _g_mime_iconv_builtin:
+ * @cd: a built-in converter
+ * @inbuf: input buffer
+ * @inleft: number of bytes left in @inbuf
+ * @outbuf: output buffer
+ * @outleft: number of bytes left in @outbuf
+ *
+ * Converts text using a built-in converter, see iconv(3) for details.
+ *
+ * Returns: %0 on success or (size_t) %-1 on error, setting errno.
+ **/
+size_t
+_g_mime_iconv_builtin (iconv_t cd, char **inbuf, size_t *inleft, char **outbuf, size_t *outleft)
+{
+	BuiltinConverter *converter = (BuiltinConverter *) cd;
+	
+	/* none of the charsets have any shift state to reset */
+	if (inbuf == NULL || *inbuf == NULL)
+		return 0;
+	
+	if (converter->to_utf8)
+		return convert_to_utf8 (converter->charset, (const unsigned char **) inbuf, inleft,
+					(unsigned char **) outbuf, outleft);
+	
+	return convert_from_utf8 (converter->charset, (const unsigned char **) inbuf, inleft,
+				  (unsigned char **) outbuf, outleft);
+}
@@ -28,6 +28,8 @@
 #include <errno.h>
 
 #include "gmime-iconv-utils.h"
+#include "gmime-iconv.h"
+#include "gmime-internal.h"
 #include "gmime-charset.h"
 
 #ifdef ENABLE_WARNINGS
@@ -84,7 +86,7 @@ g_mime_iconv_strndup (iconv_t cd, const char *str, size_t n)
 		outbuf = out + converted;
 		outleft = outlen - converted;
 		
-		converted = iconv (cd, (char **) &inbuf, &inleft, &outbuf, &outleft);
+		converted = _g_mime_iconv (cd, (char **) &inbuf, &inleft, &outbuf, &outleft);
 		if (converted != (size_t) -1 || errno == EINVAL) {
 			/*
 			 * EINVAL  An  incomplete  multibyte sequence has been encoun-
@@ -104,7 +106,7 @@ g_mime_iconv_strndup (iconv_t cd, const char *str, size_t n)
 			g_free (out);
 			
 			/* reset the cd */
-			iconv (cd, NULL, NULL, NULL, NULL);
+			_g_mime_iconv (cd, NULL, NULL, NULL, NULL);
 			
 			errno = errnosav;
 			
@@ -124,7 +126,7 @@ g_mime_iconv_strndup (iconv_t cd, const char *str, size_t n)
 	} while (TRUE);
 	
 	/* flush the iconv conversion */
-	while (iconv (cd, NULL, NULL, &outbuf, &outleft) == (size_t) -1) {
+	while (_g_mime_iconv (cd, NULL, NULL, &outbuf, &outleft) == (size_t) -1) {
 		if (errno != E2BIG)
 			break;
 		
@@ -144,7 +146,7 @@ g_mime_iconv_strndup (iconv_t cd, const char *str, size_t n)
 	memset (outbuf, 0, 4);
 	
 	/* reset the cd */
-	iconv (cd, NULL, NULL, NULL, NULL);
+	_g_mime_iconv (cd, NULL, NULL, NULL, NULL);
 	
 	return out;
 }
@@ -189,9 +191,9 @@ g_mime_iconv_locale_to_utf8 (const char *str)
 	locale = g_mime_charset_iconv_name (locale);
 	utf8 = g_mime_charset_iconv_name ("UTF-8");
 	
-	cd = iconv_open (locale, utf8);
+	cd = _g_mime_iconv_open (locale, utf8);
 	buf = g_mime_iconv_strdup (cd, str);
-	iconv_close (cd);
+	g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -221,9 +223,9 @@ g_mime_iconv_locale_to_utf8_length (const char *str, size_t n)
 	locale = g_mime_charset_iconv_name (locale);
 	utf8 = g_mime_charset_iconv_name ("UTF-8");
 	
-	cd = iconv_open (locale, utf8);
+	cd = _g_mime_iconv_open (locale, utf8);
 	buf = g_mime_iconv_strndup (cd, str, n);
-	iconv_close (cd);
+	g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -252,11 +254,11 @@ g_mime_iconv_utf8_to_locale (const char *str)
 	locale = g_mime_charset_iconv_name (locale);
 	utf8 = g_mime_charset_iconv_name ("UTF-8");
 	
-	if ((cd = iconv_open (utf8, locale)) == (iconv_t) -1)
+	if ((cd = _g_mime_iconv_open (utf8, locale)) == (iconv_t) -1)
 		return g_strdup (str);
 	
 	buf = g_mime_iconv_strdup (cd, str);
-	iconv_close (cd);
+	g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -286,11 +288,11 @@ g_mime_iconv_utf8_to_locale_length (const char *str, size_t n)
 	locale = g_mime_charset_iconv_name (locale);
 	utf8 = g_mime_charset_iconv_name ("UTF-8");
 	
-	if ((cd = iconv_open (utf8, locale)) == (iconv_t) -1)
+	if ((cd = _g_mime_iconv_open (utf8, locale)) == (iconv_t) -1)
 		return g_strndup (str, n);
 	
 	buf = g_mime_iconv_strndup (cd, str, n);
-	iconv_close (cd);
+	g_mime_iconv_close (cd);
 	
 	return buf;
 }
@@ -24,10 +24,12 @@
 #endif
 
 #include <glib.h>
+#include <string.h>
 #include <errno.h>
 
 #include "gmime-charset.h"
 #include "gmime-iconv.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -39,7 +41,97 @@
  * These functions are wrappers around the system iconv(3) routines. The
  * purpose of this wrapper is to use the appropriate system charset alias for
  * the MIME charset names given as arguments.
+ *
+ * Since opening a conversion descriptor can be expensive, descriptors
+ * that are closed using g_mime_iconv_close() are reset and kept in a
+ * small cache so that they can be handed out again by a later call to
+ * g_mime_iconv_open() for the same pair of charsets.
+ **/
+
+
+/* the maximum number of idle descriptors kept in the cache */
+#define ICONV_CACHE_SIZE 16
+
+typedef struct {
+	char *key;
+	iconv_t cd;
+} IconvCacheNode;
+
+/* idle descriptors, most recently used first */
+static GQueue *iconv_cache = NULL;
+
+/* descriptors checked out of the cache, keyed by descriptor */
+static GHashTable *iconv_open_cds = NULL;
+
+static guint iconv_cache_hits = 0;
+static guint iconv_cache_misses = 0;
+
+#ifdef G_THREADS_ENABLED
+static GMutex lock;
+#define ICONV_CACHE_UNLOCK() g_mutex_unlock (&lock)
+#define ICONV_CACHE_LOCK()   g_mutex_lock (&lock)
+#else
+#define ICONV_CACHE_UNLOCK()
+#define ICONV_CACHE_LOCK()
+#endif /* G_THREADS_ENABLED */
+
+
+static void
+iconv_cache_node_free (IconvCacheNode *node)
+{
+	g_free (node->key);
+	g_slice_free (IconvCacheNode, node);
+}
+
+
+/**
+ * g_mime_iconv_init:
+ *
+ * Initializes the iconv descriptor cache.
+ **/
+void
+g_mime_iconv_init (void)
+{
+	if (iconv_cache != NULL)
+		return;
+	
+	iconv_open_cds = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+						(GDestroyNotify) iconv_cache_node_free);
+	iconv_cache = g_queue_new ();
+	iconv_cache_misses = 0;
+	iconv_cache_hits = 0;
+}
+
+
+/**
+ * g_mime_iconv_shutdown:
+ *
+ * Closes all of the idle descriptors in the cache. Descriptors that
+ * are still open will simply be closed by g_mime_iconv_close().
  **/
+void
+g_mime_iconv_shutdown (void)
+{
+	IconvCacheNode *node;
+	
+	if (iconv_cache == NULL)
+		return;
+	
+	ICONV_CACHE_LOCK ();
+	
+	while ((node = g_queue_pop_head (iconv_cache))) {
+		iconv_close (node->cd);
+		iconv_cache_node_free (node);
+	}
+	
+	g_queue_free (iconv_cache);
+	iconv_cache = NULL;
+	
+	g_hash_table_destroy (iconv_open_cds);
+	iconv_open_cds = NULL;
+	
+	ICONV_CACHE_UNLOCK ();
+}
 
 
 /**
@@ -61,6 +153,11 @@
 iconv_t
 g_mime_iconv_open (const char *to, const char *from)
 {
+	IconvCacheNode *node;
+	GList *link;
+	iconv_t cd;
+	char *key;
+	
 	if (from == NULL || to == NULL) {
 		errno = EINVAL;
 		return (iconv_t) -1;
@@ -72,7 +169,47 @@ g_mime_iconv_open (const char *to, const char *from)
 	from = g_mime_charset_iconv_name (from);
 	to = g_mime_charset_iconv_name (to);
 	
-	return iconv_open (to, from);
+	if (iconv_cache == NULL)
+		return iconv_open (to, from);
+	
+	key = g_strdup_printf ("%s:%s", from, to);
+	
+	ICONV_CACHE_LOCK ();
+	
+	for (link = iconv_cache->head; link != NULL; link = link->next) {
+		node = link->data;
+		
+		if (!strcmp (node->key, key)) {
+			g_queue_delete_link (iconv_cache, link);
+			g_hash_table_insert (iconv_open_cds, node->cd, node);
+			iconv_cache_hits++;
+			
+			ICONV_CACHE_UNLOCK ();
+			
+			g_free (key);
+			
+			return node->cd;
+		}
+	}
+	
+	iconv_cache_misses++;
+	
+	ICONV_CACHE_UNLOCK ();
+	
+	if ((cd = iconv_open (to, from)) == (iconv_t) -1) {
+		g_free (key);
+		return cd;
+	}
+	
+	node = g_slice_new (IconvCacheNode);
+	node->key = key;
+	node->cd = cd;
+	
+	ICONV_CACHE_LOCK ();
+	g_hash_table_insert (iconv_open_cds, cd, node);
+	ICONV_CACHE_UNLOCK ();
+	
+	return cd;
 }
 
 
@@ -82,6 +219,10 @@ g_mime_iconv_open (const char *to, const char *from)
  *
  * Closes the iconv descriptor @cd.
  *
+ * If @cd was opened using g_mime_iconv_open(), its conversion state is
+ * reset and it is returned to the descriptor cache instead, evicting
+ * the least recently used idle descriptor if the cache is full.
+ *
  * See the manual page for iconv_close(3) for further details.
  *
  * Returns: %0 on success or %-1 on fail as well as setting an
@@ -90,5 +231,115 @@ g_mime_iconv_open (const char *to, const char *from)
 int
 g_mime_iconv_close (iconv_t cd)
 {
-	return iconv_close (cd);
+	IconvCacheNode *node = NULL;
+	
+	if (cd == (iconv_t) -1) {
+		errno = EBADF;
+		return -1;
+	}
+	
+	if (_g_mime_iconv_is_builtin (cd))
+		return 0;
+	
+	ICONV_CACHE_LOCK ();
+	
+	if (iconv_cache != NULL && (node = g_hash_table_lookup (iconv_open_cds, cd)))
+		g_hash_table_steal (iconv_open_cds, cd);
+	
+	if (node == NULL) {
+		ICONV_CACHE_UNLOCK ();
+		
+		return iconv_close (cd);
+	}
+	
+	/* reset the conversion state */
+	iconv (cd, NULL, NULL, NULL, NULL);
+	g_queue_push_head (iconv_cache, node);
+	
+	if (iconv_cache->length > ICONV_CACHE_SIZE) {
+		node = g_queue_pop_tail (iconv_cache);
+		iconv_close (node->cd);
+		iconv_cache_node_free (node);
+	}
+	
+	ICONV_CACHE_UNLOCK ();
+	
+	return 0;
+}
+
+
+/**
+ * g_mime_iconv_get_cache_stats:
+ * @hits: (out) (optional): return location for the number of cache hits
+ * @misses: (out) (optional): return location for the number of cache misses
+ *
+ * Gets the number of times that g_mime_iconv_open() was able to reuse
+ * a cached conversion descriptor (@hits) and the number of times that
+ * it had to open a new one (@misses) since GMime was initialized.
+ **/
+void
+g_mime_iconv_get_cache_stats (guint *hits, guint *misses)
+{
+	ICONV_CACHE_LOCK ();
+	
+	if (hits)
+		*hits = iconv_cache_hits;
+	
+	if (misses)
+		*misses = iconv_cache_misses;
+	
+	ICONV_CACHE_UNLOCK ();
+}
+
+
+/**
+ * _g_mime_iconv_open:
+ * @to: charset to convert to
+ * @from: charset to convert from
+ *
+ * Like g_mime_iconv_open() except that it may return one of the
+ * built-in converters, which must only be used with _g_mime_iconv()
+ * (or g_mime_iconv_strdup()) rather than iconv(3). The descriptor must
+ * still be closed using g_mime_iconv_close().
+ *
+ * Returns: a new conversion descriptor on success or (iconv_t) %-1 on
+ * fail as well as setting an appropriate errno value.
+ **/
+iconv_t
+_g_mime_iconv_open (const char *to, const char *from)
+{
+	iconv_t cd;
+	
+	if (from != NULL && to != NULL) {
+		if (!g_ascii_strcasecmp (from, "x-unknown"))
+			from = g_mime_locale_charset ();
+		
+		if ((cd = _g_mime_iconv_builtin_open (to, from)) != (iconv_t) -1)
+			return cd;
+	}
+	
+	return g_mime_iconv_open (to, from);
+}
+
+
+/**
+ * _g_mime_iconv:
+ * @cd: conversion descriptor
+ * @inbuf: input buffer
+ * @inleft: number of bytes left in @inbuf
+ * @outbuf: output buffer
+ * @outleft: number of bytes left in @outbuf
+ *
+ * Converts text using either a built-in converter or iconv(3).
+ *
+ * Returns: the number of non-reversible conversions performed or
+ * (size_t) %-1 on error, setting errno.
+ **/
+size_t
+_g_mime_iconv (iconv_t cd, char **inbuf, size_t *inleft, char **outbuf, size_t *outleft)
+{
+	if (_g_mime_iconv_is_builtin (cd))
+		return _g_mime_iconv_builtin (cd, inbuf, inleft, outbuf, outleft);
+	
+	return iconv (cd, inbuf, inleft, outbuf, outleft);
 }
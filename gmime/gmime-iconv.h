@@ -31,6 +31,8 @@ iconv_t g_mime_iconv_open (const char *to, const char *from);
 
 int g_mime_iconv_close (iconv_t cd);
 
+void g_mime_iconv_get_cache_stats (guint *hits, guint *misses);
+
 /**
  * g_mime_iconv:
  * @cd: iconv_t conversion descriptor
@@ -24,9 +24,17 @@
 
 #include <gmime/gmime-format-options.h>
 #include <gmime/gmime-parser-options.h>
+#include <gmime/gmime-data-wrapper.h>
+#include <gmime/gmime-filter.h>
+#include <gmime/gmime-message-part.h>
+#include <gmime/gmime-multipart.h>
+#include <gmime/gmime-message.h>
+#include <gmime/gmime-parser.h>
 #include <gmime/gmime-object.h>
+#include <gmime/gmime-part.h>
 #include <gmime/gmime-events.h>
 #include <gmime/gmime-utils.h>
+#include <gmime/gmime-iconv.h>
 
 G_BEGIN_DECLS
 
@@ -43,6 +51,37 @@ typedef struct {
 	GMimeHeader *header;
 } GMimeHeaderListChangedEventArgs;
 
+/* SIMD kernels (NULL if unsupported) */
+G_GNUC_INTERNAL void g_mime_simd_init (void);
+G_GNUC_INTERNAL extern size_t (* _g_mime_simd_base64_encode) (const unsigned char **inptr, const unsigned char *inend,
+							      unsigned char *outbuf, int *quartets);
+G_GNUC_INTERNAL extern size_t (* _g_mime_simd_base64_decode) (const unsigned char **inptr, const unsigned char *inend,
+							      unsigned char *outbuf);
+G_GNUC_INTERNAL extern size_t (* _g_mime_simd_quoted_encode) (const unsigned char **inptr, const unsigned char *inend,
+							      unsigned char *outbuf, guint32 *sofar);
+G_GNUC_INTERNAL extern size_t (* _g_mime_simd_quoted_decode) (const unsigned char **inptr, const unsigned char *inend,
+							      unsigned char *outbuf);
+G_GNUC_INTERNAL extern size_t (* _g_mime_simd_yencode) (const unsigned char **inptr, const unsigned char *inend,
+							unsigned char *outbuf, int *already);
+G_GNUC_INTERNAL extern size_t (* _g_mime_simd_ydecode) (const unsigned char **inptr, const unsigned char *inend,
+							unsigned char *outbuf);
+G_GNUC_INTERNAL extern guint32 (* _g_mime_simd_crc32) (guint32 crc, const unsigned char *inbuf, size_t inlen);
+G_GNUC_INTERNAL extern size_t (* _g_mime_simd_ascii_span) (const unsigned char *inbuf, size_t inlen, unsigned char *max);
+G_GNUC_INTERNAL extern void (* _g_mime_simd_count_8bit) (const unsigned char *inbuf, size_t inlen,
+							size_t *count0, size_t *count8);
+
+/* iconv descriptor cache */
+G_GNUC_INTERNAL void g_mime_iconv_init (void);
+G_GNUC_INTERNAL void g_mime_iconv_shutdown (void);
+G_GNUC_INTERNAL iconv_t _g_mime_iconv_open (const char *to, const char *from);
+G_GNUC_INTERNAL size_t _g_mime_iconv (iconv_t cd, char **inbuf, size_t *inleft, char **outbuf, size_t *outleft);
+
+/* built-in charset converters */
+G_GNUC_INTERNAL void g_mime_iconv_builtin_init (void);
+G_GNUC_INTERNAL iconv_t _g_mime_iconv_builtin_open (const char *to, const char *from);
+G_GNUC_INTERNAL gboolean _g_mime_iconv_is_builtin (iconv_t cd);
+G_GNUC_INTERNAL size_t _g_mime_iconv_builtin (iconv_t cd, char **inbuf, size_t *inleft, char **outbuf, size_t *outleft);
+
 /* GMimeFormatOptions */
 G_GNUC_INTERNAL void g_mime_format_options_init (void);
 G_GNUC_INTERNAL void g_mime_format_options_shutdown (void);
@@ -54,6 +93,31 @@ G_GNUC_INTERNAL void g_mime_parser_options_shutdown (void);
 G_GNUC_INTERNAL void _g_mime_parser_options_warn (GMimeParserOptions *options, gint64 offset, GMimeParserWarning errcode,
 						  const gchar *item);
 
+/* GMimeFilter */
+G_GNUC_INTERNAL void _g_mime_filter_reserve_headroom (GMimeFilter *filter, size_t headroom);
+
+/* GMimeFilterFused */
+G_GNUC_INTERNAL GMimeFilter *_g_mime_filter_fuse (GMimeFilter *decoder, GMimeFilter *next, GMimeFilter *last, int *nfused);
+
+/* GMimeStreamFilter */
+G_GNUC_INTERNAL void g_mime_stream_filter_pipelines_init (void);
+G_GNUC_INTERNAL void g_mime_stream_filter_pipelines_shutdown (void);
+G_GNUC_INTERNAL GMimeStream *_g_mime_stream_filter_get_pipeline (GMimeStream *source, GMimeContentEncoding encoding, gboolean encode,
+								 GMimeFormatOptions *options, gboolean ensure_newline);
+G_GNUC_INTERNAL void _g_mime_stream_filter_release_pipeline (GMimeStream *stream);
+
+/* GMimeDataWrapper */
+G_GNUC_INTERNAL GMimeStream *_g_mime_data_wrapper_get_cached_stream (GMimeDataWrapper *wrapper, GMimeContentEncoding encoding,
+								     GMimeNewLineFormat newline, gboolean ensure_newline);
+G_GNUC_INTERNAL GMimeStream *_g_mime_data_wrapper_new_cache_stream (GMimeDataWrapper *wrapper);
+G_GNUC_INTERNAL GMimeStream *_g_mime_data_wrapper_open_stream (GMimeDataWrapper *wrapper);
+G_GNUC_INTERNAL void _g_mime_data_wrapper_freeze (GMimeDataWrapper *wrapper);
+G_GNUC_INTERNAL gboolean _g_mime_data_wrapper_is_frozen (GMimeDataWrapper *wrapper);
+G_GNUC_INTERNAL GMimeDataWrapper *_g_mime_data_wrapper_clone (GMimeDataWrapper *wrapper);
+G_GNUC_INTERNAL void _g_mime_data_wrapper_set_cached_stream (GMimeDataWrapper *wrapper, GMimeContentEncoding encoding,
+							     GMimeNewLineFormat newline, gboolean ensure_newline,
+							     GMimeStream *stream);
+
 /* GMimeHeader */
 //G_GNUC_INTERNAL void _g_mime_header_set_raw_value (GMimeHeader *header, const char *raw_value);
 G_GNUC_INTERNAL void _g_mime_header_set_offset (GMimeHeader *header, gint64 offset);
@@ -64,19 +128,60 @@ G_GNUC_INTERNAL void _g_mime_header_list_set_options (GMimeHeaderList *headers,
 G_GNUC_INTERNAL void _g_mime_header_list_append (GMimeHeaderList *headers, const char *name, const char *raw_name,
 						 const char *raw_value, gint64 offset);
 G_GNUC_INTERNAL void _g_mime_header_list_set (GMimeHeaderList *headers, const char *name, const char *raw_value);
+G_GNUC_INTERNAL void _g_mime_header_list_append_copy (GMimeHeaderList *headers, GMimeHeader *header);
 
 /* GMimeObject */
 G_GNUC_INTERNAL void _g_mime_object_block_header_list_changed (GMimeObject *object);
 G_GNUC_INTERNAL void _g_mime_object_unblock_header_list_changed (GMimeObject *object);
+G_GNUC_INTERNAL void _g_mime_object_add_changed_listener (GMimeObject *object, GMimeEventCallback callback, gpointer user_data);
+G_GNUC_INTERNAL void _g_mime_object_remove_changed_listener (GMimeObject *object, GMimeEventCallback callback,
+							     gpointer user_data);
+G_GNUC_INTERNAL void _g_mime_object_changed (GMimeObject *object);
+G_GNUC_INTERNAL void _g_mime_object_check_mutable (GMimeObject *object);
+G_GNUC_INTERNAL gboolean _g_mime_object_is_updating (GMimeObject *object);
 G_GNUC_INTERNAL void _g_mime_object_set_content_type (GMimeObject *object, GMimeContentType *content_type);
 G_GNUC_INTERNAL void _g_mime_object_append_header (GMimeObject *object, const char *name, const char *raw_name,
 						   const char *raw_value, gint64 offset);
 
+/* GMimePart */
+G_GNUC_INTERNAL void _g_mime_part_freeze (GMimePart *part);
+G_GNUC_INTERNAL void _g_mime_part_copy (GMimePart *dest, GMimePart *src);
+
+/* GMimeMultipart */
+G_GNUC_INTERNAL void _g_mime_multipart_freeze (GMimeMultipart *multipart);
+G_GNUC_INTERNAL void _g_mime_multipart_copy (GMimeMultipart *dest, GMimeMultipart *src);
+
+/* GMimeMessagePart */
+G_GNUC_INTERNAL void _g_mime_message_part_freeze (GMimeMessagePart *part);
+G_GNUC_INTERNAL void _g_mime_message_part_copy (GMimeMessagePart *dest, GMimeMessagePart *src);
+
+/* GMimeMessage */
+G_GNUC_INTERNAL GMimeHeader *_g_mime_message_next_header (GMimeMessage *message, int *index, int *body_index);
+G_GNUC_INTERNAL void _g_mime_message_end_update (GMimeMessage *message);
+G_GNUC_INTERNAL void _g_mime_message_freeze (GMimeMessage *message);
+G_GNUC_INTERNAL void _g_mime_message_copy (GMimeMessage *dest, GMimeMessage *src);
+
+/* GMimeParser */
+G_GNUC_INTERNAL GMimeObject *_g_mime_parser_construct_part (GMimeParser *parser, GMimeParserOptions *options, gboolean digest);
+
+/* GMimePartTree */
+G_GNUC_INTERNAL GMimePartTree *_g_mime_part_tree_new (GMimeStream *stream, gboolean seekable);
+G_GNUC_INTERNAL GMimePartNode *_g_mime_part_tree_add_node (GMimePartTree *tree, GMimePartNode *parent, GMimePartNode *prev,
+							  const char *type, const char *subtype);
+
 /* GMimeContentType */
 G_GNUC_INTERNAL GMimeContentType *_g_mime_content_type_parse (GMimeParserOptions *options, const char *str, gint64 offset);
+G_GNUC_INTERNAL GMimeContentType *_g_mime_content_type_copy (GMimeContentType *content_type);
 
 /* GMimeParamList */
 G_GNUC_INTERNAL GMimeParamList *_g_mime_param_list_parse (GMimeParserOptions *options, const char *str, gint64 offset);
+G_GNUC_INTERNAL void _g_mime_param_list_copy (GMimeParamList *dest, GMimeParamList *src);
+
+/* parsed Content-Type / Content-Disposition cache */
+G_GNUC_INTERNAL void g_mime_param_cache_shutdown (void);
+G_GNUC_INTERNAL gboolean _g_mime_param_cache_can_cache (GMimeParserOptions *options, const char *str);
+G_GNUC_INTERNAL GObject *_g_mime_param_cache_lookup (GType type, GMimeParserOptions *options, const char *str);
+G_GNUC_INTERNAL void _g_mime_param_cache_add (GMimeParserOptions *options, const char *str, GObject *result);
 
 /* GMimeContentDisposition */
 G_GNUC_INTERNAL GMimeContentDisposition *_g_mime_content_disposition_parse (GMimeParserOptions *options, const char *str,
@@ -91,6 +196,13 @@ G_GNUC_INTERNAL char *_g_mime_utils_header_decode_text (GMimeParserOptions *opti
 							gint64 offset);
 G_GNUC_INTERNAL char *_g_mime_utils_header_decode_phrase (GMimeParserOptions *options, const char *text, const char **charset,
 							  gint64 offset);
+G_GNUC_INTERNAL char *_g_mime_utils_header_unfold_decode_text (GMimeParserOptions *options, const char *value, const char **charset,
+								gint64 offset);
+G_GNUC_INTERNAL void _g_mime_utils_header_unfold_decode_text_append (GMimeParserOptions *options, const char *value, const char **charset,
+								     gint64 offset, GString *decoded);
+
+/* InternetAddress */
+G_GNUC_INTERNAL void _internet_address_shutdown (void);
 
 /* InternetAddressList */
 G_GNUC_INTERNAL InternetAddressList *_internet_address_list_parse (GMimeParserOptions *options, const char *str, gint64 offset);
@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "gmime-message-part.h"
+#include "gmime-internal.h"
 
 #define d(x)
 
@@ -173,6 +174,33 @@ message_part_write_to_stream (GMimeObject *object, GMimeFormatOptions *options,
 	return total;
 }
 
+/**
+ * _g_mime_message_part_freeze:
+ * @part: a #GMimeMessagePart
+ *
+ * Freezes the message encapsulated by @part.
+ **/
+void
+_g_mime_message_part_freeze (GMimeMessagePart *part)
+{
+	if (part->message)
+		g_mime_object_freeze ((GMimeObject *) part->message);
+}
+
+/**
+ * _g_mime_message_part_copy:
+ * @dest: the #GMimeMessagePart cloned from @src
+ * @src: a #GMimeMessagePart
+ *
+ * Sets a clone of the message encapsulated by @src on @dest.
+ **/
+void
+_g_mime_message_part_copy (GMimeMessagePart *dest, GMimeMessagePart *src)
+{
+	if (src->message)
+		dest->message = (GMimeMessage *) g_mime_object_clone ((GMimeObject *) src->message);
+}
+
 
 /**
  * g_mime_message_part_new:
@@ -243,6 +271,8 @@ g_mime_message_part_set_message (GMimeMessagePart *part, GMimeMessage *message)
 		g_object_unref (part->message);
 	
 	part->message = message;
+	
+	_g_mime_object_changed ((GMimeObject *) part);
 }
 
 
@@ -0,0 +1,787 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gmime-message-template.h"
+#include "gmime-stream-filter.h"
+#include "gmime-filter-charset.h"
+#include "gmime-filter-basic.h"
+#include "gmime-stream-mem.h"
+#include "gmime-charset.h"
+#include "gmime-internal.h"
+#include "gmime-common.h"
+#include "gmime-utils.h"
+
+#define d(x)
+
+
+/**
+ * SECTION: gmime-message-template
+ * @title: GMimeMessageTemplate
+ * @short_description: Pre-serialized message templates
+ * @see_also: #GMimeMessage
+ *
+ * A #GMimeMessageTemplate serializes a #GMimeMessage once into a list
+ * of fixed byte segments and named placeholders. Each placeholder is
+ * either a header (such as To, Date or Message-Id) or the content of a
+ * #GMimePart. Instantiating the template only writes out the cached
+ * segments interleaved with the folded and encoded placeholder values,
+ * which makes it well suited for sending large numbers of personalized
+ * messages that otherwise share the bulk of their content.
+ **/
+
+
+typedef struct {
+	char *name;
+	GMimeHeader *header;
+	GMimePart *part;
+	GMimeDataWrapper *content;
+	GMimeContentEncoding encoding;
+	gboolean ensure_newline;
+	char *filename;
+	char *charset;
+	char *sentinel;
+} Placeholder;
+
+typedef struct {
+	Placeholder *placeholder;
+	guint offset;
+	guint length;
+} Segment;
+
+typedef struct {
+	Placeholder *placeholder;
+	guint offset;
+} SentinelMatch;
+
+
+static void g_mime_message_template_class_init (GMimeMessageTemplateClass *klass);
+static void g_mime_message_template_init (GMimeMessageTemplate *tmpl, GMimeMessageTemplateClass *klass);
+static void g_mime_message_template_finalize (GObject *object);
+
+
+static GObjectClass *parent_class = NULL;
+
+
+GType
+g_mime_message_template_get_type (void)
+{
+	static GType type = 0;
+	
+	if (!type) {
+		static const GTypeInfo info = {
+			sizeof (GMimeMessageTemplateClass),
+			NULL, /* base_class_init */
+			NULL, /* base_class_finalize */
+			(GClassInitFunc) g_mime_message_template_class_init,
+			NULL, /* class_finalize */
+			NULL, /* class_data */
+			sizeof (GMimeMessageTemplate),
+			0,    /* n_preallocs */
+			(GInstanceInitFunc) g_mime_message_template_init,
+		};
+		
+		type = g_type_register_static (G_TYPE_OBJECT, "GMimeMessageTemplate", &info, 0);
+	}
+	
+	return type;
+}
+
+
+static void
+g_mime_message_template_class_init (GMimeMessageTemplateClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	
+	parent_class = g_type_class_ref (G_TYPE_OBJECT);
+	
+	object_class->finalize = g_mime_message_template_finalize;
+}
+
+static void
+placeholder_free (Placeholder *placeholder)
+{
+	if (placeholder->part)
+		g_object_unref (placeholder->part);
+	g_free (placeholder->sentinel);
+	g_free (placeholder->filename);
+	g_free (placeholder->charset);
+	g_free (placeholder->name);
+	g_slice_free (Placeholder, placeholder);
+}
+
+static void
+g_mime_message_template_init (GMimeMessageTemplate *tmpl, GMimeMessageTemplateClass *klass)
+{
+	tmpl->placeholders = g_ptr_array_new_with_free_func ((GDestroyNotify) placeholder_free);
+	tmpl->segments = g_array_new (FALSE, FALSE, sizeof (Segment));
+	tmpl->buffer = g_byte_array_new ();
+	tmpl->compiled = FALSE;
+	tmpl->headers = NULL;
+	tmpl->options = NULL;
+}
+
+static void
+g_mime_message_template_finalize (GObject *object)
+{
+	GMimeMessageTemplate *tmpl = (GMimeMessageTemplate *) object;
+	
+	if (tmpl->options)
+		g_mime_format_options_free (tmpl->options);
+	
+	if (tmpl->headers)
+		g_object_unref (tmpl->headers);
+	
+	g_ptr_array_free (tmpl->placeholders, TRUE);
+	g_array_free (tmpl->segments, TRUE);
+	g_byte_array_free (tmpl->buffer, TRUE);
+	
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+/**
+ * g_mime_message_template_new:
+ *
+ * Creates a new, empty, #GMimeMessageTemplate.
+ *
+ * Returns: a new #GMimeMessageTemplate.
+ **/
+GMimeMessageTemplate *
+g_mime_message_template_new (void)
+{
+	return g_object_new (GMIME_TYPE_MESSAGE_TEMPLATE, NULL);
+}
+
+
+static Placeholder *
+placeholder_new (const char *name, GMimePart *part)
+{
+	Placeholder *placeholder;
+	
+	placeholder = g_slice_new0 (Placeholder);
+	placeholder->name = g_strdup (name);
+	
+	if (part != NULL)
+		placeholder->part = g_object_ref (part);
+	
+	return placeholder;
+}
+
+static Placeholder *
+template_find_placeholder (GMimeMessageTemplate *tmpl, const char *name, gboolean part)
+{
+	Placeholder *placeholder;
+	guint i;
+	
+	for (i = 0; i < tmpl->placeholders->len; i++) {
+		placeholder = (Placeholder *) tmpl->placeholders->pdata[i];
+		
+		if ((placeholder->part != NULL) == part && !g_ascii_strcasecmp (placeholder->name, name))
+			return placeholder;
+	}
+	
+	return NULL;
+}
+
+
+/**
+ * g_mime_message_template_add_header:
+ * @tmpl: a #GMimeMessageTemplate
+ * @header: the name of the header
+ *
+ * Adds a header placeholder named @header to the template.
+ *
+ * When the template is compiled, the first occurrence of @header in the
+ * message becomes the placeholder and any further occurrences are
+ * dropped. If the message does not contain @header, the placeholder is
+ * added after the message's own headers, just as
+ * g_mime_object_append_header() would have added it.
+ *
+ * The template needs to be recompiled for this change to take effect.
+ **/
+void
+g_mime_message_template_add_header (GMimeMessageTemplate *tmpl, const char *header)
+{
+	g_return_if_fail (GMIME_IS_MESSAGE_TEMPLATE (tmpl));
+	g_return_if_fail (header != NULL);
+	
+	if (template_find_placeholder (tmpl, header, FALSE))
+		return;
+	
+	g_ptr_array_add (tmpl->placeholders, placeholder_new (header, NULL));
+	tmpl->compiled = FALSE;
+}
+
+
+/**
+ * g_mime_message_template_add_part:
+ * @tmpl: a #GMimeMessageTemplate
+ * @name: the name of the placeholder
+ * @part: a #GMimePart contained within the message that will be compiled
+ *
+ * Adds a placeholder named @name for the content of @part. Values
+ * substituted for this placeholder are expected to be UTF-8 text and
+ * will be converted to the charset of @part (if it specifies one) and
+ * encoded using the Content-Transfer-Encoding of @part.
+ *
+ * The template needs to be recompiled for this change to take effect.
+ **/
+void
+g_mime_message_template_add_part (GMimeMessageTemplate *tmpl, const char *name, GMimePart *part)
+{
+	g_return_if_fail (GMIME_IS_MESSAGE_TEMPLATE (tmpl));
+	g_return_if_fail (GMIME_IS_PART (part));
+	g_return_if_fail (name != NULL);
+	
+	if (template_find_placeholder (tmpl, name, TRUE))
+		return;
+	
+	g_ptr_array_add (tmpl->placeholders, placeholder_new (name, part));
+	tmpl->compiled = FALSE;
+}
+
+
+static void
+template_add_segment (GMimeMessageTemplate *tmpl, Placeholder *placeholder, guint *offset)
+{
+	Segment segment;
+	
+	if (placeholder == NULL && tmpl->buffer->len == *offset)
+		return;
+	
+	segment.placeholder = placeholder;
+	segment.length = tmpl->buffer->len - *offset;
+	segment.offset = *offset;
+	
+	g_array_append_val (tmpl->segments, segment);
+	*offset = tmpl->buffer->len;
+}
+
+static ssize_t
+write_header_value (GMimeMessageTemplate *tmpl, Placeholder *placeholder, const char *value, GMimeStream *stream)
+{
+	GMimeHeader *header = placeholder->header;
+	GMimeHeaderRawValueFormatter formatter;
+	char *raw_value, *trimmed, *buf;
+	GMimeStream *filtered;
+	GMimeFilter *filter;
+	ssize_t nwritten;
+	
+	formatter = header->formatter ? header->formatter : g_mime_header_format_default;
+	trimmed = g_mime_strdup_trim (value);
+	raw_value = formatter (header, tmpl->options, trimmed, NULL);
+	buf = g_strdup_printf ("%s:%s", header->raw_name, raw_value);
+	g_free (raw_value);
+	g_free (trimmed);
+	
+	filtered = g_mime_stream_filter_new (stream);
+	filter = g_mime_format_options_create_newline_filter (tmpl->options, FALSE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	nwritten = g_mime_stream_write_string (filtered, buf);
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	g_free (buf);
+	
+	return nwritten;
+}
+
+static ssize_t
+write_part_value (GMimeMessageTemplate *tmpl, Placeholder *placeholder, GMimeDataWrapper *content,
+		  const char *value, GMimeStream *stream)
+{
+	const char *newline = g_mime_format_options_get_newline (tmpl->options);
+	ssize_t nwritten, total = 0;
+	GMimeStream *filtered;
+	GMimeFilter *filter;
+	
+	if (placeholder->encoding == GMIME_CONTENT_ENCODING_UUENCODE) {
+		if ((nwritten = g_mime_stream_printf (stream, "begin 0644 %s%s", placeholder->filename, newline)) == -1)
+			return -1;
+		
+		total += nwritten;
+	}
+	
+	filtered = g_mime_stream_filter_new (stream);
+	
+	if (value != NULL && placeholder->charset != NULL) {
+		if ((filter = g_mime_filter_charset_new ("UTF-8", placeholder->charset))) {
+			g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+			g_object_unref (filter);
+		}
+	}
+	
+	switch (placeholder->encoding) {
+	case GMIME_CONTENT_ENCODING_UUENCODE:
+	case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
+	case GMIME_CONTENT_ENCODING_BASE64:
+		filter = g_mime_filter_basic_new (placeholder->encoding, TRUE);
+		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+		g_object_unref (filter);
+		break;
+	default:
+		break;
+	}
+	
+	if (placeholder->encoding != GMIME_CONTENT_ENCODING_BINARY) {
+		filter = g_mime_format_options_create_newline_filter (tmpl->options, placeholder->ensure_newline);
+		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+		g_object_unref (filter);
+	}
+	
+	if (value != NULL)
+		nwritten = g_mime_stream_write_string (filtered, value);
+	else if (content != NULL)
+		nwritten = g_mime_data_wrapper_write_to_stream (content, filtered);
+	else
+		nwritten = 0;
+	
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	
+	if (nwritten == -1)
+		return -1;
+	
+	total += nwritten;
+	
+	if (placeholder->encoding == GMIME_CONTENT_ENCODING_UUENCODE) {
+		if ((nwritten = g_mime_stream_printf (stream, "end%s", newline)) == -1)
+			return -1;
+		
+		total += nwritten;
+	}
+	
+	return total;
+}
+
+static void
+template_reset (GMimeMessageTemplate *tmpl, GMimeMessage *message, GMimeFormatOptions *options)
+{
+	GMimeHeaderList *headers = ((GMimeObject *) message)->headers;
+	Placeholder *placeholder;
+	guint i;
+	
+	g_byte_array_set_size (tmpl->buffer, 0);
+	g_array_set_size (tmpl->segments, 0);
+	tmpl->compiled = FALSE;
+	
+	if (tmpl->options)
+		g_mime_format_options_free (tmpl->options);
+	tmpl->options = g_mime_format_options_clone (options);
+	
+	if (tmpl->headers)
+		g_object_unref (tmpl->headers);
+	tmpl->headers = g_mime_header_list_new (_g_mime_header_list_get_options (headers));
+	
+	for (i = 0; i < tmpl->placeholders->len; i++) {
+		placeholder = (Placeholder *) tmpl->placeholders->pdata[i];
+		placeholder->header = NULL;
+		
+		g_free (placeholder->sentinel);
+		placeholder->sentinel = NULL;
+		g_free (placeholder->filename);
+		placeholder->filename = NULL;
+		g_free (placeholder->charset);
+		placeholder->charset = NULL;
+	}
+}
+
+static void
+template_append_missing_headers (GMimeMessageTemplate *tmpl, GMimeStream *filtered, guint *offset)
+{
+	Placeholder *placeholder;
+	guint i;
+	
+	g_mime_stream_flush (filtered);
+	template_add_segment (tmpl, NULL, offset);
+	
+	/* header placeholders not present in the message get an empty default */
+	for (i = 0; i < tmpl->placeholders->len; i++) {
+		placeholder = (Placeholder *) tmpl->placeholders->pdata[i];
+		
+		if (placeholder->part != NULL || placeholder->header != NULL)
+			continue;
+		
+		g_mime_header_list_append (tmpl->headers, placeholder->name, "", NULL);
+		placeholder->header = g_mime_header_list_get_header_at (tmpl->headers, g_mime_header_list_get_count (tmpl->headers) - 1);
+		template_add_segment (tmpl, placeholder, offset);
+	}
+}
+
+static void
+template_compile_headers (GMimeMessageTemplate *tmpl, GMimeMessage *message, GMimeStream *stream)
+{
+	int count = g_mime_header_list_get_count (((GMimeObject *) message)->headers);
+	gboolean appended = FALSE;
+	Placeholder *placeholder;
+	GMimeStream *filtered;
+	GMimeHeader *header;
+	GMimeFilter *filter;
+	int body_index = 0;
+	guint offset = 0;
+	int index = 0;
+	
+	filtered = g_mime_stream_filter_new (stream);
+	filter = g_mime_format_options_create_newline_filter (tmpl->options, FALSE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	while (TRUE) {
+		/* missing headers go where g_mime_object_append_header() would have put them */
+		if (!appended && index == count) {
+			template_append_missing_headers (tmpl, filtered, &offset);
+			appended = TRUE;
+		}
+		
+		if (!(header = _g_mime_message_next_header (message, &index, &body_index)))
+			break;
+		
+		if (g_mime_format_options_is_hidden_header (tmpl->options, header->name))
+			continue;
+		
+		if (!(placeholder = template_find_placeholder (tmpl, header->name, FALSE))) {
+			g_mime_header_write_to_stream (header, tmpl->options, filtered);
+			continue;
+		}
+		
+		/* only the first occurrence of a header becomes the placeholder */
+		if (placeholder->header != NULL)
+			continue;
+		
+		g_mime_stream_flush (filtered);
+		template_add_segment (tmpl, NULL, &offset);
+		
+		/* keep our own copy of the header so that the template does not depend on the message */
+		_g_mime_header_list_append (tmpl->headers, header->name, header->raw_name, header->raw_value, -1);
+		placeholder->header = g_mime_header_list_get_header_at (tmpl->headers, g_mime_header_list_get_count (tmpl->headers) - 1);
+		
+		/* the original header is used when no value is substituted */
+		g_mime_header_write_to_stream (header, tmpl->options, filtered);
+		g_mime_stream_flush (filtered);
+		template_add_segment (tmpl, placeholder, &offset);
+	}
+	
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	
+	g_mime_stream_write_string (stream, g_mime_format_options_get_newline (tmpl->options));
+	template_add_segment (tmpl, NULL, &offset);
+}
+
+static void
+template_swap_content (GMimeMessageTemplate *tmpl, GMimeMessage *message)
+{
+	GMimeObject *object;
+	Placeholder *placeholder;
+	GMimeStream *stream;
+	const char *charset;
+	guint i;
+	
+	for (i = 0; i < tmpl->placeholders->len; i++) {
+		placeholder = (Placeholder *) tmpl->placeholders->pdata[i];
+		
+		if (placeholder->part == NULL)
+			continue;
+		
+		object = (GMimeObject *) placeholder->part;
+		placeholder->encoding = placeholder->part->encoding;
+		
+		/* only the toplevel part of a message gets written with ensure_newline set */
+		if (object == message->mime_part)
+			placeholder->ensure_newline = ((GMimeObject *) message)->ensure_newline;
+		else
+			placeholder->ensure_newline = object->ensure_newline;
+		
+		if (placeholder->encoding == GMIME_CONTENT_ENCODING_BINARY)
+			placeholder->ensure_newline = FALSE;
+		
+		if (placeholder->encoding == GMIME_CONTENT_ENCODING_UUENCODE) {
+			const char *filename = g_mime_part_get_filename (placeholder->part);
+			
+			placeholder->filename = g_strdup (filename ? filename : "unknown");
+		}
+		
+		if ((charset = g_mime_object_get_content_type_parameter (object, "charset")) != NULL &&
+		    g_ascii_strcasecmp (g_mime_charset_canon_name (charset), "UTF-8") != 0)
+			placeholder->charset = g_strdup (charset);
+		
+		/* substitute a sentinel that gets written out verbatim so that we can find it afterward */
+		placeholder->sentinel = g_strdup_printf ("=?gmime-template-%u-%p?=", i, (void *) tmpl);
+		stream = g_mime_stream_mem_new_with_buffer (placeholder->sentinel, strlen (placeholder->sentinel));
+		placeholder->content = placeholder->part->content;
+		placeholder->part->content = g_mime_data_wrapper_new_with_stream (stream, placeholder->encoding);
+		g_object_unref (stream);
+	}
+}
+
+static void
+template_restore_content (GMimeMessageTemplate *tmpl)
+{
+	Placeholder *placeholder;
+	guint i;
+	
+	for (i = 0; i < tmpl->placeholders->len; i++) {
+		placeholder = (Placeholder *) tmpl->placeholders->pdata[i];
+		
+		if (placeholder->part == NULL)
+			continue;
+		
+		g_object_unref (placeholder->part->content);
+		placeholder->part->content = placeholder->content;
+		placeholder->content = NULL;
+	}
+}
+
+static gint
+sentinel_match_compare (gconstpointer a, gconstpointer b)
+{
+	const SentinelMatch *ma = a, *mb = b;
+	
+	return ma->offset < mb->offset ? -1 : (ma->offset > mb->offset ? 1 : 0);
+}
+
+static gboolean
+template_find_sentinels (GMimeMessageTemplate *tmpl, GByteArray *body, GArray *matches)
+{
+	Placeholder *placeholder;
+	SentinelMatch match;
+	const char *inptr;
+	size_t n;
+	guint i;
+	
+	for (i = 0; i < tmpl->placeholders->len; i++) {
+		placeholder = (Placeholder *) tmpl->placeholders->pdata[i];
+		
+		if (placeholder->part == NULL)
+			continue;
+		
+		n = strlen (placeholder->sentinel);
+		inptr = (const char *) body->data;
+		
+		while ((inptr = memchr (inptr, '=', body->len - (inptr - (const char *) body->data)))) {
+			if ((size_t) (((const char *) body->data + body->len) - inptr) >= n && !strncmp (inptr, placeholder->sentinel, n))
+				break;
+			
+			inptr++;
+		}
+		
+		/* the part is not a descendant of the message */
+		if (inptr == NULL)
+			return FALSE;
+		
+		match.offset = inptr - (const char *) body->data;
+		match.placeholder = placeholder;
+		g_array_append_val (matches, match);
+	}
+	
+	g_array_sort (matches, sentinel_match_compare);
+	
+	return TRUE;
+}
+
+static gboolean
+template_compile_body (GMimeMessageTemplate *tmpl, GMimeMessage *message, GMimeStream *stream)
+{
+	size_t newline_len = strlen (g_mime_format_options_get_newline (tmpl->options));
+	guint offset = tmpl->buffer->len;
+	Placeholder *placeholder;
+	GMimeStream *mem;
+	SentinelMatch *match;
+	GByteArray *body;
+	GArray *matches;
+	guint start = 0;
+	size_t n;
+	guint i;
+	
+	body = g_byte_array_new ();
+	mem = g_mime_stream_mem_new_with_byte_array (body);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) mem, FALSE);
+	
+	template_swap_content (tmpl, message);
+	g_mime_object_write_content_to_stream ((GMimeObject *) message, tmpl->options, mem);
+	template_restore_content (tmpl);
+	g_object_unref (mem);
+	
+	matches = g_array_new (FALSE, FALSE, sizeof (SentinelMatch));
+	
+	if (!template_find_sentinels (tmpl, body, matches)) {
+		g_byte_array_free (body, TRUE);
+		g_array_free (matches, TRUE);
+		return FALSE;
+	}
+	
+	for (i = 0; i < matches->len; i++) {
+		match = &g_array_index (matches, SentinelMatch, i);
+		placeholder = match->placeholder;
+		
+		g_mime_stream_write (stream, (const char *) body->data + start, match->offset - start);
+		template_add_segment (tmpl, NULL, &offset);
+		
+		/* the original content is used when no value is substituted */
+		write_part_value (tmpl, placeholder, placeholder->part->content, NULL, stream);
+		template_add_segment (tmpl, placeholder, &offset);
+		
+		n = strlen (placeholder->sentinel);
+		if (placeholder->ensure_newline)
+			n += newline_len;
+		
+		start = match->offset + n;
+	}
+	
+	g_mime_stream_write (stream, (const char *) body->data + start, body->len - start);
+	template_add_segment (tmpl, NULL, &offset);
+	
+	g_byte_array_free (body, TRUE);
+	g_array_free (matches, TRUE);
+	
+	return TRUE;
+}
+
+
+/**
+ * g_mime_message_template_compile:
+ * @tmpl: a #GMimeMessageTemplate
+ * @message: a #GMimeMessage
+ * @options: (nullable): a #GMimeFormatOptions or %NULL
+ *
+ * Serializes @message into @tmpl using the specified format @options,
+ * splitting the output into fixed segments and the placeholders that
+ * have been added to the template.
+ *
+ * The MIME parts of @message that have been added as placeholders are
+ * temporarily modified during compilation, so @message must not be
+ * used concurrently by other threads.
+ *
+ * Returns: %TRUE on success or %FALSE if one of the part placeholders
+ * could not be found within @message.
+ **/
+gboolean
+g_mime_message_template_compile (GMimeMessageTemplate *tmpl, GMimeMessage *message, GMimeFormatOptions *options)
+{
+	GMimeStream *stream;
+	gboolean compiled;
+	
+	g_return_val_if_fail (GMIME_IS_MESSAGE_TEMPLATE (tmpl), FALSE);
+	g_return_val_if_fail (GMIME_IS_MESSAGE (message), FALSE);
+	
+	template_reset (tmpl, message, options);
+	
+	stream = g_mime_stream_mem_new_with_byte_array (tmpl->buffer);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) stream, FALSE);
+	
+	template_compile_headers (tmpl, message, stream);
+	compiled = template_compile_body (tmpl, message, stream);
+	g_object_unref (stream);
+	
+	if (!compiled) {
+		g_byte_array_set_size (tmpl->buffer, 0);
+		g_array_set_size (tmpl->segments, 0);
+		return FALSE;
+	}
+	
+	d(g_printerr ("compiled template: %u bytes in %u segments\n", tmpl->buffer->len, tmpl->segments->len));
+	
+	tmpl->compiled = TRUE;
+	
+	return TRUE;
+}
+
+
+static const char *
+lookup_value (const char *name, const char **names, const char **values)
+{
+	guint i;
+	
+	if (names == NULL)
+		return NULL;
+	
+	for (i = 0; names[i] != NULL; i++) {
+		if (!g_ascii_strcasecmp (names[i], name))
+			return values[i];
+	}
+	
+	return NULL;
+}
+
+
+/**
+ * g_mime_message_template_write_to_stream:
+ * @tmpl: a compiled #GMimeMessageTemplate
+ * @stream: the output stream
+ * @names: (nullable) (array zero-terminated=1): a %NULL-terminated array of placeholder names
+ * @values: (nullable) (array): the values corresponding to each of the @names
+ *
+ * Writes an instance of the template to @stream, substituting the
+ * value for each placeholder listed in @names. Header values are
+ * folded and encoded the same way g_mime_header_set_value() would.
+ * Part values are converted from UTF-8 to the part's charset and
+ * encoded according to the part's Content-Transfer-Encoding.
+ *
+ * Placeholders without a corresponding value are written as they were
+ * in the compiled message. Header placeholders that were not present
+ * in the message are omitted.
+ *
+ * A compiled template may be written from multiple threads at once.
+ *
+ * Returns: the number of bytes written or %-1 on fail.
+ **/
+ssize_t
+g_mime_message_template_write_to_stream (GMimeMessageTemplate *tmpl, GMimeStream *stream,
+					 const char **names, const char **values)
+{
+	ssize_t nwritten, total = 0;
+	Placeholder *placeholder;
+	const char *value;
+	Segment *segment;
+	guint i;
+	
+	g_return_val_if_fail (GMIME_IS_MESSAGE_TEMPLATE (tmpl), -1);
+	g_return_val_if_fail (GMIME_IS_STREAM (stream), -1);
+	g_return_val_if_fail (names == NULL || values != NULL, -1);
+	g_return_val_if_fail (tmpl->compiled, -1);
+	
+	for (i = 0; i < tmpl->segments->len; i++) {
+		segment = &g_array_index (tmpl->segments, Segment, i);
+		
+		if ((placeholder = segment->placeholder) && (value = lookup_value (placeholder->name, names, values))) {
+			if (placeholder->part != NULL)
+				nwritten = write_part_value (tmpl, placeholder, NULL, value, stream);
+			else
+				nwritten = write_header_value (tmpl, placeholder, value, stream);
+		} else {
+			nwritten = g_mime_stream_write (stream, (const char *) tmpl->buffer->data + segment->offset, segment->length);
+		}
+		
+		if (nwritten == -1)
+			return -1;
+		
+		total += nwritten;
+	}
+	
+	return total;
+}
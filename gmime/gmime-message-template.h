@@ -0,0 +1,85 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifndef __GMIME_MESSAGE_TEMPLATE_H__
+#define __GMIME_MESSAGE_TEMPLATE_H__
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <gmime/gmime-format-options.h>
+#include <gmime/gmime-message.h>
+#include <gmime/gmime-header.h>
+#include <gmime/gmime-stream.h>
+#include <gmime/gmime-part.h>
+
+G_BEGIN_DECLS
+
+#define GMIME_TYPE_MESSAGE_TEMPLATE            (g_mime_message_template_get_type ())
+#define GMIME_MESSAGE_TEMPLATE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GMIME_TYPE_MESSAGE_TEMPLATE, GMimeMessageTemplate))
+#define GMIME_MESSAGE_TEMPLATE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GMIME_TYPE_MESSAGE_TEMPLATE, GMimeMessageTemplateClass))
+#define GMIME_IS_MESSAGE_TEMPLATE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GMIME_TYPE_MESSAGE_TEMPLATE))
+#define GMIME_IS_MESSAGE_TEMPLATE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GMIME_TYPE_MESSAGE_TEMPLATE))
+#define GMIME_MESSAGE_TEMPLATE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GMIME_TYPE_MESSAGE_TEMPLATE, GMimeMessageTemplateClass))
+
+typedef struct _GMimeMessageTemplate GMimeMessageTemplate;
+typedef struct _GMimeMessageTemplateClass GMimeMessageTemplateClass;
+
+/**
+ * GMimeMessageTemplate:
+ * @parent_object: parent #GObject
+ *
+ * A pre-serialized message consisting of fixed byte segments and named
+ * placeholders that can be cheaply instantiated many times over.
+ **/
+struct _GMimeMessageTemplate {
+	GObject parent_object;
+	
+	/* < private > */
+	GMimeFormatOptions *options;
+	GMimeHeaderList *headers;
+	GPtrArray *placeholders;
+	GByteArray *buffer;
+	GArray *segments;
+	gboolean compiled;
+};
+
+struct _GMimeMessageTemplateClass {
+	GObjectClass parent_class;
+
+};
+
+
+GType g_mime_message_template_get_type (void);
+
+GMimeMessageTemplate *g_mime_message_template_new (void);
+
+void g_mime_message_template_add_header (GMimeMessageTemplate *tmpl, const char *header);
+void g_mime_message_template_add_part (GMimeMessageTemplate *tmpl, const char *name, GMimePart *part);
+
+gboolean g_mime_message_template_compile (GMimeMessageTemplate *tmpl, GMimeMessage *message, GMimeFormatOptions *options);
+
+ssize_t g_mime_message_template_write_to_stream (GMimeMessageTemplate *tmpl, GMimeStream *stream,
+						 const char **names, const char **values);
+
+G_END_DECLS
+
+#endif /* __GMIME_MESSAGE_TEMPLATE_H__ */
@@ -65,6 +65,8 @@ static ssize_t message_write_to_stream (GMimeObject *object, GMimeFormatOptions
 					gboolean content_only, GMimeStream *stream);
 static void message_encode (GMimeObject *object, GMimeEncodingConstraint constraint);
 
+static void sync_internet_address_list (InternetAddressList *list, GMimeMessage *message, const char *name);
+
 static void sender_changed (InternetAddressList *list, gpointer args, GMimeMessage *message);
 static void from_changed (InternetAddressList *list, gpointer args, GMimeMessage *message);
 static void reply_to_changed (InternetAddressList *list, gpointer args, GMimeMessage *message);
@@ -72,7 +74,16 @@ static void to_list_changed (InternetAddressList *list, gpointer args, GMimeMess
 static void cc_list_changed (InternetAddressList *list, gpointer args, GMimeMessage *message);
 static void bcc_list_changed (InternetAddressList *list, gpointer args, GMimeMessage *message);
 
+typedef struct {
+	guint unparsed;
+	guint exposed;
+	guint unsynced;
+} GMimeMessagePrivate;
+
+#define GET_PRIVATE(message) ((GMimeMessagePrivate *) G_STRUCT_MEMBER_P (message, private_offset))
+
 static GMimeObjectClass *parent_class = NULL;
+static gint private_offset = 0;
 
 static struct {
 	const char *name;
@@ -120,6 +131,7 @@ g_mime_message_get_type (void)
 		};
 		
 		type = g_type_register_static (GMIME_TYPE_OBJECT, "GMimeMessage", &info, 0);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeMessagePrivate));
 	}
 	
 	return type;
@@ -133,6 +145,7 @@ g_mime_message_class_init (GMimeMessageClass *klass)
 	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (GMIME_TYPE_OBJECT);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	gobject_class->finalize = g_mime_message_finalize;
 	
@@ -318,6 +331,49 @@ header_was_appended (GMimeObject *object, GMimeHeaderListChangedAction action, G
 	return FALSE;
 }
 
+/* Address headers are not parsed until the corresponding list is first
+ * requested. Once a list has been handed out, the caller may hold on to
+ * it, so from then on it is kept up-to-date as the headers change (or,
+ * while a batch update is in progress, once the batch is committed). */
+static void
+message_addresses_changed (GMimeMessage *message, GMimeParserOptions *options, GMimeHeaderListChangedAction action,
+			   GMimeHeader *header, GMimeAddressType type)
+{
+	GMimeMessagePrivate *priv = GET_PRIVATE (message);
+	GMimeObject *object = (GMimeObject *) message;
+	
+	if (_g_mime_object_is_updating (object)) {
+		/* the header now takes precedence over earlier list changes */
+		priv->unsynced &= ~(1 << type);
+		priv->unparsed |= 1 << type;
+	} else if (!(priv->exposed & (1 << type)))
+		priv->unparsed |= 1 << type;
+	else if (header_was_appended (object, action, header))
+		message_add_addresses (message, options, header, type);
+	else
+		message_update_addresses (message, options, type);
+}
+
+static InternetAddressList *
+message_get_addrlist (GMimeMessage *message, GMimeAddressType type)
+{
+	GMimeMessagePrivate *priv = GET_PRIVATE (message);
+	GMimeObject *object = (GMimeObject *) message;
+	GMimeParserOptions *options;
+	
+	if (priv->unparsed & (1 << type)) {
+		options = _g_mime_header_list_get_options (object->headers);
+		message_update_addresses (message, options, type);
+		priv->unparsed &= ~(1 << type);
+	}
+	
+	/* don't write to a frozen message that may be shared between threads */
+	if (!(priv->exposed & (1 << type)))
+		priv->exposed |= 1 << type;
+	
+	return message->addrlists[type];
+}
+
 static void
 process_header (GMimeObject *object, GMimeHeaderListChangedAction action, GMimeHeader *header)
 {
@@ -335,40 +391,22 @@ process_header (GMimeObject *object, GMimeHeaderListChangedAction action, GMimeH
 	
 	switch (i) {
 	case HEADER_SENDER:
-		if (header_was_appended (object, action, header))
-			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_SENDER);
-		else
-			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_SENDER);
+		message_addresses_changed (message, options, action, header, GMIME_ADDRESS_TYPE_SENDER);
 		break;
 	case HEADER_FROM:
-		if (header_was_appended (object, action, header))
-			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_FROM);
-		else
-			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_FROM);
+		message_addresses_changed (message, options, action, header, GMIME_ADDRESS_TYPE_FROM);
 		break;
 	case HEADER_REPLY_TO:
-		if (header_was_appended (object, action, header))
-			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_REPLY_TO);
-		else
-			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_REPLY_TO);
+		message_addresses_changed (message, options, action, header, GMIME_ADDRESS_TYPE_REPLY_TO);
 		break;
 	case HEADER_TO:
-		if (header_was_appended (object, action, header))
-			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_TO);
-		else
-			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_TO);
+		message_addresses_changed (message, options, action, header, GMIME_ADDRESS_TYPE_TO);
 		break;
 	case HEADER_CC:
-		if (header_was_appended (object, action, header))
-			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_CC);
-		else
-			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_CC);
+		message_addresses_changed (message, options, action, header, GMIME_ADDRESS_TYPE_CC);
 		break;
 	case HEADER_BCC:
-		if (header_was_appended (object, action, header))
-			message_add_addresses (message, options, header, GMIME_ADDRESS_TYPE_BCC);
-		else
-			message_update_addresses (message, options, GMIME_ADDRESS_TYPE_BCC);
+		message_addresses_changed (message, options, action, header, GMIME_ADDRESS_TYPE_BCC);
 		break;
 	case HEADER_SUBJECT:
 		g_free (message->subject);
@@ -430,22 +468,22 @@ message_header_removed (GMimeObject *object, GMimeHeader *header)
 	
 	switch (i) {
 	case HEADER_SENDER:
-		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_SENDER);
+		message_addresses_changed (message, options, GMIME_HEADER_LIST_CHANGED_ACTION_REMOVED, header, GMIME_ADDRESS_TYPE_SENDER);
 		break;
 	case HEADER_FROM:
-		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_FROM);
+		message_addresses_changed (message, options, GMIME_HEADER_LIST_CHANGED_ACTION_REMOVED, header, GMIME_ADDRESS_TYPE_FROM);
 		break;
 	case HEADER_REPLY_TO:
-		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_REPLY_TO);
+		message_addresses_changed (message, options, GMIME_HEADER_LIST_CHANGED_ACTION_REMOVED, header, GMIME_ADDRESS_TYPE_REPLY_TO);
 		break;
 	case HEADER_TO:
-		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_TO);
+		message_addresses_changed (message, options, GMIME_HEADER_LIST_CHANGED_ACTION_REMOVED, header, GMIME_ADDRESS_TYPE_TO);
 		break;
 	case HEADER_CC:
-		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_CC);
+		message_addresses_changed (message, options, GMIME_HEADER_LIST_CHANGED_ACTION_REMOVED, header, GMIME_ADDRESS_TYPE_CC);
 		break;
 	case HEADER_BCC:
-		message_update_addresses (message, options, GMIME_ADDRESS_TYPE_BCC);
+		message_addresses_changed (message, options, GMIME_HEADER_LIST_CHANGED_ACTION_REMOVED, header, GMIME_ADDRESS_TYPE_BCC);
 		break;
 	case HEADER_SUBJECT:
 		g_free (message->subject);
@@ -478,6 +516,9 @@ message_headers_cleared (GMimeObject *object)
 		unblock_changed_event (message, i);
 	}
 	
+	GET_PRIVATE (message)->unparsed = 0;
+	GET_PRIVATE (message)->unsynced = 0;
+	
 	g_free (message->message_id);
 	message->message_id = NULL;
 	g_free (message->subject);
@@ -491,20 +532,147 @@ message_headers_cleared (GMimeObject *object)
 	GMIME_OBJECT_CLASS (parent_class)->headers_cleared (object);
 }
 
+/**
+ * _g_mime_message_end_update:
+ * @message: a #GMimeMessage
+ *
+ * Synchronizes the address lists and address headers that were
+ * modified while a batch update was in progress.
+ **/
+void
+_g_mime_message_end_update (GMimeMessage *message)
+{
+	GMimeParserOptions *options = _g_mime_header_list_get_options (((GMimeObject *) message)->headers);
+	GMimeMessagePrivate *priv = GET_PRIVATE (message);
+	guint i;
+	
+	for (i = 0; i < N_ADDRESS_TYPES; i++) {
+		if (priv->unsynced & (1 << i)) {
+			sync_internet_address_list (message->addrlists[i], message, address_types[i].name);
+		} else if (priv->unparsed & priv->exposed & (1 << i)) {
+			message_update_addresses (message, options, i);
+			priv->unparsed &= ~(1 << i);
+		}
+	}
+	
+	priv->unsynced = 0;
+}
+
+static void
+freeze_addresses (InternetAddressList *list)
+{
+	InternetAddress *address;
+	int count, i;
+	
+	count = internet_address_list_length (list);
+	for (i = 0; i < count; i++) {
+		address = internet_address_list_get_address (list, i);
+		
+		if (INTERNET_ADDRESS_IS_GROUP (address))
+			freeze_addresses (internet_address_group_get_members ((InternetAddressGroup *) address));
+		else
+			internet_address_mailbox_get_idn_addr ((InternetAddressMailbox *) address);
+	}
+}
+
+/**
+ * _g_mime_message_freeze:
+ * @message: a #GMimeMessage
+ *
+ * Parses the address lists of @message and freezes its toplevel MIME
+ * part.
+ **/
+void
+_g_mime_message_freeze (GMimeMessage *message)
+{
+	guint i;
+	
+	/* parse the address headers (and encode any IDN domains) up-front */
+	for (i = 0; i < N_ADDRESS_TYPES; i++)
+		freeze_addresses (message_get_addrlist (message, i));
+	
+	if (message->mime_part)
+		g_mime_object_freeze (message->mime_part);
+}
+
+/**
+ * _g_mime_message_copy:
+ * @dest: the #GMimeMessage cloned from @src
+ * @src: a #GMimeMessage
+ *
+ * Copies the mbox marker of @src to @dest and sets a clone of the
+ * toplevel MIME part of @src on @dest. The address lists of @dest are
+ * left unparsed until they are requested.
+ **/
+void
+_g_mime_message_copy (GMimeMessage *dest, GMimeMessage *src)
+{
+	dest->marker = g_strdup (src->marker);
+	
+	if (src->mime_part)
+		dest->mime_part = g_mime_object_clone (src->mime_part);
+}
+
+
+/**
+ * _g_mime_message_next_header:
+ * @message: a #GMimeMessage
+ * @index: the index into the message's header list
+ * @body_index: the index into the mime part's header list
+ *
+ * Gets the next header in the order it would be written by
+ * g_mime_object_write_to_stream(), merging the message headers with
+ * those of the toplevel mime part by their stream offsets. Both
+ * indexes should be initialized to 0 before the first call.
+ *
+ * Returns: the next header or %NULL when there are no more headers.
+ **/
+GMimeHeader *
+_g_mime_message_next_header (GMimeMessage *message, int *index, int *body_index)
+{
+	GMimeObject *object = (GMimeObject *) message;
+	GMimeObject *mime_part = message->mime_part;
+	int count = g_mime_header_list_get_count (object->headers);
+	GMimeHeader *header, *body_header;
+	int body_count = 0;
+	
+	if (mime_part != NULL)
+		body_count = g_mime_header_list_get_count (mime_part->headers);
+	
+	if (*index < count && *body_index < body_count) {
+		body_header = g_mime_header_list_get_header_at (mime_part->headers, *body_index);
+		
+		if (g_mime_header_get_offset (body_header) >= 0) {
+			header = g_mime_header_list_get_header_at (object->headers, *index);
+			
+			if (g_mime_header_get_offset (header) < g_mime_header_get_offset (body_header)) {
+				(*index)++;
+				return header;
+			}
+			
+			(*body_index)++;
+			return body_header;
+		}
+	}
+	
+	if (*index < count)
+		return g_mime_header_list_get_header_at (object->headers, (*index)++);
+	
+	if (*body_index < body_count)
+		return g_mime_header_list_get_header_at (mime_part->headers, (*body_index)++);
+	
+	return NULL;
+}
 
 static ssize_t
 write_headers_to_stream (GMimeObject *object, GMimeFormatOptions *options, GMimeStream *stream)
 {
 	GMimeMessage *message = (GMimeMessage *) object;
-	GMimeObject *mime_part = message->mime_part;
 	
-	if (mime_part != NULL) {
-		int body_count = g_mime_header_list_get_count (mime_part->headers);
-		int count = g_mime_header_list_get_count (object->headers);
-		GMimeHeader *header, *body_header;
+	if (message->mime_part != NULL) {
 		ssize_t nwritten, total = 0;
-		gint64 body_offset, offset;
 		GMimeStream *filtered;
+		GMimeHeader *header;
 		GMimeFilter *filter;
 		int body_index = 0;
 		int index = 0;
@@ -514,67 +682,16 @@ write_headers_to_stream (GMimeObject *object, GMimeFormatOptions *options, GMime
 		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
 		g_object_unref (filter);
 		
-		while (index < count && body_index < body_count) {
-			body_header = g_mime_header_list_get_header_at (mime_part->headers, body_index);
-			if ((body_offset = g_mime_header_get_offset (body_header)) < 0)
-				break;
-			
-			header = g_mime_header_list_get_header_at (object->headers, index);
-			offset = g_mime_header_get_offset (header);
-			
-			if (offset < body_offset) {
-				if (!g_mime_format_options_is_hidden_header (options, header->name)) {
-					if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1) {
-						g_object_unref (filtered);
-						return -1;
-					}
-					
-					total += nwritten;
-				}
-				
-				index++;
-			} else {
-				if (!g_mime_format_options_is_hidden_header (options, body_header->name)) {
-					if ((nwritten = g_mime_header_write_to_stream (body_header, options, filtered)) == -1) {
-						g_object_unref (filtered);
-						return -1;
-					}
-					
-					total += nwritten;
-				}
-				
-				body_index++;
-			}
-		}
-		
-		while (index < count) {
-			header = g_mime_header_list_get_header_at (object->headers, index);
+		while ((header = _g_mime_message_next_header (message, &index, &body_index))) {
+			if (g_mime_format_options_is_hidden_header (options, header->name))
+				continue;
 			
-			if (!g_mime_format_options_is_hidden_header (options, header->name)) {
-				if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1) {
-					g_object_unref (filtered);
-					return -1;
-				}
-				
-				total += nwritten;
+			if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1) {
+				g_object_unref (filtered);
+				return -1;
 			}
 			
-			index++;
-		}
-		
-		while (body_index < body_count) {
-			header = g_mime_header_list_get_header_at (mime_part->headers, body_index);
-			
-			if (!g_mime_format_options_is_hidden_header (options, header->name)) {
-				if ((nwritten = g_mime_header_write_to_stream (header, options, filtered)) == -1) {
-					g_object_unref (filtered);
-					return -1;
-				}
-				
-				total += nwritten;
-			}
-			
-			body_index++;
+			total += nwritten;
 		}
 		
 		g_object_unref (filtered);
@@ -700,7 +817,7 @@ g_mime_message_get_sender (GMimeMessage *message)
 {
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	
-	return message->addrlists[GMIME_ADDRESS_TYPE_SENDER];
+	return message_get_addrlist (message, GMIME_ADDRESS_TYPE_SENDER);
 }
 
 
@@ -717,7 +834,7 @@ g_mime_message_get_from (GMimeMessage *message)
 {
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	
-	return message->addrlists[GMIME_ADDRESS_TYPE_FROM];
+	return message_get_addrlist (message, GMIME_ADDRESS_TYPE_FROM);
 }
 
 
@@ -734,7 +851,7 @@ g_mime_message_get_reply_to (GMimeMessage *message)
 {
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	
-	return message->addrlists[GMIME_ADDRESS_TYPE_REPLY_TO];
+	return message_get_addrlist (message, GMIME_ADDRESS_TYPE_REPLY_TO);
 }
 
 
@@ -751,7 +868,7 @@ g_mime_message_get_to (GMimeMessage *message)
 {
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	
-	return message->addrlists[GMIME_ADDRESS_TYPE_TO];
+	return message_get_addrlist (message, GMIME_ADDRESS_TYPE_TO);
 }
 
 
@@ -768,7 +885,7 @@ g_mime_message_get_cc (GMimeMessage *message)
 {
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	
-	return message->addrlists[GMIME_ADDRESS_TYPE_CC];
+	return message_get_addrlist (message, GMIME_ADDRESS_TYPE_CC);
 }
 
 
@@ -785,7 +902,7 @@ g_mime_message_get_bcc (GMimeMessage *message)
 {
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	
-	return message->addrlists[GMIME_ADDRESS_TYPE_BCC];
+	return message_get_addrlist (message, GMIME_ADDRESS_TYPE_BCC);
 }
 
 
@@ -816,6 +933,17 @@ sync_address_header (GMimeMessage *message, GMimeAddressType type)
 	InternetAddressList *list = message->addrlists[type];
 	const char *name = address_types[type].name;
 	
+	_g_mime_object_check_mutable ((GMimeObject *) message);
+	
+	if (_g_mime_object_is_updating ((GMimeObject *) message)) {
+		GMimeMessagePrivate *priv = GET_PRIVATE (message);
+		
+		/* the list now takes precedence over earlier header changes */
+		priv->unparsed &= ~(1 << type);
+		priv->unsynced |= 1 << type;
+		return;
+	}
+	
 	sync_internet_address_list (list, message, name);
 }
 
@@ -877,7 +1005,7 @@ g_mime_message_add_mailbox (GMimeMessage *message, GMimeAddressType type, const
 	g_return_if_fail (type < N_ADDRESS_TYPES);
 	g_return_if_fail (addr != NULL);
 	
-	addrlist = message->addrlists[type];
+	addrlist = message_get_addrlist (message, type);
 	ia = internet_address_mailbox_new (name, addr);
 	internet_address_list_add (addrlist, ia);
 	g_object_unref (ia);
@@ -900,7 +1028,7 @@ g_mime_message_get_addresses (GMimeMessage *message, GMimeAddressType type)
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	g_return_val_if_fail (type < N_ADDRESS_TYPES, NULL);
 	
-	return message->addrlists[type];
+	return message_get_addrlist (message, type);
 }
 
 
@@ -923,7 +1051,7 @@ g_mime_message_get_all_recipients (GMimeMessage *message)
 	g_return_val_if_fail (GMIME_IS_MESSAGE (message), NULL);
 	
 	for (i = GMIME_ADDRESS_TYPE_TO; i <= GMIME_ADDRESS_TYPE_BCC; i++) {
-		recipients = message->addrlists[i];
+		recipients = message_get_addrlist (message, i);
 		
 		if (internet_address_list_length (recipients) == 0)
 			continue;
@@ -1110,6 +1238,8 @@ g_mime_message_set_mime_part (GMimeMessage *message, GMimeObject *mime_part)
 	}
 	
 	message->mime_part = mime_part;
+	
+	_g_mime_object_changed ((GMimeObject *) message);
 }
 
 
@@ -1273,7 +1403,7 @@ g_mime_message_get_autocrypt_header (GMimeMessage *message, GDateTime *now)
 	retlist = g_mime_object_get_autocrypt_headers (GMIME_OBJECT (message),
 						       effective_date,
 						       "autocrypt",
-						       message->addrlists[GMIME_ADDRESS_TYPE_FROM],
+						       message_get_addrlist (message, GMIME_ADDRESS_TYPE_FROM),
 						       TRUE);
 	if (newnow)
 		g_date_time_unref (newnow);
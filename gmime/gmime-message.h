@@ -70,13 +70,19 @@ typedef enum _GMimeAddressType {
 /**
  * GMimeMessage:
  * @parent_object: parent #GMimeObject
- * @addrlists: a table of address lists
+ * @addrlists: a table of address lists (deprecated, use g_mime_message_get_addresses())
  * @mime_part: toplevel MIME part
  * @message_id: Message-Id string
  * @date: Date value
  * @subject: Subject string
  *
  * A MIME Message object.
+ *
+ * Note: The address lists are only parsed from the message headers the
+ * first time they are requested, so reading @addrlists directly is
+ * deprecated: the lists it contains may be empty or out of date. Use
+ * g_mime_message_get_addresses() or one of the per-type getters, such
+ * as g_mime_message_get_from(), instead.
  **/
 struct _GMimeMessage {
 	GMimeObject parent_object;
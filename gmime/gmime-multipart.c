@@ -263,6 +263,48 @@ multipart_encode (GMimeObject *object, GMimeEncodingConstraint constraint)
 	}
 }
 
+/**
+ * _g_mime_multipart_freeze:
+ * @multipart: a #GMimeMultipart
+ *
+ * Freezes each of the subparts of @multipart.
+ **/
+void
+_g_mime_multipart_freeze (GMimeMultipart *multipart)
+{
+	GMimeObject *subpart;
+	int i;
+	
+	for (i = 0; i < g_mime_multipart_get_count (multipart); i++) {
+		subpart = g_mime_multipart_get_part (multipart, i);
+		g_mime_object_freeze (subpart);
+	}
+}
+
+/**
+ * _g_mime_multipart_copy:
+ * @dest: the #GMimeMultipart cloned from @src
+ * @src: a #GMimeMultipart
+ *
+ * Copies the prologue and epilogue of @src to @dest and appends a
+ * clone of each of the subparts of @src to @dest.
+ **/
+void
+_g_mime_multipart_copy (GMimeMultipart *dest, GMimeMultipart *src)
+{
+	GMimeObject *subpart;
+	guint i;
+	
+	dest->write_end_boundary = src->write_end_boundary;
+	dest->prologue = g_strdup (src->prologue);
+	dest->epilogue = g_strdup (src->epilogue);
+	
+	for (i = 0; i < src->children->len; i++) {
+		subpart = g_mime_object_clone (src->children->pdata[i]);
+		g_ptr_array_add (dest->children, subpart);
+	}
+}
+
 
 /**
  * g_mime_multipart_new:
@@ -320,6 +362,8 @@ g_mime_multipart_set_prologue (GMimeMultipart *multipart, const char *prologue)
 {
 	g_return_if_fail (GMIME_IS_MULTIPART (multipart));
 	
+	_g_mime_object_check_mutable ((GMimeObject *) multipart);
+	
 	g_free (multipart->prologue);
 	multipart->prologue = g_strdup (prologue);
 }
@@ -354,6 +398,8 @@ g_mime_multipart_set_epilogue (GMimeMultipart *multipart, const char *epilogue)
 {
 	g_return_if_fail (GMIME_IS_MULTIPART (multipart));
 	
+	_g_mime_object_check_mutable ((GMimeObject *) multipart);
+	
 	g_free (multipart->epilogue);
 	multipart->epilogue = g_strdup (epilogue);
 }
@@ -400,6 +446,7 @@ g_mime_multipart_clear (GMimeMultipart *multipart)
 	g_return_if_fail (GMIME_IS_MULTIPART (multipart));
 	
 	GMIME_MULTIPART_GET_CLASS (multipart)->clear (multipart);
+	_g_mime_object_changed ((GMimeObject *) multipart);
 }
 
 
@@ -425,6 +472,7 @@ g_mime_multipart_add (GMimeMultipart *multipart, GMimeObject *part)
 	g_return_if_fail (GMIME_IS_OBJECT (part));
 	
 	GMIME_MULTIPART_GET_CLASS (multipart)->add (multipart, part);
+	_g_mime_object_changed ((GMimeObject *) multipart);
 }
 
 
@@ -474,6 +522,7 @@ g_mime_multipart_insert (GMimeMultipart *multipart, int index, GMimeObject *part
 	g_return_if_fail (index >= 0);
 	
 	GMIME_MULTIPART_GET_CLASS (multipart)->insert (multipart, index, part);
+	_g_mime_object_changed ((GMimeObject *) multipart);
 }
 
 
@@ -504,7 +553,12 @@ g_mime_multipart_remove (GMimeMultipart *multipart, GMimeObject *part)
 	g_return_val_if_fail (GMIME_IS_MULTIPART (multipart), FALSE);
 	g_return_val_if_fail (GMIME_IS_OBJECT (part), FALSE);
 	
-	return GMIME_MULTIPART_GET_CLASS (multipart)->remove (multipart, part);
+	if (!GMIME_MULTIPART_GET_CLASS (multipart)->remove (multipart, part))
+		return FALSE;
+	
+	_g_mime_object_changed ((GMimeObject *) multipart);
+	
+	return TRUE;
 }
 
 
@@ -537,10 +591,15 @@ multipart_remove_at (GMimeMultipart *multipart, int index)
 GMimeObject *
 g_mime_multipart_remove_at (GMimeMultipart *multipart, int index)
 {
+	GMimeObject *removed;
+	
 	g_return_val_if_fail (GMIME_IS_MULTIPART (multipart), NULL);
 	g_return_val_if_fail (index >= 0, NULL);
 	
-	return GMIME_MULTIPART_GET_CLASS (multipart)->remove_at (multipart, index);
+	if ((removed = GMIME_MULTIPART_GET_CLASS (multipart)->remove_at (multipart, index)))
+		_g_mime_object_changed ((GMimeObject *) multipart);
+	
+	return removed;
 }
 
 
@@ -572,6 +631,8 @@ g_mime_multipart_replace (GMimeMultipart *multipart, int index, GMimeObject *rep
 	multipart->children->pdata[index] = replacement;
 	g_object_ref (replacement);
 	
+	_g_mime_object_changed ((GMimeObject *) multipart);
+	
 	return replaced;
 }
 
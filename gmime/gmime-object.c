@@ -55,6 +55,19 @@ struct _subtype_bucket {
 	GType object_type;
 };
 
+/* A small per-thread, direct-mapped cache of type/subtype -> GType
+ * resolutions made by the type registry. Entries are invalidated by
+ * bumping the registry generation whenever a type is registered. */
+#define TYPE_CACHE_SIZE     64
+#define TYPE_CACHE_NAME_LEN 32
+
+typedef struct {
+	char type[TYPE_CACHE_NAME_LEN];
+	char subtype[TYPE_CACHE_NAME_LEN];
+	GType object_type;
+	int generation;
+} TypeCacheEntry;
+
 static void _g_mime_object_set_content_disposition (GMimeObject *object, GMimeContentDisposition *disposition);
 void _g_mime_object_set_content_type (GMimeObject *object, GMimeContentType *content_type);
 
@@ -71,6 +84,8 @@ static void object_set_content_type (GMimeObject *object, GMimeContentType *cont
 static char *object_get_headers (GMimeObject *object, GMimeFormatOptions *options);
 static ssize_t object_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, gboolean content_only, GMimeStream *stream);
 static void object_encode (GMimeObject *object, GMimeEncodingConstraint constraint);
+static void object_end_update (GMimeObject *object);
+static void object_freeze (GMimeObject *object);
 
 static void header_list_changed (GMimeHeaderList *headers, GMimeHeaderListChangedEventArgs *args, GMimeObject *object);
 static void content_type_changed (GMimeContentType *content_type, gpointer args, GMimeObject *object);
@@ -78,8 +93,20 @@ static void content_disposition_changed (GMimeContentDisposition *disposition, g
 
 
 static GHashTable *type_hash = NULL;
+static int type_generation = 1;
+static GPrivate type_cache = G_PRIVATE_INIT (g_free);
+
+typedef struct {
+	GMimeEvent *changed;
+	guint update_depth;
+	guint pending;
+	gboolean frozen;
+} GMimeObjectPrivate;
+
+#define GET_PRIVATE(object) ((GMimeObjectPrivate *) G_STRUCT_MEMBER_P (object, private_offset))
 
 static GObjectClass *parent_class = NULL;
+static gint private_offset = 0;
 
 
 GType
@@ -102,6 +129,7 @@ g_mime_object_get_type (void)
 		
 		type = g_type_register_static (G_TYPE_OBJECT, "GMimeObject",
 					       &info, G_TYPE_FLAG_ABSTRACT);
+		private_offset = g_type_add_instance_private (type, sizeof (GMimeObjectPrivate));
 	}
 	
 	return type;
@@ -114,6 +142,7 @@ g_mime_object_class_init (GMimeObjectClass *klass)
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	
 	parent_class = g_type_class_ref (G_TYPE_OBJECT);
+	g_type_class_adjust_private_offset (klass, &private_offset);
 	
 	object_class->finalize = g_mime_object_finalize;
 	
@@ -147,6 +176,7 @@ static void
 g_mime_object_finalize (GObject *object)
 {
 	GMimeObject *mime = (GMimeObject *) object;
+	GMimeObjectPrivate *priv = GET_PRIVATE (mime);
 	GMimeEvent *event;
 	
 	if (mime->content_type) {
@@ -167,6 +197,9 @@ g_mime_object_finalize (GObject *object)
 		g_object_unref (mime->headers);
 	}
 	
+	if (priv->changed)
+		g_mime_event_free (priv->changed);
+	
 	g_free (mime->content_id);
 	
 	G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -185,6 +218,12 @@ static char *content_headers[] = {
 	"Content-Id",
 };
 
+/* header syncs deferred until g_mime_object_end_update() */
+enum {
+	PENDING_CONTENT_DISPOSITION = 1 << 0,
+	PENDING_CONTENT_TYPE        = 1 << 1,
+};
+
 static void
 object_header_added (GMimeObject *object, GMimeHeader *header)
 {
@@ -220,9 +259,11 @@ object_header_changed (GMimeObject *object, GMimeHeader *header)
 		value = g_mime_header_get_value (header);
 		disposition = _g_mime_content_disposition_parse (options, value, header->offset);
 		_g_mime_object_set_content_disposition (object, disposition);
+		GET_PRIVATE (object)->pending &= ~PENDING_CONTENT_DISPOSITION;
 		g_object_unref (disposition);
 		break;
 	case HEADER_CONTENT_TYPE:
+		GET_PRIVATE (object)->pending &= ~PENDING_CONTENT_TYPE;
 		value = g_mime_header_get_value (header);
 		content_type = _g_mime_content_type_parse (options, value, header->offset);
 		_g_mime_object_set_content_type (object, content_type);
@@ -232,6 +273,7 @@ object_header_changed (GMimeObject *object, GMimeHeader *header)
 		value = g_mime_header_get_value (header);
 		g_free (object->content_id);
 		object->content_id = g_mime_utils_decode_message_id (value);
+		_g_mime_object_changed (object);
 		break;
 	}
 }
@@ -261,6 +303,7 @@ object_header_removed (GMimeObject *object, GMimeHeader *header)
 			g_object_unref (object->disposition);
 			object->disposition = NULL;
 		}
+		GET_PRIVATE (object)->pending &= ~PENDING_CONTENT_DISPOSITION;
 		break;
 	case HEADER_CONTENT_TYPE:
 		/* never allow the removal of the Content-Type header */
@@ -268,6 +311,7 @@ object_header_removed (GMimeObject *object, GMimeHeader *header)
 	case HEADER_CONTENT_ID:
 		g_free (object->content_id);
 		object->content_id = NULL;
+		_g_mime_object_changed (object);
 		break;
 	}
 }
@@ -284,13 +328,20 @@ object_headers_cleared (GMimeObject *object)
 		object->disposition = NULL;
 	}
 	
-	g_free (object->content_id);
-	object->content_id = NULL;
+	GET_PRIVATE (object)->pending &= ~PENDING_CONTENT_DISPOSITION;
+	
+	if (object->content_id) {
+		g_free (object->content_id);
+		object->content_id = NULL;
+		_g_mime_object_changed (object);
+	}
 }
 
 static void
 header_list_changed (GMimeHeaderList *headers, GMimeHeaderListChangedEventArgs *args, GMimeObject *object)
 {
+	_g_mime_object_check_mutable (object);
+	
 	// FIXME: add a header_inserted() API so that header_added() can be better optimized. See gmime-message.c:message_header_added()/process_header().
 	switch (args->action) {
 	case GMIME_HEADER_LIST_CHANGED_ACTION_ADDED:
@@ -312,6 +363,9 @@ header_list_changed (GMimeHeaderList *headers, GMimeHeaderListChangedEventArgs *
 void
 _g_mime_object_block_header_list_changed (GMimeObject *object)
 {
+	/* every internal header sync starts here */
+	_g_mime_object_check_mutable (object);
+	
 	g_mime_event_block (object->headers->changed, (GMimeEventCallback) header_list_changed, object);
 }
 
@@ -321,11 +375,81 @@ _g_mime_object_unblock_header_list_changed (GMimeObject *object)
 	g_mime_event_unblock (object->headers->changed, (GMimeEventCallback) header_list_changed, object);
 }
 
+/**
+ * _g_mime_object_check_mutable:
+ * @object: a #GMimeObject
+ *
+ * Emits a critical warning if @object is being modified after having
+ * been frozen with g_mime_object_freeze().
+ **/
+void
+_g_mime_object_check_mutable (GMimeObject *object)
+{
+#ifndef G_DISABLE_CHECKS
+	if (G_UNLIKELY (GET_PRIVATE (object)->frozen))
+		g_critical ("%s %p is frozen and must not be modified", G_OBJECT_TYPE_NAME (object), (void *) object);
+#endif
+}
+
+/**
+ * _g_mime_object_add_changed_listener:
+ * @object: a #GMimeObject
+ * @callback: the callback
+ * @user_data: user data to pass to @callback
+ *
+ * Registers @callback to be notified whenever the Content-Id of
+ * @object or the set of subparts that it directly contains changes.
+ **/
+void
+_g_mime_object_add_changed_listener (GMimeObject *object, GMimeEventCallback callback, gpointer user_data)
+{
+	GMimeObjectPrivate *priv = GET_PRIVATE (object);
+	
+	if (priv->changed == NULL)
+		priv->changed = g_mime_event_new (object);
+	
+	g_mime_event_add (priv->changed, callback, user_data);
+}
+
+void
+_g_mime_object_remove_changed_listener (GMimeObject *object, GMimeEventCallback callback, gpointer user_data)
+{
+	GMimeObjectPrivate *priv = GET_PRIVATE (object);
+	
+	if (priv->changed != NULL)
+		g_mime_event_remove (priv->changed, callback, user_data);
+}
+
+/**
+ * _g_mime_object_changed:
+ * @object: a #GMimeObject
+ *
+ * Notifies the listeners of @object that its Content-Id or its
+ * subparts have changed.
+ **/
+void
+_g_mime_object_changed (GMimeObject *object)
+{
+	GMimeObjectPrivate *priv = GET_PRIVATE (object);
+	
+	_g_mime_object_check_mutable (object);
+	
+	/* the event is only allocated once someone is listening */
+	if (priv->changed != NULL)
+		g_mime_event_emit (priv->changed, NULL);
+}
+
 static void
 content_type_changed (GMimeContentType *content_type, gpointer args, GMimeObject *object)
 {
+	GMimeObjectPrivate *priv = GET_PRIVATE (object);
 	char *raw_value;
 	
+	if (priv->update_depth > 0) {
+		priv->pending |= PENDING_CONTENT_TYPE;
+		return;
+	}
+	
 	raw_value = g_mime_content_type_encode (content_type, NULL);
 	
 	_g_mime_object_block_header_list_changed (object);
@@ -337,8 +461,14 @@ content_type_changed (GMimeContentType *content_type, gpointer args, GMimeObject
 static void
 content_disposition_changed (GMimeContentDisposition *disposition, gpointer args, GMimeObject *object)
 {
+	GMimeObjectPrivate *priv = GET_PRIVATE (object);
 	char *raw_value;
 	
+	if (priv->update_depth > 0) {
+		priv->pending |= PENDING_CONTENT_DISPOSITION;
+		return;
+	}
+	
 	_g_mime_object_block_header_list_changed (object);
 	
 	if (disposition) {
@@ -387,6 +517,83 @@ g_mime_object_register_type (const char *type, const char *subtype, GType object
 	sub->subtype = g_strdup (subtype);
 	sub->object_type = object_type;
 	g_hash_table_insert (bucket->subtype_hash, sub->subtype, sub);
+	
+	g_atomic_int_inc (&type_generation);
+}
+
+
+static GType
+object_type_lookup (const char *type, const char *subtype)
+{
+	struct _type_bucket *bucket;
+	struct _subtype_bucket *sub;
+	GType obj_type;
+	
+	if ((bucket = g_hash_table_lookup (type_hash, type))) {
+		if (!(sub = g_hash_table_lookup (bucket->subtype_hash, subtype)))
+			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
+		
+		obj_type = sub ? sub->object_type : 0;
+	} else {
+		bucket = g_hash_table_lookup (type_hash, "*");
+		obj_type = bucket ? bucket->object_type : 0;
+	}
+	
+	if (!obj_type) {
+		/* use the default mime object */
+		if ((bucket = g_hash_table_lookup (type_hash, "*"))) {
+			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
+			obj_type = sub ? sub->object_type : 0;
+		}
+	}
+	
+	return obj_type;
+}
+
+static GType
+object_type_resolve (const char *type, const char *subtype)
+{
+	int generation = g_atomic_int_get (&type_generation);
+	size_t tlen = 0, slen = 0;
+	TypeCacheEntry *entry;
+	GType obj_type;
+	guint hash = 5381;
+	
+	while (type[tlen]) {
+		hash = (hash << 5) + hash + g_ascii_tolower (type[tlen]);
+		tlen++;
+	}
+	
+	hash = (hash << 5) + hash + '/';
+	
+	while (subtype[slen]) {
+		hash = (hash << 5) + hash + g_ascii_tolower (subtype[slen]);
+		slen++;
+	}
+	
+	if (tlen >= TYPE_CACHE_NAME_LEN || slen >= TYPE_CACHE_NAME_LEN)
+		return object_type_lookup (type, subtype);
+	
+	if (!(entry = g_private_get (&type_cache))) {
+		entry = g_new0 (TypeCacheEntry, TYPE_CACHE_SIZE);
+		g_private_set (&type_cache, entry);
+	}
+	
+	entry += hash % TYPE_CACHE_SIZE;
+	
+	if (entry->generation == generation &&
+	    !g_ascii_strcasecmp (entry->type, type) &&
+	    !g_ascii_strcasecmp (entry->subtype, subtype))
+		return entry->object_type;
+	
+	obj_type = object_type_lookup (type, subtype);
+	
+	memcpy (entry->type, type, tlen + 1);
+	memcpy (entry->subtype, subtype, slen + 1);
+	entry->object_type = obj_type;
+	entry->generation = generation;
+	
+	return obj_type;
 }
 
 
@@ -409,33 +616,13 @@ g_mime_object_register_type (const char *type, const char *subtype, GType object
 GMimeObject *
 g_mime_object_new (GMimeParserOptions *options, GMimeContentType *content_type)
 {
-	struct _type_bucket *bucket;
-	struct _subtype_bucket *sub;
 	GMimeObject *object;
 	GType obj_type;
 	
 	g_return_val_if_fail (GMIME_IS_CONTENT_TYPE (content_type), NULL);
 	
-	if ((bucket = g_hash_table_lookup (type_hash, content_type->type))) {
-		if (!(sub = g_hash_table_lookup (bucket->subtype_hash, content_type->subtype)))
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-		
-		obj_type = sub ? sub->object_type : 0;
-	} else {
-		bucket = g_hash_table_lookup (type_hash, "*");
-		obj_type = bucket ? bucket->object_type : 0;
-	}
-	
-	if (!obj_type) {
-		/* use the default mime object */
-		if ((bucket = g_hash_table_lookup (type_hash, "*"))) {
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-			obj_type = sub ? sub->object_type : 0;
-		}
-		
-		if (!obj_type)
-			return NULL;
-	}
+	if (!(obj_type = object_type_resolve (content_type->type, content_type->subtype)))
+		return NULL;
 	
 	object = g_object_new (obj_type, NULL);
 	_g_mime_header_list_set_options (object->headers, options);
@@ -465,33 +652,13 @@ g_mime_object_new (GMimeParserOptions *options, GMimeContentType *content_type)
 GMimeObject *
 g_mime_object_new_type (GMimeParserOptions *options, const char *type, const char *subtype)
 {
-	struct _type_bucket *bucket;
-	struct _subtype_bucket *sub;
 	GMimeObject *object;
 	GType obj_type;
 	
 	g_return_val_if_fail (type != NULL, NULL);
 	
-	if ((bucket = g_hash_table_lookup (type_hash, type))) {
-		if (!(sub = g_hash_table_lookup (bucket->subtype_hash, subtype)))
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-		
-		obj_type = sub ? sub->object_type : 0;
-	} else {
-		bucket = g_hash_table_lookup (type_hash, "*");
-		obj_type = bucket ? bucket->object_type : 0;
-	}
-	
-	if (!obj_type) {
-		/* use the default mime object */
-		if ((bucket = g_hash_table_lookup (type_hash, "*"))) {
-			sub = g_hash_table_lookup (bucket->subtype_hash, "*");
-			obj_type = sub ? sub->object_type : 0;
-		}
-		
-		if (!obj_type)
-			return NULL;
-	}
+	if (!(obj_type = object_type_resolve (type, subtype)))
+		return NULL;
 	
 	object = g_object_new (obj_type, NULL);
 	_g_mime_header_list_set_options (object->headers, options);
@@ -802,6 +969,7 @@ g_mime_object_set_content_id (GMimeObject *object, const char *content_id)
 	
 	g_free (object->content_id);
 	object->content_id = g_strdup (content_id);
+	_g_mime_object_changed (object);
 	
 	msgid = g_strdup_printf ("<%s>", content_id);
 	_g_mime_object_block_header_list_changed (object);
@@ -1087,6 +1255,251 @@ g_mime_object_get_header_list (GMimeObject *object)
 }
 
 
+static void
+object_end_update (GMimeObject *object)
+{
+	GMimeObjectPrivate *priv = GET_PRIVATE (object);
+	
+	if (priv->pending & PENDING_CONTENT_TYPE)
+		content_type_changed (object->content_type, NULL, object);
+	
+	if (priv->pending & PENDING_CONTENT_DISPOSITION)
+		content_disposition_changed (object->disposition, NULL, object);
+	
+	priv->pending = 0;
+}
+
+
+/**
+ * g_mime_object_begin_update:
+ * @object: a #GMimeObject
+ *
+ * Begins a batch of changes to @object. Until the matching call to
+ * g_mime_object_end_update(), changes made to the #GMimeContentType,
+ * #GMimeContentDisposition (and, for a #GMimeMessage, the address
+ * lists) are not serialized back into the header list each time they
+ * are modified. Instead, each affected header is re-encoded once when
+ * the batch is committed.
+ *
+ * Calls may be nested; only the outermost g_mime_object_end_update()
+ * commits the changes.
+ *
+ * Note: The raw header values of @object may be out of date until the
+ * batch has been committed.
+ **/
+void
+g_mime_object_begin_update (GMimeObject *object)
+{
+	g_return_if_fail (GMIME_IS_OBJECT (object));
+	
+	GET_PRIVATE (object)->update_depth++;
+}
+
+
+/**
+ * g_mime_object_end_update:
+ * @object: a #GMimeObject
+ *
+ * Ends a batch of changes started with g_mime_object_begin_update().
+ * If this ends the outermost batch, every header that was affected by
+ * changes made during the batch is synchronized.
+ **/
+void
+g_mime_object_end_update (GMimeObject *object)
+{
+	GMimeObjectPrivate *priv;
+	
+	g_return_if_fail (GMIME_IS_OBJECT (object));
+	
+	priv = GET_PRIVATE (object);
+	
+	g_return_if_fail (priv->update_depth > 0);
+	
+	if (--priv->update_depth > 0)
+		return;
+	
+	if (GMIME_IS_MESSAGE (object))
+		_g_mime_message_end_update ((GMimeMessage *) object);
+	
+	object_end_update (object);
+}
+
+
+/**
+ * _g_mime_object_is_updating:
+ * @object: a #GMimeObject
+ *
+ * Checks whether a batch of changes started with
+ * g_mime_object_begin_update() is in progress on @object.
+ *
+ * Returns: %TRUE if header syncs are currently being deferred.
+ **/
+gboolean
+_g_mime_object_is_updating (GMimeObject *object)
+{
+	return GET_PRIVATE (object)->update_depth > 0;
+}
+
+
+static void
+object_freeze (GMimeObject *object)
+{
+	GMimeHeader *header;
+	int count, i;
+	
+	/* decode (and cache) the value of every header */
+	count = g_mime_header_list_get_count (object->headers);
+	for (i = 0; i < count; i++) {
+		header = g_mime_header_list_get_header_at (object->headers, i);
+		g_mime_header_get_value (header);
+	}
+}
+
+
+/**
+ * g_mime_object_freeze:
+ * @object: a #GMimeObject
+ *
+ * Makes @object, and every MIME part contained within it, read-only.
+ *
+ * GMime objects fill in a number of caches lazily, such as the decoded
+ * header values and a message's address lists, so even reading from an
+ * object may modify it. Freezing forces all of these caches to be
+ * populated up-front. Once frozen, the object may be shared between
+ * threads without any locking as long as it is only read from.
+ *
+ * Since a frozen #GMimePart may be read concurrently, content caching
+ * is disabled and content that cannot safely be read from several
+ * threads at once (such as a non-seekable stream) is moved into memory.
+ * Seekable file-backed content is left in place. Use g_mime_data_wrapper_write_to_stream() to read the
+ * content rather than reading the data wrapper's stream directly.
+ *
+ * Modifying a frozen object is a programming error and results in a
+ * critical warning.
+ **/
+void
+g_mime_object_freeze (GMimeObject *object)
+{
+	GMimeObjectPrivate *priv;
+	
+	g_return_if_fail (GMIME_IS_OBJECT (object));
+	
+	priv = GET_PRIVATE (object);
+	
+	g_return_if_fail (priv->update_depth == 0);
+	
+	if (priv->frozen)
+		return;
+	
+	if (GMIME_IS_MESSAGE (object))
+		_g_mime_message_freeze ((GMimeMessage *) object);
+	else if (GMIME_IS_MESSAGE_PART (object))
+		_g_mime_message_part_freeze ((GMimeMessagePart *) object);
+	else if (GMIME_IS_MULTIPART (object))
+		_g_mime_multipart_freeze ((GMimeMultipart *) object);
+	else if (GMIME_IS_PART (object))
+		_g_mime_part_freeze ((GMimePart *) object);
+	
+	object_freeze (object);
+	priv->frozen = TRUE;
+}
+
+
+/**
+ * g_mime_object_is_frozen:
+ * @object: a #GMimeObject
+ *
+ * Gets whether or not @object has been frozen with g_mime_object_freeze().
+ *
+ * Returns: %TRUE if @object is frozen or %FALSE otherwise.
+ **/
+gboolean
+g_mime_object_is_frozen (GMimeObject *object)
+{
+	g_return_val_if_fail (GMIME_IS_OBJECT (object), FALSE);
+	
+	return GET_PRIVATE (object)->frozen;
+}
+
+
+static GMimeObject *
+object_clone (GMimeObject *object)
+{
+	GMimeContentType *content_type;
+	GMimeHeader *header;
+	GMimeObject *clone;
+	int count, i;
+	
+	clone = g_object_new (G_OBJECT_TYPE (object), NULL);
+	_g_mime_header_list_set_options (clone->headers, _g_mime_header_list_get_options (object->headers));
+	clone->ensure_newline = object->ensure_newline;
+	
+	/* the header_added() handlers take care of the Content-Type, etc */
+	count = g_mime_header_list_get_count (object->headers);
+	for (i = 0; i < count; i++) {
+		header = g_mime_header_list_get_header_at (object->headers, i);
+		_g_mime_header_list_append_copy (clone->headers, header);
+	}
+	
+	/* the parser does not serialize a default Content-Type to the headers */
+	if (clone->content_type == NULL && object->content_type != NULL) {
+		content_type = _g_mime_content_type_copy (object->content_type);
+		_g_mime_object_set_content_type (clone, content_type);
+		g_object_unref (content_type);
+	}
+	
+	return clone;
+}
+
+
+/**
+ * g_mime_object_clone:
+ * @object: a #GMimeObject
+ *
+ * Creates a deep copy of @object, such as a #GMimeMessage, without
+ * serializing and reparsing it.
+ *
+ * Only the MIME structure is duplicated: the headers are copied along
+ * with their already-decoded values, the content of the MIME parts is
+ * not copied (each clone reads it through its own substream of the
+ * original content stream) and the address lists of a message are
+ * not parsed until they are requested. This makes it cheap to create
+ * several slightly different variants of one message.
+ *
+ * The clone is independent of @object: modifying one does not affect
+ * the other. Note, however, that the underlying content is shared, so
+ * it must not be modified in place; use
+ * g_mime_part_set_content() to replace the content of a cloned part.
+ *
+ * Cloning a frozen object does not modify it, so a message frozen with
+ * g_mime_object_freeze() can be cloned from multiple threads at once.
+ * The clone itself is not frozen.
+ *
+ * Returns: (transfer full): a copy of @object.
+ **/
+GMimeObject *
+g_mime_object_clone (GMimeObject *object)
+{
+	GMimeObject *clone;
+	
+	g_return_val_if_fail (GMIME_IS_OBJECT (object), NULL);
+	g_return_val_if_fail (GET_PRIVATE (object)->update_depth == 0, NULL);
+	
+	clone = object_clone (object);
+	
+	if (GMIME_IS_MESSAGE (object))
+		_g_mime_message_copy ((GMimeMessage *) clone, (GMimeMessage *) object);
+	else if (GMIME_IS_MESSAGE_PART (object))
+		_g_mime_message_part_copy ((GMimeMessagePart *) clone, (GMimeMessagePart *) object);
+	else if (GMIME_IS_MULTIPART (object))
+		_g_mime_multipart_copy ((GMimeMultipart *) clone, (GMimeMultipart *) object);
+	else if (GMIME_IS_PART (object))
+		_g_mime_part_copy ((GMimePart *) clone, (GMimePart *) object);
+	
+	return clone;
+}
+
+
 static void
 subtype_bucket_foreach (gpointer key, gpointer value, gpointer user_data)
 {
@@ -1117,6 +1530,8 @@ g_mime_object_type_registry_shutdown (void)
 	g_hash_table_foreach (type_hash, type_bucket_foreach, NULL);
 	g_hash_table_destroy (type_hash);
 	type_hash = NULL;
+	
+	g_atomic_int_inc (&type_generation);
 }
 
 void
@@ -131,6 +131,14 @@ gboolean g_mime_object_remove_header (GMimeObject *object, const char *header);
 
 GMimeHeaderList *g_mime_object_get_header_list (GMimeObject *object);
 
+void g_mime_object_begin_update (GMimeObject *object);
+void g_mime_object_end_update (GMimeObject *object);
+
+void g_mime_object_freeze (GMimeObject *object);
+gboolean g_mime_object_is_frozen (GMimeObject *object);
+
+GMimeObject *g_mime_object_clone (GMimeObject *object);
+
 char *g_mime_object_get_headers (GMimeObject *object, GMimeFormatOptions *options);
 
 ssize_t g_mime_object_write_to_stream (GMimeObject *object, GMimeFormatOptions *options, GMimeStream *stream);
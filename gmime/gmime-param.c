@@ -658,7 +658,7 @@ encode_param (GMimeParam *param, GMimeFormatOptions *options, GMimeParamEncoding
 	}
 	
 	if (g_ascii_strcasecmp (charset, "UTF-8") != 0)
-		cd = g_mime_iconv_open (charset, "UTF-8");
+		cd = _g_mime_iconv_open (charset, "UTF-8");
 	
 	if (cd != (iconv_t) -1) {
 		outbuf = g_mime_iconv_strdup (cd, param->value);
@@ -1223,10 +1223,10 @@ charset_convert (const char *charset, char *in, size_t inlen)
 	}
 	
 	/* need charset conversion */
-	cd = g_mime_iconv_open ("UTF-8", charset);
+	cd = _g_mime_iconv_open ("UTF-8", charset);
 	if (cd == (iconv_t) -1 && !locale) {
 		charset = g_mime_locale_charset ();
-		cd = g_mime_iconv_open ("UTF-8", charset);
+		cd = _g_mime_iconv_open ("UTF-8", charset);
 	}
 	
 	if (cd != (iconv_t) -1) {
@@ -1466,3 +1466,241 @@ _g_mime_param_list_parse (GMimeParserOptions *options, const char *str, gint64 o
 	
 	return decode_param_list (options, str, offset);
 }
+
+
+/**
+ * _g_mime_param_list_copy:
+ * @dest: the destination #GMimeParamList
+ * @src: the source #GMimeParamList
+ *
+ * Appends a copy of each of the parameters in @src to @dest without
+ * emitting any change notifications.
+ **/
+void
+_g_mime_param_list_copy (GMimeParamList *dest, GMimeParamList *src)
+{
+	GMimeParam *param, *copy;
+	guint i;
+	
+	for (i = 0; i < src->array->len; i++) {
+		param = (GMimeParam *) src->array->pdata[i];
+		
+		copy = g_mime_param_new ();
+		copy->charset = g_strdup (param->charset);
+		copy->value = g_strdup (param->value);
+		copy->name = g_strdup (param->name);
+		copy->lang = g_strdup (param->lang);
+		copy->method = param->method;
+		
+		g_mime_param_list_add (dest, copy);
+	}
+}
+
+
+/* the maximum number of parsed header values remembered by the cache */
+#define PARAM_CACHE_SIZE 128
+
+/* longer values tend to carry unique filenames and are unlikely to recur */
+#define PARAM_CACHE_MAX_VALUE 256
+
+typedef struct {
+	GMimeRfcComplianceMode mode;
+	GObject *result;
+	char *value;
+	GType type;
+} ParamCacheNode;
+
+typedef struct {
+	GHashTable *hash;  /* ParamCacheNode -> GList link in lru */
+	GQueue lru;        /* ParamCacheNode's, most recently used first */
+} ParamCache;
+
+/* raw Content-Type / Content-Disposition value -> parsed snapshot */
+static ParamCache param_cache = { NULL, G_QUEUE_INIT };
+
+#ifdef G_THREADS_ENABLED
+static GMutex param_cache_lock;
+#define PARAM_CACHE_UNLOCK() g_mutex_unlock (&param_cache_lock)
+#define PARAM_CACHE_LOCK()   g_mutex_lock (&param_cache_lock)
+#else
+#define PARAM_CACHE_UNLOCK()
+#define PARAM_CACHE_LOCK()
+#endif /* G_THREADS_ENABLED */
+
+static guint
+param_cache_node_hash (gconstpointer key)
+{
+	const ParamCacheNode *node = key;
+	
+	return g_str_hash (node->value) ^ ((guint) node->type + node->mode);
+}
+
+static gboolean
+param_cache_node_equal (gconstpointer a, gconstpointer b)
+{
+	const ParamCacheNode *node0 = a, *node1 = b;
+	
+	return node0->type == node1->type && node0->mode == node1->mode &&
+		!strcmp (node0->value, node1->value);
+}
+
+static void
+param_cache_node_free (ParamCacheNode *node)
+{
+	g_object_unref (node->result);
+	g_free (node->value);
+	g_slice_free (ParamCacheNode, node);
+}
+
+
+/**
+ * _g_mime_param_cache_can_cache:
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @str: the raw Content-Type or Content-Disposition value
+ *
+ * Checks whether the parsed result of @str may be shared through the
+ * parameter cache. Only values whose parse depends on nothing but the
+ * parameter compliance mode are cacheable. Values without any
+ * parameters are not worth caching since parsing them is cheaper than
+ * looking them up.
+ *
+ * Returns: %TRUE if @str is cacheable or %FALSE otherwise.
+ **/
+gboolean
+_g_mime_param_cache_can_cache (GMimeParserOptions *options, const char *str)
+{
+	register const unsigned char *inptr = (const unsigned char *) str;
+	const unsigned char *inend = inptr + PARAM_CACHE_MAX_VALUE;
+	gboolean params = FALSE;
+	
+	/* a cache hit would not report any parser warnings */
+	if (g_mime_parser_options_get_warning_callback (options) != NULL)
+		return FALSE;
+	
+	while (*inptr && inptr < inend) {
+		/* 8bit and rfc2047 encoded values depend on the charset options */
+		if (*inptr > 127 || (*inptr == '=' && inptr[1] == '?'))
+			return FALSE;
+		
+		if (*inptr == ';')
+			params = TRUE;
+		
+		inptr++;
+	}
+	
+	return params && *inptr == '\0';
+}
+
+
+/**
+ * _g_mime_param_cache_lookup:
+ * @type: the #GType of the parsed object
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @str: the raw Content-Type or Content-Disposition value
+ *
+ * Looks up the previously parsed result of @str. The returned object is
+ * shared with the cache and must never be modified; callers hand out a
+ * copy of it instead.
+ *
+ * Returns: (nullable) (transfer full): the cached object or %NULL.
+ **/
+GObject *
+_g_mime_param_cache_lookup (GType type, GMimeParserOptions *options, const char *str)
+{
+	GObject *result = NULL;
+	ParamCacheNode key;
+	GList *link;
+	
+	key.mode = g_mime_parser_options_get_parameter_compliance_mode (options);
+	key.value = (char *) str;
+	key.type = type;
+	
+	PARAM_CACHE_LOCK ();
+	
+	if (param_cache.hash != NULL && (link = g_hash_table_lookup (param_cache.hash, &key))) {
+		/* move to the front of the lru */
+		g_queue_unlink (&param_cache.lru, link);
+		g_queue_push_head_link (&param_cache.lru, link);
+		
+		result = g_object_ref (((ParamCacheNode *) link->data)->result);
+	}
+	
+	PARAM_CACHE_UNLOCK ();
+	
+	return result;
+}
+
+
+/**
+ * _g_mime_param_cache_add:
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @str: the raw Content-Type or Content-Disposition value
+ * @result: (transfer full): the parsed object
+ *
+ * Adds @result to the cache as the parsed result of @str, evicting the
+ * least recently used entry if the cache is full. @result must not be
+ * referenced by anything but the cache from here on.
+ **/
+void
+_g_mime_param_cache_add (GMimeParserOptions *options, const char *str, GObject *result)
+{
+	ParamCacheNode *node;
+	
+	node = g_slice_new (ParamCacheNode);
+	node->mode = g_mime_parser_options_get_parameter_compliance_mode (options);
+	node->type = G_OBJECT_TYPE (result);
+	node->value = g_strdup (str);
+	node->result = result;
+	
+	PARAM_CACHE_LOCK ();
+	
+	if (param_cache.hash == NULL)
+		param_cache.hash = g_hash_table_new (param_cache_node_hash, param_cache_node_equal);
+	
+	/* another thread may have beaten us to it */
+	if (g_hash_table_contains (param_cache.hash, node)) {
+		PARAM_CACHE_UNLOCK ();
+		param_cache_node_free (node);
+		return;
+	}
+	
+	g_queue_push_head (&param_cache.lru, node);
+	g_hash_table_insert (param_cache.hash, node, param_cache.lru.head);
+	
+	if (param_cache.lru.length > PARAM_CACHE_SIZE) {
+		node = g_queue_pop_tail (&param_cache.lru);
+		g_hash_table_remove (param_cache.hash, node);
+	} else {
+		node = NULL;
+	}
+	
+	PARAM_CACHE_UNLOCK ();
+	
+	/* finalize the evicted snapshot outside of the lock */
+	if (node != NULL)
+		param_cache_node_free (node);
+}
+
+
+/**
+ * g_mime_param_cache_shutdown:
+ *
+ * Frees the parameter cache.
+ **/
+void
+g_mime_param_cache_shutdown (void)
+{
+	ParamCacheNode *node;
+	
+	PARAM_CACHE_LOCK ();
+	
+	while ((node = g_queue_pop_head (&param_cache.lru)))
+		param_cache_node_free (node);
+	
+	if (param_cache.hash != NULL) {
+		g_hash_table_destroy (param_cache.hash);
+		param_cache.hash = NULL;
+	}
+	
+	PARAM_CACHE_UNLOCK ();
+}
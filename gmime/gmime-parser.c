@@ -1389,7 +1389,7 @@ content_type_is_type (ContentType *content_type, const char *type, const char *s
 }
 
 static ContentType *
-parser_content_type (GMimeParser *parser, GMimeContentType *parent)
+parser_content_type (GMimeParser *parser, gboolean digest)
 {
 	ContentType *content_type;
 	const char *value;
@@ -1398,7 +1398,7 @@ parser_content_type (GMimeParser *parser, GMimeContentType *parent)
 	
 	if (!(value = parser_find_header (parser, "Content-Type", NULL)) ||
 	    !g_mime_parse_content_type (&value, &content_type->type, &content_type->subtype)) {
-		if (parent != NULL && g_mime_content_type_is_type (parent, "multipart", "digest")) {
+		if (digest) {
 			content_type->type = g_strdup ("message");
 			content_type->subtype = g_strdup ("rfc822");
 		} else {
@@ -1732,6 +1732,53 @@ check_repeated_header (GMimeParserOptions *options, GMimeObject *object, const H
 		check_header_conflict (options, object, header);
 }
 
+/* Checks for the possibility of an empty message/rfc822 part. */
+static gboolean
+message_part_is_empty (GMimeParser *parser)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	register char *inptr;
+	size_t atleast;
+	char *inend;
+	
+	if (priv->bounds == NULL)
+		return FALSE;
+	
+	/* figure out minimum amount of data we need */
+	atleast = MAX (SCAN_HEAD, MAX_BOUNDARY_LEN (priv->bounds));
+	
+	if (parser_fill (parser, atleast) <= 0) {
+		priv->boundary = BOUNDARY_EOS;
+		return TRUE;
+	}
+	
+	inptr = priv->inptr;
+	inend = priv->inend;
+	/* Note: see optimization comment [1] */
+	*inend = '\n';
+	
+	while (*inptr != '\n')
+		inptr++;
+	
+	priv->boundary = check_boundary (priv, priv->inptr, inptr - priv->inptr);
+	switch (priv->boundary) {
+	case BOUNDARY_IMMEDIATE_END:
+	case BOUNDARY_IMMEDIATE:
+	case BOUNDARY_PARENT:
+		return TRUE;
+	case BOUNDARY_PARENT_END:
+		/* ignore "From " boundaries, boken mailers tend to include these lines... */
+		if (strncmp (priv->inptr, "From ", 5) != 0)
+			return TRUE;
+		break;
+	case BOUNDARY_NONE:
+	case BOUNDARY_EOS:
+		break;
+	}
+	
+	return FALSE;
+}
+
 static void
 parser_scan_message_part (GMimeParser *parser, GMimeParserOptions *options, GMimeMessagePart *mpart, int depth)
 {
@@ -1745,44 +1792,8 @@ parser_scan_message_part (GMimeParser *parser, GMimeParserOptions *options, GMim
 	
 	g_assert (priv->state == GMIME_PARSER_STATE_CONTENT);
 	
-	if (priv->bounds != NULL) {
-		/* Check for the possibility of an empty message/rfc822 part. */
-		register char *inptr;
-		size_t atleast;
-		char *inend;
-		
-		/* figure out minimum amount of data we need */
-		atleast = MAX (SCAN_HEAD, MAX_BOUNDARY_LEN (priv->bounds));
-		
-		if (parser_fill (parser, atleast) <= 0) {
-			priv->boundary = BOUNDARY_EOS;
-			return;
-		}
-		
-		inptr = priv->inptr;
-		inend = priv->inend;
-		/* Note: see optimization comment [1] */
-		*inend = '\n';
-		
-		while (*inptr != '\n')
-			inptr++;
-		
-		priv->boundary = check_boundary (priv, priv->inptr, inptr - priv->inptr);
-		switch (priv->boundary) {
-		case BOUNDARY_IMMEDIATE_END:
-		case BOUNDARY_IMMEDIATE:
-		case BOUNDARY_PARENT:
-			return;
-		case BOUNDARY_PARENT_END:
-			/* ignore "From " boundaries, boken mailers tend to include these lines... */
-			if (strncmp (priv->inptr, "From ", 5) != 0)
-				return;
-			break;
-		case BOUNDARY_NONE:
-		case BOUNDARY_EOS:
-			break;
-		}
-	}
+	if (message_part_is_empty (parser))
+		return;
 	
 	/* get the headers */
 	priv->state = GMIME_PARSER_STATE_HEADERS;
@@ -1809,7 +1820,7 @@ parser_scan_message_part (GMimeParser *parser, GMimeParserOptions *options, GMim
 		}
 	}
 	
-	content_type = parser_content_type (parser, NULL);
+	content_type = parser_content_type (parser, FALSE);
 	if (content_type_is_type (content_type, "multipart", "*"))
 		object = parser_construct_multipart (parser, options, content_type, TRUE, depth + 1);
 	else
@@ -1836,6 +1847,32 @@ is_rfc822 (const char *subtype)
 	return FALSE;
 }
 
+/* Checks whether a message/rfc822 part has been encoded (which is not allowed) */
+static gboolean
+message_part_is_encoded (struct _GMimeParserPrivate *priv)
+{
+	Header *header;
+	guint i;
+	
+	for (i = 0; i < priv->headers->len; i++) {
+		header = priv->headers->pdata[i];
+		
+		if (g_ascii_strcasecmp (header->name, "Content-Transfer-Encoding") != 0)
+			continue;
+		
+		switch (g_mime_content_encoding_from_string (header->raw_value)) {
+		case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
+		case GMIME_CONTENT_ENCODING_UUENCODE:
+		case GMIME_CONTENT_ENCODING_BASE64:
+			return TRUE;
+		default:
+			return FALSE;
+		}
+	}
+	
+	return FALSE;
+}
+
 static GMimeObject *
 parser_construct_leaf_part (GMimeParser *parser, GMimeParserOptions *options, ContentType *content_type, gboolean toplevel, int depth)
 {
@@ -1860,24 +1897,8 @@ parser_construct_leaf_part (GMimeParser *parser, GMimeParserOptions *options, Co
 			is_encoded = TRUE;
 		}
 		
-		for (i = 0; i < priv->headers->len && !is_encoded; i++) {
-			header = priv->headers->pdata[i];
-			
-			if (g_ascii_strcasecmp (header->name, "Content-Transfer-Encoding") != 0)
-				continue;
-			
-			switch (g_mime_content_encoding_from_string (header->raw_value)) {
-			case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
-			case GMIME_CONTENT_ENCODING_UUENCODE:
-			case GMIME_CONTENT_ENCODING_BASE64:
-				is_encoded = TRUE;
-				break;
-			default:
-				break;
-			}
-			
-			break;
-		}
+		if (!is_encoded)
+			is_encoded = message_part_is_encoded (priv);
 		
 		if (is_encoded) {
 			subtype = "octet-stream";
@@ -2019,7 +2040,7 @@ parser_scan_multipart_subparts (GMimeParser *parser, GMimeParserOptions *options
 			break;
 		}
 		
-		content_type = parser_content_type (parser, ((GMimeObject *) multipart)->content_type);
+		content_type = parser_content_type (parser, g_mime_content_type_is_type (((GMimeObject *) multipart)->content_type, "multipart", "digest"));
 		if (content_type_is_type (content_type, "multipart", "*"))
 			subpart = parser_construct_multipart (parser, options, content_type, FALSE, depth + 1);
 		else
@@ -2121,7 +2142,7 @@ parser_construct_multipart (GMimeParser *parser, GMimeParserOptions *options, Co
 }
 
 static GMimeObject *
-parser_construct_part (GMimeParser *parser, GMimeParserOptions *options)
+parser_construct_part (GMimeParser *parser, GMimeParserOptions *options, gboolean digest)
 {
 	struct _GMimeParserPrivate *priv = parser->priv;
 	ContentType *content_type;
@@ -2136,7 +2157,7 @@ parser_construct_part (GMimeParser *parser, GMimeParserOptions *options)
 			return NULL;
 	}
 	
-	content_type = parser_content_type (parser, NULL);
+	content_type = parser_content_type (parser, digest);
 	if (content_type_is_type (content_type, "multipart", "*"))
 		object = parser_construct_multipart (parser, options, content_type, FALSE, 0);
 	else
@@ -2163,10 +2184,50 @@ g_mime_parser_construct_part (GMimeParser *parser, GMimeParserOptions *options)
 {
 	g_return_val_if_fail (GMIME_IS_PARSER (parser), NULL);
 	
-	return parser_construct_part (parser, options);
+	return parser_construct_part (parser, options, FALSE);
 }
 
 
+/**
+ * _g_mime_parser_construct_part:
+ * @parser: a #GMimeParser context
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @digest: %TRUE if the part is a subpart of a multipart/digest
+ *
+ * Constructs a MIME part from @parser, defaulting to message/rfc822
+ * rather than text/plain if @digest is %TRUE and the part has no
+ * Content-Type header.
+ *
+ * Returns: (nullable) (transfer full): a MIME part based on @parser or %NULL on
+ * fail.
+ **/
+GMimeObject *
+_g_mime_parser_construct_part (GMimeParser *parser, GMimeParserOptions *options, gboolean digest)
+{
+	return parser_construct_part (parser, options, digest);
+}
+
+
+static unsigned long
+parser_content_length (GMimeParser *parser)
+{
+	unsigned long content_length;
+	const char *inptr;
+	char *endptr;
+	
+	if (!(inptr = parser_find_header (parser, "Content-Length", NULL)))
+		return ULONG_MAX;
+	
+	while (is_lwsp (*inptr))
+		inptr++;
+	
+	content_length = strtoul (inptr, &endptr, 10);
+	if (endptr == inptr)
+		return ULONG_MAX;
+	
+	return content_length;
+}
+
 static GMimeMessage *
 parser_construct_message (GMimeParser *parser, GMimeParserOptions *options)
 {
@@ -2175,10 +2236,8 @@ parser_construct_message (GMimeParser *parser, GMimeParserOptions *options)
 	ContentType *content_type;
 	GMimeMessage *message;
 	GMimeObject *object;
-	const char *inptr;
 	gboolean can_warn;
 	Header *header;
-	char *endptr;
 	guint i;
 	
 	/* scan the from-line if we are parsing an mbox */
@@ -2198,20 +2257,13 @@ parser_construct_message (GMimeParser *parser, GMimeParserOptions *options)
 	((GMimeObject *) message)->ensure_newline = FALSE;
 	_g_mime_header_list_set_options (((GMimeObject *) message)->headers, options);
 	
+	if (priv->respect_content_length)
+		content_length = parser_content_length (parser);
+	
 	can_warn = g_mime_parser_options_get_warning_callback (options) != NULL;
 	for (i = 0; i < priv->headers->len; i++) {
 		header = priv->headers->pdata[i];
 		
-		if (priv->respect_content_length && !g_ascii_strcasecmp (header->name, "Content-Length")) {
-			inptr = header->raw_value;
-			while (is_lwsp (*inptr))
-				inptr++;
-			
-			content_length = strtoul (inptr, &endptr, 10);
-			if (endptr == inptr)
-				content_length = ULONG_MAX;
-		}
-		
 		if (g_ascii_strncasecmp (header->name, "Content-", 8) != 0) {
 			if (can_warn)
 				check_repeated_header (options, (GMimeObject *) message, header);
@@ -2230,7 +2282,7 @@ parser_construct_message (GMimeParser *parser, GMimeParserOptions *options)
 		parser_push_boundary (parser, MMDF_BOUNDARY);
 	}
 	
-	content_type = parser_content_type (parser, NULL);
+	content_type = parser_content_type (parser, FALSE);
 	if (content_type_is_type (content_type, "multipart", "*"))
 		object = parser_construct_multipart (parser, options, content_type, TRUE, 0);
 	else
@@ -2269,6 +2321,281 @@ g_mime_parser_construct_message (GMimeParser *parser, GMimeParserOptions *option
 }
 
 
+typedef struct {
+	GMimePartTree *tree;
+	GMimeStream *null;
+	gint64 scan_end;
+} PartTreeState;
+
+static GMimePartNode *tree_construct_node (GMimeParser *parser, GMimeParserOptions *options, PartTreeState *state,
+					   GMimePartNode *parent, GMimePartNode *prev, ContentType *content_type, int depth);
+
+static void
+tree_scan_content (GMimeParser *parser, PartTreeState *state)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	gboolean empty;
+	gint64 start;
+	
+	start = parser_offset (priv, NULL);
+	
+	/* the same null stream is reused to measure the content of every part */
+	g_mime_stream_reset (state->null);
+	parser_scan_content (parser, state->null, &empty);
+	
+	state->scan_end = start + g_mime_stream_tell (state->null);
+}
+
+static void
+tree_scan_message_part (GMimeParser *parser, GMimeParserOptions *options, PartTreeState *state, GMimePartNode *node, int depth)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	ContentType *content_type;
+	
+	g_assert (priv->state == GMIME_PARSER_STATE_CONTENT);
+	
+	if (message_part_is_empty (parser))
+		return;
+	
+	/* get the headers */
+	priv->state = GMIME_PARSER_STATE_HEADERS;
+	if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR) {
+		priv->boundary = BOUNDARY_EOS;
+		return;
+	}
+	
+	content_type = parser_content_type (parser, FALSE);
+	tree_construct_node (parser, options, state, node, NULL, content_type, depth + 1);
+	content_type_destroy (content_type);
+}
+
+static BoundaryType
+tree_scan_multipart_subparts (GMimeParser *parser, GMimeParserOptions *options, PartTreeState *state, GMimePartNode *multipart, int depth)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	gboolean digest = g_mime_part_node_is_type (multipart, "multipart", "digest");
+	ContentType *content_type;
+	GMimePartNode *prev = NULL;
+	
+	do {
+		/* skip over the boundary marker */
+		if (parser_skip_line (parser) == -1) {
+			priv->boundary = BOUNDARY_EOS;
+			break;
+		}
+		
+		/* get the headers */
+		priv->state = GMIME_PARSER_STATE_HEADERS;
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR) {
+			priv->boundary = BOUNDARY_EOS;
+			break;
+		}
+		
+		if (priv->state == GMIME_PARSER_STATE_BOUNDARY && priv->headers->len == 0) {
+			if (priv->boundary == BOUNDARY_IMMEDIATE)
+				continue;
+			break;
+		}
+		
+		if (priv->state == GMIME_PARSER_STATE_COMPLETE && priv->headers->len == 0) {
+			priv->boundary = BOUNDARY_IMMEDIATE_END;
+			break;
+		}
+		
+		content_type = parser_content_type (parser, digest);
+		prev = tree_construct_node (parser, options, state, multipart, prev, content_type, depth + 1);
+		content_type_destroy (content_type);
+	} while (priv->boundary == BOUNDARY_IMMEDIATE);
+	
+	return priv->boundary;
+}
+
+static void
+tree_scan_multipart (GMimeParser *parser, GMimeParserOptions *options, PartTreeState *state, GMimePartNode *node, const char *boundary, int depth)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	
+	if (boundary == NULL || depth >= MAX_LEVEL) {
+		/* this will scan everything into the prologue */
+		tree_scan_content (parser, state);
+		return;
+	}
+	
+	parser_push_boundary (parser, boundary);
+	
+	/* prologue */
+	tree_scan_content (parser, state);
+	
+	if (priv->boundary == BOUNDARY_IMMEDIATE)
+		priv->boundary = tree_scan_multipart_subparts (parser, options, state, node, depth);
+	
+	if (priv->boundary == BOUNDARY_IMMEDIATE_END) {
+		/* eat end boundary and scan the epilogue */
+		parser_skip_line (parser);
+		parser_pop_boundary (parser);
+		tree_scan_content (parser, state);
+		return;
+	}
+	
+	parser_pop_boundary (parser);
+	
+	if (priv->boundary == BOUNDARY_PARENT_END && found_immediate_boundary (priv, TRUE))
+		priv->boundary = BOUNDARY_IMMEDIATE_END;
+	else if (priv->boundary == BOUNDARY_PARENT && found_immediate_boundary (priv, FALSE))
+		priv->boundary = BOUNDARY_IMMEDIATE;
+}
+
+static GMimePartNode *
+tree_construct_node (GMimeParser *parser, GMimeParserOptions *options, PartTreeState *state,
+		     GMimePartNode *parent, GMimePartNode *prev, ContentType *content_type, int depth)
+{
+	struct _GMimeParserPrivate *priv = parser->priv;
+	gboolean multipart, message = FALSE;
+	GMimeContentType *mime_type;
+	char *boundary = NULL;
+	GMimePartNode *node;
+	const char *value;
+	gint64 offset;
+	
+	g_assert (priv->state >= GMIME_PARSER_STATE_HEADERS_END);
+	
+	node = _g_mime_part_tree_add_node (state->tree, parent, prev, content_type->type, content_type->subtype);
+	node->headers_begin = priv->headers_begin;
+	node->headers_end = priv->headers_end;
+	
+	if ((multipart = content_type_is_type (content_type, "multipart", "*"))) {
+		/* only multiparts need their parameters to be parsed */
+		if ((value = parser_find_header (parser, "Content-Type", &offset))) {
+			mime_type = _g_mime_content_type_parse (options, value, offset);
+			boundary = g_strdup (g_mime_content_type_get_parameter (mime_type, "boundary"));
+			g_object_unref (mime_type);
+		}
+	} else if (content_type_is_type (content_type, "message", "*") && is_rfc822 (content_type->subtype)) {
+		message = depth < MAX_LEVEL && !message_part_is_encoded (priv);
+	}
+	
+	parser_free_headers (priv);
+	
+	if (priv->state == GMIME_PARSER_STATE_HEADERS_END) {
+		/* skip empty line after headers */
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR) {
+			priv->boundary = BOUNDARY_EOS;
+			node->content_begin = node->content_end = parser_offset (priv, NULL);
+			g_free (boundary);
+			return node;
+		}
+	}
+	
+	node->content_begin = state->scan_end = parser_offset (priv, NULL);
+	
+	if (multipart) {
+		tree_scan_multipart (parser, options, state, node, boundary, depth);
+		g_free (boundary);
+	} else if (priv->state == GMIME_PARSER_STATE_CONTENT) {
+		if (message)
+			tree_scan_message_part (parser, options, state, node, depth + 1);
+		else
+			tree_scan_content (parser, state);
+	}
+	
+	node->content_end = state->scan_end;
+	
+	return node;
+}
+
+
+/**
+ * g_mime_parser_construct_part_tree:
+ * @parser: a #GMimeParser context
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ *
+ * Scans the next MIME message from @parser, like
+ * g_mime_parser_construct_message() would, but only records its MIME
+ * structure in a lightweight #GMimePartTree rather than constructing a
+ * #GMimeMessage. Individual parts can later be constructed on demand
+ * using g_mime_part_tree_construct_part().
+ *
+ * Note: No parser warnings are emitted while scanning the structure,
+ * even if @options has a warning callback. Warnings for a part are
+ * reported when it is constructed with g_mime_part_tree_construct_part().
+ *
+ * Returns: (nullable) (transfer full): a #GMimePartTree or %NULL on
+ * fail.
+ **/
+GMimePartTree *
+g_mime_parser_construct_part_tree (GMimeParser *parser, GMimeParserOptions *options)
+{
+	struct _GMimeParserPrivate *priv;
+	unsigned long content_length = ULONG_MAX;
+	GMimeParserOptions *scan_options = NULL;
+	ContentType *content_type;
+	PartTreeState state;
+	
+	g_return_val_if_fail (GMIME_IS_PARSER (parser), NULL);
+	
+	priv = parser->priv;
+	
+	/* warnings are reported once the parts are actually constructed */
+	if (g_mime_parser_options_get_warning_callback (options) != NULL) {
+		scan_options = g_mime_parser_options_clone (options);
+		g_mime_parser_options_set_warning_callback (scan_options, NULL, NULL, NULL);
+		options = scan_options;
+	}
+	
+	/* scan the from-line if we are parsing an mbox */
+	while (priv->state != GMIME_PARSER_STATE_MESSAGE_HEADERS) {
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR)
+			goto error;
+	}
+	
+	/* parse the headers */
+	priv->toplevel = TRUE;
+	while (priv->state < GMIME_PARSER_STATE_HEADERS_END) {
+		if (parser_step (parser, options) == GMIME_PARSER_STATE_ERROR)
+			goto error;
+	}
+	
+	if (priv->respect_content_length)
+		content_length = parser_content_length (parser);
+	
+	if (priv->format == GMIME_FORMAT_MBOX) {
+		parser_push_boundary (parser, MBOX_BOUNDARY);
+		priv->content_end = 0;
+		
+		if (priv->respect_content_length && content_length < ULONG_MAX)
+			priv->content_end = parser_offset (priv, NULL) + content_length;
+	} else if (priv->format == GMIME_FORMAT_MMDF) {
+		parser_push_boundary (parser, MMDF_BOUNDARY);
+	}
+	
+	state.tree = _g_mime_part_tree_new (priv->stream, priv->seekable && priv->offset != -1);
+	state.null = g_mime_stream_null_new ();
+	state.scan_end = -1;
+	
+	content_type = parser_content_type (parser, FALSE);
+	tree_construct_node (parser, options, &state, NULL, NULL, content_type, 0);
+	content_type_destroy (content_type);
+	
+	g_object_unref (state.null);
+	
+	if (priv->format == GMIME_FORMAT_MBOX) {
+		priv->state = GMIME_PARSER_STATE_FROM;
+		parser_pop_boundary (parser);
+	}
+	
+	if (scan_options)
+		g_mime_parser_options_free (scan_options);
+	
+	return state.tree;
+	
+ error:
+	if (scan_options)
+		g_mime_parser_options_free (scan_options);
+	
+	return NULL;
+}
+
+
 /**
  * g_mime_parser_get_mbox_marker:
  * @parser: a #GMimeParser context
@@ -28,6 +28,7 @@
 
 #include <gmime/gmime-object.h>
 #include <gmime/gmime-message.h>
+#include <gmime/gmime-part-tree.h>
 #include <gmime/gmime-content-type.h>
 #include <gmime/gmime-parser-options.h>
 #include <gmime/gmime-stream.h>
@@ -117,6 +118,7 @@ void g_mime_parser_set_header_regex (GMimeParser *parser, const char *regex,
 
 GMimeObject *g_mime_parser_construct_part (GMimeParser *parser, GMimeParserOptions *options);
 GMimeMessage *g_mime_parser_construct_message (GMimeParser *parser, GMimeParserOptions *options);
+GMimePartTree *g_mime_parser_construct_part_tree (GMimeParser *parser, GMimeParserOptions *options);
 
 gint64 g_mime_parser_tell (GMimeParser *parser);
 
@@ -0,0 +1,297 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gmime-part-index.h"
+#include "gmime-message-part.h"
+#include "gmime-part-iter.h"
+#include "gmime-multipart.h"
+#include "gmime-message.h"
+#include "gmime-internal.h"
+
+
+/**
+ * SECTION: gmime-part-index
+ * @title: GMimePartIndex
+ * @short_description: MIME part lookup tables
+ * @see_also: #GMimePartIter
+ *
+ * A #GMimePartIndex maps the Content-Ids and #GMimePartIter paths of
+ * all of the MIME parts contained within a #GMimeObject to the parts
+ * themselves, and each part back to its path, without rescanning the
+ * MIME structure on every lookup.
+ *
+ * The index keeps track of any modifications made to the MIME
+ * structure and is transparently rebuilt by the next lookup that
+ * follows one.
+ **/
+
+
+struct _GMimePartIndex {
+	GMimeObject *toplevel;
+	GHashTable *content_ids;  /* content-id -> GMimeObject */
+	GHashTable *paths;        /* path -> GMimeObject */
+	GHashTable *parts;        /* GMimeObject -> path */
+	GPtrArray *objects;       /* every object being listened to */
+	gboolean dirty;
+};
+
+
+static void
+part_index_changed (GMimeObject *object, gpointer args, GMimePartIndex *index)
+{
+	index->dirty = TRUE;
+}
+
+static void
+part_index_clear (GMimePartIndex *index)
+{
+	GMimeObject *object;
+	guint i;
+	
+	for (i = 0; i < index->objects->len; i++) {
+		object = (GMimeObject *) index->objects->pdata[i];
+		_g_mime_object_remove_changed_listener (object, (GMimeEventCallback) part_index_changed, index);
+		g_object_unref (object);
+	}
+	
+	g_ptr_array_set_size (index->objects, 0);
+	g_hash_table_remove_all (index->content_ids);
+	g_hash_table_remove_all (index->parts);
+	g_hash_table_remove_all (index->paths);
+}
+
+static void
+part_index_add_object (GMimePartIndex *index, GMimeObject *object)
+{
+	GMimeMultipart *multipart;
+	GMimeMessage *message;
+	int i, n;
+	
+	/* listen for changes to the Content-Id or to the subparts */
+	_g_mime_object_add_changed_listener (object, (GMimeEventCallback) part_index_changed, index);
+	g_ptr_array_add (index->objects, object);
+	g_object_ref (object);
+	
+	/* like g_mime_multipart_get_subpart_from_content_id(), the first match wins */
+	if (object->content_id && !g_hash_table_contains (index->content_ids, object->content_id))
+		g_hash_table_insert (index->content_ids, g_strdup (object->content_id), object);
+	
+	if (GMIME_IS_MULTIPART (object)) {
+		multipart = (GMimeMultipart *) object;
+		n = g_mime_multipart_get_count (multipart);
+		
+		for (i = 0; i < n; i++)
+			part_index_add_object (index, g_mime_multipart_get_part (multipart, i));
+	} else if (GMIME_IS_MESSAGE_PART (object)) {
+		if ((message = g_mime_message_part_get_message ((GMimeMessagePart *) object)))
+			part_index_add_object (index, (GMimeObject *) message);
+	} else if (GMIME_IS_MESSAGE (object)) {
+		message = (GMimeMessage *) object;
+		
+		if (message->mime_part)
+			part_index_add_object (index, message->mime_part);
+	}
+}
+
+static void
+part_index_build (GMimePartIndex *index)
+{
+	GMimeObject *current;
+	GMimePartIter *iter;
+	char *path;
+	
+	part_index_add_object (index, index->toplevel);
+	
+	/* let GMimePartIter compute the paths so that they match its own */
+	iter = g_mime_part_iter_new (index->toplevel);
+	
+	while (g_mime_part_iter_is_valid (iter)) {
+		current = g_mime_part_iter_get_current (iter);
+		path = g_mime_part_iter_get_path (iter);
+		
+		g_hash_table_insert (index->paths, path, current);
+		if (!g_hash_table_contains (index->parts, current))
+			g_hash_table_insert (index->parts, current, path);
+		
+		g_mime_part_iter_next (iter);
+	}
+	
+	g_mime_part_iter_free (iter);
+	
+	index->dirty = FALSE;
+}
+
+static void
+part_index_sync (GMimePartIndex *index)
+{
+	if (!index->dirty)
+		return;
+	
+	part_index_clear (index);
+	part_index_build (index);
+}
+
+
+/**
+ * g_mime_part_index_new:
+ * @toplevel: a #GMimeObject to use as the toplevel
+ *
+ * Creates a new #GMimePartIndex of all of the MIME parts contained
+ * within @toplevel.
+ *
+ * Returns: a newly allocated #GMimePartIndex which should be freed
+ * using g_mime_part_index_free() when finished with it.
+ **/
+GMimePartIndex *
+g_mime_part_index_new (GMimeObject *toplevel)
+{
+	GMimePartIndex *index;
+	
+	g_return_val_if_fail (GMIME_IS_OBJECT (toplevel), NULL);
+	
+	index = g_slice_new (GMimePartIndex);
+	index->content_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	index->paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	index->parts = g_hash_table_new (g_direct_hash, g_direct_equal);
+	index->objects = g_ptr_array_new ();
+	index->toplevel = toplevel;
+	g_object_ref (toplevel);
+	
+	part_index_build (index);
+	
+	return index;
+}
+
+
+/**
+ * g_mime_part_index_free:
+ * @index: a #GMimePartIndex
+ *
+ * Frees the memory allocated by g_mime_part_index_new().
+ **/
+void
+g_mime_part_index_free (GMimePartIndex *index)
+{
+	g_return_if_fail (index != NULL);
+	
+	part_index_clear (index);
+	
+	g_hash_table_destroy (index->content_ids);
+	g_hash_table_destroy (index->parts);
+	g_hash_table_destroy (index->paths);
+	g_ptr_array_free (index->objects, TRUE);
+	g_object_unref (index->toplevel);
+	
+	g_slice_free (GMimePartIndex, index);
+}
+
+
+/**
+ * g_mime_part_index_get_toplevel:
+ * @index: a #GMimePartIndex
+ *
+ * Gets the toplevel #GMimeObject used to initialize @index.
+ *
+ * Returns: (transfer none): the toplevel #GMimeObject.
+ **/
+GMimeObject *
+g_mime_part_index_get_toplevel (GMimePartIndex *index)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	
+	return index->toplevel;
+}
+
+
+/**
+ * g_mime_part_index_get_part_from_content_id:
+ * @index: a #GMimePartIndex
+ * @content_id: the content id of the part to look for
+ *
+ * Gets the MIME part with the content-id @content_id, such as one
+ * referenced by a "cid:" URL.
+ *
+ * Unlike g_mime_multipart_get_subpart_from_content_id(), this also
+ * finds parts contained within encapsulated messages.
+ *
+ * Returns: (transfer none): the #GMimeObject whose content-id matches
+ * @content_id, or %NULL if a match cannot be found.
+ **/
+GMimeObject *
+g_mime_part_index_get_part_from_content_id (GMimePartIndex *index, const char *content_id)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (content_id != NULL, NULL);
+	
+	part_index_sync (index);
+	
+	return g_hash_table_lookup (index->content_ids, content_id);
+}
+
+
+/**
+ * g_mime_part_index_get_part_from_path:
+ * @index: a #GMimePartIndex
+ * @path: a string representing the path of the part
+ *
+ * Gets the MIME part at @path, where @path is in the same format as
+ * the paths used by g_mime_part_iter_jump_to().
+ *
+ * Returns: (transfer none): the #GMimeObject at @path or %NULL if no
+ * such part exists.
+ **/
+GMimeObject *
+g_mime_part_index_get_part_from_path (GMimePartIndex *index, const char *path)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (path != NULL, NULL);
+	
+	part_index_sync (index);
+	
+	return g_hash_table_lookup (index->paths, path);
+}
+
+
+/**
+ * g_mime_part_index_get_path:
+ * @index: a #GMimePartIndex
+ * @part: a #GMimeObject
+ *
+ * Gets the path of @part, in the same format as the paths returned by
+ * g_mime_part_iter_get_path().
+ *
+ * Returns: (nullable): a newly allocated string containing the path
+ * of @part or %NULL if @part is not contained within the toplevel.
+ **/
+char *
+g_mime_part_index_get_path (GMimePartIndex *index, GMimeObject *part)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (GMIME_IS_OBJECT (part), NULL);
+	
+	part_index_sync (index);
+	
+	return g_strdup (g_hash_table_lookup (index->parts, part));
+}
@@ -0,0 +1,47 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifndef __GMIME_PART_INDEX_H__
+#define __GMIME_PART_INDEX_H__
+
+#include <gmime/gmime-object.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GMimePartIndex:
+ *
+ * An index of the MIME parts contained within a #GMimeObject.
+ **/
+typedef struct _GMimePartIndex GMimePartIndex;
+
+GMimePartIndex *g_mime_part_index_new (GMimeObject *toplevel);
+void g_mime_part_index_free (GMimePartIndex *index);
+
+GMimeObject *g_mime_part_index_get_toplevel (GMimePartIndex *index);
+
+GMimeObject *g_mime_part_index_get_part_from_content_id (GMimePartIndex *index, const char *content_id);
+GMimeObject *g_mime_part_index_get_part_from_path (GMimePartIndex *index, const char *path);
+char *g_mime_part_index_get_path (GMimePartIndex *index, GMimeObject *part);
+
+G_END_DECLS
+
+#endif /* __GMIME_PART_INDEX_H__ */
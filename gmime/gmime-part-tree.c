@@ -0,0 +1,311 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gmime-part-tree.h"
+#include "gmime-parser.h"
+#include "gmime-internal.h"
+
+
+/**
+ * SECTION: gmime-part-tree
+ * @title: GMimePartTree
+ * @short_description: a lightweight MIME structure
+ * @see_also: #GMimeParser
+ *
+ * A #GMimePartTree describes the MIME structure of a message without
+ * instantiating any #GMimeObject. It is produced by
+ * g_mime_parser_construct_part_tree() and records, for each MIME part,
+ * its media type and where its headers and content are located in the
+ * stream.
+ *
+ * All of the nodes and strings of a tree are allocated from a handful
+ * of blocks owned by the tree, so building one costs a small fraction
+ * of the allocations needed to construct the equivalent #GMimeMessage.
+ * Any node can be converted into a full #GMimeObject on demand.
+ **/
+
+
+/* number of nodes allocated at a time */
+#define NODE_SLAB_SIZE 32
+
+struct _GMimePartTree {
+	GMimeStream *stream;
+	GStringChunk *strings;
+	GMimePartNode *root;
+	GSList *slabs;
+	guint slab_used;
+	guint count;
+	gboolean seekable;
+};
+
+
+/**
+ * _g_mime_part_tree_new:
+ * @stream: the stream being parsed
+ * @seekable: whether or not @stream is seekable
+ *
+ * Creates a new, empty, #GMimePartTree for @stream.
+ *
+ * Returns: a new #GMimePartTree.
+ **/
+GMimePartTree *
+_g_mime_part_tree_new (GMimeStream *stream, gboolean seekable)
+{
+	GMimePartTree *tree;
+	
+	tree = g_slice_new (GMimePartTree);
+	tree->strings = g_string_chunk_new (256);
+	tree->stream = stream;
+	tree->seekable = seekable;
+	tree->slab_used = NODE_SLAB_SIZE;
+	tree->slabs = NULL;
+	tree->root = NULL;
+	tree->count = 0;
+	
+	g_object_ref (stream);
+	
+	return tree;
+}
+
+
+/**
+ * _g_mime_part_tree_add_node:
+ * @tree: a #GMimePartTree
+ * @parent: the parent node or %NULL for the root node
+ * @prev: the previous sibling or %NULL if the new node is the first child
+ * @type: the media type
+ * @subtype: the media subtype
+ *
+ * Allocates a new node from @tree's slabs and links it in after @prev.
+ *
+ * Returns: the new node; its offsets are initialized to %-1.
+ **/
+GMimePartNode *
+_g_mime_part_tree_add_node (GMimePartTree *tree, GMimePartNode *parent, GMimePartNode *prev, const char *type, const char *subtype)
+{
+	GMimePartNode *node;
+	
+	if (tree->slab_used == NODE_SLAB_SIZE) {
+		tree->slabs = g_slist_prepend (tree->slabs, g_new (GMimePartNode, NODE_SLAB_SIZE));
+		tree->slab_used = 0;
+	}
+	
+	node = ((GMimePartNode *) tree->slabs->data) + tree->slab_used++;
+	node->type = g_string_chunk_insert_const (tree->strings, type);
+	node->subtype = g_string_chunk_insert_const (tree->strings, subtype);
+	node->depth = parent ? parent->depth + 1 : 0;
+	node->parent = parent;
+	node->children = NULL;
+	node->next = NULL;
+	node->headers_begin = -1;
+	node->headers_end = -1;
+	node->content_begin = -1;
+	node->content_end = -1;
+	
+	if (prev != NULL)
+		prev->next = node;
+	else if (parent != NULL)
+		parent->children = node;
+	else
+		tree->root = node;
+	
+	tree->count++;
+	
+	return node;
+}
+
+
+/**
+ * g_mime_part_tree_free:
+ * @tree: a #GMimePartTree
+ *
+ * Frees @tree and all of its nodes.
+ **/
+void
+g_mime_part_tree_free (GMimePartTree *tree)
+{
+	GSList *slab;
+	
+	g_return_if_fail (tree != NULL);
+	
+	for (slab = tree->slabs; slab != NULL; slab = slab->next)
+		g_free (slab->data);
+	g_slist_free (tree->slabs);
+	
+	g_string_chunk_free (tree->strings);
+	g_object_unref (tree->stream);
+	
+	g_slice_free (GMimePartTree, tree);
+}
+
+
+/**
+ * g_mime_part_tree_get_root:
+ * @tree: a #GMimePartTree
+ *
+ * Gets the root node of @tree, which describes the body of the message.
+ * Its headers are the headers of the message itself.
+ *
+ * Returns: (transfer none): the root node.
+ **/
+GMimePartNode *
+g_mime_part_tree_get_root (GMimePartTree *tree)
+{
+	g_return_val_if_fail (tree != NULL, NULL);
+	
+	return tree->root;
+}
+
+
+/**
+ * g_mime_part_tree_get_count:
+ * @tree: a #GMimePartTree
+ *
+ * Gets the total number of nodes in @tree.
+ *
+ * Returns: the number of nodes in @tree.
+ **/
+guint
+g_mime_part_tree_get_count (GMimePartTree *tree)
+{
+	g_return_val_if_fail (tree != NULL, 0);
+	
+	return tree->count;
+}
+
+
+static GMimeParser *
+part_tree_parser_new (GMimePartTree *tree, gint64 start, gint64 end)
+{
+	GMimeParser *parser;
+	GMimeStream *stream;
+	
+	stream = g_mime_stream_substream (tree->stream, start, end);
+	parser = g_mime_parser_new_with_stream (stream);
+	g_object_unref (stream);
+	
+	return parser;
+}
+
+
+/**
+ * g_mime_part_tree_construct_message:
+ * @tree: a #GMimePartTree
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ *
+ * Constructs the full #GMimeMessage described by @tree.
+ *
+ * Note: This requires the stream that @tree was parsed from to be
+ * seekable.
+ *
+ * Returns: (nullable) (transfer full): the message or %NULL on fail.
+ **/
+GMimeMessage *
+g_mime_part_tree_construct_message (GMimePartTree *tree, GMimeParserOptions *options)
+{
+	GMimeMessage *message;
+	GMimeParser *parser;
+	
+	g_return_val_if_fail (tree != NULL, NULL);
+	
+	if (!tree->seekable || tree->root == NULL)
+		return NULL;
+	
+	parser = part_tree_parser_new (tree, tree->root->headers_begin, tree->root->content_end);
+	message = g_mime_parser_construct_message (parser, options);
+	g_object_unref (parser);
+	
+	return message;
+}
+
+
+/**
+ * g_mime_part_tree_construct_part:
+ * @tree: a #GMimePartTree
+ * @node: a #GMimePartNode belonging to @tree
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ *
+ * Constructs the full #GMimeObject (and all of its children) described
+ * by @node.
+ *
+ * Note: This requires the stream that @tree was parsed from to be
+ * seekable.
+ *
+ * Returns: (nullable) (transfer full): the MIME part or %NULL on fail.
+ **/
+GMimeObject *
+g_mime_part_tree_construct_part (GMimePartTree *tree, GMimePartNode *node, GMimeParserOptions *options)
+{
+	GMimeParser *parser;
+	GMimeObject *object;
+	gboolean digest;
+	
+	g_return_val_if_fail (tree != NULL, NULL);
+	g_return_val_if_fail (node != NULL, NULL);
+	
+	if (!tree->seekable || node->headers_begin < 0 || node->content_end < node->headers_begin)
+		return NULL;
+	
+	/* subparts of a multipart/digest default to message/rfc822 */
+	digest = node->parent != NULL && g_mime_part_node_is_type (node->parent, "multipart", "digest");
+	
+	parser = part_tree_parser_new (tree, node->headers_begin, node->content_end);
+	object = _g_mime_parser_construct_part (parser, options, digest);
+	g_object_unref (parser);
+	
+	return object;
+}
+
+
+/**
+ * g_mime_part_node_is_type:
+ * @node: a #GMimePartNode
+ * @type: the media type to compare against
+ * @subtype: the media subtype to compare against
+ *
+ * Compares the given @type and @subtype with that of @node, in the
+ * same way as g_mime_content_type_is_type().
+ *
+ * Returns: %TRUE if the MIME types match or %FALSE otherwise.
+ **/
+gboolean
+g_mime_part_node_is_type (GMimePartNode *node, const char *type, const char *subtype)
+{
+	g_return_val_if_fail (node != NULL, FALSE);
+	g_return_val_if_fail (type != NULL, FALSE);
+	g_return_val_if_fail (subtype != NULL, FALSE);
+	
+	if (!strcmp (type, "*") || !g_ascii_strcasecmp (node->type, type)) {
+		if (!strcmp (subtype, "*"))
+			return TRUE;
+		
+		if (!g_ascii_strcasecmp (node->subtype, subtype))
+			return TRUE;
+	}
+	
+	return FALSE;
+}
@@ -0,0 +1,91 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifndef __GMIME_PART_TREE_H__
+#define __GMIME_PART_TREE_H__
+
+#include <glib.h>
+
+#include <gmime/gmime-parser-options.h>
+#include <gmime/gmime-message.h>
+#include <gmime/gmime-object.h>
+#include <gmime/gmime-stream.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GMimePartTree GMimePartTree;
+typedef struct _GMimePartNode GMimePartNode;
+
+/**
+ * GMimePartTree:
+ *
+ * An opaque structure describing the MIME structure of a message, as
+ * scanned by g_mime_parser_construct_part_tree().
+ **/
+
+/**
+ * GMimePartNode:
+ * @parent: the parent node or %NULL if this is the root node
+ * @next: the next sibling node or %NULL
+ * @children: the first child node or %NULL
+ * @type: the media type
+ * @subtype: the media subtype
+ * @headers_begin: the stream offset of the node's headers
+ * @headers_end: the stream offset of the end of the node's headers
+ * @content_begin: the stream offset of the node's content
+ * @content_end: the stream offset of the end of the node's content
+ * @depth: the nesting depth of the node
+ *
+ * A lightweight description of a MIME part within a #GMimePartTree.
+ *
+ * The children of a multipart node are its subparts. A message/rfc822
+ * node has a single child describing the body of the encapsulated
+ * message, whose headers are those of the encapsulated message.
+ **/
+struct _GMimePartNode {
+	GMimePartNode *parent;
+	GMimePartNode *next;
+	GMimePartNode *children;
+	
+	const char *type;
+	const char *subtype;
+	
+	gint64 headers_begin;
+	gint64 headers_end;
+	gint64 content_begin;
+	gint64 content_end;
+	int depth;
+};
+
+
+void g_mime_part_tree_free (GMimePartTree *tree);
+
+GMimePartNode *g_mime_part_tree_get_root (GMimePartTree *tree);
+guint g_mime_part_tree_get_count (GMimePartTree *tree);
+
+GMimeMessage *g_mime_part_tree_construct_message (GMimePartTree *tree, GMimeParserOptions *options);
+GMimeObject *g_mime_part_tree_construct_part (GMimePartTree *tree, GMimePartNode *node, GMimeParserOptions *options);
+
+gboolean g_mime_part_node_is_type (GMimePartNode *node, const char *type, const char *subtype);
+
+G_END_DECLS
+
+#endif /* __GMIME_PART_TREE_H__ */
@@ -284,15 +284,17 @@ mime_part_headers_cleared (GMimeObject *object)
 
 
 static ssize_t
-write_content (GMimePart *part, GMimeFormatOptions *options, GMimeStream *stream)
+write_encoded_content (GMimePart *part, GMimeFormatOptions *options, GMimeStream *stream)
 {
 	GMimeObject *object = (GMimeObject *) part;
-	ssize_t nwritten, total = 0;
 	GMimeStream *filtered;
-	GMimeFilter *filter;
+	ssize_t nwritten;
 	
-	if (!part->content)
-		return 0;
+	/* binary content must be written as-is, so no newline conversion */
+	if (part->encoding == GMIME_CONTENT_ENCODING_BINARY)
+		options = NULL;
+	else if (options == NULL)
+		options = g_mime_format_options_get_default ();
 	
 	/* Evil Genius's "slight" optimization: Since GMimeDataWrapper::write_to_stream()
 	 * decodes its content stream to the raw format, we can cheat by requesting its
@@ -301,73 +303,94 @@ write_content (GMimePart *part, GMimeFormatOptions *options, GMimeStream *stream
 	 */
 	
 	if (part->encoding != g_mime_data_wrapper_get_encoding (part->content)) {
-		const char *newline = g_mime_format_options_get_newline (options);
-		const char *filename;
+		filtered = _g_mime_stream_filter_get_pipeline (stream, part->encoding, TRUE, options, object->ensure_newline);
+		nwritten = g_mime_data_wrapper_write_to_stream (part->content, filtered);
+		g_mime_stream_flush (filtered);
+		_g_mime_stream_filter_release_pipeline (filtered);
+	} else {
+		GMimeStream *content;
 		
-		filtered = g_mime_stream_filter_new (stream);
+		content = _g_mime_data_wrapper_open_stream (part->content);
 		
-		switch (part->encoding) {
-		case GMIME_CONTENT_ENCODING_UUENCODE:
-			if (!(filename = g_mime_part_get_filename (part)))
-				filename = "unknown";
-			
-			if ((nwritten = g_mime_stream_printf (stream, "begin 0644 %s%s", filename, newline)) == -1)
-				return -1;
-			
-			total += nwritten;
-			
-			/* fall thru... */
-		case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
-		case GMIME_CONTENT_ENCODING_BASE64:
-			filter = g_mime_filter_basic_new (part->encoding, TRUE);
-			g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-			g_object_unref (filter);
-			break;
-		default:
-			break;
-		}
-		
-		if (part->encoding != GMIME_CONTENT_ENCODING_BINARY) {
-			filter = g_mime_format_options_create_newline_filter (options, object->ensure_newline);
-			g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-			g_object_unref (filter);
-		}
-		
-		nwritten = g_mime_data_wrapper_write_to_stream (part->content, filtered);
+		filtered = _g_mime_stream_filter_get_pipeline (stream, GMIME_CONTENT_ENCODING_DEFAULT, TRUE, options, object->ensure_newline);
+		nwritten = g_mime_stream_write_to_stream (content, filtered);
 		g_mime_stream_flush (filtered);
-		g_object_unref (filtered);
+		_g_mime_stream_filter_release_pipeline (filtered);
 		
-		if (nwritten == -1)
-			return -1;
+		if (!_g_mime_data_wrapper_is_frozen (part->content))
+			g_mime_stream_reset (content);
 		
-		total += nwritten;
+		g_object_unref (content);
+	}
+	
+	return nwritten;
+}
+
+static ssize_t
+write_cached_content (GMimePart *part, GMimeFormatOptions *options, GMimeStream *stream)
+{
+	GMimeNewLineFormat format = g_mime_format_options_get_newline_format (options);
+	gboolean ensure_newline = ((GMimeObject *) part)->ensure_newline;
+	GMimeStream *cached;
+	ssize_t nwritten;
+	
+	cached = _g_mime_data_wrapper_get_cached_stream (part->content, part->encoding, format, ensure_newline);
+	
+	if (cached == NULL) {
+		cached = _g_mime_data_wrapper_new_cache_stream (part->content);
 		
-		if (part->encoding == GMIME_CONTENT_ENCODING_UUENCODE) {
-			if ((nwritten = g_mime_stream_printf (stream, "end%s", newline)) == -1)
-				return -1;
+		if (write_encoded_content (part, options, cached) == -1) {
+			g_object_unref (cached);
 			
-			total += nwritten;
+			return write_encoded_content (part, options, stream);
 		}
-	} else {
-		GMimeStream *content;
-		
-		content = g_mime_data_wrapper_get_stream (part->content);
-		g_mime_stream_reset (content);
 		
-		filtered = g_mime_stream_filter_new (stream);
-		
-		if (part->encoding != GMIME_CONTENT_ENCODING_BINARY) {
-			filter = g_mime_format_options_create_newline_filter (options, object->ensure_newline);
-			g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
-			g_object_unref (filter);
-		}
+		_g_mime_data_wrapper_set_cached_stream (part->content, part->encoding, format, ensure_newline, cached);
+		g_object_unref (cached);
+	}
+	
+	g_mime_stream_reset (cached);
+	nwritten = g_mime_stream_write_to_stream (cached, stream);
+	g_mime_stream_reset (cached);
+	
+	return nwritten;
+}
+
+static ssize_t
+write_content (GMimePart *part, GMimeFormatOptions *options, GMimeStream *stream)
+{
+	const char *newline = g_mime_format_options_get_newline (options);
+	gboolean uuencode = FALSE;
+	ssize_t nwritten, total = 0;
+	const char *filename;
+	
+	if (!part->content)
+		return 0;
+	
+	if (part->encoding == GMIME_CONTENT_ENCODING_UUENCODE &&
+	    part->encoding != g_mime_data_wrapper_get_encoding (part->content)) {
+		if (!(filename = g_mime_part_get_filename (part)))
+			filename = "unknown";
 		
-		nwritten = g_mime_stream_write_to_stream (content, filtered);
-		g_mime_stream_flush (filtered);
-		g_mime_stream_reset (content);
-		g_object_unref (filtered);
+		if ((nwritten = g_mime_stream_printf (stream, "begin 0644 %s%s", filename, newline)) == -1)
+			return -1;
 		
-		if (nwritten == -1)
+		total += nwritten;
+		uuencode = TRUE;
+	}
+	
+	if (g_mime_data_wrapper_get_caching (part->content))
+		nwritten = write_cached_content (part, options, stream);
+	else
+		nwritten = write_encoded_content (part, options, stream);
+	
+	if (nwritten == -1)
+		return -1;
+	
+	total += nwritten;
+	
+	if (uuencode) {
+		if ((nwritten = g_mime_stream_printf (stream, "end%s", newline)) == -1)
 			return -1;
 		
 		total += nwritten;
@@ -463,6 +486,38 @@ mime_part_encode (GMimeObject *object, GMimeEncodingConstraint constraint)
 	g_object_unref (filter);
 }
 
+/**
+ * _g_mime_part_freeze:
+ * @part: a #GMimePart
+ *
+ * Caches the OpenPGP data type of @part and freezes its content.
+ **/
+void
+_g_mime_part_freeze (GMimePart *part)
+{
+	if (part->content) {
+		/* detect (and cache) the type of OpenPGP data, if any */
+		g_mime_part_get_openpgp_data (part);
+		_g_mime_data_wrapper_freeze (part->content);
+	}
+}
+
+/**
+ * _g_mime_part_copy:
+ * @dest: the #GMimePart cloned from @src
+ * @src: a #GMimePart
+ *
+ * Sets a data wrapper sharing the content of @src on @dest.
+ **/
+void
+_g_mime_part_copy (GMimePart *dest, GMimePart *src)
+{
+	if (src->content)
+		dest->content = _g_mime_data_wrapper_clone (src->content);
+	
+	dest->openpgp = src->openpgp;
+}
+
 
 /**
  * g_mime_part_new:
@@ -943,6 +998,8 @@ g_mime_part_set_content (GMimePart *mime_part, GMimeDataWrapper *content)
 	if (mime_part->content == content)
 		return;
 	
+	_g_mime_object_check_mutable ((GMimeObject *) mime_part);
+	
 	GMIME_PART_GET_CLASS (mime_part)->set_content (mime_part, content);
 }
 
@@ -979,6 +1036,8 @@ g_mime_part_set_openpgp_data (GMimePart *mime_part, GMimeOpenPGPData data)
 {
 	g_return_if_fail (GMIME_IS_PART (mime_part));
 	
+	_g_mime_object_check_mutable ((GMimeObject *) mime_part);
+	
 	mime_part->openpgp = data;
 }
 
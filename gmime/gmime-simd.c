@@ -0,0 +1,908 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*  GMime
+ *  Copyright (C) 2000-2022 Jeffrey Stedfast
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, 51 Franklin Street, Fifth Floor, Boston, MA
+ *  02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include "gmime-internal.h"
+
+
+/*
+ * Runtime-dispatched SIMD kernels for the hot encoder/decoder loops.
+ *
+ * The kernels only ever handle the easy bulk of the input and hand
+ * control back to the scalar code as soon as they run into anything
+ * unusual (padding, garbage, the end of the buffer, etc.), so the
+ * scalar implementations in gmime-encodings.c remain the reference
+ * for all of the edge cases and the kernels never need to know about
+ * the state/save streaming contract beyond the current line position.
+ *
+ * The kernel pointers are left NULL when the CPU (or compiler) does
+ * not support any of the instruction sets.
+ */
+
+#define BASE64_QUARTETS_PER_LINE 19
+#define QP_MAX_LINE_LEN 75
+#define YENC_MAX_LINE_LEN 128
+
+size_t (* _g_mime_simd_base64_encode) (const unsigned char **inptr, const unsigned char *inend,
+				       unsigned char *outbuf, int *quartets) = NULL;
+size_t (* _g_mime_simd_base64_decode) (const unsigned char **inptr, const unsigned char *inend,
+				       unsigned char *outbuf) = NULL;
+size_t (* _g_mime_simd_quoted_encode) (const unsigned char **inptr, const unsigned char *inend,
+				       unsigned char *outbuf, guint32 *sofar) = NULL;
+size_t (* _g_mime_simd_quoted_decode) (const unsigned char **inptr, const unsigned char *inend,
+				       unsigned char *outbuf) = NULL;
+size_t (* _g_mime_simd_yencode) (const unsigned char **inptr, const unsigned char *inend,
+				 unsigned char *outbuf, int *already) = NULL;
+size_t (* _g_mime_simd_ydecode) (const unsigned char **inptr, const unsigned char *inend,
+				 unsigned char *outbuf) = NULL;
+guint32 (* _g_mime_simd_crc32) (guint32 crc, const unsigned char *inbuf, size_t inlen) = NULL;
+size_t (* _g_mime_simd_ascii_span) (const unsigned char *inbuf, size_t inlen, unsigned char *max) = NULL;
+void (* _g_mime_simd_count_8bit) (const unsigned char *inbuf, size_t inlen, size_t *count0, size_t *count8) = NULL;
+
+
+#ifdef HAVE_X86_SIMD
+
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static inline unsigned char *
+base64_encode_quartet (const unsigned char *inptr, unsigned char *outptr)
+{
+	*outptr++ = base64_alphabet[inptr[0] >> 2];
+	*outptr++ = base64_alphabet[(inptr[1] >> 4) | ((inptr[0] & 0x3) << 4)];
+	*outptr++ = base64_alphabet[((inptr[1] & 0x0f) << 2) | (inptr[2] >> 6)];
+	*outptr++ = base64_alphabet[inptr[2] & 0x3f];
+	
+	return outptr;
+}
+
+/* encodes 12 bytes of input (16 bytes must be readable) into 16 base64 characters */
+__attribute__((target("ssse3"))) static inline __m128i
+base64_encode_block_ssse3 (const unsigned char *inptr)
+{
+	__m128i in, indices, result, less;
+	
+	in = _mm_loadu_si128 ((const __m128i *) inptr);
+	
+	/* spread each 3-byte group into a 32-bit lane and extract the four 6-bit indices */
+	in = _mm_shuffle_epi8 (in, _mm_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	indices = _mm_or_si128 (_mm_mulhi_epu16 (_mm_and_si128 (in, _mm_set1_epi32 (0x0fc0fc00)),
+						 _mm_set1_epi32 (0x04000040)),
+				_mm_mullo_epi16 (_mm_and_si128 (in, _mm_set1_epi32 (0x003f03f0)),
+						 _mm_set1_epi32 (0x01000010)));
+	
+	/* map each index onto the offset that turns it into its base64 character */
+	result = _mm_subs_epu8 (indices, _mm_set1_epi8 (51));
+	less = _mm_cmpgt_epi8 (_mm_set1_epi8 (26), indices);
+	result = _mm_or_si128 (result, _mm_and_si128 (less, _mm_set1_epi8 (13)));
+	result = _mm_shuffle_epi8 (_mm_setr_epi8 ('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+						  '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+						  '/' - 63, 'A', 0, 0), result);
+	
+	return _mm_add_epi8 (result, indices);
+}
+
+/* encodes 24 bytes of input (28 bytes must be readable) into 32 base64 characters */
+__attribute__((target("avx2"))) static inline __m256i
+base64_encode_block_avx2 (const unsigned char *inptr)
+{
+	__m256i in, indices, result, less;
+	
+	in = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *) inptr)),
+				      _mm_loadu_si128 ((const __m128i *) (inptr + 12)), 1);
+	
+	in = _mm256_shuffle_epi8 (in, _mm256_setr_epi8 (1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+							1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+	indices = _mm256_or_si256 (_mm256_mulhi_epu16 (_mm256_and_si256 (in, _mm256_set1_epi32 (0x0fc0fc00)),
+						       _mm256_set1_epi32 (0x04000040)),
+				   _mm256_mullo_epi16 (_mm256_and_si256 (in, _mm256_set1_epi32 (0x003f03f0)),
+						       _mm256_set1_epi32 (0x01000010)));
+	
+	result = _mm256_subs_epu8 (indices, _mm256_set1_epi8 (51));
+	less = _mm256_cmpgt_epi8 (_mm256_set1_epi8 (26), indices);
+	result = _mm256_or_si256 (result, _mm256_and_si256 (less, _mm256_set1_epi8 (13)));
+	result = _mm256_shuffle_epi8 (_mm256_setr_epi8 ('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+							'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+							'/' - 63, 'A', 0, 0,
+							'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+							'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+							'/' - 63, 'A', 0, 0), result);
+	
+	return _mm256_add_epi8 (result, indices);
+}
+
+__attribute__((target("ssse3"))) static size_t
+base64_encode_ssse3 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf, int *quartets)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	int q = *quartets;
+	
+	while (inend - inptr >= 16) {
+		if (BASE64_QUARTETS_PER_LINE - q >= 4) {
+			_mm_storeu_si128 ((__m128i *) outptr, base64_encode_block_ssse3 (inptr));
+			outptr += 16;
+			inptr += 12;
+			q += 4;
+		} else {
+			outptr = base64_encode_quartet (inptr, outptr);
+			inptr += 3;
+			q++;
+		}
+		
+		if (q >= BASE64_QUARTETS_PER_LINE) {
+			*outptr++ = '\n';
+			q = 0;
+		}
+	}
+	
+	*quartets = q;
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+__attribute__((target("avx2"))) static size_t
+base64_encode_avx2 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf, int *quartets)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	int q = *quartets;
+	
+	while (inend - inptr >= 16) {
+		if (BASE64_QUARTETS_PER_LINE - q >= 8 && inend - inptr >= 28) {
+			_mm256_storeu_si256 ((__m256i *) outptr, base64_encode_block_avx2 (inptr));
+			outptr += 32;
+			inptr += 24;
+			q += 8;
+		} else if (BASE64_QUARTETS_PER_LINE - q >= 4) {
+			_mm_storeu_si128 ((__m128i *) outptr, base64_encode_block_ssse3 (inptr));
+			outptr += 16;
+			inptr += 12;
+			q += 4;
+		} else {
+			outptr = base64_encode_quartet (inptr, outptr);
+			inptr += 3;
+			q++;
+		}
+		
+		if (q >= BASE64_QUARTETS_PER_LINE) {
+			*outptr++ = '\n';
+			q = 0;
+		}
+	}
+	
+	*quartets = q;
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+/* decodes 16 base64 characters into 12 bytes, returns FALSE (having
+ * written nothing) if any of them are not in the base64 alphabet */
+__attribute__((target("ssse3"))) static inline gboolean
+base64_decode_block_ssse3 (const unsigned char *inptr, unsigned char *outptr)
+{
+	const __m128i lut_lo = _mm_setr_epi8 (0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+					      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i lut_hi = _mm_setr_epi8 (0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+					      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8 (0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i nibble = _mm_set1_epi8 (0x0f);
+	__m128i in, hi, lo, roll;
+	int tail;
+	
+	in = _mm_loadu_si128 ((const __m128i *) inptr);
+	hi = _mm_and_si128 (_mm_srli_epi32 (in, 4), nibble);
+	lo = _mm_and_si128 (in, nibble);
+	
+	/* each character class has a bit in common between its hi and lo nibble lookups */
+	if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_and_si128 (_mm_shuffle_epi8 (lut_lo, lo),
+								_mm_shuffle_epi8 (lut_hi, hi)),
+					       _mm_setzero_si128 ())) != 0xffff)
+		return FALSE;
+	
+	roll = _mm_shuffle_epi8 (lut_roll, _mm_add_epi8 (_mm_cmpeq_epi8 (in, _mm_set1_epi8 ('/')), hi));
+	in = _mm_add_epi8 (in, roll);
+	
+	/* pack the 6-bit values back into 3-byte groups */
+	in = _mm_maddubs_epi16 (in, _mm_set1_epi32 (0x01400140));
+	in = _mm_madd_epi16 (in, _mm_set1_epi32 (0x00011000));
+	in = _mm_shuffle_epi8 (in, _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	
+	_mm_storel_epi64 ((__m128i *) outptr, in);
+	tail = _mm_cvtsi128_si32 (_mm_srli_si128 (in, 8));
+	memcpy (outptr + 8, &tail, 4);
+	
+	return TRUE;
+}
+
+/* decodes 32 base64 characters into 24 bytes */
+__attribute__((target("avx2"))) static inline gboolean
+base64_decode_block_avx2 (const unsigned char *inptr, unsigned char *outptr)
+{
+	const __m256i lut_lo = _mm256_setr_epi8 (0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+						 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+						 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i lut_hi = _mm256_setr_epi8 (0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+						 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+						 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8 (0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+						   0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i nibble = _mm256_set1_epi8 (0x0f);
+	__m256i in, hi, lo, roll;
+	
+	in = _mm256_loadu_si256 ((const __m256i *) inptr);
+	hi = _mm256_and_si256 (_mm256_srli_epi32 (in, 4), nibble);
+	lo = _mm256_and_si256 (in, nibble);
+	
+	if (_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_and_si256 (_mm256_shuffle_epi8 (lut_lo, lo),
+									 _mm256_shuffle_epi8 (lut_hi, hi)),
+						     _mm256_setzero_si256 ())) != -1)
+		return FALSE;
+	
+	roll = _mm256_shuffle_epi8 (lut_roll, _mm256_add_epi8 (_mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ('/')), hi));
+	in = _mm256_add_epi8 (in, roll);
+	
+	in = _mm256_maddubs_epi16 (in, _mm256_set1_epi32 (0x01400140));
+	in = _mm256_madd_epi16 (in, _mm256_set1_epi32 (0x00011000));
+	in = _mm256_shuffle_epi8 (in, _mm256_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+							2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	
+	/* each lane now holds 12 bytes, squeeze them together */
+	in = _mm256_permutevar8x32_epi32 (in, _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 3, 7));
+	
+	_mm_storeu_si128 ((__m128i *) outptr, _mm256_castsi256_si128 (in));
+	_mm_storel_epi64 ((__m128i *) (outptr + 16), _mm256_extracti128_si256 (in, 1));
+	
+	return TRUE;
+}
+
+__attribute__((target("ssse3"))) static size_t
+base64_decode_ssse3 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	
+	while (inend - inptr >= 16) {
+		if (*inptr == '\n' || *inptr == '\r') {
+			inptr++;
+		} else if (base64_decode_block_ssse3 (inptr, outptr)) {
+			outptr += 12;
+			inptr += 16;
+		} else {
+			break;
+		}
+	}
+	
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+__attribute__((target("avx2"))) static size_t
+base64_decode_avx2 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	
+	while (inend - inptr >= 16) {
+		if (*inptr == '\n' || *inptr == '\r') {
+			inptr++;
+		} else if (inend - inptr >= 32 && base64_decode_block_avx2 (inptr, outptr)) {
+			outptr += 24;
+			inptr += 32;
+		} else if (base64_decode_block_ssse3 (inptr, outptr)) {
+			outptr += 12;
+			inptr += 16;
+		} else {
+			break;
+		}
+	}
+	
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+/* copies a run of @runlen characters that are safe to pass through
+ * unencoded, inserting soft line breaks where the scalar encoder would */
+static inline unsigned char *
+quoted_encode_run (const unsigned char *inptr, size_t runlen, unsigned char *outptr, guint32 *sofar)
+{
+	size_t n;
+	
+	while (runlen > 0) {
+		if (*sofar >= QP_MAX_LINE_LEN) {
+			*outptr++ = '=';
+			*outptr++ = '\n';
+			*sofar = 0;
+		}
+		
+		n = MIN (runlen, QP_MAX_LINE_LEN - *sofar);
+		memcpy (outptr, inptr, n);
+		*sofar += n;
+		outptr += n;
+		inptr += n;
+		runlen -= n;
+	}
+	
+	return outptr;
+}
+
+/* returns a bitmask of the characters in the 16 bytes at @inptr that the
+ * quoted-printable encoder passes through as-is: printable characters
+ * other than '=' and any blanks that are not followed by a line break
+ * (17 bytes must be readable) */
+__attribute__((target("ssse3"))) static inline guint32
+quoted_safe_mask_ssse3 (const unsigned char *inptr)
+{
+	__m128i in, next, printable, blank, eol;
+	
+	in = _mm_loadu_si128 ((const __m128i *) inptr);
+	next = _mm_loadu_si128 ((const __m128i *) (inptr + 1));
+	
+	printable = _mm_and_si128 (_mm_cmpgt_epi8 (in, _mm_set1_epi8 (32)), _mm_cmpgt_epi8 (_mm_set1_epi8 (127), in));
+	printable = _mm_andnot_si128 (_mm_cmpeq_epi8 (in, _mm_set1_epi8 ('=')), printable);
+	blank = _mm_or_si128 (_mm_cmpeq_epi8 (in, _mm_set1_epi8 (' ')), _mm_cmpeq_epi8 (in, _mm_set1_epi8 ('\t')));
+	eol = _mm_or_si128 (_mm_cmpeq_epi8 (next, _mm_set1_epi8 ('\r')), _mm_cmpeq_epi8 (next, _mm_set1_epi8 ('\n')));
+	
+	return (guint32) _mm_movemask_epi8 (_mm_or_si128 (printable, _mm_andnot_si128 (eol, blank)));
+}
+
+__attribute__((target("avx2"))) static inline guint32
+quoted_safe_mask_avx2 (const unsigned char *inptr)
+{
+	__m256i in, next, printable, blank, eol;
+	
+	in = _mm256_loadu_si256 ((const __m256i *) inptr);
+	next = _mm256_loadu_si256 ((const __m256i *) (inptr + 1));
+	
+	printable = _mm256_and_si256 (_mm256_cmpgt_epi8 (in, _mm256_set1_epi8 (32)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 (127), in));
+	printable = _mm256_andnot_si256 (_mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ('=')), printable);
+	blank = _mm256_or_si256 (_mm256_cmpeq_epi8 (in, _mm256_set1_epi8 (' ')), _mm256_cmpeq_epi8 (in, _mm256_set1_epi8 ('\t')));
+	eol = _mm256_or_si256 (_mm256_cmpeq_epi8 (next, _mm256_set1_epi8 ('\r')), _mm256_cmpeq_epi8 (next, _mm256_set1_epi8 ('\n')));
+	
+	return (guint32) _mm256_movemask_epi8 (_mm256_or_si256 (printable, _mm256_andnot_si256 (eol, blank)));
+}
+
+__attribute__((target("ssse3"))) static size_t
+quoted_encode_ssse3 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf, guint32 *sofar)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	guint32 mask;
+	size_t n;
+	
+	while (inend - inptr > 16) {
+		mask = quoted_safe_mask_ssse3 (inptr);
+		n = mask == 0xffff ? 16 : __builtin_ctz (~mask);
+		
+		outptr = quoted_encode_run (inptr, n, outptr, sofar);
+		inptr += n;
+		
+		if (n < 16)
+			break;
+	}
+	
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+__attribute__((target("avx2"))) static size_t
+quoted_encode_avx2 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf, guint32 *sofar)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	guint32 mask;
+	size_t n;
+	
+	while (inend - inptr > 32) {
+		mask = quoted_safe_mask_avx2 (inptr);
+		n = mask == 0xffffffff ? 32 : __builtin_ctz (~mask);
+		
+		outptr = quoted_encode_run (inptr, n, outptr, sofar);
+		inptr += n;
+		
+		if (n < 32)
+			goto done;
+	}
+	
+	while (inend - inptr > 16) {
+		mask = quoted_safe_mask_ssse3 (inptr);
+		n = mask == 0xffff ? 16 : __builtin_ctz (~mask);
+		
+		outptr = quoted_encode_run (inptr, n, outptr, sofar);
+		inptr += n;
+		
+		if (n < 16)
+			break;
+	}
+	
+ done:
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+/* copies everything up to the next '=' */
+__attribute__((target("ssse3"))) static size_t
+quoted_decode_ssse3 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	guint32 mask;
+	__m128i block;
+	size_t n;
+	
+	while (inend - inptr >= 16) {
+		block = _mm_loadu_si128 ((const __m128i *) inptr);
+		
+		if ((mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (block, _mm_set1_epi8 ('=')))) != 0) {
+			n = __builtin_ctz (mask);
+			memcpy (outptr, inptr, n);
+			outptr += n;
+			inptr += n;
+			break;
+		}
+		
+		_mm_storeu_si128 ((__m128i *) outptr, block);
+		outptr += 16;
+		inptr += 16;
+	}
+	
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+__attribute__((target("avx2"))) static size_t
+quoted_decode_avx2 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	guint32 mask;
+	__m256i block;
+	size_t n;
+	
+	while (inend - inptr >= 32) {
+		block = _mm256_loadu_si256 ((const __m256i *) inptr);
+		
+		if ((mask = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (block, _mm256_set1_epi8 ('=')))) != 0) {
+			n = __builtin_ctz (mask);
+			memcpy (outptr, inptr, n);
+			outptr += n;
+			inptr += n;
+			
+			*in = inptr;
+			
+			return (size_t) (outptr - outbuf);
+		}
+		
+		_mm256_storeu_si256 ((__m256i *) outptr, block);
+		outptr += 32;
+		inptr += 32;
+	}
+	
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf) + quoted_decode_ssse3 (in, inend, outptr);
+}
+
+/* pshufb tables, indexed by an 8-bit mask of the bytes that need escaping
+ * (encoder) or removing (decoder) in an 8-byte half of a block */
+static unsigned char yenc_expand_shuffle[256][16];
+static unsigned char yenc_expand_add[256][16];
+static unsigned char yenc_compact_shuffle[256][16];
+
+static void
+yenc_tables_init (void)
+{
+	int mask, i, j;
+	
+	for (mask = 0; mask < 256; mask++) {
+		memset (yenc_expand_shuffle[mask], 0x80, 16);
+		memset (yenc_expand_add[mask], 0, 16);
+		memset (yenc_compact_shuffle[mask], 0x80, 16);
+		
+		for (i = 0, j = 0; i < 8; i++) {
+			if (mask & (1 << i)) {
+				/* '=' followed by the character + 64 */
+				yenc_expand_add[mask][j++] = '=';
+				yenc_expand_add[mask][j] = 64;
+			}
+			
+			yenc_expand_shuffle[mask][j++] = i;
+		}
+		
+		for (i = 0, j = 0; i < 8; i++) {
+			if (!(mask & (1 << i)))
+				yenc_compact_shuffle[mask][j++] = i;
+		}
+	}
+}
+
+static inline unsigned char *
+yencode_char (unsigned char c, unsigned char *outptr, int *already)
+{
+	c += 42;
+	
+	if (c == '\0' || c == '\t' || c == '\r' || c == '\n' || c == '=') {
+		*outptr++ = '=';
+		*outptr++ = c + 64;
+		*already += 2;
+	} else {
+		*outptr++ = c;
+		(*already)++;
+	}
+	
+	if (*already >= YENC_MAX_LINE_LEN) {
+		*outptr++ = '\n';
+		*already = 0;
+	}
+	
+	return outptr;
+}
+
+__attribute__((target("ssse3"))) static size_t
+yencode_ssse3 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf, int *already)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	__m128i block, escape, half;
+	guint32 mask, lo, hi;
+	int i, n;
+	
+	/* a block may write up to 8 bytes past its own output, which
+	 * the output of the next 8 bytes of input is sure to cover */
+	while (inend - inptr >= 24) {
+		block = _mm_add_epi8 (_mm_loadu_si128 ((const __m128i *) inptr), _mm_set1_epi8 (42));
+		escape = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (block, _mm_setzero_si128 ()),
+						     _mm_cmpeq_epi8 (block, _mm_set1_epi8 ('\t'))),
+				       _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (block, _mm_set1_epi8 ('\r')),
+								   _mm_cmpeq_epi8 (block, _mm_set1_epi8 ('\n'))),
+						     _mm_cmpeq_epi8 (block, _mm_set1_epi8 ('='))));
+		mask = _mm_movemask_epi8 (escape);
+		n = 16 + __builtin_popcount (mask);
+		
+		if (*already + n >= YENC_MAX_LINE_LEN) {
+			/* the line ends somewhere in this block */
+			for (i = 0; i < 16; i++)
+				outptr = yencode_char (inptr[i], outptr, already);
+			inptr += 16;
+			continue;
+		}
+		
+		lo = mask & 0xff;
+		hi = mask >> 8;
+		
+		half = _mm_shuffle_epi8 (block, _mm_loadu_si128 ((const __m128i *) yenc_expand_shuffle[lo]));
+		half = _mm_add_epi8 (half, _mm_loadu_si128 ((const __m128i *) yenc_expand_add[lo]));
+		_mm_storeu_si128 ((__m128i *) outptr, half);
+		outptr += 8 + __builtin_popcount (lo);
+		
+		half = _mm_shuffle_epi8 (_mm_srli_si128 (block, 8), _mm_loadu_si128 ((const __m128i *) yenc_expand_shuffle[hi]));
+		half = _mm_add_epi8 (half, _mm_loadu_si128 ((const __m128i *) yenc_expand_add[hi]));
+		_mm_storeu_si128 ((__m128i *) outptr, half);
+		outptr += 8 + __builtin_popcount (hi);
+		
+		*already += n;
+		inptr += 16;
+	}
+	
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+/* decodes blocks of yEnc data, stopping at anything that needs the
+ * decoder's state machine: an escape that straddles the block, "==",
+ * an escaped newline, or a newline followed by '=' (which might be
+ * the start of a =yend line) */
+__attribute__((target("ssse3"))) static size_t
+ydecode_ssse3 (const unsigned char **in, const unsigned char *inend, unsigned char *outbuf)
+{
+	register const unsigned char *inptr = *in;
+	register unsigned char *outptr = outbuf;
+	guint32 eq, nl, skip, lo, hi;
+	__m128i block, equals, escaped;
+	
+	while (inend - inptr >= 16) {
+		block = _mm_loadu_si128 ((const __m128i *) inptr);
+		equals = _mm_cmpeq_epi8 (block, _mm_set1_epi8 ('='));
+		eq = _mm_movemask_epi8 (equals);
+		nl = _mm_movemask_epi8 (_mm_cmpeq_epi8 (block, _mm_set1_epi8 ('\n')));
+		
+		if (((eq | nl) & 0x8000) || (eq & (eq << 1)) || (nl & (eq << 1)) || (eq & (nl << 1)))
+			break;
+		
+		/* escaped characters are offset by an additional 64 */
+		escaped = _mm_and_si128 (_mm_slli_si128 (equals, 1), _mm_set1_epi8 (64));
+		
+		block = _mm_sub_epi8 (_mm_sub_epi8 (block, _mm_set1_epi8 (42)), escaped);
+		
+		skip = eq | nl;
+		lo = skip & 0xff;
+		hi = skip >> 8;
+		
+		_mm_storel_epi64 ((__m128i *) outptr, _mm_shuffle_epi8 (block, _mm_loadu_si128 ((const __m128i *) yenc_compact_shuffle[lo])));
+		outptr += 8 - __builtin_popcount (lo);
+		
+		_mm_storel_epi64 ((__m128i *) outptr, _mm_shuffle_epi8 (_mm_srli_si128 (block, 8), _mm_loadu_si128 ((const __m128i *) yenc_compact_shuffle[hi])));
+		outptr += 8 - __builtin_popcount (hi);
+		
+		inptr += 16;
+	}
+	
+	*in = inptr;
+	
+	return (size_t) (outptr - outbuf);
+}
+
+/* CRC-32 (as used by yEnc) by folding with carry-less multiplication,
+ * see Intel's "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction". @inlen must be a multiple of 16 and at
+ * least 64. */
+__attribute__((target("pclmul,sse4.1"))) static guint32
+crc32_pclmul (guint32 crc, const unsigned char *inbuf, size_t inlen)
+{
+	const __m128i k1k2 = _mm_set_epi64x (0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x (0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x (0x0000000000, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x (0x01f7011641, 0x01db710641);
+	const __m128i mask32 = _mm_setr_epi32 (~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+	
+	x1 = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) inbuf), _mm_cvtsi32_si128 ((int) crc));
+	x2 = _mm_loadu_si128 ((const __m128i *) (inbuf + 16));
+	x3 = _mm_loadu_si128 ((const __m128i *) (inbuf + 32));
+	x4 = _mm_loadu_si128 ((const __m128i *) (inbuf + 48));
+	inbuf += 64;
+	inlen -= 64;
+	
+	/* fold 4 x 128 bits at a time */
+	while (inlen >= 64) {
+		x5 = _mm_clmulepi64_si128 (x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128 (x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128 (x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128 (x4, k1k2, 0x00);
+		
+		x1 = _mm_clmulepi64_si128 (x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128 (x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128 (x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128 (x4, k1k2, 0x11);
+		
+		x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5), _mm_loadu_si128 ((const __m128i *) inbuf));
+		x2 = _mm_xor_si128 (_mm_xor_si128 (x2, x6), _mm_loadu_si128 ((const __m128i *) (inbuf + 16)));
+		x3 = _mm_xor_si128 (_mm_xor_si128 (x3, x7), _mm_loadu_si128 ((const __m128i *) (inbuf + 32)));
+		x4 = _mm_xor_si128 (_mm_xor_si128 (x4, x8), _mm_loadu_si128 ((const __m128i *) (inbuf + 48)));
+		
+		inbuf += 64;
+		inlen -= 64;
+	}
+	
+	/* fold the 4 lanes into one */
+	x5 = _mm_clmulepi64_si128 (x1, k3k4, 0x00);
+	x1 = _mm_xor_si128 (_mm_xor_si128 (_mm_clmulepi64_si128 (x1, k3k4, 0x11), x2), x5);
+	x5 = _mm_clmulepi64_si128 (x1, k3k4, 0x00);
+	x1 = _mm_xor_si128 (_mm_xor_si128 (_mm_clmulepi64_si128 (x1, k3k4, 0x11), x3), x5);
+	x5 = _mm_clmulepi64_si128 (x1, k3k4, 0x00);
+	x1 = _mm_xor_si128 (_mm_xor_si128 (_mm_clmulepi64_si128 (x1, k3k4, 0x11), x4), x5);
+	
+	/* fold any remaining 128 bit blocks */
+	while (inlen >= 16) {
+		x5 = _mm_clmulepi64_si128 (x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128 (x1, k3k4, 0x11);
+		x1 = _mm_xor_si128 (_mm_xor_si128 (x1, x5), _mm_loadu_si128 ((const __m128i *) inbuf));
+		
+		inbuf += 16;
+		inlen -= 16;
+	}
+	
+	/* fold 128 bits down to 64 */
+	x2 = _mm_clmulepi64_si128 (x1, k3k4, 0x10);
+	x1 = _mm_xor_si128 (_mm_srli_si128 (x1, 8), x2);
+	
+	x2 = _mm_srli_si128 (x1, 4);
+	x1 = _mm_and_si128 (x1, mask32);
+	x1 = _mm_xor_si128 (_mm_clmulepi64_si128 (x1, k5k0, 0x00), x2);
+	
+	/* Barrett reduction down to 32 bits */
+	x2 = _mm_and_si128 (x1, mask32);
+	x2 = _mm_clmulepi64_si128 (x2, poly, 0x10);
+	x2 = _mm_and_si128 (x2, mask32);
+	x2 = _mm_clmulepi64_si128 (x2, poly, 0x00);
+	x1 = _mm_xor_si128 (x1, x2);
+	
+	return (guint32) _mm_extract_epi32 (x1, 1);
+}
+
+static inline size_t
+ascii_span_tail (const unsigned char *inbuf, const unsigned char *inptr, const unsigned char *inend,
+		 unsigned char hi, unsigned char *max)
+{
+	while (inptr < inend && *inptr < 128) {
+		hi = MAX (hi, *inptr);
+		inptr++;
+	}
+	
+	*max = hi;
+	
+	return (size_t) (inptr - inbuf);
+}
+
+__attribute__((target("sse2"))) static inline unsigned char
+max_epu8_sse2 (__m128i v)
+{
+	v = _mm_max_epu8 (v, _mm_srli_si128 (v, 8));
+	v = _mm_max_epu8 (v, _mm_srli_si128 (v, 4));
+	v = _mm_max_epu8 (v, _mm_srli_si128 (v, 2));
+	v = _mm_max_epu8 (v, _mm_srli_si128 (v, 1));
+	
+	return (unsigned char) _mm_cvtsi128_si32 (v);
+}
+
+/* finds the length of the run of 7-bit characters at the start of
+ * @inbuf as well as the largest character value within that run */
+__attribute__((target("sse2"))) static size_t
+ascii_span_sse2 (const unsigned char *inbuf, size_t inlen, unsigned char *max)
+{
+	const unsigned char *inend = inbuf + inlen;
+	const unsigned char *inptr = inbuf;
+	__m128i block, hi = _mm_setzero_si128 ();
+	
+	while (inend - inptr >= 16) {
+		block = _mm_loadu_si128 ((const __m128i *) inptr);
+		if (_mm_movemask_epi8 (block) != 0)
+			break;
+		
+		hi = _mm_max_epu8 (hi, block);
+		inptr += 16;
+	}
+	
+	return ascii_span_tail (inbuf, inptr, inend, max_epu8_sse2 (hi), max);
+}
+
+__attribute__((target("avx2"))) static size_t
+ascii_span_avx2 (const unsigned char *inbuf, size_t inlen, unsigned char *max)
+{
+	const unsigned char *inend = inbuf + inlen;
+	const unsigned char *inptr = inbuf;
+	__m256i block, hi = _mm256_setzero_si256 ();
+	
+	while (inend - inptr >= 32) {
+		block = _mm256_loadu_si256 ((const __m256i *) inptr);
+		if (_mm256_movemask_epi8 (block) != 0)
+			break;
+		
+		hi = _mm256_max_epu8 (hi, block);
+		inptr += 32;
+	}
+	
+	return ascii_span_tail (inbuf, inptr, inend,
+				max_epu8_sse2 (_mm_max_epu8 (_mm256_castsi256_si128 (hi), _mm256_extracti128_si256 (hi, 1))),
+				max);
+}
+
+static inline void
+count_8bit_tail (const unsigned char *inptr, const unsigned char *inend, size_t *count0, size_t *count8)
+{
+	while (inptr < inend) {
+		if (*inptr == 0)
+			(*count0)++;
+		else if (*inptr & 0x80)
+			(*count8)++;
+		inptr++;
+	}
+}
+
+/* adds the number of nul bytes and 8bit bytes in @inbuf to @count0
+ * and @count8, respectively */
+__attribute__((target("sse2,popcnt"))) static void
+count_8bit_sse2 (const unsigned char *inbuf, size_t inlen, size_t *count0, size_t *count8)
+{
+	const unsigned char *inend = inbuf + inlen;
+	const unsigned char *inptr = inbuf;
+	__m128i block;
+	
+	while (inend - inptr >= 16) {
+		block = _mm_loadu_si128 ((const __m128i *) inptr);
+		*count0 += __builtin_popcount (_mm_movemask_epi8 (_mm_cmpeq_epi8 (block, _mm_setzero_si128 ())));
+		*count8 += __builtin_popcount (_mm_movemask_epi8 (block));
+		inptr += 16;
+	}
+	
+	count_8bit_tail (inptr, inend, count0, count8);
+}
+
+__attribute__((target("avx2,popcnt"))) static void
+count_8bit_avx2 (const unsigned char *inbuf, size_t inlen, size_t *count0, size_t *count8)
+{
+	const unsigned char *inend = inbuf + inlen;
+	const unsigned char *inptr = inbuf;
+	__m256i block;
+	
+	while (inend - inptr >= 32) {
+		block = _mm256_loadu_si256 ((const __m256i *) inptr);
+		*count0 += __builtin_popcount ((guint32) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (block, _mm256_setzero_si256 ())));
+		*count8 += __builtin_popcount ((guint32) _mm256_movemask_epi8 (block));
+		inptr += 32;
+	}
+	
+	count_8bit_tail (inptr, inend, count0, count8);
+}
+
+#endif /* HAVE_X86_SIMD */
+
+
+/**
+ * g_mime_simd_init:
+ *
+ * Picks the best SIMD kernels supported by the CPU we are running on.
+ **/
+void
+g_mime_simd_init (void)
+{
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init ();
+	
+	if (__builtin_cpu_supports ("ssse3")) {
+		yenc_tables_init ();
+		_g_mime_simd_yencode = yencode_ssse3;
+		_g_mime_simd_ydecode = ydecode_ssse3;
+	}
+	
+	if (__builtin_cpu_supports ("pclmul") && __builtin_cpu_supports ("sse4.1"))
+		_g_mime_simd_crc32 = crc32_pclmul;
+	
+	if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("popcnt")) {
+		_g_mime_simd_ascii_span = ascii_span_avx2;
+		_g_mime_simd_count_8bit = count_8bit_avx2;
+	} else if (__builtin_cpu_supports ("sse2")) {
+		_g_mime_simd_ascii_span = ascii_span_sse2;
+		if (__builtin_cpu_supports ("popcnt"))
+			_g_mime_simd_count_8bit = count_8bit_sse2;
+	}
+	
+	if (__builtin_cpu_supports ("avx2")) {
+		_g_mime_simd_base64_encode = base64_encode_avx2;
+		_g_mime_simd_base64_decode = base64_decode_avx2;
+		_g_mime_simd_quoted_encode = quoted_encode_avx2;
+		_g_mime_simd_quoted_decode = quoted_decode_avx2;
+	} else if (__builtin_cpu_supports ("ssse3")) {
+		_g_mime_simd_base64_encode = base64_encode_ssse3;
+		_g_mime_simd_base64_decode = base64_decode_ssse3;
+		_g_mime_simd_quoted_encode = quoted_encode_ssse3;
+		_g_mime_simd_quoted_decode = quoted_decode_ssse3;
+	}
+#endif
+}
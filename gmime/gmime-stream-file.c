@@ -152,11 +152,26 @@ stream_read (GMimeStream *stream, char *buf, size_t len)
 	if (stream->bound_end != -1)
 		len = (size_t) MIN (stream->bound_end - stream->position, (gint64) len);
 	
+#ifdef HAVE_FLOCKFILE
+	/* substreams sharing the FILE may be read from different threads */
+	flockfile (fstream->fp);
+#endif
+	
 	/* make sure we are at the right position */
-	if ((fseek (fstream->fp, (long) stream->position, SEEK_SET)) == -1)
+	if ((fseek (fstream->fp, (long) stream->position, SEEK_SET)) == -1) {
+#ifdef HAVE_FLOCKFILE
+		funlockfile (fstream->fp);
+#endif
 		return -1;
+	}
+	
+	nread = fread (buf, 1, len, fstream->fp);
+	
+#ifdef HAVE_FLOCKFILE
+	funlockfile (fstream->fp);
+#endif
 	
-	if ((nread = fread (buf, 1, len, fstream->fp)) > 0)
+	if (nread > 0)
 		stream->position += nread;
 	
 	return (ssize_t) nread;
@@ -25,7 +25,10 @@
 
 #include <string.h>
 
+#include "gmime-format-options.h"
 #include "gmime-stream-filter.h"
+#include "gmime-filter-basic.h"
+#include "gmime-internal.h"
 
 
 /**
@@ -47,6 +50,8 @@
 #define READ_PAD (64)		/* bytes padded before buffer */
 #define READ_SIZE (4096)
 
+#define MAX_PIPELINES (32)	/* max number of idle pipelines to keep around */
+
 #define _PRIVATE(o) (((GMimeStreamFilter *)(o))->priv)
 
 struct _filter {
@@ -57,14 +62,18 @@ struct _filter {
 
 struct _GMimeStreamFilterPrivate {
 	struct _filter *filters;
+	struct _filter *run;	/* the filters actually run, with fusable chains replaced */
 	int filterid;		/* next filter id */
 	
-	char *realbuffer;	/* buffer - READ_PAD */
+	char *realbuffer;	/* buffer - readpad */
 	char *buffer;		/* READ_SIZE bytes */
+	size_t readpad;		/* bytes padded before buffer */
 	
 	char *filtered;		/* the filtered data */
 	size_t filteredlen;
 	
+	guint pipeline;		/* pipeline key or 0 if not a pipeline */
+	
 	int last_was_read:1;	/* was the last op read or write? */
 	int flushed:1;          /* have the filters been flushed? */
 };
@@ -73,6 +82,8 @@ static void g_mime_stream_filter_class_init (GMimeStreamFilterClass *klass);
 static void g_mime_stream_filter_init (GMimeStreamFilter *stream, GMimeStreamFilterClass *klass);
 static void g_mime_stream_filter_finalize (GObject *object);
 
+static void filter_list_free (struct _filter *f);
+
 static ssize_t stream_read (GMimeStream *stream, char *buf, size_t n);
 static ssize_t stream_write (GMimeStream *stream, const char *buf, size_t n);
 static int stream_flush (GMimeStream *stream);
@@ -87,6 +98,17 @@ static GMimeStream *stream_substream (GMimeStream *stream, gint64 start, gint64
 
 static GMimeStreamClass *parent_class = NULL;
 
+static GPtrArray *pipelines = NULL;
+
+#ifdef G_THREADS_ENABLED
+static GMutex pipeline_lock;
+#define PIPELINE_UNLOCK() g_mutex_unlock (&pipeline_lock);
+#define PIPELINE_LOCK() g_mutex_lock (&pipeline_lock);
+#else
+#define PIPELINE_UNLOCK()
+#define PIPELINE_LOCK()
+#endif /* G_THREADS_ENABLED */
+
 
 GType
 g_mime_stream_filter_get_type (void)
@@ -142,12 +164,15 @@ g_mime_stream_filter_init (GMimeStreamFilter *stream, GMimeStreamFilterClass *kl
 	stream->owner = FALSE;
 	stream->priv = g_new (struct _GMimeStreamFilterPrivate, 1);
 	stream->priv->filters = NULL;
+	stream->priv->run = NULL;
 	stream->priv->filterid = 0;
 	stream->priv->realbuffer = g_malloc (READ_SIZE + READ_PAD);
 	stream->priv->buffer = stream->priv->realbuffer + READ_PAD;
+	stream->priv->readpad = READ_PAD;
 	stream->priv->last_was_read = TRUE;
 	stream->priv->filteredlen = 0;
 	stream->priv->flushed = FALSE;
+	stream->priv->pipeline = 0;
 }
 
 static void
@@ -155,25 +180,93 @@ g_mime_stream_filter_finalize (GObject *object)
 {
 	GMimeStreamFilter *filter = (GMimeStreamFilter *) object;
 	struct _GMimeStreamFilterPrivate *p = filter->priv;
-	struct _filter *fn, *f;
 	
-	f = p->filters;
+	filter_list_free (p->filters);
+	filter_list_free (p->run);
+	
+	g_free (p->realbuffer);
+	g_free (p);
+	
+	if (filter->source)
+		g_object_unref (filter->source);
+	
+	G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+
+static void
+filter_list_free (struct _filter *f)
+{
+	struct _filter *fn;
+	
 	while (f) {
 		fn = f->next;
 		g_object_unref (f->filter);
 		g_free (f);
 		f = fn;
 	}
+}
+
+static struct _filter *
+get_run_filters (struct _GMimeStreamFilterPrivate *priv)
+{
+	struct _filter *f, *fn, *next, *last, *tail;
+	GMimeFilter *filter;
+	int n;
 	
-	g_free (p->realbuffer);
-	g_free (p);
+	if (priv->run != NULL || priv->filters == NULL)
+		return priv->run;
 	
-	if (filter->source)
-		g_object_unref (filter->source);
+	/* substitute fused filters for the chains that have one */
+	tail = (struct _filter *) &priv->run;
+	f = priv->filters;
 	
-	G_OBJECT_CLASS (parent_class)->finalize (object);
+	while (f != NULL) {
+		next = f->next;
+		last = next ? next->next : NULL;
+		
+		if ((filter = _g_mime_filter_fuse (f->filter, next ? next->filter : NULL, last ? last->filter : NULL, &n))) {
+			while (n-- > 0)
+				f = f->next;
+		} else {
+			filter = g_object_ref (f->filter);
+			f = f->next;
+		}
+		
+		fn = g_new (struct _filter, 1);
+		fn->filter = filter;
+		fn->next = NULL;
+		fn->id = -1;
+		
+		tail->next = fn;
+		tail = fn;
+	}
+	
+	return priv->run;
 }
 
+static void
+reset_filters (struct _GMimeStreamFilterPrivate *priv)
+{
+	struct _filter *f;
+	
+	/* fused filters reset the filters they replaced */
+	f = priv->run ? priv->run : priv->filters;
+	while (f != NULL) {
+		g_mime_filter_reset (f->filter);
+		f = f->next;
+	}
+}
+
+static void
+reserve_headroom (struct _filter *f)
+{
+	/* make sure the output of this filter leaves enough room in
+	 * front of it for the next filter to preload its backed up
+	 * data without having to copy the whole buffer */
+	if (f->next && f->next->filter->backlen > 0)
+		_g_mime_filter_reserve_headroom (f->filter, f->next->filter->backlen);
+}
 
 static ssize_t
 stream_read (GMimeStream *stream, char *buf, size_t n)
@@ -186,7 +279,17 @@ stream_read (GMimeStream *stream, char *buf, size_t n)
 	priv->last_was_read = TRUE;
 	
 	if (priv->filteredlen <= 0) {
-		size_t presize = READ_PAD;
+		size_t presize;
+		
+		if ((f = get_run_filters (priv)) && f->filter->backlen > priv->readpad) {
+			/* grow the padding so the first filter can preload its backlog in place */
+			priv->readpad = (f->filter->backlen + (READ_PAD - 1)) & ~((size_t) READ_PAD - 1);
+			g_free (priv->realbuffer);
+			priv->realbuffer = g_malloc (READ_SIZE + priv->readpad);
+			priv->buffer = priv->realbuffer + priv->readpad;
+		}
+		
+		presize = priv->readpad;
 		
 		nread = g_mime_stream_read (filter->source, priv->buffer, READ_SIZE);
 		if (nread <= 0) {
@@ -194,9 +297,10 @@ stream_read (GMimeStream *stream, char *buf, size_t n)
 			if (g_mime_stream_eos (filter->source) && !priv->flushed) {
 				priv->filtered = priv->buffer;
 				priv->filteredlen = 0;
-				f = priv->filters;
+				f = get_run_filters (priv);
 				
 				while (f != NULL) {
+					reserve_headroom (f);
 					g_mime_filter_complete (f->filter, priv->filtered, priv->filteredlen,
 								presize, &priv->filtered, &priv->filteredlen,
 								&presize);
@@ -213,9 +317,10 @@ stream_read (GMimeStream *stream, char *buf, size_t n)
 			priv->filtered = priv->buffer;
 			priv->filteredlen = nread;
 			priv->flushed = FALSE;
-			f = priv->filters;
+			f = get_run_filters (priv);
 			
 			while (f != NULL) {
+				reserve_headroom (f);
 				g_mime_filter_filter (f->filter, priv->filtered, priv->filteredlen, presize,
 						      &priv->filtered, &priv->filteredlen, &presize);
 				
@@ -245,9 +350,10 @@ stream_write (GMimeStream *stream, const char *buf, size_t n)
 	priv->last_was_read = FALSE;
 	priv->flushed = FALSE;
 	
-	f = priv->filters;
+	f = get_run_filters (priv);
 	presize = 0;
 	while (f != NULL) {
+		reserve_headroom (f);
 		g_mime_filter_filter (f->filter, buffer, n, presize, &buffer, &n, &presize);
 		
 		f = f->next;
@@ -277,9 +383,10 @@ stream_flush (GMimeStream *stream)
 	buffer = "";
 	len = 0;
 	presize = 0;
-	f = priv->filters;
+	f = get_run_filters (priv);
 	
 	while (f != NULL) {
+		reserve_headroom (f);
 		g_mime_filter_complete (f->filter, buffer, len, presize, &buffer, &len, &presize);
 		
 		f = f->next;
@@ -326,7 +433,6 @@ stream_reset (GMimeStream *stream)
 {
 	GMimeStreamFilter *filter = (GMimeStreamFilter *) stream;
 	struct _GMimeStreamFilterPrivate *priv = filter->priv;
-	struct _filter *f;
 	
 	if (g_mime_stream_reset (filter->source) == -1)
 		return -1;
@@ -335,11 +441,7 @@ stream_reset (GMimeStream *stream)
 	priv->flushed = FALSE;
 	
 	/* and reset filters */
-	f = priv->filters;
-	while (f != NULL) {
-		g_mime_filter_reset (f->filter);
-		f = f->next;
-	}
+	reset_filters (priv);
 	
 	return 0;
 }
@@ -465,6 +567,10 @@ g_mime_stream_filter_add (GMimeStreamFilter *stream, GMimeFilter *filter)
 	f->next = fn;
 	fn->next = NULL;
 	
+	/* the chain needs to be re-examined for fusable filters */
+	filter_list_free (priv->run);
+	priv->run = NULL;
+	
 	return fn->id;
 }
 
@@ -497,6 +603,9 @@ g_mime_stream_filter_remove (GMimeStreamFilter *stream, int id)
 			f->next = fn->next;
 			g_object_unref (fn->filter);
 			g_free (fn);
+			
+			filter_list_free (priv->run);
+			priv->run = NULL;
 		}
 		f = f->next;
 	}
@@ -538,3 +647,158 @@ g_mime_stream_filter_get_owner (GMimeStreamFilter *stream)
 	
 	return stream->owner;
 }
+
+
+void
+g_mime_stream_filter_pipelines_init (void)
+{
+#ifdef G_THREADS_ENABLED
+	g_mutex_init (&pipeline_lock);
+#endif
+	
+	pipelines = g_ptr_array_new ();
+}
+
+void
+g_mime_stream_filter_pipelines_shutdown (void)
+{
+	guint i;
+	
+	if (pipelines == NULL)
+		return;
+	
+	for (i = 0; i < pipelines->len; i++)
+		g_object_unref (pipelines->pdata[i]);
+	
+	g_ptr_array_free (pipelines, TRUE);
+	pipelines = NULL;
+	
+#ifdef G_THREADS_ENABLED
+	if (glib_check_version (2, 37, 4) == NULL) {
+		/* see g_mime_charset_map_shutdown() */
+		g_mutex_clear (&pipeline_lock);
+	}
+#endif
+}
+
+
+/**
+ * _g_mime_stream_filter_get_pipeline:
+ * @source: source stream
+ * @encoding: a #GMimeContentEncoding
+ * @encode: %TRUE if @encoding should be used to encode or %FALSE to decode
+ * @options: (nullable): the #GMimeFormatOptions to create a newline filter for or %NULL for none
+ * @ensure_newline: %TRUE if the output must *always* end with a new line
+ *
+ * Gets a #GMimeStreamFilter wrapping @source that transfer-encodes (or
+ * decodes) the data passing through it using @encoding and then
+ * converts line endings according to @options.
+ *
+ * Idle pipelines are kept in a pool keyed by their configuration so
+ * that writing many parts does not need to allocate new filter streams,
+ * filters and filter buffers for each one of them.
+ *
+ * The pipeline must be released using
+ * _g_mime_stream_filter_release_pipeline() once the caller is done with
+ * it and must not be referenced beyond that point.
+ *
+ * Returns: a filter stream for the requested pipeline.
+ **/
+GMimeStream *
+_g_mime_stream_filter_get_pipeline (GMimeStream *source, GMimeContentEncoding encoding, gboolean encode,
+				    GMimeFormatOptions *options, gboolean ensure_newline)
+{
+	GMimeStreamFilter *filtered = NULL;
+	GMimeFilter *filter;
+	guint pipeline, i;
+	
+	switch (encoding) {
+	case GMIME_CONTENT_ENCODING_UUENCODE:
+	case GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE:
+	case GMIME_CONTENT_ENCODING_BASE64:
+		break;
+	default:
+		encoding = GMIME_CONTENT_ENCODING_DEFAULT;
+		encode = FALSE;
+		break;
+	}
+	
+	/* pack the configuration into a non-zero key */
+	pipeline = (encoding << 5) | (encode ? 1 << 4 : 0) | 1;
+	if (options != NULL) {
+		pipeline |= (g_mime_format_options_get_newline_format (options) == GMIME_NEWLINE_FORMAT_DOS) ? 1 << 3 : 0;
+		pipeline |= ensure_newline ? 1 << 2 : 0;
+		pipeline |= 1 << 1;
+	}
+	
+	PIPELINE_LOCK ();
+	
+	if (pipelines != NULL) {
+		for (i = pipelines->len; i > 0; i--) {
+			if (((GMimeStreamFilter *) pipelines->pdata[i - 1])->priv->pipeline == pipeline) {
+				filtered = g_ptr_array_remove_index_fast (pipelines, i - 1);
+				break;
+			}
+		}
+	}
+	
+	PIPELINE_UNLOCK ();
+	
+	if (filtered == NULL) {
+		filtered = g_object_new (GMIME_TYPE_STREAM_FILTER, NULL);
+		filtered->priv->pipeline = pipeline;
+		
+		if (encoding != GMIME_CONTENT_ENCODING_DEFAULT) {
+			filter = g_mime_filter_basic_new (encoding, encode);
+			g_mime_stream_filter_add (filtered, filter);
+			g_object_unref (filter);
+		}
+		
+		if (options != NULL) {
+			filter = g_mime_format_options_create_newline_filter (options, ensure_newline);
+			g_mime_stream_filter_add (filtered, filter);
+			g_object_unref (filter);
+		}
+	}
+	
+	filtered->source = g_object_ref (source);
+	g_mime_stream_construct ((GMimeStream *) filtered, source->bound_start, source->bound_end);
+	
+	return (GMimeStream *) filtered;
+}
+
+
+/**
+ * _g_mime_stream_filter_release_pipeline:
+ * @stream: a pipeline returned by _g_mime_stream_filter_get_pipeline()
+ *
+ * Resets the filters of the pipeline and returns it to the pool of idle
+ * pipelines (or destroys it if the pool is full).
+ **/
+void
+_g_mime_stream_filter_release_pipeline (GMimeStream *stream)
+{
+	GMimeStreamFilter *filtered = (GMimeStreamFilter *) stream;
+	struct _GMimeStreamFilterPrivate *priv = filtered->priv;
+	
+	reset_filters (priv);
+	
+	priv->last_was_read = TRUE;
+	priv->filteredlen = 0;
+	priv->flushed = FALSE;
+	
+	g_object_unref (filtered->source);
+	filtered->source = NULL;
+	
+	PIPELINE_LOCK ();
+	
+	if (pipelines != NULL && pipelines->len < MAX_PIPELINES) {
+		g_ptr_array_add (pipelines, filtered);
+		filtered = NULL;
+	}
+	
+	PIPELINE_UNLOCK ();
+	
+	if (filtered != NULL)
+		g_object_unref (filtered);
+}
@@ -160,6 +160,13 @@ stream_read (GMimeStream *stream, char *buf, size_t len)
 	if (stream->bound_end != -1)
 		len = (size_t) MIN (stream->bound_end - stream->position, (gint64) len);
 	
+#ifdef HAVE_PREAD
+	/* don't depend on the fd's seek position so that substreams
+	 * sharing the fd can be read from different threads */
+	do {
+		nread = pread (fs->fd, buf, len, (off_t) stream->position);
+	} while (nread == -1 && errno == EINTR);
+#else
 	/* make sure we are at the right position */
 	if (lseek (fs->fd, (off_t) stream->position, SEEK_SET) == -1)
 		return -1;
@@ -167,6 +174,7 @@ stream_read (GMimeStream *stream, char *buf, size_t len)
 	do {
 		nread = read (fs->fd, buf, len);
 	} while (nread == -1 && errno == EINTR);
+#endif
 	
 	if (nread > 0) {
 		stream->position += nread;
@@ -791,6 +791,241 @@ g_mime_utils_header_decode_date (const char *str)
 }
 
 
+#define is_date_lwsp(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+#define is_date_digit(c) ((c) >= '0' && (c) <= '9')
+#define date_digit2(p) ((((p)[0] - '0') * 10) + ((p)[1] - '0'))
+
+/* days since 1970-01-01 for the given proleptic Gregorian date */
+static gint64
+date_days_from_civil (int year, int month, int day)
+{
+	int era, yoe, doy, doe;
+	
+	year -= month <= 2;
+	era = year / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	
+	return (gint64) era * 146097 + doe - 719468;
+}
+
+static int
+date_month_from_name (const char *in)
+{
+	const unsigned char *name = (const unsigned char *) in;
+	guint32 key;
+	
+	/* cheap perfect-ish hash: fold the 3 letters to lower case and compare */
+	key = ((name[0] | 0x20) << 16) | ((name[1] | 0x20) << 8) | (name[2] | 0x20);
+	
+	switch (key) {
+	case ('j' << 16) | ('a' << 8) | 'n': return 1;
+	case ('f' << 16) | ('e' << 8) | 'b': return 2;
+	case ('m' << 16) | ('a' << 8) | 'r': return 3;
+	case ('a' << 16) | ('p' << 8) | 'r': return 4;
+	case ('m' << 16) | ('a' << 8) | 'y': return 5;
+	case ('j' << 16) | ('u' << 8) | 'n': return 6;
+	case ('j' << 16) | ('u' << 8) | 'l': return 7;
+	case ('a' << 16) | ('u' << 8) | 'g': return 8;
+	case ('s' << 16) | ('e' << 8) | 'p': return 9;
+	case ('o' << 16) | ('c' << 8) | 't': return 10;
+	case ('n' << 16) | ('o' << 8) | 'v': return 11;
+	case ('d' << 16) | ('e' << 8) | 'c': return 12;
+	default: return -1;
+	}
+}
+
+/* Fixed-format parser for well-formed rfc5322 dates, i.e.
+ * "[Www,] DD Mmm YYYY HH:MM[:SS] [+-HHMM|zone]". Returns FALSE
+ * for anything else so that the caller can fall back to the
+ * tolerant tokenizing parser. */
+static gboolean
+parse_rfc5322_date_fast (const char *str, gint64 *time, int *tz_offset)
+{
+	register const char *inptr = str;
+	int year, month, day, hour, min, sec, tz = 0;
+	int days_in_month, tz_hour, tz_min;
+	const char *word;
+	size_t n;
+	guint t;
+	
+	while (is_date_lwsp (*inptr))
+		inptr++;
+	
+	/* optional day-of-week */
+	if (!is_date_digit (*inptr)) {
+		if (get_wday (inptr, 3) == -1)
+			return FALSE;
+		
+		inptr += 3;
+		if (*inptr == ',')
+			inptr++;
+		else if (!is_date_lwsp (*inptr))
+			return FALSE;
+		
+		while (is_date_lwsp (*inptr))
+			inptr++;
+	}
+	
+	/* day */
+	if (!is_date_digit (inptr[0]))
+		return FALSE;
+	
+	if (is_date_digit (inptr[1])) {
+		day = date_digit2 (inptr);
+		inptr += 2;
+	} else {
+		day = inptr[0] - '0';
+		inptr++;
+	}
+	
+	if (!is_date_lwsp (*inptr))
+		return FALSE;
+	
+	while (is_date_lwsp (*inptr))
+		inptr++;
+	
+	/* month */
+	if (!inptr[0] || !inptr[1] || !inptr[2] || !is_date_lwsp (inptr[3]))
+		return FALSE;
+	
+	if ((month = date_month_from_name (inptr)) == -1)
+		return FALSE;
+	
+	inptr += 3;
+	while (is_date_lwsp (*inptr))
+		inptr++;
+	
+	/* 4-digit year */
+	if (!is_date_digit (inptr[0]) || !is_date_digit (inptr[1]) ||
+	    !is_date_digit (inptr[2]) || !is_date_digit (inptr[3]) ||
+	    !is_date_lwsp (inptr[4]))
+		return FALSE;
+	
+	year = date_digit2 (inptr) * 100 + date_digit2 (inptr + 2);
+	inptr += 4;
+	
+	if (year < 1969)
+		return FALSE;
+	
+	while (is_date_lwsp (*inptr))
+		inptr++;
+	
+	/* HH:MM[:SS] */
+	if (!is_date_digit (inptr[0]) || !is_date_digit (inptr[1]) || inptr[2] != ':' ||
+	    !is_date_digit (inptr[3]) || !is_date_digit (inptr[4]))
+		return FALSE;
+	
+	hour = date_digit2 (inptr);
+	min = date_digit2 (inptr + 3);
+	inptr += 5;
+	
+	if (*inptr == ':') {
+		if (!is_date_digit (inptr[1]) || !is_date_digit (inptr[2]))
+			return FALSE;
+		
+		sec = date_digit2 (inptr + 1);
+		inptr += 3;
+	} else {
+		sec = 0;
+	}
+	
+	if (hour > 23 || min > 59 || sec > 59)
+		return FALSE;
+	
+	days_in_month = month == 2 ? (g_date_is_leap_year (year) ? 29 : 28) : 30 + ((month + (month > 7)) & 1);
+	if (day < 1 || day > days_in_month)
+		return FALSE;
+	
+	/* timezone (optional) */
+	if (*inptr != '\0' && !is_date_lwsp (*inptr))
+		return FALSE;
+	
+	while (is_date_lwsp (*inptr))
+		inptr++;
+	
+	if (*inptr == '+' || *inptr == '-') {
+		if (!is_date_digit (inptr[1]) || !is_date_digit (inptr[2]) ||
+		    !is_date_digit (inptr[3]) || !is_date_digit (inptr[4]))
+			return FALSE;
+		
+		tz_hour = date_digit2 (inptr + 1);
+		tz_min = date_digit2 (inptr + 3);
+		
+		if (tz_hour > 23 || tz_min > 59)
+			return FALSE;
+		
+		tz = tz_hour * 60 + tz_min;
+		if (*inptr == '-')
+			tz = -tz;
+		
+		inptr += 5;
+	} else if (*inptr != '\0') {
+		word = inptr;
+		while (*inptr >= 'A' && *inptr <= 'Z')
+			inptr++;
+		
+		n = (size_t) (inptr - word);
+		
+		for (t = 0; t < G_N_ELEMENTS (tz_offsets); t++) {
+			if (strlen (tz_offsets[t].name) == n && !strncmp (word, tz_offsets[t].name, n))
+				break;
+		}
+		
+		if (t == G_N_ELEMENTS (tz_offsets))
+			return FALSE;
+		
+		tz = (tz_offsets[t].offset / 100) * 60 + (tz_offsets[t].offset % 100);
+	}
+	
+	/* anything after the timezone (e.g. a comment) is ignored */
+	if (*inptr != '\0' && !is_date_lwsp (*inptr))
+		return FALSE;
+	
+	*time = (date_days_from_civil (year, month, day) * 86400) + (hour * 3600) + (min * 60) + sec - (tz * 60);
+	*tz_offset = tz;
+	
+	return TRUE;
+}
+
+
+/**
+ * g_mime_utils_header_decode_date_unix:
+ * @str: input date string
+ * @time: (out): return location for the number of seconds since the Unix epoch
+ * @tz_offset: (out): return location for the timezone offset from UTC, in minutes
+ *
+ * Parses the rfc822 date string into a Unix timestamp and a timezone
+ * offset without allocating any memory for well-formed rfc5322 date
+ * strings. Dates that do not strictly conform are handled by the same
+ * tolerant parser as g_mime_utils_header_decode_date().
+ *
+ * Returns: %TRUE if the date was parsed successfully or %FALSE otherwise.
+ **/
+gboolean
+g_mime_utils_header_decode_date_unix (const char *str, gint64 *time, int *tz_offset)
+{
+	GDateTime *date;
+	
+	g_return_val_if_fail (str != NULL, FALSE);
+	g_return_val_if_fail (time != NULL, FALSE);
+	g_return_val_if_fail (tz_offset != NULL, FALSE);
+	
+	if (parse_rfc5322_date_fast (str, time, tz_offset))
+		return TRUE;
+	
+	if (!(date = g_mime_utils_header_decode_date (str)))
+		return FALSE;
+	
+	*time = g_date_time_to_unix (date);
+	*tz_offset = (int) (g_date_time_get_utc_offset (date) / G_TIME_SPAN_MINUTE);
+	g_date_time_unref (date);
+	
+	return TRUE;
+}
+
+
 /**
  * g_mime_utils_generate_message_id:
  * @fqdn: Fully qualified domain name
@@ -1053,7 +1288,18 @@ g_mime_utils_text_is_8bit (const unsigned char *text, size_t len)
 	g_return_val_if_fail (text != NULL, FALSE);
 	
 	inend = text + len;
-	for (inptr = text; *inptr && inptr < inend; inptr++)
+	inptr = text;
+	
+	if (_g_mime_simd_ascii_span) {
+		unsigned char max;
+		
+		inptr += _g_mime_simd_ascii_span (text, len, &max);
+		
+		/* an 8bit character only counts if there is no nul before it */
+		return inptr < inend && !memchr (text, 0, inptr - text);
+	}
+	
+	for ( ; *inptr && inptr < inend; inptr++)
 		if (*inptr > (unsigned char) 127)
 			return TRUE;
 	
@@ -1079,10 +1325,16 @@ g_mime_utils_best_encoding (const unsigned char *text, size_t len)
 	const unsigned char *ch, *inend;
 	size_t count = 0;
 	
-	inend = text + len;
-	for (ch = text; ch < inend; ch++)
-		if (*ch > (unsigned char) 127)
-			count++;
+	if (_g_mime_simd_count_8bit) {
+		size_t count0 = 0;
+		
+		_g_mime_simd_count_8bit (text, len, &count0, &count);
+	} else {
+		inend = text + len;
+		for (ch = text; ch < inend; ch++)
+			if (*ch > (unsigned char) 127)
+				count++;
+	}
 	
 	if ((float) count <= len * 0.17)
 		return GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE;
@@ -1131,7 +1383,7 @@ charset_convert (iconv_t cd, const char *inbuf, size_t inleft, char **outp, size
 	}
 	
 	do {
-		rc = iconv (cd, (char **) &inbuf, &inleft, &outbuf, &outleft);
+		rc = _g_mime_iconv (cd, (char **) &inbuf, &inleft, &outbuf, &outleft);
 		if (rc == (size_t) -1) {
 			if (errno == EINVAL) {
 				/* incomplete sequence at the end of the input buffer */
@@ -1171,7 +1423,7 @@ charset_convert (iconv_t cd, const char *inbuf, size_t inleft, char **outp, size
 		}
 	} while (inleft > 0);
 	
-	while (iconv (cd, NULL, NULL, &outbuf, &outleft) == (size_t) -1) {
+	while (_g_mime_iconv (cd, NULL, NULL, &outbuf, &outleft) == (size_t) -1) {
 		if (errno != E2BIG)
 			break;
 		
@@ -1227,7 +1479,7 @@ g_mime_utils_decode_8bit (GMimeParserOptions *options, const char *text, size_t
 	out = g_malloc (outleft + 1);
 	
 	for (i = 0; charsets[i]; i++) {
-		if ((cd = g_mime_iconv_open ("UTF-8", charsets[i])) == (iconv_t) -1)
+		if ((cd = _g_mime_iconv_open ("UTF-8", charsets[i])) == (iconv_t) -1)
 			continue;
 		
 		outlen = charset_convert (cd, text, len, &out, &outleft, &ninval);
@@ -1247,7 +1499,7 @@ g_mime_utils_decode_8bit (GMimeParserOptions *options, const char *text, size_t
 	 * try to find the one that fit the best and use that to convert what we can,
 	 * replacing any byte we can't convert with a '?' */
 	
-	if ((cd = g_mime_iconv_open ("UTF-8", best)) == (iconv_t) -1) {
+	if ((cd = _g_mime_iconv_open ("UTF-8", best)) == (iconv_t) -1) {
 		/* this shouldn't happen... but if we are here, then
 		 * it did...  the only thing we can do at this point
 		 * is replace the 8bit garbage and pray */
@@ -1805,22 +2057,20 @@ rfc2047_token_decode (rfc2047_token *token, unsigned char *outbuf, int *state, g
 		return quoted_decode (inbuf, len, outbuf, state, save);
 }
 
-static char *
-rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_t buflen, const char **charset_out)
+static void
+rfc2047_decode_tokens_append (GMimeParserOptions *options, rfc2047_token *tokens, GString *decoded, const char **charset_out)
 {
 	rfc2047_token *token, *next;
 	size_t outlen, ninval, len;
 	unsigned char *outptr;
 	const char *charset;
 	GByteArray *outbuf;
-	GString *decoded;
 	char encoding;
 	guint32 save;
 	iconv_t cd;
 	int state;
 	char *str;
 	
-	decoded = g_string_sized_new (buflen + 1);
 	outbuf = g_byte_array_sized_new (76);
 
 	if (charset_out)
@@ -1883,7 +2133,7 @@ rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_
 				}
 				
 				g_string_append_len (decoded, (char *) outptr, outlen);
-			} else if ((cd = g_mime_iconv_open ("UTF-8", charset)) == (iconv_t) -1) {
+			} else if ((cd = _g_mime_iconv_open ("UTF-8", charset)) == (iconv_t) -1) {
 				w(g_warning ("Cannot convert from %s to UTF-8, header display may "
 					     "be corrupt: %s", charset[0] ? charset : "unspecified charset",
 					     g_strerror (errno)));
@@ -1921,11 +2171,58 @@ rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_
 	}
 	
 	g_byte_array_free (outbuf, TRUE);
+}
+
+static char *
+rfc2047_decode_tokens (GMimeParserOptions *options, rfc2047_token *tokens, size_t buflen, const char **charset_out)
+{
+	GString *decoded;
+	
+	decoded = g_string_sized_new (buflen + 1);
+	rfc2047_decode_tokens_append (options, tokens, decoded, charset_out);
 	
 	return g_string_free (decoded, FALSE);
 }
 
 
+/* Returns %TRUE if @text contains neither 8bit characters nor a
+ * possible "=?" encoded-word marker, in which case both tokenizers
+ * would produce a list of plain tokens that decode to @text itself. */
+static gboolean
+rfc2047_text_is_plain (const char *text, size_t *len)
+{
+	register const unsigned char *inptr = (const unsigned char *) text;
+	const unsigned char *inend;
+	unsigned char max;
+	
+	if (_g_mime_simd_ascii_span) {
+		*len = strlen (text);
+		
+		if (_g_mime_simd_ascii_span ((const unsigned char *) text, *len, &max) < *len)
+			return FALSE;
+		
+		inend = inptr + *len;
+		while ((inptr = memchr (inptr, '=', inend - inptr))) {
+			if (*++inptr == '?')
+				return FALSE;
+		}
+		
+		return TRUE;
+	}
+	
+	while (*inptr) {
+		if (*inptr > 127 || (*inptr == '=' && inptr[1] == '?'))
+			return FALSE;
+		
+		inptr++;
+	}
+	
+	*len = (size_t) (inptr - (const unsigned char *) text);
+	
+	return TRUE;
+}
+
+
 /**
  * _g_mime_utils_header_decode_text:
  * @text: header text to decode
@@ -1952,6 +2249,14 @@ _g_mime_utils_header_decode_text (GMimeParserOptions *options, const char *text,
 		return g_strdup ("");
 	}
 	
+	/* fast path: nothing to decode, so skip tokenizing altogether */
+	if (rfc2047_text_is_plain (text, &len)) {
+		if (charset)
+			*charset = NULL;
+		
+		return g_strndup (text, len);
+	}
+	
 	tokens = tokenize_rfc2047_text (options, text, &len, offset);
 	decoded = rfc2047_decode_tokens (options, tokens, len, charset);
 	rfc2047_token_list_free (tokens);
@@ -1960,6 +2265,140 @@ _g_mime_utils_header_decode_text (GMimeParserOptions *options, const char *text,
 }
 
 
+/* Like rfc2047_text_is_plain(), but for a raw (folded) value where a
+ * "=?" marker may still be split by a line break. */
+static gboolean
+rfc2047_folded_text_is_plain (const char *inptr, const char *inend)
+{
+	const char *start = inptr;
+	unsigned char max;
+	
+	if (_g_mime_simd_ascii_span) {
+		if (_g_mime_simd_ascii_span ((const unsigned char *) inptr, (size_t) (inend - inptr), &max) < (size_t) (inend - inptr))
+			return FALSE;
+	} else {
+		while (inptr < inend) {
+			if (*inptr++ & 0x80)
+				return FALSE;
+		}
+		
+		inptr = start;
+	}
+	
+	while ((inptr = memchr (inptr, '=', inend - inptr))) {
+		inptr++;
+		
+		while (inptr < inend && (*inptr == '\r' || *inptr == '\n'))
+			inptr++;
+		
+		if (inptr < inend && *inptr == '?')
+			return FALSE;
+	}
+	
+	return TRUE;
+}
+
+/**
+ * _g_mime_utils_header_unfold_decode_text_append:
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @value: raw (folded) header value
+ * @charset: (optional): if non-%NULL, this will be set to the charset used in the rfc2047 encoded-word tokens
+ * @offset: header offset, only used for reporting a #GMimeParserWarning
+ * @decoded: the string to append the decoded value to
+ *
+ * Unfolds and decodes an rfc2047 encoded 'text' header value,
+ * appending the UTF-8 result to @decoded.
+ **/
+void
+_g_mime_utils_header_unfold_decode_text_append (GMimeParserOptions *options, const char *value, const char **charset,
+						gint64 offset, GString *decoded)
+{
+	register const char *inptr = value;
+	const char *start, *inend, *eoln;
+	rfc2047_token *tokens;
+	char buf[1024];
+	char *unfolded;
+	size_t len;
+	
+	if (charset)
+		*charset = NULL;
+	
+	while (is_lwsp (*inptr))
+		inptr++;
+	
+	inend = start = inptr;
+	while (*inptr) {
+		if (!is_lwsp (*inptr++))
+			inend = inptr;
+	}
+	
+	if (rfc2047_folded_text_is_plain (start, inend)) {
+		/* nothing to decode: copy the value, minus line breaks, straight into the output */
+		inptr = start;
+		
+		while (inptr < inend) {
+			eoln = inptr;
+			while (eoln < inend && *eoln != '\r' && *eoln != '\n')
+				eoln++;
+			
+			g_string_append_len (decoded, inptr, eoln - inptr);
+			inptr = eoln;
+			
+			while (inptr < inend && (*inptr == '\r' || *inptr == '\n'))
+				inptr++;
+		}
+		
+		return;
+	}
+	
+	/* the tokenizer needs an unfolded, nul-terminated string; avoid
+	 * going to the heap for the scratch copy when we can */
+	len = (size_t) (inend - start);
+	unfolded = len < sizeof (buf) ? buf : g_malloc (len + 1);
+	
+	for (len = 0, inptr = start; inptr < inend; inptr++) {
+		if (*inptr != '\r' && *inptr != '\n')
+			unfolded[len++] = *inptr;
+	}
+	
+	unfolded[len] = '\0';
+	
+	tokens = tokenize_rfc2047_text (options, unfolded, &len, offset);
+	rfc2047_decode_tokens_append (options, tokens, decoded, charset);
+	rfc2047_token_list_free (tokens);
+	
+	if (unfolded != buf)
+		g_free (unfolded);
+}
+
+
+/**
+ * _g_mime_utils_header_unfold_decode_text:
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @value: raw (folded) header value
+ * @charset: (optional): if non-%NULL, this will be set to the charset used in the rfc2047 encoded-word tokens
+ * @offset: header offset, only used for reporting a #GMimeParserWarning
+ *
+ * Unfolds and decodes an rfc2047 encoded 'text' header value in a
+ * single pass. Equivalent to calling g_mime_utils_header_unfold()
+ * followed by _g_mime_utils_header_decode_text(), but without the
+ * intermediate allocation.
+ *
+ * Returns: a newly allocated UTF-8 string representing the the decoded
+ * header.
+ **/
+char *
+_g_mime_utils_header_unfold_decode_text (GMimeParserOptions *options, const char *value, const char **charset, gint64 offset)
+{
+	GString *decoded;
+	
+	decoded = g_string_sized_new (strlen (value) + 1);
+	_g_mime_utils_header_unfold_decode_text_append (options, value, charset, offset, decoded);
+	
+	return g_string_free (decoded, FALSE);
+}
+
+
 /**
  * g_mime_utils_header_decode_text:
  * @text: header text to decode
@@ -2003,6 +2442,14 @@ _g_mime_utils_header_decode_phrase (GMimeParserOptions *options, const char *phr
 		return g_strdup ("");
 	}
 	
+	/* fast path: nothing to decode, so skip tokenizing altogether */
+	if (rfc2047_text_is_plain (phrase, &len)) {
+		if (charset)
+			*charset = NULL;
+		
+		return g_strndup (phrase, len);
+	}
+	
 	tokens = tokenize_rfc2047_phrase (options, phrase, &len, offset);
 	decoded = rfc2047_decode_tokens (options, tokens, len, charset);
 	rfc2047_token_list_free (tokens);
@@ -2067,7 +2514,7 @@ rfc2047_encode_word (GString *string, const char *word, size_t len,
 	char encoding;
 	
 	if (g_ascii_strcasecmp (charset, "UTF-8") != 0)
-		cd = g_mime_iconv_open (charset, "UTF-8");
+		cd = _g_mime_iconv_open (charset, "UTF-8");
 	
 	if (cd != (iconv_t) -1) {
 		uword = g_mime_iconv_strndup (cd, (char *) word, len);
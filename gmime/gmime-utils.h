@@ -32,6 +32,7 @@
 G_BEGIN_DECLS
 
 GDateTime *g_mime_utils_header_decode_date (const char *str);
+gboolean g_mime_utils_header_decode_date_unix (const char *str, gint64 *time, int *tz_offset);
 char *g_mime_utils_header_format_date (GDateTime *date);
 
 char *g_mime_utils_generate_message_id (const char *fqdn);
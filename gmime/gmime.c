@@ -114,9 +114,13 @@ g_mime_init (void)
 	g_type_init ();
 #endif
 	
+	g_mime_simd_init ();
 	g_mime_format_options_init ();
 	g_mime_parser_options_init ();
 	g_mime_charset_map_init ();
+	g_mime_iconv_init ();
+	g_mime_iconv_builtin_init ();
+	g_mime_stream_filter_pipelines_init ();
 	
 #ifdef ENABLE_CRYPTO
 	/* gpgme_check_version() initializes GpgMe */
@@ -171,6 +175,7 @@ g_mime_init (void)
 	
 	g_mime_parser_get_type ();
 	g_mime_message_get_type ();
+	g_mime_message_template_get_type ();
 	g_mime_data_wrapper_get_type ();
 	
 	internet_address_get_type ();
@@ -229,5 +234,9 @@ g_mime_shutdown (void)
 	g_mime_crypto_context_shutdown ();
 	g_mime_format_options_shutdown ();
 	g_mime_parser_options_shutdown ();
+	g_mime_iconv_shutdown ();
+	_internet_address_shutdown ();
+	g_mime_param_cache_shutdown ();
 	g_mime_charset_map_shutdown ();
+	g_mime_stream_filter_pipelines_shutdown ();
 }
@@ -35,6 +35,7 @@
 #include <gmime/gmime-object.h>
 #include <gmime/gmime-part.h>
 #include <gmime/gmime-text-part.h>
+#include <gmime/gmime-part-index.h>
 #include <gmime/gmime-part-iter.h>
 #include <gmime/gmime-application-pkcs7-mime.h>
 #include <gmime/gmime-multipart.h>
@@ -43,11 +44,13 @@
 #include <gmime/gmime-message.h>
 #include <gmime/gmime-message-part.h>
 #include <gmime/gmime-message-partial.h>
+#include <gmime/gmime-message-template.h>
 #include <gmime/internet-address.h>
 #include <gmime/gmime-encodings.h>
 #include <gmime/gmime-format-options.h>
 #include <gmime/gmime-parser-options.h>
 #include <gmime/gmime-parser.h>
+#include <gmime/gmime-part-tree.h>
 #include <gmime/gmime-utils.h>
 #include <gmime/gmime-references.h>
 #include <gmime/gmime-stream.h>
@@ -108,6 +108,131 @@ static void internet_address_finalize (GObject *object);
 static GObjectClass *parent_class = NULL;
 
 
+#ifdef LIBIDN
+/* the maximum number of domains remembered by each of the IDN caches */
+#define IDN_CACHE_SIZE 256
+
+typedef struct {
+	char *domain;
+	char *result;
+} IdnCacheNode;
+
+typedef struct {
+	GHashTable *hash;  /* domain -> GList link in lru */
+	GQueue lru;        /* IdnCacheNode's, most recently used first */
+} IdnCache;
+
+/* domain -> ACE and ACE -> unicode conversions, shared by all mailboxes */
+static IdnCache idn_ascii_cache = { NULL, G_QUEUE_INIT };
+static IdnCache idn_unicode_cache = { NULL, G_QUEUE_INIT };
+
+#ifdef G_THREADS_ENABLED
+static GMutex idn_lock;
+#define IDN_CACHE_UNLOCK() g_mutex_unlock (&idn_lock)
+#define IDN_CACHE_LOCK()   g_mutex_lock (&idn_lock)
+#else
+#define IDN_CACHE_UNLOCK()
+#define IDN_CACHE_LOCK()
+#endif /* G_THREADS_ENABLED */
+
+static void
+idn_cache_node_free (IdnCacheNode *node)
+{
+	g_free (node->domain);
+	g_free (node->result);
+	g_slice_free (IdnCacheNode, node);
+}
+
+static void
+idn_cache_clear (IdnCache *cache)
+{
+	IdnCacheNode *node;
+	
+	while ((node = g_queue_pop_head (&cache->lru)))
+		idn_cache_node_free (node);
+	
+	if (cache->hash != NULL) {
+		g_hash_table_destroy (cache->hash);
+		cache->hash = NULL;
+	}
+}
+
+/* appends the cached conversion of @domain to @str, if there is one */
+static gboolean
+idn_cache_append (IdnCache *cache, const char *domain, GString *str)
+{
+	IdnCacheNode *node;
+	GList *link;
+	
+	IDN_CACHE_LOCK ();
+	
+	if (cache->hash == NULL || !(link = g_hash_table_lookup (cache->hash, domain))) {
+		IDN_CACHE_UNLOCK ();
+		return FALSE;
+	}
+	
+	/* move to the front of the lru */
+	g_queue_unlink (&cache->lru, link);
+	g_queue_push_head_link (&cache->lru, link);
+	
+	node = link->data;
+	g_string_append (str, node->result);
+	
+	IDN_CACHE_UNLOCK ();
+	
+	return TRUE;
+}
+
+static void
+idn_cache_add (IdnCache *cache, const char *domain, const char *result)
+{
+	IdnCacheNode *node;
+	
+	IDN_CACHE_LOCK ();
+	
+	if (cache->hash == NULL)
+		cache->hash = g_hash_table_new (g_str_hash, g_str_equal);
+	
+	/* another thread may have beaten us to it */
+	if (g_hash_table_contains (cache->hash, domain)) {
+		IDN_CACHE_UNLOCK ();
+		return;
+	}
+	
+	node = g_slice_new (IdnCacheNode);
+	node->domain = g_strdup (domain);
+	node->result = g_strdup (result);
+	
+	g_queue_push_head (&cache->lru, node);
+	g_hash_table_insert (cache->hash, node->domain, cache->lru.head);
+	
+	if (cache->lru.length > IDN_CACHE_SIZE) {
+		node = g_queue_pop_tail (&cache->lru);
+		g_hash_table_remove (cache->hash, node->domain);
+		idn_cache_node_free (node);
+	}
+	
+	IDN_CACHE_UNLOCK ();
+}
+#endif /* LIBIDN */
+
+/**
+ * _internet_address_shutdown:
+ *
+ * Frees the IDN conversion caches.
+ **/
+void
+_internet_address_shutdown (void)
+{
+#ifdef LIBIDN
+	IDN_CACHE_LOCK ();
+	idn_cache_clear (&idn_ascii_cache);
+	idn_cache_clear (&idn_unicode_cache);
+	IDN_CACHE_UNLOCK ();
+#endif
+}
+
+
 GType
 internet_address_get_type (void)
 {
@@ -465,17 +590,32 @@ internet_address_mailbox_get_idn_addr (InternetAddressMailbox *mailbox)
 #ifdef LIBIDN
 	if (!mailbox->idn_addr && mailbox->at > 0) {
 		const char *domain = mailbox->addr + mailbox->at + 1;
+		const char *inptr = domain;
+		size_t n;
+		
+		/* an ascii domain is already in its ACE form */
+		while (*inptr && !(*inptr & 0x80))
+			inptr++;
+		
+		if (*inptr == '\0')
+			return mailbox->addr;
 		
 		encoded = g_string_new ("");
 		g_string_append_len (encoded, mailbox->addr, mailbox->at + 1);
-		if (idn2_to_ascii_8z (domain, &ascii, 0) == IDN2_OK) {
-			if (!g_ascii_strcasecmp (domain, ascii))
+		n = encoded->len;
+		
+		if (!idn_cache_append (&idn_ascii_cache, domain, encoded)) {
+			if (idn2_to_ascii_8z (domain, &ascii, 0) == IDN2_OK) {
+				if (!g_ascii_strcasecmp (domain, ascii))
+					g_string_append (encoded, domain);
+				else
+					g_string_append (encoded, ascii);
+				idn2_free (ascii);
+			} else {
 				g_string_append (encoded, domain);
-			else
-				g_string_append (encoded, ascii);
-			idn2_free (ascii);
-		} else {
-			g_string_append (encoded, domain);
+			}
+			
+			idn_cache_add (&idn_ascii_cache, domain, encoded->str + n);
 		}
 		
 		mailbox->idn_addr = g_string_free (encoded, FALSE);
@@ -1551,13 +1691,18 @@ dotatom_parse (GString *str, const char **in, const char *sentinels)
 	
 #ifdef LIBIDN
 	if (domain != str) {
+		size_t n = str->len;
 		char *unicode;
 		
-		if (idn2_to_unicode_8z8z (domain->str, &unicode, 0) == IDN2_OK) {
-			g_string_append (str, unicode);
-			free (unicode);
-		} else {
-			g_string_append_len (str, domain->str, domain->len);
+		if (!idn_cache_append (&idn_unicode_cache, domain->str, str)) {
+			if (idn2_to_unicode_8z8z (domain->str, &unicode, 0) == IDN2_OK) {
+				g_string_append (str, unicode);
+				free (unicode);
+			} else {
+				g_string_append_len (str, domain->str, domain->len);
+			}
+			
+			idn_cache_add (&idn_unicode_cache, domain->str, str->str + n);
 		}
 		
 		g_string_free (domain, TRUE);
@@ -2202,3 +2347,597 @@ internet_address_list_append_parse (InternetAddressList *list, GMimeParserOption
 
 	_internet_address_list_append_parse (list, options, str, -1);
 }
+
+
+static void
+span_scan_name (InternetAddressSpan *span, const char *name, size_t length)
+{
+	register const unsigned char *inptr = (const unsigned char *) name;
+	const unsigned char *inend = inptr + length;
+	
+	span->name = name;
+	span->name_length = length;
+	
+	while (inptr < inend) {
+		if (*inptr == '"' || *inptr == '\\')
+			span->flags |= INTERNET_ADDRESS_SPAN_NAME_QUOTED;
+		else if (*inptr == '=' && inptr + 1 < inend && inptr[1] == '?')
+			span->flags |= INTERNET_ADDRESS_SPAN_NAME_ENCODED;
+		else if (*inptr > 127)
+			span->flags |= INTERNET_ADDRESS_SPAN_NAME_8BIT;
+		
+		inptr++;
+	}
+}
+
+static gboolean
+span_scan_comment_name (InternetAddressSpan *span, const char **in)
+{
+	const char *comment;
+	
+	skip_lwsp (in);
+	
+	if (**in != '(')
+		return TRUE;
+	
+	comment = *in;
+	if (!skip_comment (in))
+		return FALSE;
+	
+	comment++;
+	
+	span_scan_name (span, comment, (size_t) ((*in - 1) - comment));
+	span->flags |= INTERNET_ADDRESS_SPAN_NAME_COMMENT;
+	
+	return TRUE;
+}
+
+static gboolean
+span_scan_route (const char **in)
+{
+	const char *inptr = *in;
+	const char *save;
+	
+	do {
+		inptr++;
+		
+		/* domain */
+		save = inptr;
+		do {
+			skip_cfws (&inptr);
+			
+			if (*inptr == '[') {
+				while (*inptr && *inptr != ']')
+					inptr++;
+				
+				if (*inptr == ']')
+					inptr++;
+			} else if (!skip_atom (&inptr)) {
+				break;
+			}
+			
+			save = inptr;
+			skip_cfws (&inptr);
+			if (*inptr != '.') {
+				inptr = save;
+				break;
+			}
+			
+			inptr++;
+		} while (*inptr);
+		
+		if (save == *in)
+			goto error;
+		
+		skip_cfws (&inptr);
+		if (*inptr == ',') {
+			inptr++;
+			skip_cfws (&inptr);
+			
+			/* obs-domain-lists allow commas with nothing between them... */
+			while (*inptr == ',') {
+				inptr++;
+				skip_cfws (&inptr);
+			}
+		}
+	} while (*inptr == '@');
+	
+	skip_cfws (&inptr);
+	
+	if (*inptr != ':')
+		goto error;
+	
+	*in = inptr;
+	
+	return TRUE;
+	
+ error:
+	while (*inptr && *inptr != ':' && *inptr != '>')
+		inptr++;
+	
+	*in = inptr;
+	
+	return FALSE;
+}
+
+/* span-based equivalent of addrspec_parse() */
+static gboolean
+span_scan_addrspec (InternetAddressSpan *span, const char **in, const char *sentinels)
+{
+	const char *inptr = *in;
+	const char *word, *end;
+	
+	/* local-part */
+	span->local_part = inptr;
+	
+	do {
+		word = inptr;
+		
+		if (!skip_word (&inptr))
+			goto error;
+		
+		if (!g_utf8_validate (word, (size_t) (inptr - word), NULL))
+			goto error;
+		
+		end = inptr;
+		
+		if (!skip_cfws (&inptr))
+			goto error;
+		
+		if (*inptr != '.')
+			break;
+		
+		word = ++inptr;
+		
+		if (!skip_cfws (&inptr))
+			goto error;
+		
+		if (*inptr == '\0')
+			goto error;
+		
+		if (word - 1 != end || inptr != word)
+			span->flags |= INTERNET_ADDRESS_SPAN_ADDR_CFWS;
+	} while (TRUE);
+	
+	span->local_part_length = (size_t) (end - span->local_part);
+	
+	if (*inptr == '\0' || strchr (sentinels, *inptr)) {
+		*in = inptr;
+		return TRUE;
+	}
+	
+	if (*inptr != '@')
+		goto error;
+	
+	inptr++;
+	
+	if (*inptr == '\0')
+		goto error;
+	
+	if (!skip_cfws (&inptr))
+		goto error;
+	
+	if (*inptr == '\0')
+		goto error;
+	
+	/* domain */
+	span->domain = inptr;
+	
+	if (*inptr == '[') {
+		inptr++;
+		
+		if (skip_lwsp (&inptr))
+			span->flags |= INTERNET_ADDRESS_SPAN_ADDR_CFWS;
+		
+		do {
+			while (*inptr && is_dtext (*inptr))
+				inptr++;
+			
+			if (skip_lwsp (&inptr))
+				span->flags |= INTERNET_ADDRESS_SPAN_ADDR_CFWS;
+			
+			if (*inptr == '\0')
+				goto error;
+			
+			if (*inptr == ']')
+				break;
+			
+			if (!is_dtext (*inptr))
+				goto error;
+		} while (TRUE);
+		
+		end = ++inptr;
+	} else {
+		do {
+			if (!is_atom (*inptr))
+				goto error;
+			
+			word = inptr;
+			while (is_atom (*inptr))
+				inptr++;
+			
+			if (!g_utf8_validate (word, (size_t) (inptr - word), NULL))
+				goto error;
+			
+			if (!strncmp (word, "xn--", 4))
+				span->flags |= INTERNET_ADDRESS_SPAN_IDN_DOMAIN;
+			
+			end = inptr;
+			
+			if (!skip_cfws (&inptr))
+				goto error;
+			
+			if (*inptr != '.') {
+				inptr = end;
+				break;
+			}
+			
+			word = ++inptr;
+			
+			if (!skip_cfws (&inptr))
+				goto error;
+			
+			/* allow domains to end with a '.', but strip it off */
+			if (*inptr == '\0' || strchr (sentinels, *inptr))
+				break;
+			
+			if (word - 1 != end || inptr != word)
+				span->flags |= INTERNET_ADDRESS_SPAN_ADDR_CFWS;
+		} while (TRUE);
+	}
+	
+	span->domain_length = (size_t) (end - span->domain);
+	*in = inptr;
+	
+	return TRUE;
+	
+ error:
+	*in = inptr;
+	
+	return FALSE;
+}
+
+/* span-based equivalent of mailbox_parse() */
+static gboolean
+span_scan_angle_addr (InternetAddressScanner *scanner, InternetAddressSpan *span, const char **in)
+{
+	GMimeRfcComplianceMode mode = g_mime_parser_options_get_address_compliance_mode (scanner->options);
+	const char *inptr = *in;
+	
+	/* skip over the '<' */
+	inptr++;
+	
+	if (*inptr == '<') {
+		if (mode != GMIME_RFC_COMPLIANCE_LOOSE)
+			goto error;
+		
+		do {
+			inptr++;
+		} while (*inptr == '<');
+	}
+	
+	if (*inptr == '\0')
+		goto error;
+	
+	if (!skip_cfws (&inptr))
+		goto error;
+	
+	if (*inptr == '@') {
+		if (!span_scan_route (&inptr))
+			goto error;
+		
+		inptr++;
+		
+		if (!skip_cfws (&inptr))
+			goto error;
+	}
+	
+	if (!span_scan_addrspec (span, &inptr, COMMA_GREATER_THAN_OR_SEMICOLON))
+		goto error;
+	
+	if (!skip_cfws (&inptr))
+		goto error;
+	
+	if (*inptr != '>') {
+		if (mode != GMIME_RFC_COMPLIANCE_LOOSE)
+			goto error;
+	} else {
+		inptr++;
+		
+		if (*inptr == '>') {
+			if (mode != GMIME_RFC_COMPLIANCE_LOOSE)
+				goto error;
+			
+			do {
+				inptr++;
+			} while (*inptr == '>');
+		}
+	}
+	
+	*in = inptr;
+	
+	return TRUE;
+	
+ error:
+	*in = inptr;
+	
+	return FALSE;
+}
+
+/* span-based equivalent of address_parse() */
+static gboolean
+span_scan_address (InternetAddressScanner *scanner, InternetAddressSpan *span, const char **in)
+{
+	GMimeRfcComplianceMode mode = g_mime_parser_options_get_address_compliance_mode (scanner->options);
+	int min_words = g_mime_parser_options_get_allow_addresses_without_domain (scanner->options) ? 1 : 0;
+	gboolean trim_leading_quote = FALSE;
+	const char *inptr = *in;
+	const char *start, *end;
+	size_t length;
+	int words = 0;
+	
+	memset (span, 0, sizeof (InternetAddressSpan));
+	span->group_depth = scanner->depth;
+	
+	if (!skip_cfws (&inptr) || *inptr == '\0')
+		goto error;
+	
+	/* keep track of the start & length of the phrase */
+	start = inptr;
+	length = 0;
+	
+	while (*inptr) {
+		if (mode != GMIME_RFC_COMPLIANCE_LOOSE) {
+			if (!skip_word (&inptr))
+				break;
+		} else if (*inptr == '"') {
+			const char *qstring = inptr;
+			
+			if (!skip_quoted (&inptr)) {
+				inptr = qstring + 1;
+				
+				skip_lwsp (&inptr);
+				
+				if (!skip_atom (&inptr))
+					break;
+				
+				if (start == qstring)
+					trim_leading_quote = TRUE;
+			}
+		} else {
+			if (!skip_atom (&inptr))
+				break;
+		}
+		
+		length = (size_t) (inptr - start);
+		
+		do {
+			if (!skip_cfws (&inptr))
+				goto error;
+			
+			/* Note: some clients don't quote dots in the name */
+			if (*inptr != '.')
+				break;
+			
+			inptr++;
+			
+			length = (size_t) (inptr - start);
+		} while (TRUE);
+		
+		words++;
+		
+		/* Note: some clients don't quote commas in the name */
+		if (*inptr == ',' && words > min_words) {
+			inptr++;
+			
+			length = (size_t) (inptr - start);
+			
+			if (!skip_cfws (&inptr))
+				goto error;
+		}
+	}
+	
+	if (!skip_cfws (&inptr))
+		goto error;
+	
+	if (*inptr == '\0' || *inptr == ',' || *inptr == '>' || *inptr == ';') {
+		/* an addr-spec w/o a domain */
+		char sentinels[2] = { *inptr != '\0' ? *inptr : ',', 0 };
+		
+		inptr = start;
+		
+		if (!span_scan_addrspec (span, &inptr, sentinels))
+			goto error;
+		
+		if (!span_scan_comment_name (span, &inptr))
+			goto error;
+		
+		if (*inptr == '>') {
+			if (mode != GMIME_RFC_COMPLIANCE_LOOSE)
+				goto error;
+			
+			inptr++;
+		}
+		
+		*in = inptr;
+		
+		return TRUE;
+	}
+	
+	if (*inptr == ':') {
+		/* rfc2822 group address */
+		if (trim_leading_quote) {
+			start++;
+			length--;
+		}
+		
+		if (length > 0)
+			span_scan_name (span, start, length);
+		
+		span->flags |= INTERNET_ADDRESS_SPAN_GROUP;
+		
+		/* skip over the ':' and any superfluous colons (and whitespace) */
+		do {
+			inptr++;
+		} while (*inptr == ':' || is_lwsp (*inptr));
+		
+		scanner->depth++;
+		*in = inptr;
+		
+		return TRUE;
+	}
+	
+	if (*inptr == '@') {
+		/* rewind back to the beginning of the local-part */
+		inptr = start;
+		
+		if (!span_scan_addrspec (span, &inptr, COMMA_GREATER_THAN_OR_SEMICOLON))
+			goto error;
+		
+		if (!span_scan_comment_name (span, &inptr))
+			goto error;
+		
+		if (!skip_cfws (&inptr))
+			goto error;
+		
+		if (*inptr != '<') {
+			if (*inptr == '>') {
+				if (mode != GMIME_RFC_COMPLIANCE_LOOSE)
+					goto error;
+				
+				inptr++;
+			}
+			
+			*in = inptr;
+			
+			return TRUE;
+		}
+		
+		/* We have an address like "user@example.com <user@example.com>"; i.e. the name
+		 * is an unquoted string with an '@'. */
+		if (mode != GMIME_RFC_COMPLIANCE_LOOSE)
+			goto error;
+		
+		end = inptr;
+		while (end > start && is_lwsp (*(end - 1)))
+			end--;
+		
+		memset (span, 0, sizeof (InternetAddressSpan));
+		span->group_depth = scanner->depth;
+		length = (size_t) (end - start);
+	}
+	
+	if (*inptr == '<') {
+		/* rfc2822 angle-addr token */
+		if (trim_leading_quote) {
+			start++;
+			length--;
+		}
+		
+		if (length > 0)
+			span_scan_name (span, start, length);
+		
+		if (!span_scan_angle_addr (scanner, span, &inptr))
+			goto error;
+		
+		*in = inptr;
+		
+		return TRUE;
+	}
+	
+ error:
+	*in = inptr;
+	
+	return FALSE;
+}
+
+
+/**
+ * internet_address_scanner_init:
+ * @scanner: an #InternetAddressScanner
+ * @options: (nullable): a #GMimeParserOptions or %NULL
+ * @str: a string containing internet addresses
+ *
+ * Initializes @scanner to iterate over the addresses in @str. The
+ * scanner does not copy @str, so it must remain valid for as long
+ * as the scanner and the spans it yields are in use.
+ **/
+void
+internet_address_scanner_init (InternetAddressScanner *scanner, GMimeParserOptions *options, const char *str)
+{
+	g_return_if_fail (scanner != NULL);
+	g_return_if_fail (str != NULL);
+	
+	scanner->options = options;
+	scanner->inptr = str;
+	scanner->depth = 0;
+}
+
+
+/**
+ * internet_address_scanner_next:
+ * @scanner: an #InternetAddressScanner
+ * @span: (out): the address span
+ *
+ * Scans the next address, filling in @span with slices of the input
+ * string. Unlike internet_address_list_parse(), nothing is allocated
+ * or decoded; @span's flags indicate which of the slices still need
+ * unquoting, rfc2047 decoding, comment removal or IDN decoding in order
+ * to get the same values that an #InternetAddress would have.
+ *
+ * Groups are flattened: the group name is yielded as a span with the
+ * %INTERNET_ADDRESS_SPAN_GROUP flag set, followed by its members whose
+ * group depth is one greater. Addresses that cannot be parsed are
+ * skipped, just like internet_address_list_parse() would.
+ *
+ * Returns: %TRUE if an address was scanned or %FALSE if there are no
+ * more addresses.
+ **/
+gboolean
+internet_address_scanner_next (InternetAddressScanner *scanner, InternetAddressSpan *span)
+{
+	const char *inptr;
+	
+	g_return_val_if_fail (scanner != NULL, FALSE);
+	g_return_val_if_fail (span != NULL, FALSE);
+	
+	inptr = scanner->inptr;
+	
+	do {
+		/* skip over any null addresses between commas */
+		do {
+			if (!skip_cfws (&inptr)) {
+				scanner->inptr = inptr;
+				return FALSE;
+			}
+			
+			if (*inptr != ',')
+				break;
+			
+			inptr++;
+		} while (TRUE);
+		
+		if (scanner->depth > 0 && *inptr == ';') {
+			/* end of the current group */
+			scanner->depth--;
+			inptr++;
+			continue;
+		}
+		
+		if (*inptr == '\0')
+			break;
+		
+		if (span_scan_address (scanner, span, &inptr)) {
+			scanner->inptr = inptr;
+			return TRUE;
+		}
+		
+		/* skip this address... */
+		while (*inptr && *inptr != ',' && (scanner->depth == 0 || *inptr != ';'))
+			inptr++;
+	} while (*inptr);
+	
+	scanner->inptr = inptr;
+	
+	return FALSE;
+}
@@ -216,6 +216,71 @@ void internet_address_list_encode (InternetAddressList *list, GMimeFormatOptions
 InternetAddressList *internet_address_list_parse (GMimeParserOptions *options, const char *str);
 void internet_address_list_append_parse (InternetAddressList *list, GMimeParserOptions *options, const char *str);
 
+
+/**
+ * InternetAddressSpanFlags:
+ * @INTERNET_ADDRESS_SPAN_GROUP: The span is the name of a group rather than a mailbox.
+ * @INTERNET_ADDRESS_SPAN_NAME_QUOTED: The name contains quoted-strings or quoted-pairs that need unquoting.
+ * @INTERNET_ADDRESS_SPAN_NAME_ENCODED: The name may contain rfc2047 encoded-words.
+ * @INTERNET_ADDRESS_SPAN_NAME_8BIT: The name contains raw 8bit text.
+ * @INTERNET_ADDRESS_SPAN_NAME_COMMENT: The name was taken from a trailing comment.
+ * @INTERNET_ADDRESS_SPAN_ADDR_CFWS: The local-part or domain contain comments or whitespace that need to be removed.
+ * @INTERNET_ADDRESS_SPAN_IDN_DOMAIN: The domain contains IDNA-encoded ("xn--") labels.
+ *
+ * Flags describing what needs to be done to an #InternetAddressSpan in
+ * order to materialize it.
+ **/
+typedef enum {
+	INTERNET_ADDRESS_SPAN_GROUP        = 1 << 0,
+	INTERNET_ADDRESS_SPAN_NAME_QUOTED  = 1 << 1,
+	INTERNET_ADDRESS_SPAN_NAME_ENCODED = 1 << 2,
+	INTERNET_ADDRESS_SPAN_NAME_8BIT    = 1 << 3,
+	INTERNET_ADDRESS_SPAN_NAME_COMMENT = 1 << 4,
+	INTERNET_ADDRESS_SPAN_ADDR_CFWS    = 1 << 5,
+	INTERNET_ADDRESS_SPAN_IDN_DOMAIN   = 1 << 6
+} InternetAddressSpanFlags;
+
+/**
+ * InternetAddressSpan:
+ * @name: the start of the raw display name (or group name) or %NULL
+ * @name_length: the length of the raw display name
+ * @local_part: the start of the raw local-part or %NULL for groups
+ * @local_part_length: the length of the raw local-part
+ * @domain: the start of the raw domain or %NULL if there is none
+ * @domain_length: the length of the raw domain
+ * @group_depth: the number of groups enclosing this address
+ * @flags: a bitfield of #InternetAddressSpanFlags
+ *
+ * A single address yielded by an #InternetAddressScanner. All of the
+ * strings point into the scanned input and are not nul-terminated.
+ **/
+typedef struct {
+	const char *name;
+	size_t name_length;
+	const char *local_part;
+	size_t local_part_length;
+	const char *domain;
+	size_t domain_length;
+	int group_depth;
+	InternetAddressSpanFlags flags;
+} InternetAddressSpan;
+
+/**
+ * InternetAddressScanner:
+ *
+ * A low-level, allocation-free iterator over the addresses in an
+ * address-list header value.
+ **/
+typedef struct {
+	/* < private > */
+	GMimeParserOptions *options;
+	const char *inptr;
+	int depth;
+} InternetAddressScanner;
+
+void internet_address_scanner_init (InternetAddressScanner *scanner, GMimeParserOptions *options, const char *str);
+gboolean internet_address_scanner_next (InternetAddressScanner *scanner, InternetAddressSpan *span);
+
 G_END_DECLS
 
 #endif /* __INTERNET_ADDRESS_H__ */
@@ -504,12 +504,421 @@ error:
 	g_byte_array_free (actual, TRUE);
 }
 
+static GByteArray *
+encoding_step_chunked (GMimeEncoding *state, const char *input, size_t len, size_t chunk)
+{
+	GByteArray *output = g_byte_array_new ();
+	size_t n, nout, offset;
+	
+	while (len > 0) {
+		n = MIN (len, chunk);
+		
+		offset = output->len;
+		g_byte_array_set_size (output, offset + g_mime_encoding_outlen (state, n));
+		nout = g_mime_encoding_step (state, input, n, (char *) output->data + offset);
+		g_byte_array_set_size (output, offset + nout);
+		
+		input += n;
+		len -= n;
+	}
+	
+	return output;
+}
+
+static void
+encoding_flush (GMimeEncoding *state, GByteArray *output)
+{
+	size_t offset = output->len;
+	size_t nout;
+	
+	g_byte_array_set_size (output, offset + g_mime_encoding_outlen (state, 0));
+	nout = g_mime_encoding_flush (state, NULL, 0, (char *) output->data + offset);
+	g_byte_array_set_size (output, offset + nout);
+}
+
+static void
+test_step_parity (GMimeContentEncoding encoding, gboolean encode, const char *what, const char *input, size_t len)
+{
+	const char *name = g_mime_content_encoding_to_string (encoding);
+	static const size_t chunks[] = { 4096, 1024, 77, 33, 16 };
+	GByteArray *expected, *actual = NULL;
+	GMimeEncoding reference, state;
+	guint32 refsave;
+	int refstate;
+	guint i;
+	
+	testsuite_check ("%s %s parity (%s)", name, encode ? "encoder" : "decoder", what);
+	
+	/* single bytes are never handed off to the vectorized kernels */
+	if (encode)
+		g_mime_encoding_init_encode (&reference, encoding);
+	else
+		g_mime_encoding_init_decode (&reference, encoding);
+	expected = encoding_step_chunked (&reference, input, len, 1);
+	refstate = reference.state;
+	refsave = reference.save;
+	encoding_flush (&reference, expected);
+	
+	for (i = 0; i <= G_N_ELEMENTS (chunks); i++) {
+		size_t chunk = i < G_N_ELEMENTS (chunks) ? chunks[i] : len;
+		
+		if (encode)
+			g_mime_encoding_init_encode (&state, encoding);
+		else
+			g_mime_encoding_init_decode (&state, encoding);
+		actual = encoding_step_chunked (&state, input, len, chunk);
+		
+		if (state.state != refstate || state.save != refsave) {
+			testsuite_check_failed ("%s failed: buffer-size=%zu: state does not match", what, chunk);
+			goto error;
+		}
+		
+		encoding_flush (&state, actual);
+		
+		if (actual->len != expected->len) {
+			testsuite_check_failed ("%s failed: buffer-size=%zu: lengths do not match: expected=%u; actual=%u",
+						what, chunk, expected->len, actual->len);
+			goto error;
+		}
+		
+		if (memcmp (actual->data, expected->data, actual->len) != 0) {
+			testsuite_check_failed ("%s failed: buffer-size=%zu: content does not match", what, chunk);
+			goto error;
+		}
+		
+		g_byte_array_free (actual, TRUE);
+		actual = NULL;
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	if (actual != NULL)
+		g_byte_array_free (actual, TRUE);
+	g_byte_array_free (expected, TRUE);
+}
+
+static void
+test_base64_parity (GByteArray *random)
+{
+	GMimeEncoding encoder;
+	GByteArray *encoded;
+	GString *str;
+	guint i, j;
+	
+	test_step_parity (GMIME_CONTENT_ENCODING_BASE64, TRUE, "random", (const char *) random->data, random->len);
+	
+	g_mime_encoding_init_encode (&encoder, GMIME_CONTENT_ENCODING_BASE64);
+	encoded = encoding_step_chunked (&encoder, (const char *) random->data, random->len, random->len);
+	test_step_parity (GMIME_CONTENT_ENCODING_BASE64, FALSE, "random", (const char *) encoded->data, encoded->len);
+	
+	/* same thing with CRLF line endings */
+	str = g_string_new ("");
+	for (i = 0; i < encoded->len; i++) {
+		if (encoded->data[i] == '\n')
+			g_string_append_c (str, '\r');
+		g_string_append_c (str, encoded->data[i]);
+	}
+	
+	test_step_parity (GMIME_CONTENT_ENCODING_BASE64, FALSE, "crlf", str->str, str->len);
+	
+	/* every possible byte value at every position of a 32-byte block */
+	g_string_truncate (str, 0);
+	for (i = 0; i < 256; i++) {
+		for (j = 0; j < 32; j++) {
+			g_string_append_len (str, (const char *) encoded->data + ((i * 32 + j) * 7) % 4096, 40);
+			g_string_insert_c (str, str->len - 40 + j, (char) i);
+		}
+	}
+	
+	test_step_parity (GMIME_CONTENT_ENCODING_BASE64, FALSE, "garbage", str->str, str->len);
+	
+	g_byte_array_free (encoded, TRUE);
+	g_string_free (str, TRUE);
+}
+
+static void
+test_quoted_printable_parity (GByteArray *wikipedia, GByteArray *random)
+{
+	static const char *tokens[] = {
+		"word", "Quoted", "printable", "=", " ", "  ", "\t", " \n", "\t\r\n", "\n", "\r\n", "\r",
+		"caf\xc3\xa9", "\x01", "\xff", "=20", "=\n", "a-very-long-token-that-pushes-the-line-past-seventy-six-columns"
+	};
+	GMimeEncoding encoder;
+	GByteArray *encoded;
+	GString *str;
+	guint i;
+	
+	test_step_parity (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, TRUE, "wikipedia", (const char *) wikipedia->data, wikipedia->len);
+	test_step_parity (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, TRUE, "random", (const char *) random->data, 256 * 1024);
+	
+	/* text with lots of the cases the encoder has to special-case */
+	str = g_string_new ("");
+	for (i = 0; i < 256 * 1024; i++) {
+		guint8 r = random->data[i];
+		
+		if (r < 128)
+			g_string_append (str, tokens[r % 3]);
+		else
+			g_string_append (str, tokens[r % G_N_ELEMENTS (tokens)]);
+	}
+	
+	test_step_parity (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, TRUE, "mixed", str->str, str->len);
+	
+	g_mime_encoding_init_encode (&encoder, GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE);
+	encoded = encoding_step_chunked (&encoder, str->str, str->len, str->len);
+	encoding_flush (&encoder, encoded);
+	
+	test_step_parity (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, FALSE, "encoded", (const char *) encoded->data, encoded->len);
+	test_step_parity (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, FALSE, "mixed", str->str, str->len);
+	
+	g_byte_array_free (encoded, TRUE);
+	g_string_free (str, TRUE);
+}
+
+static void
+test_throughput (GMimeContentEncoding encoding, GByteArray *random)
+{
+	const char *name = g_mime_content_encoding_to_string (encoding);
+	GByteArray *encoded, *decoded;
+	gint64 start, encode, decode;
+	GMimeEncoding state;
+	double mb;
+	
+	testsuite_check ("%s throughput", name);
+	
+	mb = random->len / (1024.0 * 1024.0);
+	
+	start = g_get_monotonic_time ();
+	g_mime_encoding_init_encode (&state, encoding);
+	encoded = encoding_step_chunked (&state, (const char *) random->data, random->len, 65536);
+	encoding_flush (&state, encoded);
+	encode = MAX (g_get_monotonic_time () - start, 1);
+	
+	start = g_get_monotonic_time ();
+	g_mime_encoding_init_decode (&state, encoding);
+	decoded = encoding_step_chunked (&state, (const char *) encoded->data, encoded->len, 65536);
+	encoding_flush (&state, decoded);
+	decode = MAX (g_get_monotonic_time () - start, 1);
+	
+	v(fprintf (stdout, "%s: encode %.1f MB/s, decode %.1f MB/s\n", name,
+		   mb / (encode / 1000000.0), mb / (decode / 1000000.0)));
+	
+	if (decoded->len != random->len || memcmp (decoded->data, random->data, random->len) != 0)
+		testsuite_check_failed ("%s throughput failed: round trip does not match", name);
+	else
+		testsuite_check_passed ();
+	
+	g_byte_array_free (encoded, TRUE);
+	g_byte_array_free (decoded, TRUE);
+}
+
+typedef struct {
+	int state;
+	guint32 pcrc;
+	guint32 crc;
+} YencState;
+
+static GByteArray *
+yenc_step_chunked (gboolean encode, const unsigned char *input, size_t len, size_t chunk, YencState *ys)
+{
+	GByteArray *output = g_byte_array_new ();
+	size_t n, outlen;
+	guint8 *outbuf;
+	
+	outbuf = g_malloc ((chunk + 2) * 2 + 62);
+	
+	while (len > 0) {
+		n = MIN (chunk, len);
+		
+		if (encode)
+			outlen = g_mime_yencode_step (input, n, outbuf, &ys->state, &ys->pcrc, &ys->crc);
+		else
+			outlen = g_mime_ydecode_step (input, n, outbuf, &ys->state, &ys->pcrc, &ys->crc);
+		
+		g_byte_array_append (output, outbuf, outlen);
+		input += n;
+		len -= n;
+	}
+	
+	g_free (outbuf);
+	
+	return output;
+}
+
+static void
+yenc_state_init (gboolean encode, YencState *ys)
+{
+	ys->state = encode ? GMIME_YENCODE_STATE_INIT : GMIME_YDECODE_STATE_INIT;
+	ys->pcrc = GMIME_YENCODE_CRC_INIT;
+	ys->crc = GMIME_YENCODE_CRC_INIT;
+}
+
+static void
+test_yenc_step_parity (gboolean encode, const char *what, const unsigned char *input, size_t len)
+{
+	static const size_t chunks[] = { 4096, 1024, 77, 33, 16 };
+	GByteArray *expected, *actual = NULL;
+	YencState reference, ys;
+	guint i;
+	
+	testsuite_check ("yEnc %s parity (%s)", encode ? "encoder" : "decoder", what);
+	
+	/* single bytes are never handed off to the vectorized kernels */
+	yenc_state_init (encode, &reference);
+	expected = yenc_step_chunked (encode, input, len, 1, &reference);
+	
+	for (i = 0; i <= G_N_ELEMENTS (chunks); i++) {
+		size_t chunk = i < G_N_ELEMENTS (chunks) ? chunks[i] : len;
+		
+		yenc_state_init (encode, &ys);
+		actual = yenc_step_chunked (encode, input, len, chunk, &ys);
+		
+		if (ys.state != reference.state) {
+			testsuite_check_failed ("%s failed: buffer-size=%zu: state does not match", what, chunk);
+			goto error;
+		}
+		
+		if (ys.pcrc != reference.pcrc || ys.crc != reference.crc) {
+			testsuite_check_failed ("%s failed: buffer-size=%zu: crc does not match: expected=%08x; actual=%08x",
+						what, chunk, GMIME_YENCODE_CRC_FINAL (reference.crc),
+						GMIME_YENCODE_CRC_FINAL (ys.crc));
+			goto error;
+		}
+		
+		if (actual->len != expected->len) {
+			testsuite_check_failed ("%s failed: buffer-size=%zu: lengths do not match: expected=%u; actual=%u",
+						what, chunk, expected->len, actual->len);
+			goto error;
+		}
+		
+		if (memcmp (actual->data, expected->data, actual->len) != 0) {
+			testsuite_check_failed ("%s failed: buffer-size=%zu: content does not match", what, chunk);
+			goto error;
+		}
+		
+		g_byte_array_free (actual, TRUE);
+		actual = NULL;
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	if (actual != NULL)
+		g_byte_array_free (actual, TRUE);
+	g_byte_array_free (expected, TRUE);
+}
+
+static void
+test_yenc_crc (GByteArray *random)
+{
+	guint32 crc = GMIME_YENCODE_CRC_INIT;
+	guint32 expected = 0xffffffff;
+	unsigned char outbuf[1024];
+	int state = 0;
+	size_t i;
+	int j;
+	
+	testsuite_check ("yEnc crc32");
+	
+	/* compare against a bitwise implementation of CRC-32 */
+	for (i = 0; i < random->len; i++) {
+		expected ^= random->data[i];
+		for (j = 0; j < 8; j++)
+			expected = (expected >> 1) ^ (0xedb88320 & -(expected & 1));
+	}
+	
+	for (i = 0; i < random->len; i += 256) {
+		guint32 pcrc = GMIME_YENCODE_CRC_INIT;
+		
+		g_mime_yencode_step (random->data + i, MIN (256, random->len - i), outbuf, &state, &pcrc, &crc);
+	}
+	
+	if (GMIME_YENCODE_CRC_FINAL (crc) != ~expected)
+		testsuite_check_failed ("yEnc crc32 failed: expected=%08x; actual=%08x", ~expected, GMIME_YENCODE_CRC_FINAL (crc));
+	else
+		testsuite_check_passed ();
+}
+
+static void
+test_yenc (GByteArray *random)
+{
+	GByteArray *encoded, *decoded;
+	gint64 start, encode, decode;
+	YencState ys;
+	GString *str;
+	guint i, j;
+	double mb;
+	
+	test_yenc_crc (random);
+	
+	test_yenc_step_parity (TRUE, "random", random->data, random->len);
+	
+	yenc_state_init (TRUE, &ys);
+	encoded = yenc_step_chunked (TRUE, random->data, random->len, 65536, &ys);
+	test_yenc_step_parity (FALSE, "random", encoded->data, encoded->len);
+	
+	/* same thing with CRLF line endings and a =yend trailer */
+	str = g_string_new ("");
+	for (i = 0; i < encoded->len; i++) {
+		if (encoded->data[i] == '\n')
+			g_string_append_c (str, '\r');
+		g_string_append_c (str, encoded->data[i]);
+	}
+	g_string_append (str, "\r\n=yend size=4194311\r\n");
+	
+	test_yenc_step_parity (FALSE, "crlf", (const unsigned char *) str->str, str->len);
+	
+	/* escapes and line breaks at every position of a 32-byte block */
+	g_string_truncate (str, 0);
+	for (i = 0; i < 256; i++) {
+		static const char specials[] = "=\n==\n=\n\n";
+		
+		for (j = 0; j < 32; j++) {
+			g_string_append_len (str, (const char *) encoded->data + ((i * 32 + j) * 7) % 4096, 40);
+			g_string_insert_len (str, str->len - 40 + j, specials + (i % 7), 1 + (i / 7) % 2);
+		}
+	}
+	
+	test_yenc_step_parity (FALSE, "escapes", (const unsigned char *) str->str, str->len);
+	
+	g_string_free (str, TRUE);
+	
+	testsuite_check ("yEnc throughput");
+	
+	mb = random->len / (1024.0 * 1024.0);
+	
+	start = g_get_monotonic_time ();
+	yenc_state_init (TRUE, &ys);
+	g_byte_array_free (encoded, TRUE);
+	encoded = yenc_step_chunked (TRUE, random->data, random->len, 65536, &ys);
+	encode = MAX (g_get_monotonic_time () - start, 1);
+	
+	start = g_get_monotonic_time ();
+	yenc_state_init (FALSE, &ys);
+	decoded = yenc_step_chunked (FALSE, encoded->data, encoded->len, 65536, &ys);
+	decode = MAX (g_get_monotonic_time () - start, 1);
+	
+	v(fprintf (stdout, "yEnc: encode %.1f MB/s, decode %.1f MB/s\n",
+		   mb / (encode / 1000000.0), mb / (decode / 1000000.0)));
+	
+	if (decoded->len != random->len || memcmp (decoded->data, random->data, random->len) != 0)
+		testsuite_check_failed ("yEnc throughput failed: round trip does not match");
+	else
+		testsuite_check_passed ();
+	
+	g_byte_array_free (encoded, TRUE);
+	g_byte_array_free (decoded, TRUE);
+}
+
 int main (int argc, char **argv)
 {
 	const char *datadir = "data/encodings";
 	GByteArray *photo, *b64, *uu;
 	GByteArray *wikipedia, *qp;
+	GByteArray *random, *text;
 	struct stat st;
+	GRand *rand;
 	char *path;
 	int i;
 	
@@ -547,6 +956,17 @@ int main (int argc, char **argv)
 	qp = read_all_bytes (path, TRUE);
 	g_free (path);
 	
+	rand = g_rand_new_with_seed (1234);
+	random = g_byte_array_new ();
+	g_byte_array_set_size (random, 4 * 1024 * 1024 + 7);
+	for (i = 0; i < (int) random->len; i++)
+		random->data[i] = (guint8) g_rand_int (rand);
+	g_rand_free (rand);
+	
+	text = g_byte_array_new ();
+	while (text->len < 4 * 1024 * 1024)
+		g_byte_array_append (text, wikipedia->data, wikipedia->len);
+	
 	testsuite_start ("Content-Transfer-Encoding");
 	test_content_encoding_mappings ();
 	testsuite_end ();
@@ -561,6 +981,8 @@ int main (int argc, char **argv)
 	test_decoder (GMIME_CONTENT_ENCODING_BASE64, b64, photo, 1024);
 	test_decoder (GMIME_CONTENT_ENCODING_BASE64, b64, photo, 16);
 	test_decoder (GMIME_CONTENT_ENCODING_BASE64, b64, photo, 1);
+	test_base64_parity (random);
+	test_throughput (GMIME_CONTENT_ENCODING_BASE64, random);
 	testsuite_end ();
 	
 	testsuite_start ("uuencode");
@@ -588,6 +1010,12 @@ int main (int argc, char **argv)
 	test_decoder (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, qp, wikipedia, 1024);
 	test_decoder (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, qp, wikipedia, 16);
 	test_decoder (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, qp, wikipedia, 1);
+	test_quoted_printable_parity (wikipedia, random);
+	test_throughput (GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, text);
+	testsuite_end ();
+	
+	testsuite_start ("yEnc");
+	test_yenc (random);
 	testsuite_end ();
 	
 	g_byte_array_free (wikipedia, TRUE);
@@ -595,6 +1023,8 @@ int main (int argc, char **argv)
 	g_byte_array_free (b64, TRUE);
 	g_byte_array_free (uu, TRUE);
 	g_byte_array_free (qp, TRUE);
+	g_byte_array_free (random, TRUE);
+	g_byte_array_free (text, TRUE);
 	
 	g_mime_shutdown ();
 	
@@ -156,6 +156,103 @@ error:
 	g_byte_array_free (actual, TRUE);
 }
 
+static void
+test_fused_decode (const char *datadir, const char *base, const char *charset, GMimeContentEncoding encoding, gboolean inc)
+{
+	const char *what = "fused decode";
+	GMimeStream *istream, *ostream, *filtered, *onebyte;
+	GByteArray *encoded, *actual, *expected;
+	GMimeFilter *filter;
+	char *path, *name;
+	
+	testsuite_check ("%s (%s %s -> utf-8 -> LF, %s%s)", what, g_mime_content_encoding_to_string (encoding),
+			 charset ? charset : "utf-8", base, inc ? ", one byte at a time" : "");
+	
+	/* encode the text with CRLF line endings */
+	encoded = g_byte_array_new ();
+	ostream = g_mime_stream_mem_new_with_byte_array (encoded);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) ostream, FALSE);
+	filtered = g_mime_stream_filter_new (ostream);
+	g_object_unref (ostream);
+	
+	filter = g_mime_filter_unix2dos_new (FALSE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	filter = g_mime_filter_basic_new (encoding, TRUE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	name = g_strdup_printf ("%s.%s.txt", base, charset ? charset : "utf-8");
+	path = g_build_filename (datadir, name, NULL);
+	istream = g_mime_stream_fs_open (path, O_RDONLY, 0644, NULL);
+	g_mime_stream_write_to_stream (istream, filtered);
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	g_object_unref (istream);
+	g_free (path);
+	g_free (name);
+	
+	/* decode it again using a filter chain that GMimeStreamFilter fuses */
+	actual = g_byte_array_new ();
+	ostream = g_mime_stream_mem_new_with_byte_array (actual);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) ostream, FALSE);
+	filtered = g_mime_stream_filter_new (ostream);
+	g_object_unref (ostream);
+	
+	filter = g_mime_filter_basic_new (encoding, FALSE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	if (charset != NULL) {
+		filter = g_mime_filter_charset_new (charset, "utf-8");
+		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+		g_object_unref (filter);
+	}
+	
+	filter = g_mime_filter_dos2unix_new (FALSE);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	if (inc) {
+		onebyte = test_stream_onebyte_new (filtered);
+		g_object_unref (filtered);
+	} else {
+		onebyte = filtered;
+	}
+	
+	istream = g_mime_stream_mem_new_with_buffer ((const char *) encoded->data, encoded->len);
+	g_mime_stream_write_to_stream (istream, onebyte);
+	g_mime_stream_flush (onebyte);
+	g_object_unref (onebyte);
+	g_object_unref (istream);
+	
+	name = g_strdup_printf ("%s.utf-8.txt", base);
+	path = g_build_filename (datadir, name, NULL);
+	expected = read_all_bytes (path, TRUE);
+	g_free (path);
+	g_free (name);
+	
+	if (actual->len != expected->len) {
+		testsuite_check_failed ("%s failed: stream lengths do not match: expected=%u; actual=%u",
+					what, expected->len, actual->len);
+		goto error;
+	}
+	
+	if (memcmp (actual->data, expected->data, actual->len) != 0) {
+		testsuite_check_failed ("%s failed: stream contents do not match", what);
+		goto error;
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	
+	g_byte_array_free (expected, TRUE);
+	g_byte_array_free (encoded, TRUE);
+	g_byte_array_free (actual, TRUE);
+}
+
 static void
 test_enriched (const char *datadir, const char *input, const char *output)
 {
@@ -381,6 +478,93 @@ error:
 	g_byte_array_free (actual, TRUE);
 }
 
+static GMimeStream *
+long_lines_stream_new (GMimeStream *source, gboolean dos2unix)
+{
+	GMimeStream *filtered;
+	GMimeFilter *filter;
+	
+	filtered = g_mime_stream_filter_new (source);
+	
+	if (dos2unix) {
+		filter = g_mime_filter_dos2unix_new (FALSE);
+		g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+		g_object_unref (filter);
+	}
+	
+	filter = g_mime_filter_html_new (GMIME_FILTER_HTML_CONVERT_NL | GMIME_FILTER_HTML_CONVERT_SPACES, 0);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	return filtered;
+}
+
+static void
+test_long_backlog (gboolean dos2unix)
+{
+	const char *what = "GMimeStreamFilter";
+	GByteArray *expected, *actual;
+	GMimeStream *stream, *filtered;
+	GString *input;
+	char buf[1000];
+	ssize_t nread;
+	int i;
+	
+	testsuite_check ("%s long backlog (%s)", what, dos2unix ? "dos2unix + html" : "html");
+	
+	/* lines much longer than both the read padding and the filter
+	 * prespace force the html filter to back up more data than
+	 * there is room for in front of its input */
+	input = g_string_new ("");
+	for (i = 0; i < 4000; i++)
+		g_string_append_printf (input, "word%d%s", i, (i % 700) == 699 ? "\r\n" : " ");
+	
+	/* write all of the input at once so that nothing gets backed up */
+	expected = g_byte_array_new ();
+	stream = g_mime_stream_mem_new_with_byte_array (expected);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) stream, FALSE);
+	filtered = long_lines_stream_new (stream, dos2unix);
+	g_object_unref (stream);
+	
+	g_mime_stream_write (filtered, input->str, input->len);
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	
+	/* now read it back in chunks */
+	actual = g_byte_array_new ();
+	stream = g_mime_stream_mem_new_with_buffer (input->str, input->len);
+	filtered = long_lines_stream_new (stream, dos2unix);
+	g_object_unref (stream);
+	
+	while (!g_mime_stream_eos (filtered)) {
+		if ((nread = g_mime_stream_read (filtered, buf, sizeof (buf))) < 0)
+			break;
+		
+		g_byte_array_append (actual, (guint8 *) buf, nread);
+	}
+	
+	g_object_unref (filtered);
+	
+	if (actual->len != expected->len) {
+		testsuite_check_failed ("%s failed: stream lengths do not match: expected=%u; actual=%u",
+					what, expected->len, actual->len);
+		goto error;
+	}
+	
+	if (memcmp (actual->data, expected->data, actual->len) != 0) {
+		testsuite_check_failed ("%s failed: stream contents do not match", what);
+		goto error;
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	
+	g_string_free (input, TRUE);
+	g_byte_array_free (expected, TRUE);
+	g_byte_array_free (actual, TRUE);
+}
+
 static void
 test_smtp_data (const char *datadir, const char *input, const char *output)
 {
@@ -504,6 +688,13 @@ int main (int argc, char **argv)
 	test_charset_conversion (datadir, "japanese", "utf-8", "shift-jis");
 	test_charset_conversion (datadir, "japanese", "shift-jis", "utf-8");
 	
+	test_fused_decode (datadir, "japanese", "shift-jis", GMIME_CONTENT_ENCODING_BASE64, FALSE);
+	test_fused_decode (datadir, "japanese", "shift-jis", GMIME_CONTENT_ENCODING_BASE64, TRUE);
+	test_fused_decode (datadir, "japanese", "shift-jis", GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, TRUE);
+	test_fused_decode (datadir, "cyrillic", "koi8-r", GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, FALSE);
+	test_fused_decode (datadir, "chinese", NULL, GMIME_CONTENT_ENCODING_BASE64, TRUE);
+	test_fused_decode (datadir, "chinese", NULL, GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE, TRUE);
+	
 	test_enriched (datadir, "enriched.txt", "enriched.html");
 	
 	test_gzip (datadir, "lorem-ipsum.txt");
@@ -513,6 +704,9 @@ int main (int argc, char **argv)
 	test_html (datadir, "html-input.txt", "html-output.mark.html", GMIME_FILTER_HTML_MARK_CITATION);
 	test_html (datadir, "html-input.txt", "html-output.cite.html", GMIME_FILTER_HTML_CITE);
 	
+	test_long_backlog (FALSE);
+	test_long_backlog (TRUE);
+	
 	test_smtp_data (datadir, "smtp-input.txt", "smtp-output.txt");
 	
 	test_windows (datadir, "french-fable.cp1252.txt", "iso-8859-1", "windows-cp1252");
@@ -597,6 +597,283 @@ test_header_formatting (void)
 	g_object_unref (list);
 }
 
+static const char lazy_address_message[] =
+	"From: Sender <sender@example.com>\n"
+	"To: First <first@example.com>\n"
+	"Cc: one@example.com, two@example.com, three@example.com\n"
+	"Subject: lazy addresses\n"
+	"\n"
+	"body\n";
+
+static void
+test_lazy_addresses (void)
+{
+	InternetAddressList *to, *cc, *bcc;
+	GMimeMessage *message;
+	GMimeParser *parser;
+	GMimeStream *stream;
+	GMimeObject *object;
+	InternetAddress *ia;
+	
+	stream = g_mime_stream_mem_new_with_buffer (lazy_address_message, sizeof (lazy_address_message) - 1);
+	parser = g_mime_parser_new_with_stream (stream);
+	g_object_unref (stream);
+	
+	message = g_mime_parser_construct_message (parser, NULL);
+	object = (GMimeObject *) message;
+	g_object_unref (parser);
+	
+	testsuite_check ("lazily parsed address lists");
+	try {
+		/* modify the Cc header before the list has ever been requested */
+		g_mime_object_append_header (object, "Cc", "four@example.com", NULL);
+		
+		cc = g_mime_message_get_cc (message);
+		if (internet_address_list_length (cc) != 4)
+			throw (exception_new ("unexpected number of Cc addresses: %d", internet_address_list_length (cc)));
+		
+		ia = internet_address_list_get_address (cc, 3);
+		if (strcmp ("four@example.com", internet_address_mailbox_get_addr ((InternetAddressMailbox *) ia)) != 0)
+			throw (exception_new ("unexpected Cc address after appending a header"));
+		
+		/* once handed out, a list must track header changes */
+		to = g_mime_message_get_to (message);
+		if (internet_address_list_length (to) != 1)
+			throw (exception_new ("unexpected number of To addresses"));
+		
+		g_mime_object_append_header (object, "To", "Second <second@example.com>", NULL);
+		if (internet_address_list_length (to) != 2)
+			throw (exception_new ("To list not updated after appending a header"));
+		
+		g_mime_object_remove_header (object, "Cc");
+		if (internet_address_list_length (cc) != 1)
+			throw (exception_new ("Cc list not updated after removing a header: %d", internet_address_list_length (cc)));
+		
+		/* a list with no headers at all */
+		bcc = g_mime_message_get_bcc (message);
+		if (bcc == NULL || internet_address_list_length (bcc) != 0)
+			throw (exception_new ("unexpected Bcc list"));
+		
+		/* and the header is written back when a lazily parsed list is modified */
+		g_mime_object_set_header (object, "Bcc", "hidden@example.com", NULL);
+		g_mime_message_add_mailbox (message, GMIME_ADDRESS_TYPE_BCC, NULL, "also-hidden@example.com");
+		if (internet_address_list_length (bcc) != 2)
+			throw (exception_new ("unexpected number of Bcc addresses"));
+		
+		if (strcmp ("hidden@example.com, also-hidden@example.com", g_mime_object_get_header (object, "Bcc")) != 0)
+			throw (exception_new ("unexpected Bcc header: %s", g_mime_object_get_header (object, "Bcc")));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("lazily parsed address lists: %s", ex->message);
+	} finally;
+	
+	g_object_unref (message);
+}
+
+static void
+test_batched_updates (void)
+{
+	GMimeObject *object, *part;
+	InternetAddressList *to, *cc;
+	GMimeMessage *message;
+	const char *value;
+	char *addr;
+	int i;
+	
+	message = g_mime_message_new (TRUE);
+	object = (GMimeObject *) message;
+	
+	part = (GMimeObject *) g_mime_text_part_new ();
+	g_mime_message_set_mime_part (message, part);
+	g_object_unref (part);
+	
+	testsuite_check ("batched address list updates");
+	try {
+		to = g_mime_message_get_to (message);
+		
+		g_mime_object_begin_update (object);
+		g_mime_object_begin_update (object);
+		
+		for (i = 0; i < 200; i++) {
+			addr = g_strdup_printf ("user%d@example.com", i);
+			g_mime_message_add_mailbox (message, GMIME_ADDRESS_TYPE_TO, NULL, addr);
+			g_free (addr);
+		}
+		
+		if (g_mime_object_get_header (object, "To") != NULL)
+			throw (exception_new ("To header was synced in the middle of a batch"));
+		
+		g_mime_object_end_update (object);
+		
+		if (g_mime_object_get_header (object, "To") != NULL)
+			throw (exception_new ("To header was synced by a nested end_update"));
+		
+		g_mime_object_end_update (object);
+		
+		if (!(value = g_mime_object_get_header (object, "To")))
+			throw (exception_new ("To header was not synced when the batch was committed"));
+		
+		if (strncmp (value, "user0@example.com, user1@example.com, ", 38) != 0 || !strstr (value, "user199@example.com"))
+			throw (exception_new ("unexpected To header: %s", value));
+		
+		if (internet_address_list_length (to) != 200)
+			throw (exception_new ("unexpected number of To addresses: %d", internet_address_list_length (to)));
+		
+		/* header changes made to an exposed list are applied on commit */
+		g_mime_object_begin_update (object);
+		g_mime_object_set_header (object, "To", "one@example.com, two@example.com", NULL);
+		
+		if (internet_address_list_length (to) != 200)
+			throw (exception_new ("To list was reparsed in the middle of a batch"));
+		
+		g_mime_object_end_update (object);
+		
+		if (internet_address_list_length (to) != 2)
+			throw (exception_new ("To list was not reparsed when the batch was committed"));
+		
+		/* the last change wins */
+		cc = g_mime_message_get_cc (message);
+		g_mime_object_begin_update (object);
+		g_mime_message_add_mailbox (message, GMIME_ADDRESS_TYPE_CC, NULL, "list@example.com");
+		g_mime_object_set_header (object, "Cc", "header@example.com", NULL);
+		g_mime_object_end_update (object);
+		
+		if (internet_address_list_length (cc) != 1 || strcmp (g_mime_object_get_header (object, "Cc"), "header@example.com") != 0)
+			throw (exception_new ("Cc list does not match the header that was set last"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("batched address list updates: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("batched content-type updates");
+	try {
+		g_mime_object_begin_update (part);
+		g_mime_object_set_content_type_parameter (part, "charset", "iso-8859-1");
+		g_mime_object_set_content_type_parameter (part, "format", "flowed");
+		g_mime_object_set_disposition (part, "attachment");
+		g_mime_object_set_content_disposition_parameter (part, "filename", "body.txt");
+		
+		value = g_mime_object_get_header (part, "Content-Type");
+		if (value != NULL && strstr (value, "flowed") != NULL)
+			throw (exception_new ("Content-Type header was synced in the middle of a batch"));
+		
+		g_mime_object_end_update (part);
+		
+		value = g_mime_object_get_header (part, "Content-Type");
+		if (!value || strcmp (value, "text/plain; charset=iso-8859-1; format=flowed") != 0)
+			throw (exception_new ("unexpected Content-Type header: %s", value ? value : "(null)"));
+		
+		value = g_mime_object_get_header (part, "Content-Disposition");
+		if (!value || strcmp (value, "attachment; filename=body.txt") != 0)
+			throw (exception_new ("unexpected Content-Disposition header: %s", value ? value : "(null)"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("batched content-type updates: %s", ex->message);
+	} finally;
+	
+	g_object_unref (message);
+}
+
+static const char decode_values_message[] =
+	"From: \"Joe\" =?iso-8859-1?q?M=FCller?= <joe@example.com>\r\n"
+	"To: list@example.com\r\n"
+	"Subject: a plain subject that has been\r\n"
+	"\tfolded over   \r\n"
+	"  several lines  \r\n"
+	"X-Encoded: =?utf-8?b?SGVsbG8=?=\r\n"
+	" =?utf-8?b?IHdvcmxk?= and =?iso-8859-1?q?caf=E9?=\r\n"
+	"X-Latin1: d\xe9j\xe0 vu\r\n"
+	"X-Almost: a=b ?= =? =?bogus\r\n"
+	"X-Empty: \r\n"
+	"Message-Id: <decode.values@example.com>\r\n"
+	"\r\n"
+	"body\r\n";
+
+static void
+test_decode_values (void)
+{
+	GMimeMessage *message = NULL;
+	GMimeHeaderList *list;
+	GMimeParser *parser;
+	GMimeStream *stream;
+	GMimeHeader *header;
+	char **values = NULL;
+	char *unfolded, *expected;
+	int count, i;
+	
+	stream = g_mime_stream_mem_new_with_buffer (decode_values_message, sizeof (decode_values_message) - 1);
+	parser = g_mime_parser_new_with_stream (stream);
+	g_object_unref (stream);
+	
+	message = g_mime_parser_construct_message (parser, NULL);
+	g_object_unref (parser);
+	
+	testsuite_check ("decode values");
+	try {
+		if (message == NULL)
+			throw (exception_new ("failed to parse message"));
+		
+		list = g_mime_object_get_header_list ((GMimeObject *) message);
+		count = g_mime_header_list_get_count (list);
+		
+		values = g_mime_header_list_decode_values (list);
+		
+		for (i = 0; i < count; i++) {
+			header = g_mime_header_list_get_header_at (list, i);
+			
+			if (values[i] == NULL)
+				throw (exception_new ("missing value for %s", g_mime_header_get_name (header)));
+			
+			unfolded = g_mime_utils_header_unfold (g_mime_header_get_raw_value (header));
+			expected = g_mime_utils_header_decode_text (NULL, unfolded);
+			g_free (unfolded);
+			
+			if (strcmp (expected, values[i]) != 0) {
+				Exception *ex;
+				
+				ex = exception_new ("%s: batch value does not match: actual=\"%s\", expected=\"%s\"",
+						    g_mime_header_get_name (header), values[i], expected);
+				g_free (expected);
+				throw (ex);
+			}
+			
+			if (strcmp (expected, g_mime_header_get_value (header)) != 0) {
+				Exception *ex;
+				
+				ex = exception_new ("%s: value does not match: actual=\"%s\", expected=\"%s\"",
+						    g_mime_header_get_name (header), g_mime_header_get_value (header), expected);
+				g_free (expected);
+				throw (ex);
+			}
+			
+			g_free (expected);
+		}
+		
+		if (values[count] != NULL)
+			throw (exception_new ("value vector is not NULL-terminated"));
+		
+		if (strcmp (values[0], "\"Joe\" M\xc3\xbcller <joe@example.com>") != 0)
+			throw (exception_new ("unexpected From value: %s", values[0]));
+		
+		if (strcmp (values[2], "a plain subject that has been\tfolded over     several lines") != 0)
+			throw (exception_new ("unexpected Subject value: %s", values[2]));
+		
+		if (strcmp (values[3], "Hello world and caf\xc3\xa9") != 0)
+			throw (exception_new ("unexpected X-Encoded value: %s", values[3]));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("decode values: %s", ex->message);
+	} finally;
+	
+	if (message)
+		g_object_unref (message);
+	g_free (values);
+}
+
 int main (int argc, char **argv)
 {
 	g_mime_init ();
@@ -619,12 +896,18 @@ int main (int argc, char **argv)
 	test_content_type_sync ();
 	test_disposition_sync ();
 	test_address_sync ();
+	test_lazy_addresses ();
+	test_batched_updates ();
 	testsuite_end ();
 	
 	testsuite_start ("header formatting");
 	test_header_formatting ();
 	testsuite_end ();
 	
+	testsuite_start ("header value decoding");
+	test_decode_values ();
+	testsuite_end ();
+	
 	g_mime_shutdown ();
 	
 	return testsuite_exit ();
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include <gmime/gmime.h>
 
@@ -132,6 +133,465 @@ test_utils (void)
 	testsuite_end ();
 }
 
+static void
+test_charset_best (void)
+{
+	const char *padding = "The quick brown fox jumps over the lazy dog. 0123456789 {|}~";
+	GMimeCharset charset, expected;
+	const char *inptr, *next;
+	GString *text;
+	char *utf8;
+	iconv_t cd;
+	int i, j;
+	
+	testsuite_start ("charset detection");
+	
+	text = g_string_new ("");
+	
+	for (i = 0; i < G_N_ELEMENTS (tests); i++) {
+		testsuite_check ("test #%d: best charset for %s text", i, tests[i].charset);
+		
+		try {
+			if ((cd = g_mime_iconv_open ("UTF-8", tests[i].charset)) == (iconv_t) -1) {
+				throw (exception_new ("could not open conversion for %s to UTF-8",
+						      tests[i].charset));
+			}
+			
+			utf8 = g_mime_iconv_strdup (cd, tests[i].text);
+			g_mime_iconv_close (cd);
+			
+			if (utf8 == NULL) {
+				throw (exception_new ("could not convert \"%s\" from %s to UTF-8",
+						      tests[i].text, tests[i].charset));
+			}
+			
+			/* surround the text with long runs of 7-bit characters */
+			g_string_assign (text, padding);
+			g_string_append (text, utf8);
+			g_string_append (text, padding);
+			g_string_append (text, utf8);
+			if (i & 1)
+				g_string_append_c (text, '\x7f');
+			g_free (utf8);
+			
+			/* stepping 1 character at a time never skips over a run */
+			g_mime_charset_init (&expected);
+			for (inptr = text->str; *inptr; inptr = next) {
+				next = g_utf8_next_char (inptr);
+				g_mime_charset_step (&expected, inptr, next - inptr);
+			}
+			
+			g_mime_charset_init (&charset);
+			g_mime_charset_step (&charset, text->str, text->len);
+			
+			if (charset.mask != expected.mask || charset.level != expected.level) {
+				throw (exception_new ("charset masks do not match: expected %08x/%d, got %08x/%d",
+						      expected.mask, expected.level, charset.mask, charset.level));
+			}
+			
+			testsuite_check_passed ();
+		} catch (ex) {
+			testsuite_check_failed ("test #%d failed: %s", i, ex->message);
+		} finally;
+	}
+	
+	testsuite_check ("8bit text detection");
+	
+	try {
+		GMimeContentEncoding encoding;
+		size_t count, len;
+		gboolean is8bit;
+		int nul, hi;
+		
+		for (len = 0; len < 80; len++) {
+			for (hi = -1; hi < (int) len; hi++) {
+				for (nul = -1; nul < (int) len; nul += 7) {
+					g_string_truncate (text, 0);
+					for (j = 0; j < (int) len; j++)
+						g_string_append_c (text, (char) (j == hi ? 0xe0 : j == nul ? 0 : 'a' + (j % 26)));
+					
+					/* nul-bytes terminate the text (the 8bit char wins if they collide) */
+					is8bit = hi != -1 && (nul == -1 || hi <= nul);
+					
+					if (g_mime_utils_text_is_8bit ((unsigned char *) text->str, len) != is8bit) {
+						throw (exception_new ("len=%zu, 8bit=%d, nul=%d: expected %s",
+								      len, hi, nul, is8bit ? "TRUE" : "FALSE"));
+					}
+				}
+			}
+			
+			for (hi = 1; hi < 10; hi++) {
+				g_string_truncate (text, 0);
+				for (j = 0, count = 0; j < (int) len; j++) {
+					if ((j % hi) == 0) {
+						g_string_append_c (text, (char) 0xe0);
+						count++;
+					} else {
+						g_string_append_c (text, 'a' + (j % 26));
+					}
+				}
+				
+				if ((float) count <= len * 0.17)
+					encoding = GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE;
+				else
+					encoding = GMIME_CONTENT_ENCODING_BASE64;
+				
+				if (g_mime_utils_best_encoding ((unsigned char *) text->str, len) != encoding) {
+					throw (exception_new ("len=%zu, 8bit=%zu: expected %s", len, count,
+							      g_mime_content_encoding_to_string (encoding)));
+				}
+			}
+		}
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("8bit text detection failed: %s", ex->message);
+	} finally;
+	
+	g_string_free (text, TRUE);
+	
+	testsuite_end ();
+}
+
+static void
+test_iconv_cache (void)
+{
+	guint hits, misses, hits0, misses0;
+	iconv_t cd, cd2;
+	char *str;
+	
+	testsuite_start ("iconv descriptor cache");
+	
+	testsuite_check ("closed descriptors are reused");
+	try {
+		g_mime_iconv_get_cache_stats (&hits0, &misses0);
+		
+		if ((cd = g_mime_iconv_open ("iso-2022-jp", "UTF-8")) == (iconv_t) -1)
+			throw (exception_new ("could not open conversion from UTF-8 to iso-2022-jp"));
+		
+		/* while checked out, a descriptor must not be handed out again */
+		if ((cd2 = g_mime_iconv_open ("iso-2022-jp", "UTF-8")) == (iconv_t) -1) {
+			g_mime_iconv_close (cd);
+			throw (exception_new ("could not open a second conversion from UTF-8 to iso-2022-jp"));
+		}
+		
+		if (cd2 == cd) {
+			g_mime_iconv_close (cd);
+			throw (exception_new ("descriptor handed out twice"));
+		}
+		
+		g_mime_iconv_close (cd2);
+		g_mime_iconv_close (cd);
+		
+		g_mime_iconv_get_cache_stats (&hits, &misses);
+		if (misses != misses0 + 2 || hits != hits0)
+			throw (exception_new ("expected 2 misses and 0 hits, got %u and %u", misses - misses0, hits - hits0));
+		
+		/* the most recently closed descriptor should be reused first */
+		if ((cd2 = g_mime_iconv_open ("iso-2022-jp", "utf-8")) != cd) {
+			if (cd2 != (iconv_t) -1)
+				g_mime_iconv_close (cd2);
+			throw (exception_new ("cached descriptor was not reused"));
+		}
+		
+		g_mime_iconv_close (cd2);
+		
+		g_mime_iconv_get_cache_stats (&hits, &misses);
+		if (misses != misses0 + 2 || hits != hits0 + 1)
+			throw (exception_new ("expected 2 misses and 1 hit, got %u and %u", misses - misses0, hits - hits0));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("closed descriptors are reused: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("cached descriptors are reset");
+	try {
+		char inbuf[] = "\xe6\x97\xa5\xe6\x9c\xac";
+		char outbuf[64], *outptr, *inptr;
+		size_t inleft, outleft;
+		
+		if ((cd = g_mime_iconv_open ("iso-2022-jp", "UTF-8")) == (iconv_t) -1)
+			throw (exception_new ("could not open conversion from UTF-8 to iso-2022-jp"));
+		
+		/* leave the descriptor in the JIS X 0208 shift state */
+		inptr = inbuf;
+		inleft = strlen (inptr);
+		outptr = outbuf;
+		outleft = sizeof (outbuf);
+		g_mime_iconv (cd, &inptr, &inleft, &outptr, &outleft);
+		g_mime_iconv_close (cd);
+		
+		cd = g_mime_iconv_open ("iso-2022-jp", "UTF-8");
+		str = g_mime_iconv_strdup (cd, "abc");
+		g_mime_iconv_close (cd);
+		
+		if (str == NULL || strcmp (str, "abc") != 0) {
+			g_free (str);
+			throw (exception_new ("conversion state was not reset"));
+		}
+		
+		g_free (str);
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("cached descriptors are reset: %s", ex->message);
+	} finally;
+	
+	testsuite_end ();
+}
+
+/* converts @inbuf using the system iconv, skipping over invalid input
+ * the same way GMimeFilterCharset does */
+static GByteArray *
+iconv_reference (const char *to, const char *from, const char *inbuf, size_t inlen)
+{
+	GByteArray *output = g_byte_array_new ();
+	char outbuf[4096], *outptr;
+	char *inptr = (char *) inbuf;
+	size_t inleft = inlen;
+	size_t outleft, rc;
+	iconv_t cd;
+	
+	cd = g_mime_iconv_open (to, from);
+	
+	while (inleft > 0) {
+		outptr = outbuf;
+		outleft = sizeof (outbuf);
+		rc = g_mime_iconv (cd, &inptr, &inleft, &outptr, &outleft);
+		g_byte_array_append (output, (guint8 *) outbuf, outptr - outbuf);
+		
+		if (rc == (size_t) -1) {
+			if (errno == EINVAL)
+				break;
+			
+			if (errno == EILSEQ) {
+				inleft--;
+				inptr++;
+			}
+		}
+	}
+	
+	g_mime_iconv_close (cd);
+	
+	return output;
+}
+
+static GByteArray *
+filter_convert (const char *to, const char *from, const char *inbuf, size_t inlen, size_t chunk)
+{
+	GMimeStream *stream, *filtered;
+	GByteArray *output;
+	GMimeFilter *filter;
+	size_t n;
+	
+	output = g_byte_array_new ();
+	stream = g_mime_stream_mem_new_with_byte_array (output);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) stream, FALSE);
+	filtered = g_mime_stream_filter_new (stream);
+	g_object_unref (stream);
+	
+	filter = g_mime_filter_charset_new (from, to);
+	g_mime_stream_filter_add ((GMimeStreamFilter *) filtered, filter);
+	g_object_unref (filter);
+	
+	while (inlen > 0) {
+		n = MIN (chunk, inlen);
+		g_mime_stream_write (filtered, inbuf, n);
+		inbuf += n;
+		inlen -= n;
+	}
+	
+	g_mime_stream_flush (filtered);
+	g_object_unref (filtered);
+	
+	return output;
+}
+
+static void
+test_builtin_converters (void)
+{
+	static const char *charsets[] = {
+		"us-ascii", "iso-8859-1", "iso-8859-15", "windows-1251", "windows-1252", "koi8-r", "UTF-8"
+	};
+	static const size_t chunks[] = { 4096, 7, 1 };
+	GByteArray *expected, *actual, *utf8;
+	GString *input;
+	char *str;
+	guint i, j;
+	
+	testsuite_start ("built-in charset converters");
+	
+	input = g_string_new ("");
+	
+	for (i = 0; i < G_N_ELEMENTS (charsets); i++) {
+		testsuite_check ("%s", charsets[i]);
+		
+		try {
+			/* every byte value, surrounded by some plain text */
+			g_string_truncate (input, 0);
+			for (j = 0; j < 256; j++) {
+				g_string_append (input, "The quick brown fox ");
+				g_string_append_c (input, (char) j);
+			}
+			
+			/* plus some (possibly truncated) UTF-8 sequences */
+			g_string_append (input, "\xc3\xa9\xe2\x82\xac\xd0\x96\xe2\x99\xa5\xf0\x9f\x98\x80\xed\xa0\x80\xe2\x82");
+			
+			expected = iconv_reference ("UTF-8", charsets[i], input->str, input->len);
+			
+			for (j = 0; j < G_N_ELEMENTS (chunks); j++) {
+				actual = filter_convert ("UTF-8", charsets[i], input->str, input->len, chunks[j]);
+				
+				if (actual->len != expected->len || memcmp (actual->data, expected->data, actual->len) != 0) {
+					g_byte_array_free (expected, TRUE);
+					g_byte_array_free (actual, TRUE);
+					
+					throw (exception_new ("conversion to UTF-8 does not match iconv (buffer-size=%zu)", chunks[j]));
+				}
+				
+				g_byte_array_free (actual, TRUE);
+			}
+			
+			/* now convert the UTF-8 back along with some characters not in the charset */
+			utf8 = expected;
+			g_byte_array_append (utf8, (guint8 *) "\xc3\xa9\xe2\x82\xac\xd0\x96\xe2\x99\xa5\xc3", 11);
+			
+			expected = iconv_reference (charsets[i], "UTF-8", (char *) utf8->data, utf8->len);
+			
+			for (j = 0; j < G_N_ELEMENTS (chunks); j++) {
+				actual = filter_convert (charsets[i], "UTF-8", (char *) utf8->data, utf8->len, chunks[j]);
+				
+				if (actual->len != expected->len || memcmp (actual->data, expected->data, actual->len) != 0) {
+					g_byte_array_free (expected, TRUE);
+					g_byte_array_free (actual, TRUE);
+					g_byte_array_free (utf8, TRUE);
+					
+					throw (exception_new ("conversion from UTF-8 does not match iconv (buffer-size=%zu)", chunks[j]));
+				}
+				
+				g_byte_array_free (actual, TRUE);
+			}
+			
+			g_byte_array_free (expected, TRUE);
+			g_byte_array_free (utf8, TRUE);
+			
+			testsuite_check_passed ();
+		} catch (ex) {
+			testsuite_check_failed ("%s failed: %s", charsets[i], ex->message);
+		} finally;
+	}
+	
+	testsuite_check ("g_mime_utils_decode_8bit");
+	try {
+		GMimeParserOptions *options = g_mime_parser_options_new ();
+		const char *fallback[] = { "UTF-8", "windows-1252", NULL };
+		
+		g_mime_parser_options_set_fallback_charsets (options, fallback);
+		
+		str = g_mime_utils_decode_8bit (options, "Caf\xc3\xa9", 5);
+		if (strcmp (str, "Caf\xc3\xa9") != 0) {
+			g_free (str);
+			g_mime_parser_options_free (options);
+			throw (exception_new ("UTF-8 text was not preserved"));
+		}
+		g_free (str);
+		
+		str = g_mime_utils_decode_8bit (options, "\x93" "Caf\xe9\x94 \x80", 8);
+		g_mime_parser_options_free (options);
+		
+		if (strcmp (str, "\xe2\x80\x9c" "Caf\xc3\xa9\xe2\x80\x9d \xe2\x82\xac") != 0) {
+			g_free (str);
+			throw (exception_new ("windows-1252 text was not converted"));
+		}
+		g_free (str);
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("g_mime_utils_decode_8bit failed: %s", ex->message);
+	} finally;
+	
+	g_string_free (input, TRUE);
+	
+	testsuite_end ();
+}
+
+static const char *charset_names[] = {
+	"utf-8", "UTF8", "iso-8859-1", "ISO_8859-15", "iso8859-2", "windows-1252", "Windows-CP1251",
+	"microsoft-cp1250", "koi8-r", "ks_c_5601-1987", "gb2312", "shift_jis", "sjis", "iso-2022-jp",
+	"iso-10646-1", "big5", "x-user-defined", "ANSI_X3.4-1968"
+};
+
+static gpointer
+resolve_charset_names (gpointer user_data)
+{
+	const char **expected = user_data;
+	char name[64];
+	guint i, j;
+	
+	for (i = 0; i < 2000; i++) {
+		for (j = 0; j < G_N_ELEMENTS (charset_names); j++) {
+			if (g_mime_charset_iconv_name (charset_names[j]) != expected[j])
+				return GINT_TO_POINTER (FALSE);
+		}
+		
+		/* names that have not been seen before */
+		g_snprintf (name, sizeof (name), "x-charset-%p-%u", (void *) name, i % 300);
+		if (strcmp (g_mime_charset_iconv_name (name), name) != 0)
+			return GINT_TO_POINTER (FALSE);
+	}
+	
+	return GINT_TO_POINTER (TRUE);
+}
+
+static void
+test_charset_names (void)
+{
+	const char *expected[G_N_ELEMENTS (charset_names)];
+	GThread *threads[8];
+	gboolean success;
+	guint i;
+	
+	testsuite_start ("charset name resolution");
+	
+	testsuite_check ("iconv names");
+	try {
+		for (i = 0; i < G_N_ELEMENTS (charset_names); i++) {
+			expected[i] = g_mime_charset_iconv_name (charset_names[i]);
+			
+			if (g_mime_charset_iconv_name (charset_names[i]) != expected[i])
+				throw (exception_new ("%s resolved to a different string the second time", charset_names[i]));
+		}
+		
+		if (strcmp (expected[0], "UTF-8") != 0 || strcmp (expected[1], "UTF-8") != 0)
+			throw (exception_new ("utf-8 resolved to %s", expected[0]));
+		
+		if (strcmp (expected[5], "CP1252") != 0 || strcmp (expected[6], "CP1251") != 0 || strcmp (expected[7], "CP1250") != 0)
+			throw (exception_new ("windows charsets resolved to %s, %s, %s", expected[5], expected[6], expected[7]));
+		
+		if (strcmp (expected[9], "EUC-KR") != 0 || strcmp (expected[10], "GBK") != 0)
+			throw (exception_new ("CJK charsets resolved to %s, %s", expected[9], expected[10]));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("iconv names failed: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("concurrent lookups");
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("resolve", resolve_charset_names, (gpointer) expected);
+	
+	for (i = 0, success = TRUE; i < G_N_ELEMENTS (threads); i++)
+		success = GPOINTER_TO_INT (g_thread_join (threads[i])) && success;
+	
+	if (success)
+		testsuite_check_passed ();
+	else
+		testsuite_check_failed ("concurrent lookups failed: results did not match");
+	
+	testsuite_end ();
+}
+
 int main (int argc, char **argv)
 {
 	g_mime_init ();
@@ -139,6 +599,10 @@ int main (int argc, char **argv)
 	testsuite_init (argc, argv);
 	
 	test_utils ();
+	test_charset_best ();
+	test_iconv_cache ();
+	test_builtin_converters ();
+	test_charset_names ();
 	
 	g_mime_shutdown ();
 	
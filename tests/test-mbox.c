@@ -176,6 +176,609 @@ test_parser (GMimeParser *parser, GMimeStream *mbox, GMimeStream *summary)
 	}
 }
 
+static void
+print_part_tree (GMimeStream *stream, GMimePartNode *node, int depth)
+{
+	GMimePartNode *child;
+	
+	print_depth (stream, depth);
+	
+	g_mime_stream_printf (stream, "Content-Type: %s/%s\n", node->type, node->subtype);
+	
+	for (child = node->children; child != NULL; child = child->next)
+		print_part_tree (stream, child, depth + 1);
+}
+
+static char *
+stream_to_string (GMimeStream *stream)
+{
+	GByteArray *array = g_mime_stream_mem_get_byte_array ((GMimeStreamMem *) stream);
+	
+	return g_strndup ((char *) array->data, array->len);
+}
+
+static void
+check_part_tree_nodes (GMimePartTree *tree, GMimePartNode *node, GMimeObject *parent)
+{
+	GMimeObject *object, *expected;
+	GMimePartNode *child;
+	char *estr, *astr;
+	int index = 0;
+	
+	for (child = node->children; child != NULL; child = child->next, index++) {
+		if (child->depth != node->depth + 1 || child->parent != node)
+			throw (exception_new ("node has the wrong parent"));
+		
+		if (child->headers_begin > child->content_begin || child->content_begin > child->content_end)
+			throw (exception_new ("node has inconsistent offsets"));
+		
+		if (GMIME_IS_MULTIPART (parent))
+			expected = g_mime_multipart_get_part ((GMimeMultipart *) parent, index);
+		else
+			expected = g_mime_message_get_mime_part (g_mime_message_part_get_message ((GMimeMessagePart *) parent));
+		
+		if (!(object = g_mime_part_tree_construct_part (tree, child, NULL)))
+			throw (exception_new ("failed to construct a %s/%s part", child->type, child->subtype));
+		
+		if (!g_mime_content_type_is_type (g_mime_object_get_content_type (object), child->type, child->subtype))
+			throw (exception_new ("constructed part is not %s/%s", child->type, child->subtype));
+		
+		/* the body of an encapsulated message shares its headers with the message */
+		if (GMIME_IS_MULTIPART (parent)) {
+			estr = g_mime_object_to_string (expected, NULL);
+			astr = g_mime_object_to_string (object, NULL);
+			
+			if (strcmp (estr, astr) != 0)
+				throw (exception_new ("constructed %s/%s part does not match", child->type, child->subtype));
+			
+			g_free (estr);
+			g_free (astr);
+		}
+		
+		g_object_unref (object);
+		
+		check_part_tree_nodes (tree, child, expected);
+	}
+}
+
+static void
+check_part_index (GMimePartIndex *index)
+{
+	GMimeObject *current, *part;
+	GMimePartIter *iter;
+	char *path, *ipath;
+	
+	iter = g_mime_part_iter_new (g_mime_part_index_get_toplevel (index));
+	
+	while (g_mime_part_iter_is_valid (iter)) {
+		current = g_mime_part_iter_get_current (iter);
+		path = g_mime_part_iter_get_path (iter);
+		
+		if (g_mime_part_index_get_part_from_path (index, path) != current)
+			throw (exception_new ("indexed part at %s does not match", path));
+		
+		if (!(ipath = g_mime_part_index_get_path (index, current)) || strcmp (ipath, path) != 0)
+			throw (exception_new ("indexed path %s does not match %s", ipath ? ipath : "(null)", path));
+		
+		if (current->content_id) {
+			if (!(part = g_mime_part_index_get_part_from_content_id (index, current->content_id)))
+				throw (exception_new ("Content-Id %s of %s is not indexed", current->content_id, path));
+			
+			if (strcmp (part->content_id, current->content_id) != 0)
+				throw (exception_new ("indexed Content-Id %s does not match", part->content_id));
+		}
+		
+		g_free (ipath);
+		g_free (path);
+		
+		g_mime_part_iter_next (iter);
+	}
+	
+	g_mime_part_iter_free (iter);
+}
+
+static void
+test_part_tree (const char *buf, size_t len, GMimeFormat format)
+{
+	GMimeStream *stream, *expected, *actual;
+	GMimeMessage *message, *constructed;
+	GMimeParser *parser, *tparser;
+	char *estr, *astr;
+	GMimePartIndex *index;
+	GMimePartTree *tree;
+	int nmsg = 0;
+	
+	stream = g_mime_stream_mem_new_with_buffer (buf, len);
+	parser = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_format (parser, format);
+	g_object_unref (stream);
+	
+	stream = g_mime_stream_mem_new_with_buffer (buf, len);
+	tparser = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_format (tparser, format);
+	g_object_unref (stream);
+	
+	while (!g_mime_parser_eos (parser)) {
+		if (!(message = g_mime_parser_construct_message (parser, NULL)))
+			throw (exception_new ("failed to parse message #%d", nmsg));
+		
+		if (!(tree = g_mime_parser_construct_part_tree (tparser, NULL)))
+			throw (exception_new ("failed to scan the structure of message #%d", nmsg));
+		
+		expected = g_mime_stream_mem_new ();
+		actual = g_mime_stream_mem_new ();
+		
+		print_mime_struct (expected, g_mime_message_get_mime_part (message), 0);
+		print_part_tree (actual, g_mime_part_tree_get_root (tree), 0);
+		
+		estr = stream_to_string (expected);
+		astr = stream_to_string (actual);
+		g_object_unref (expected);
+		g_object_unref (actual);
+		
+		if (strcmp (estr, astr) != 0)
+			throw (exception_new ("structure of message #%d does not match", nmsg));
+		
+		g_free (estr);
+		g_free (astr);
+		
+		if (!(constructed = g_mime_part_tree_construct_message (tree, NULL)))
+			throw (exception_new ("failed to construct message #%d", nmsg));
+		
+		estr = g_mime_object_to_string ((GMimeObject *) message, NULL);
+		astr = g_mime_object_to_string ((GMimeObject *) constructed, NULL);
+		g_object_unref (constructed);
+		
+		if (strcmp (estr, astr) != 0)
+			throw (exception_new ("constructed message #%d does not match", nmsg));
+		
+		g_free (estr);
+		g_free (astr);
+		
+		check_part_tree_nodes (tree, g_mime_part_tree_get_root (tree), g_mime_message_get_mime_part (message));
+		
+		index = g_mime_part_index_new ((GMimeObject *) message);
+		check_part_index (index);
+		g_mime_part_index_free (index);
+		
+		g_mime_part_tree_free (tree);
+		g_object_unref (message);
+		nmsg++;
+	}
+	
+	if (!g_mime_parser_eos (tparser))
+		throw (exception_new ("part tree parser did not consume the whole stream"));
+	
+	g_object_unref (tparser);
+	g_object_unref (parser);
+}
+
+static const char warning_message[] =
+	"From: sender@example.com\r\n"
+	"Subject: caf\xc3\xa9\r\n"
+	"Bad Header: value\r\n"
+	"Content-Type: multipart/mixed; boundary=b; boundary=c\r\n"
+	"\r\n"
+	"--b\r\n"
+	"Content-Type: text/plain; charset=utf-8; charset=us-ascii\r\n"
+	"\r\n"
+	"text\r\n"
+	"--b--\r\n";
+
+static void
+count_warnings (gint64 offset, GMimeParserWarning errcode, const gchar *item, gpointer user_data)
+{
+	(*((int *) user_data))++;
+}
+
+static void
+test_part_tree_warnings (void)
+{
+	GMimeParserOptions *options;
+	GMimeMessage *message;
+	GMimeParser *parser;
+	GMimeStream *stream;
+	GMimePartTree *tree;
+	int warnings = 0;
+	
+	options = g_mime_parser_options_new ();
+	g_mime_parser_options_set_warning_callback (options, count_warnings, &warnings, NULL);
+	
+	stream = g_mime_stream_mem_new_with_buffer (warning_message, sizeof (warning_message) - 1);
+	parser = g_mime_parser_new_with_stream (stream);
+	g_object_unref (stream);
+	
+	tree = g_mime_parser_construct_part_tree (parser, options);
+	g_object_unref (parser);
+	
+	if (tree == NULL) {
+		g_mime_parser_options_free (options);
+		throw (exception_new ("failed to scan the structure"));
+	}
+	
+	if (warnings != 0) {
+		g_mime_parser_options_free (options);
+		g_mime_part_tree_free (tree);
+		throw (exception_new ("%d warnings were emitted while scanning the structure", warnings));
+	}
+	
+	message = g_mime_part_tree_construct_message (tree, options);
+	g_mime_part_tree_free (tree);
+	
+	if (message)
+		g_object_unref (message);
+	
+	g_mime_parser_options_free (options);
+	
+	if (warnings == 0)
+		throw (exception_new ("no warnings were emitted when constructing the message"));
+}
+
+static const char nested_message[] =
+	"From: sender@example.com\r\n"
+	"To: recipient@example.com\r\n"
+	"Subject: nested\r\n"
+	"MIME-Version: 1.0\r\n"
+	"Content-Type: multipart/mixed; boundary=\"outer\"\r\n"
+	"\r\n"
+	"This is the prologue.\r\n"
+	"--outer\r\n"
+	"Content-Type: text/plain\r\n"
+	"\r\n"
+	"Hello.\r\n"
+	"--outer\r\n"
+	"Content-Type: message/rfc822\r\n"
+	"\r\n"
+	"From: inner@example.com\r\n"
+	"Subject: inner\r\n"
+	"Content-Type: multipart/alternative; boundary=inner\r\n"
+	"\r\n"
+	"--inner\r\n"
+	"Content-Type: text/plain\r\n"
+	"\r\n"
+	"plain\r\n"
+	"--inner\r\n"
+	"Content-Type: text/html\r\n"
+	"\r\n"
+	"<p>html</p>\r\n"
+	"--inner--\r\n"
+	"--outer\r\n"
+	"Content-Type: multipart/digest; boundary=digest\r\n"
+	"\r\n"
+	"--digest\r\n"
+	"\r\n"
+	"Subject: digested\r\n"
+	"\r\n"
+	"digested body\r\n"
+	"--digest--\r\n"
+	"--outer\r\n"
+	"Content-Type: message/rfc822\r\n"
+	"Content-Transfer-Encoding: base64\r\n"
+	"\r\n"
+	"U3ViamVjdDogZW5jb2RlZAoKYm9keQo=\r\n"
+	"--outer--\r\n"
+	"This is the epilogue.\r\n";
+
+static void
+test_part_index (void)
+{
+	GMimeObject *part, *text, *inner;
+	GMimeMultipart *multipart;
+	GMimePartIndex *index;
+	GMimeMessage *message;
+	GMimeParser *parser;
+	GMimeStream *stream;
+	char *path;
+	
+	stream = g_mime_stream_mem_new_with_buffer (nested_message, sizeof (nested_message) - 1);
+	parser = g_mime_parser_new_with_stream (stream);
+	g_object_unref (stream);
+	
+	if (!(message = g_mime_parser_construct_message (parser, NULL)))
+		throw (exception_new ("failed to parse the nested message"));
+	
+	g_object_unref (parser);
+	
+	index = g_mime_part_index_new ((GMimeObject *) message);
+	check_part_index (index);
+	
+	multipart = (GMimeMultipart *) g_mime_message_get_mime_part (message);
+	part = g_mime_multipart_get_part (multipart, 0);
+	inner = g_mime_multipart_get_part (multipart, 1);
+	
+	if (g_mime_part_index_get_part_from_path (index, "1") != part)
+		throw (exception_new ("part 1 is not the first subpart"));
+	
+	if (g_mime_part_index_get_part_from_content_id (index, "hello@example.com") != NULL)
+		throw (exception_new ("found a Content-Id that does not exist"));
+	
+	/* Content-Ids set through the API or through the headers */
+	g_mime_object_set_content_id (part, "hello@example.com");
+	if (g_mime_part_index_get_part_from_content_id (index, "hello@example.com") != part)
+		throw (exception_new ("Content-Id set via the API was not indexed"));
+	
+	g_mime_object_set_header (g_mime_multipart_get_part (multipart, 3), "Content-Id", "<encoded@example.com>", NULL);
+	if (g_mime_part_index_get_part_from_content_id (index, "encoded@example.com") != g_mime_multipart_get_part (multipart, 3))
+		throw (exception_new ("Content-Id set via the headers was not indexed"));
+	
+	/* adding and removing subparts */
+	text = (GMimeObject *) g_mime_text_part_new ();
+	g_mime_object_set_content_id (text, "new@example.com");
+	g_mime_multipart_add (multipart, text);
+	g_object_unref (text);
+	
+	if (g_mime_part_index_get_part_from_content_id (index, "new@example.com") != text)
+		throw (exception_new ("added part was not indexed"));
+	
+	if (!(path = g_mime_part_index_get_path (index, text)) || strcmp (path, "5") != 0)
+		throw (exception_new ("added part has the wrong path: %s", path ? path : "(null)"));
+	g_free (path);
+	
+	g_object_ref (part);
+	g_mime_multipart_remove (multipart, part);
+	
+	if (g_mime_part_index_get_part_from_content_id (index, "hello@example.com") != NULL)
+		throw (exception_new ("removed part is still indexed by Content-Id"));
+	
+	if ((path = g_mime_part_index_get_path (index, part)) != NULL)
+		throw (exception_new ("removed part is still indexed at %s", path));
+	
+	g_object_unref (part);
+	
+	if (!(path = g_mime_part_index_get_path (index, text)) || strcmp (path, "4") != 0)
+		throw (exception_new ("added part was not renumbered: %s", path ? path : "(null)"));
+	g_free (path);
+	
+	check_part_index (index);
+	
+	/* replacing the contents of a message/rfc822 part */
+	if (g_mime_part_index_get_part_from_path (index, "1.1") == NULL)
+		throw (exception_new ("the encapsulated message's first subpart is not indexed"));
+	
+	g_mime_message_part_set_message ((GMimeMessagePart *) inner, NULL);
+	
+	if (g_mime_part_index_get_part_from_path (index, "1.1") != NULL)
+		throw (exception_new ("the removed message's subparts are still indexed"));
+	
+	check_part_index (index);
+	
+	g_mime_part_index_free (index);
+	g_object_unref (message);
+}
+
+typedef struct {
+	GMimeMessage *message;
+	GByteArray *expected;
+	char *text;
+} FrozenMessage;
+
+static GByteArray *
+write_message (GMimeMessage *message, char **text)
+{
+	GMimeObject *body, *part;
+	GByteArray *array;
+	GMimeStream *mem;
+	
+	body = g_mime_message_get_mime_part (message);
+	part = g_mime_multipart_get_part ((GMimeMultipart *) body, 0);
+	*text = g_mime_text_part_get_text ((GMimeTextPart *) part);
+	
+	array = g_byte_array_new ();
+	mem = g_mime_stream_mem_new_with_byte_array (array);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) mem, FALSE);
+	g_mime_object_write_to_stream ((GMimeObject *) message, NULL, mem);
+	g_object_unref (mem);
+	
+	return array;
+}
+
+static gpointer
+read_frozen_message (gpointer data)
+{
+	FrozenMessage *frozen = data;
+	gboolean match;
+	GByteArray *array;
+	char *text;
+	int i;
+	
+	for (i = 0; i < 50; i++) {
+		array = write_message (frozen->message, &text);
+		match = array->len == frozen->expected->len && !memcmp (array->data, frozen->expected->data, array->len) &&
+			!strcmp (text, frozen->text);
+		g_byte_array_free (array, TRUE);
+		g_free (text);
+		
+		if (!match)
+			return GINT_TO_POINTER (FALSE);
+	}
+	
+	return GINT_TO_POINTER (TRUE);
+}
+
+static void
+test_freeze (GMimeStream *stream, gboolean shared)
+{
+	GMimeObject *body, *part, *parent;
+	GMimeMessage *message, *inner;
+	GMimeStream *content;
+	GMimeParser *parser;
+	FrozenMessage frozen;
+	GMimePartIter *iter;
+	GThread *threads[4];
+	GType type = G_OBJECT_TYPE (stream);
+	gboolean success;
+	int i;
+	
+	g_mime_stream_write (stream, nested_message, sizeof (nested_message) - 1);
+	g_mime_stream_reset (stream);
+	
+	parser = g_mime_parser_new_with_stream (stream);
+	g_mime_parser_set_persist_stream (parser, TRUE);
+	g_object_unref (stream);
+	
+	if (!(message = g_mime_parser_construct_message (parser, NULL)))
+		throw (exception_new ("failed to parse the nested message"));
+	
+	g_object_unref (parser);
+	
+	g_mime_object_freeze ((GMimeObject *) message);
+	
+	if (!g_mime_object_is_frozen ((GMimeObject *) message))
+		throw (exception_new ("the message was not frozen"));
+	
+	body = g_mime_message_get_mime_part (message);
+	iter = g_mime_part_iter_new ((GMimeObject *) message);
+	do {
+		part = g_mime_part_iter_get_current (iter);
+		parent = g_mime_part_iter_get_parent (iter);
+		
+		if (!g_mime_object_is_frozen (part) || !g_mime_object_is_frozen (parent))
+			throw (exception_new ("a subpart was not frozen"));
+		
+		if (GMIME_IS_MESSAGE_PART (part)) {
+			inner = g_mime_message_part_get_message ((GMimeMessagePart *) part);
+			
+			if (!g_mime_object_is_frozen ((GMimeObject *) inner))
+				throw (exception_new ("an encapsulated message was not frozen"));
+		} else if (GMIME_IS_PART (part)) {
+			content = g_mime_data_wrapper_get_stream (g_mime_part_get_content ((GMimePart *) part));
+			
+			if (shared && G_OBJECT_TYPE (content) != type)
+				throw (exception_new ("the content of a frozen part was copied into memory"));
+			
+			if (!shared && !GMIME_IS_STREAM_MEM (content))
+				throw (exception_new ("the content of a frozen part is not in memory"));
+		}
+	} while (g_mime_part_iter_next (iter));
+	g_mime_part_iter_free (iter);
+	
+	if (!g_mime_object_is_frozen (body))
+		throw (exception_new ("the body was not frozen"));
+	
+	frozen.message = message;
+	frozen.expected = write_message (message, &frozen.text);
+	
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("freeze", read_frozen_message, &frozen);
+	
+	success = TRUE;
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		success = GPOINTER_TO_INT (g_thread_join (threads[i])) && success;
+	
+	g_byte_array_free (frozen.expected, TRUE);
+	g_object_unref (message);
+	g_free (frozen.text);
+	
+	if (!success)
+		throw (exception_new ("concurrent readers did not get the original message"));
+}
+
+static void
+check_message_output (GMimeMessage *message, GByteArray *expected, const char *what)
+{
+	GByteArray *array;
+	gboolean match;
+	char *text;
+	
+	array = write_message (message, &text);
+	match = array->len == expected->len && !memcmp (array->data, expected->data, array->len);
+	g_byte_array_free (array, TRUE);
+	g_free (text);
+	
+	if (!match)
+		throw (exception_new ("%s does not match the original message", what));
+}
+
+static void
+test_clone (void)
+{
+	GMimeMessage *message, *clone, *variant, *inner;
+	GMimeMultipart *multipart, *original;
+	GMimeStream *stream, *content, *source;
+	GMimeObject *part, *text;
+	InternetAddress *mailbox;
+	GByteArray *expected;
+	GMimeParser *parser;
+	char *body;
+	
+	stream = g_mime_stream_mem_new_with_buffer (nested_message, sizeof (nested_message) - 1);
+	parser = g_mime_parser_new_with_stream (stream);
+	g_object_unref (stream);
+	
+	if (!(message = g_mime_parser_construct_message (parser, NULL)))
+		throw (exception_new ("failed to parse the nested message"));
+	
+	g_object_unref (parser);
+	
+	expected = write_message (message, &body);
+	g_free (body);
+	
+	clone = (GMimeMessage *) g_mime_object_clone ((GMimeObject *) message);
+	if (!GMIME_IS_MESSAGE (clone))
+		throw (exception_new ("the clone is not a message"));
+	
+	check_message_output (clone, expected, "the clone");
+	
+	original = (GMimeMultipart *) g_mime_message_get_mime_part (message);
+	multipart = (GMimeMultipart *) g_mime_message_get_mime_part (clone);
+	if ((GMimeObject *) multipart == (GMimeObject *) original || !GMIME_IS_MULTIPART (multipart) ||
+	    g_mime_multipart_get_count (multipart) != g_mime_multipart_get_count (original))
+		throw (exception_new ("the MIME structure was not cloned"));
+	
+	/* the content is shared, the data wrappers and streams are not */
+	text = g_mime_multipart_get_part (multipart, 0);
+	part = g_mime_multipart_get_part (original, 0);
+	if (g_mime_part_get_content ((GMimePart *) text) == g_mime_part_get_content ((GMimePart *) part))
+		throw (exception_new ("the data wrapper of a part was shared"));
+	
+	content = g_mime_data_wrapper_get_stream (g_mime_part_get_content ((GMimePart *) text));
+	source = g_mime_data_wrapper_get_stream (g_mime_part_get_content ((GMimePart *) part));
+	if (content == source || !GMIME_IS_STREAM_MEM (content) ||
+	    g_mime_stream_mem_get_byte_array ((GMimeStreamMem *) content) !=
+	    g_mime_stream_mem_get_byte_array ((GMimeStreamMem *) source))
+		throw (exception_new ("the content of a part was not shared"));
+	
+	g_mime_stream_seek (source, 0, GMIME_STREAM_SEEK_END);
+	if (g_mime_stream_tell (content) != content->bound_start)
+		throw (exception_new ("the clone shares a stream position with the original"));
+	
+	/* modifying the clone must not affect the original */
+	g_mime_message_set_subject (clone, "variant", NULL);
+	mailbox = internet_address_mailbox_new ("Another", "another@example.com");
+	internet_address_list_add (g_mime_message_get_to (clone), mailbox);
+	g_object_unref (mailbox);
+	g_mime_text_part_set_text ((GMimeTextPart *) text, "Goodbye.\n");
+	g_mime_multipart_set_epilogue (multipart, NULL);
+	g_object_unref (g_mime_multipart_remove_at (multipart, 3));
+	
+	inner = g_mime_message_part_get_message ((GMimeMessagePart *) g_mime_multipart_get_part (multipart, 1));
+	g_mime_message_set_subject (inner, "inner variant", NULL);
+	
+	check_message_output (message, expected, "the original message");
+	
+	if (strcmp (g_mime_message_get_subject (clone), "variant") != 0 ||
+	    internet_address_list_length (g_mime_message_get_to (clone)) != 2 ||
+	    internet_address_list_length (g_mime_message_get_to (message)) != 1)
+		throw (exception_new ("the clone's headers were not modified"));
+	
+	/* a frozen message can be cloned, the clone is mutable */
+	g_mime_object_freeze ((GMimeObject *) message);
+	variant = (GMimeMessage *) g_mime_object_clone ((GMimeObject *) message);
+	
+	if (g_mime_object_is_frozen ((GMimeObject *) variant))
+		throw (exception_new ("the clone of a frozen message is frozen"));
+	
+	check_message_output (variant, expected, "the clone of a frozen message");
+	
+	g_mime_message_set_subject (variant, "another variant", NULL);
+	check_message_output (message, expected, "the frozen message");
+	
+	g_byte_array_free (expected, TRUE);
+	g_object_unref (variant);
+	g_object_unref (message);
+	g_object_unref (clone);
+}
+
 static gboolean
 streams_match (GMimeStream *istream, GMimeStream *ostream)
 {
@@ -274,12 +877,13 @@ streams_match (GMimeStream *istream, GMimeStream *ostream)
 int main (int argc, char **argv)
 {
 	const char *datadir = "data/mbox";
-	char input[256], output[256], *tmp, *p, *q;
+	char input[256], output[256], *tmp, *buf, *p, *q;
 	GMimeStream *istream, *ostream, *mstream, *pstream;
 	GMimeParser *parser;
 	const char *dent;
 	const char *path;
 	struct stat st;
+	gsize len;
 	GDir *dir;
 	int i;
 #ifdef ENABLE_MBOX_MATCH
@@ -303,6 +907,81 @@ int main (int argc, char **argv)
 	
 	testsuite_start ("Mbox parser");
 	
+	testsuite_check ("part tree of a nested message");
+	try {
+		test_part_tree (nested_message, sizeof (nested_message) - 1, GMIME_FORMAT_MESSAGE);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("part tree of a nested message: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("part tree scan warnings");
+	try {
+		test_part_tree_warnings ();
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("part tree scan warnings: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("part index of a nested message");
+	try {
+		test_part_index ();
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("part index of a nested message: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("frozen message shared between threads (GMimeStreamFs)");
+	try {
+		char tmpname[] = "test-mbox.XXXXXX";
+		int fd;
+		
+		if ((fd = mkstemp (tmpname)) == -1)
+			throw (exception_new ("could not create a temporary file"));
+		unlink (tmpname);
+		
+#ifdef HAVE_PREAD
+		test_freeze (g_mime_stream_fs_new (fd), TRUE);
+#else
+		test_freeze (g_mime_stream_fs_new (fd), FALSE);
+#endif
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("frozen message shared between threads (GMimeStreamFs): %s", ex->message);
+	} finally;
+	
+	testsuite_check ("frozen message shared between threads (GMimeStreamFile)");
+	try {
+#ifdef HAVE_FLOCKFILE
+		test_freeze (g_mime_stream_file_new (tmpfile ()), TRUE);
+#else
+		test_freeze (g_mime_stream_file_new (tmpfile ()), FALSE);
+#endif
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("frozen message shared between threads (GMimeStreamFile): %s", ex->message);
+	} finally;
+	
+	testsuite_check ("frozen message shared between threads (GMimeStreamBuffer)");
+	try {
+		GMimeStream *source = g_mime_stream_mem_new ();
+		
+		/* a stream that cannot be shared, so its content must be moved into memory */
+		test_freeze (g_mime_stream_buffer_new (source, GMIME_STREAM_BUFFER_BLOCK_READ), FALSE);
+		g_object_unref (source);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("frozen message shared between threads (GMimeStreamBuffer): %s", ex->message);
+	} finally;
+	
+	testsuite_check ("clone of a nested message");
+	try {
+		test_clone ();
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("clone of a nested message: %s", ex->message);
+	} finally;
+	
 	if (stat (path, &st) == -1)
 		goto exit;
 	
@@ -400,6 +1079,12 @@ int main (int argc, char **argv)
 				if (!streams_match (ostream, pstream))
 					throw (exception_new ("summaries do not match for `%s'", dent));
 				
+				if (!g_file_get_contents (input, &buf, &len, NULL))
+					throw (exception_new ("could not read `%s'", input));
+				
+				test_part_tree (buf, len, GMIME_FORMAT_MBOX);
+				g_free (buf);
+				
 				testsuite_check_passed ();
 				
 #ifdef ENABLE_MBOX_MATCH
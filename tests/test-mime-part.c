@@ -477,6 +477,289 @@ error:
 	g_free (path);
 }
 
+static GByteArray *
+write_part_content (GMimePart *mime_part, GMimeFormatOptions *options)
+{
+	GByteArray *buffer;
+	GMimeStream *stream;
+	
+	buffer = g_byte_array_new ();
+	stream = g_mime_stream_mem_new_with_byte_array (buffer);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) stream, FALSE);
+	g_mime_object_write_content_to_stream ((GMimeObject *) mime_part, options, stream);
+	g_object_unref (stream);
+	
+	return buffer;
+}
+
+static void
+test_cached_write_to_stream (const char *datadir, GMimeContentEncoding encoding, GMimeNewLineFormat newline)
+{
+	const char *what = "GMimePart::write_to_stream() with caching";
+	GByteArray *expected, *actual = NULL;
+	GMimeFormatOptions *options;
+	GMimeDataWrapper *content;
+	GMimePart *mime_part;
+	GMimeStream *stream;
+	int i;
+	
+	testsuite_check ("%s (%s, %s)", what, g_mime_content_encoding_to_string (encoding),
+			 newline == GMIME_NEWLINE_FORMAT_DOS ? "dos" : "unix");
+	
+	options = g_mime_format_options_clone (NULL);
+	g_mime_format_options_set_newline_format (options, newline);
+	
+	mime_part = create_mime_part ("image", "png", datadir, "raptors.png");
+	g_mime_part_set_content_encoding (mime_part, encoding);
+	expected = write_part_content (mime_part, options);
+	
+	content = g_mime_part_get_content (mime_part);
+	g_mime_data_wrapper_set_caching (content, TRUE);
+	
+	for (i = 0; i < 3; i++) {
+		actual = write_part_content (mime_part, options);
+		
+		if (actual->len != expected->len) {
+			testsuite_check_failed ("%s failed: lengths did not match on write #%d (%u vs %u)",
+						what, i + 1, actual->len, expected->len);
+			goto error;
+		}
+		
+		if (memcmp (actual->data, expected->data, actual->len) != 0) {
+			testsuite_check_failed ("%s failed: streams did not match on write #%d", what, i + 1);
+			goto error;
+		}
+		
+		g_byte_array_free (actual, TRUE);
+		actual = NULL;
+	}
+	
+	/* changing the content stream must invalidate the cache */
+	stream = g_mime_stream_mem_new_with_buffer ("raptor", 6);
+	g_mime_data_wrapper_set_stream (content, stream);
+	g_object_unref (stream);
+	
+	actual = write_part_content (mime_part, options);
+	
+	if (actual->len >= expected->len) {
+		testsuite_check_failed ("%s failed: stale content written after g_mime_data_wrapper_set_stream()", what);
+		goto error;
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	if (actual != NULL)
+		g_byte_array_free (actual, TRUE);
+	g_byte_array_free (expected, TRUE);
+	g_mime_format_options_free (options);
+	g_object_unref (mime_part);
+}
+
+static void
+test_repeated_write_to_stream (const char *datadir)
+{
+	const char *what = "GMimePart::write_to_stream() with reused filter pipelines";
+	GMimeContentEncoding encodings[] = {
+		GMIME_CONTENT_ENCODING_BASE64,
+		GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE,
+		GMIME_CONTENT_ENCODING_UUENCODE
+	};
+	GByteArray *expected[G_N_ELEMENTS (encodings)];
+	GMimePart *mime_part;
+	GByteArray *actual;
+	guint i, j;
+	
+	testsuite_check ("%s", what);
+	
+	mime_part = create_mime_part ("image", "png", datadir, "raptors.png");
+	
+	for (i = 0; i < G_N_ELEMENTS (encodings); i++) {
+		g_mime_part_set_content_encoding (mime_part, encodings[i]);
+		expected[i] = write_part_content (mime_part, NULL);
+	}
+	
+	/* interleave the encodings so that each write gets a pipeline that was previously used */
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < G_N_ELEMENTS (encodings); i++) {
+			g_mime_part_set_content_encoding (mime_part, encodings[i]);
+			actual = write_part_content (mime_part, NULL);
+			
+			if (actual->len != expected[i]->len || memcmp (actual->data, expected[i]->data, actual->len) != 0) {
+				testsuite_check_failed ("%s failed: %s output did not match on write #%u", what,
+							g_mime_content_encoding_to_string (encodings[i]), j + 2);
+				g_byte_array_free (actual, TRUE);
+				goto error;
+			}
+			
+			g_byte_array_free (actual, TRUE);
+		}
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	for (i = 0; i < G_N_ELEMENTS (encodings); i++)
+		g_byte_array_free (expected[i], TRUE);
+	g_object_unref (mime_part);
+}
+
+static const char *template_names[] = {
+	"To", "Message-Id", "X-Campaign", "greeting", NULL
+};
+
+static const char *template_values[][4] = {
+	{ "Élise Dupont <elise@example.com>", "1@example.com", "raptors-2022",
+	  "Chère Élise,\n\nVoici votre rapport mensuel sur les rapaces.\n" },
+	{ "\"Strauß, Jürgen\" <juergen@example.com>", "2@example.com", "raptors-2022",
+	  "Lieber Jürgen,\n\nhier ist Ihr monatlicher Greifvogelbericht, diesmal mit einer besonders langen Zeile, die vom Quoted-Printable-Encoder umgebrochen werden muss.\n" },
+};
+
+static GMimeMessage *
+create_template_message (const char *datadir, GMimeTextPart **greeting)
+{
+	GMimeMultipart *multipart;
+	GMimeMessage *message;
+	GMimePart *mime_part;
+	
+	message = g_mime_message_new (TRUE);
+	g_mime_message_add_mailbox (message, GMIME_ADDRESS_TYPE_FROM, "Raptor Watch", "news@raptors.example.com");
+	g_mime_message_add_mailbox (message, GMIME_ADDRESS_TYPE_TO, "Placeholder", "placeholder@example.com");
+	g_mime_message_set_subject (message, "Your monthly raptor report", NULL);
+	g_mime_message_set_message_id (message, "0@example.com");
+	
+	multipart = g_mime_multipart_new_with_subtype ("mixed");
+	g_mime_multipart_set_boundary (multipart, "=-raptor-boundary");
+	
+	*greeting = g_mime_text_part_new_with_subtype ("plain");
+	g_mime_text_part_set_text (*greeting, "Chère lectrice, cher lecteur,\n");
+	g_mime_part_set_content_encoding ((GMimePart *) *greeting, GMIME_CONTENT_ENCODING_QUOTEDPRINTABLE);
+	g_mime_multipart_add (multipart, (GMimeObject *) *greeting);
+	g_object_unref (*greeting);
+	
+	mime_part = create_mime_part ("image", "png", datadir, "raptors.png");
+	g_mime_part_set_content_encoding (mime_part, GMIME_CONTENT_ENCODING_BASE64);
+	g_mime_part_set_filename (mime_part, "raptors.png");
+	g_mime_multipart_add (multipart, (GMimeObject *) mime_part);
+	g_object_unref (mime_part);
+	
+	g_mime_message_set_mime_part (message, (GMimeObject *) multipart);
+	g_object_unref (multipart);
+	
+	return message;
+}
+
+static GByteArray *
+write_message_template (GMimeMessageTemplate *tmpl, const char **values)
+{
+	GByteArray *buffer;
+	GMimeStream *stream;
+	
+	buffer = g_byte_array_new ();
+	stream = g_mime_stream_mem_new_with_byte_array (buffer);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) stream, FALSE);
+	g_mime_message_template_write_to_stream (tmpl, stream, values ? template_names : NULL, values);
+	g_object_unref (stream);
+	
+	return buffer;
+}
+
+static GByteArray *
+write_message (GMimeMessage *message, GMimeFormatOptions *options)
+{
+	GByteArray *buffer;
+	GMimeStream *stream;
+	
+	buffer = g_byte_array_new ();
+	stream = g_mime_stream_mem_new_with_byte_array (buffer);
+	g_mime_stream_mem_set_owner ((GMimeStreamMem *) stream, FALSE);
+	g_mime_object_write_to_stream ((GMimeObject *) message, options, stream);
+	g_object_unref (stream);
+	
+	return buffer;
+}
+
+static gboolean
+byte_arrays_equal (GByteArray *a, GByteArray *b)
+{
+	return a->len == b->len && memcmp (a->data, b->data, a->len) == 0;
+}
+
+static void
+test_message_template (const char *datadir, GMimeNewLineFormat newline)
+{
+	const char *what = "GMimeMessageTemplate::write_to_stream()";
+	GByteArray *expected = NULL, *actual = NULL;
+	GMimeMessageTemplate *tmpl;
+	GMimeFormatOptions *options;
+	GMimeMessage *message;
+	GMimeTextPart *greeting;
+	guint i;
+	
+	testsuite_check ("%s (%s)", what, newline == GMIME_NEWLINE_FORMAT_DOS ? "dos" : "unix");
+	
+	options = g_mime_format_options_clone (NULL);
+	g_mime_format_options_set_newline_format (options, newline);
+	
+	message = create_template_message (datadir, &greeting);
+	
+	tmpl = g_mime_message_template_new ();
+	g_mime_message_template_add_header (tmpl, "To");
+	g_mime_message_template_add_header (tmpl, "Message-Id");
+	g_mime_message_template_add_header (tmpl, "X-Campaign");
+	g_mime_message_template_add_part (tmpl, "greeting", (GMimePart *) greeting);
+	
+	if (!g_mime_message_template_compile (tmpl, message, options)) {
+		testsuite_check_failed ("%s failed: could not compile the template", what);
+		goto error;
+	}
+	
+	/* without any values, the template should reproduce the original message */
+	expected = write_message (message, options);
+	actual = write_message_template (tmpl, NULL);
+	
+	if (!byte_arrays_equal (expected, actual)) {
+		testsuite_check_failed ("%s failed: default instance did not match the message", what);
+		goto error;
+	}
+	
+	g_byte_array_free (expected, TRUE);
+	g_byte_array_free (actual, TRUE);
+	expected = actual = NULL;
+	
+	for (i = 0; i < G_N_ELEMENTS (template_values); i++) {
+		actual = write_message_template (tmpl, template_values[i]);
+		
+		g_mime_object_set_header ((GMimeObject *) message, "To", template_values[i][0], NULL);
+		g_mime_object_set_header ((GMimeObject *) message, "Message-Id", template_values[i][1], NULL);
+		g_mime_object_set_header ((GMimeObject *) message, "X-Campaign", template_values[i][2], NULL);
+		g_mime_text_part_set_text (greeting, template_values[i][3]);
+		expected = write_message (message, options);
+		
+		v(fprintf (stdout, "%.*s", (int) actual->len, (char *) actual->data));
+		
+		if (!byte_arrays_equal (expected, actual)) {
+			testsuite_check_failed ("%s failed: instance #%u did not match the message", what, i + 1);
+			goto error;
+		}
+		
+		g_byte_array_free (expected, TRUE);
+		g_byte_array_free (actual, TRUE);
+		expected = actual = NULL;
+	}
+	
+	testsuite_check_passed ();
+	
+error:
+	if (expected != NULL)
+		g_byte_array_free (expected, TRUE);
+	if (actual != NULL)
+		g_byte_array_free (actual, TRUE);
+	g_mime_format_options_free (options);
+	g_object_unref (message);
+	g_object_unref (tmpl);
+}
+
 static char *openpgp_data_types[] = {
 	"GMIME_OPENPGP_DATA_NONE",
 	"GMIME_OPENPGP_DATA_ENCRYPTED",
@@ -560,6 +843,69 @@ cleanup:
 	g_object_unref (part);
 }
 
+static struct {
+	const char *type;
+	const char *subtype;
+	const char *expected;
+} object_types[] = {
+	{ "text", "plain", "GMimeTextPart" },
+	{ "TEXT", "HTML", "GMimeTextPart" },
+	{ "multipart", "mixed", "GMimeMultipart" },
+	{ "Multipart", "Signed", "GMimeMultipartSigned" },
+	{ "multipart", "x-unknown", "GMimeMultipart" },
+	{ "message", "rfc822", "GMimeMessagePart" },
+	{ "message", "partial", "GMimeMessagePartial" },
+	{ "application", "pkcs7-mime", "GMimeApplicationPkcs7Mime" },
+	{ "application", "octet-stream", "GMimePart" },
+	{ "x-unknown", "x-unknown", "GMimePart" },
+	{ "application", "x-a-subtype-name-that-is-too-long-to-be-cached", "GMimePart" },
+};
+
+static void
+test_object_types (void)
+{
+	GMimeObject *object;
+	const char *name;
+	guint i, j;
+	
+	testsuite_check ("g_mime_object_new_type()");
+	try {
+		/* do each lookup twice so that the second one is resolved from the cache */
+		for (j = 0; j < 2; j++) {
+			for (i = 0; i < G_N_ELEMENTS (object_types); i++) {
+				object = g_mime_object_new_type (NULL, object_types[i].type, object_types[i].subtype);
+				name = G_OBJECT_TYPE_NAME (object);
+				g_object_unref (object);
+				
+				if (strcmp (name, object_types[i].expected) != 0)
+					throw (exception_new ("%s/%s: expected %s but got %s", object_types[i].type,
+							      object_types[i].subtype, object_types[i].expected, name));
+			}
+		}
+		
+		/* registering a type must take effect for types that have already been resolved */
+		object = g_mime_object_new_type (NULL, "application", "x-gmime-test");
+		name = G_OBJECT_TYPE_NAME (object);
+		g_object_unref (object);
+		
+		if (strcmp (name, "GMimePart") != 0)
+			throw (exception_new ("application/x-gmime-test: expected GMimePart but got %s", name));
+		
+		g_mime_object_register_type ("application", "x-gmime-test", GMIME_TYPE_TEXT_PART);
+		
+		object = g_mime_object_new_type (NULL, "Application", "X-GMime-Test");
+		name = G_OBJECT_TYPE_NAME (object);
+		g_object_unref (object);
+		
+		if (strcmp (name, "GMimeTextPart") != 0)
+			throw (exception_new ("application/x-gmime-test: expected GMimeTextPart but got %s", name));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("g_mime_object_new_type(): %s", ex->message);
+	} finally;
+}
+
 int main (int argc, char **argv)
 {
 	const char *datadir = "data/mime-part";
@@ -586,9 +932,17 @@ int main (int argc, char **argv)
 	
 	test_content_headers (datadir);
 	
+	test_object_types ();
+	
 	test_write_to_stream (datadir, "raptors.b64.txt", GMIME_CONTENT_ENCODING_DEFAULT);
 	test_write_to_stream (datadir, "raptors.uu.txt", GMIME_CONTENT_ENCODING_UUENCODE);
 	
+	test_cached_write_to_stream (datadir, GMIME_CONTENT_ENCODING_BASE64, GMIME_NEWLINE_FORMAT_UNIX);
+	test_cached_write_to_stream (datadir, GMIME_CONTENT_ENCODING_BASE64, GMIME_NEWLINE_FORMAT_DOS);
+	test_cached_write_to_stream (datadir, GMIME_CONTENT_ENCODING_UUENCODE, GMIME_NEWLINE_FORMAT_UNIX);
+	
+	test_repeated_write_to_stream (datadir);
+	
 	test_openpgp_data (datadir, "raptors.png", GMIME_OPENPGP_DATA_NONE);
 	test_openpgp_data (datadir, "signed-body.txt", GMIME_OPENPGP_DATA_SIGNED);
 	test_openpgp_data (datadir, "encrypted-body.txt", GMIME_OPENPGP_DATA_ENCRYPTED);
@@ -599,6 +953,13 @@ int main (int argc, char **argv)
 	
 	testsuite_end ();
 	
+	testsuite_start ("GMimeMessageTemplate");
+	
+	test_message_template (datadir, GMIME_NEWLINE_FORMAT_UNIX);
+	test_message_template (datadir, GMIME_NEWLINE_FORMAT_DOS);
+	
+	testsuite_end ();
+	
 	g_mime_shutdown ();
 	
 	return testsuite_exit ();
@@ -313,6 +313,292 @@ test_addrspec (GMimeParserOptions *options, gboolean test_broken)
 }
 
 
+static const char *scanner_inputs[] = {
+	"Undisclosed recipients:;",
+	"Friends: Joe <joe@example.com>, \"Smith, Jane\" <jane@example.com>; boss@example.com",
+	"Outer: Inner: a@example.com;, b@example.com;, c@example.com",
+	"<@route1.example,@route2.example:user@example.com>",
+	"john . smith (comment) @ example . com",
+	"user@[ 192.168.0.1 ]",
+	"user@xn--bcher-kva.example",
+	"=?iso-8859-1?q?Fran=E7ois?= Pons <fpons@example.com>, bad@@example.com, good@example.com",
+	"Caf\xe9 <cafe@example.com>",
+	"localpart-only, \"Quoted\\\" Name\" <q@example.com>",
+	",,, , a@example.com ,,",
+};
+
+static void
+flatten_address_list (InternetAddressList *list, GPtrArray *flat, GArray *depths, int depth)
+{
+	InternetAddress *ia;
+	int i;
+	
+	for (i = 0; i < internet_address_list_length (list); i++) {
+		ia = internet_address_list_get_address (list, i);
+		g_ptr_array_add (flat, ia);
+		g_array_append_val (depths, depth);
+		
+		if (INTERNET_ADDRESS_IS_GROUP (ia))
+			flatten_address_list (((InternetAddressGroup *) ia)->members, flat, depths, depth + 1);
+	}
+}
+
+static Exception *
+check_scanner (GMimeParserOptions *options, const char *input)
+{
+	InternetAddressScanner scanner;
+	InternetAddressList *list;
+	InternetAddressSpan span;
+	Exception *ex = NULL;
+	GArray *depths;
+	GPtrArray *flat;
+	InternetAddress *ia;
+	char *name, *buf;
+	const char *addr;
+	guint n = 0;
+	
+	flat = g_ptr_array_new ();
+	depths = g_array_new (FALSE, FALSE, sizeof (int));
+	
+	if ((list = internet_address_list_parse (options, input)))
+		flatten_address_list (list, flat, depths, 0);
+	
+	internet_address_scanner_init (&scanner, options, input);
+	while (ex == NULL && internet_address_scanner_next (&scanner, &span)) {
+		if (n >= flat->len) {
+			ex = exception_new ("scanner yielded too many addresses");
+			break;
+		}
+		
+		ia = flat->pdata[n];
+		
+		if (span.group_depth != g_array_index (depths, int, n)) {
+			ex = exception_new ("address %u: group depth %d != %d", n, span.group_depth, g_array_index (depths, int, n));
+			break;
+		}
+		
+		if (!!(span.flags & INTERNET_ADDRESS_SPAN_GROUP) != !!INTERNET_ADDRESS_IS_GROUP (ia)) {
+			ex = exception_new ("address %u: group/mailbox mismatch", n);
+			break;
+		}
+		
+		/* materialize the name the same way the object parser does */
+		buf = g_strndup (span.name ? span.name : "", span.name_length);
+		if (span.flags & INTERNET_ADDRESS_SPAN_NAME_8BIT) {
+			name = g_mime_utils_decode_8bit (options, buf, span.name_length);
+			g_free (buf);
+			buf = name;
+		}
+		g_mime_utils_unquote_string (buf);
+		name = g_mime_utils_header_decode_phrase (options, buf);
+		g_strstrip (name);
+		g_free (buf);
+		
+		if (strcmp (name, ia->name ? ia->name : "") != 0)
+			ex = exception_new ("address %u: name '%s' != '%s'", n, name, ia->name ? ia->name : "");
+		g_free (name);
+		
+		if (ex == NULL && INTERNET_ADDRESS_IS_MAILBOX (ia) &&
+		    !(span.flags & (INTERNET_ADDRESS_SPAN_ADDR_CFWS | INTERNET_ADDRESS_SPAN_IDN_DOMAIN))) {
+			addr = internet_address_mailbox_get_addr ((InternetAddressMailbox *) ia);
+			
+			if (span.domain != NULL)
+				buf = g_strdup_printf ("%.*s@%.*s", (int) span.local_part_length, span.local_part,
+						       (int) span.domain_length, span.domain);
+			else
+				buf = g_strndup (span.local_part, span.local_part_length);
+			
+			if (strcmp (buf, addr) != 0)
+				ex = exception_new ("address %u: addr '%s' != '%s'", n, buf, addr);
+			g_free (buf);
+		}
+		
+		n++;
+	}
+	
+	if (ex == NULL && n != flat->len)
+		ex = exception_new ("scanner yielded %u addresses, expected %u", n, flat->len);
+	
+	g_array_free (depths, TRUE);
+	g_ptr_array_free (flat, TRUE);
+	if (list)
+		g_object_unref (list);
+	
+	return ex;
+}
+
+static void
+test_address_scanner (GMimeParserOptions *options)
+{
+	InternetAddressScanner scanner;
+	InternetAddressSpan span;
+	Exception *ex;
+	guint i;
+	
+	for (i = 0; i < G_N_ELEMENTS (addrspec); i++) {
+		testsuite_check ("addrspec[%u]", i);
+		if ((ex = check_scanner (options, addrspec[i].input))) {
+			testsuite_check_failed ("addrspec[%u]: %s: %s", i, addrspec[i].input, ex->message);
+			exception_free (ex);
+		} else {
+			testsuite_check_passed ();
+		}
+	}
+	
+	for (i = 0; i < G_N_ELEMENTS (broken_addrspec); i++) {
+		testsuite_check ("broken_addrspec[%u]", i);
+		if ((ex = check_scanner (options, broken_addrspec[i].input))) {
+			testsuite_check_failed ("broken_addrspec[%u]: %s: %s", i, broken_addrspec[i].input, ex->message);
+			exception_free (ex);
+		} else {
+			testsuite_check_passed ();
+		}
+	}
+	
+	for (i = 0; i < G_N_ELEMENTS (scanner_inputs); i++) {
+		testsuite_check ("scanner_inputs[%u]", i);
+		if ((ex = check_scanner (options, scanner_inputs[i]))) {
+			testsuite_check_failed ("scanner_inputs[%u]: %s: %s", i, scanner_inputs[i], ex->message);
+			exception_free (ex);
+		} else {
+			testsuite_check_passed ();
+		}
+	}
+	
+	testsuite_check ("span flags");
+	try {
+		internet_address_scanner_init (&scanner, options, "\"A. Person\" <a (x) . b@xn--bcher-kva.example>");
+		if (!internet_address_scanner_next (&scanner, &span))
+			throw (exception_new ("no address scanned"));
+		
+		if (span.name_length != 11 || strncmp (span.name, "\"A. Person\"", 11) != 0)
+			throw (exception_new ("unexpected name span"));
+		
+		if (span.flags != (INTERNET_ADDRESS_SPAN_NAME_QUOTED | INTERNET_ADDRESS_SPAN_ADDR_CFWS | INTERNET_ADDRESS_SPAN_IDN_DOMAIN))
+			throw (exception_new ("unexpected flags: 0x%x", span.flags));
+		
+		if (span.local_part_length != 9 || strncmp (span.local_part, "a (x) . b", 9) != 0)
+			throw (exception_new ("unexpected local-part span"));
+		
+		if (span.domain_length != 21 || strncmp (span.domain, "xn--bcher-kva.example", 21) != 0)
+			throw (exception_new ("unexpected domain span"));
+		
+		if (internet_address_scanner_next (&scanner, &span))
+			throw (exception_new ("unexpected second address"));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("span flags: %s", ex->message);
+	} finally;
+}
+
+#define IDN_TEST_DOMAINS 600
+
+static gpointer
+idn_round_trip (gpointer user_data)
+{
+	int offset = GPOINTER_TO_INT (user_data);
+	InternetAddressMailbox *mailbox;
+	InternetAddressList *list;
+	InternetAddress *ia;
+	const char *idn_addr;
+	char *addr, *ace;
+	int i, n;
+	
+	for (i = 0; i < IDN_TEST_DOMAINS; i++) {
+		n = (i + offset) % IDN_TEST_DOMAINS;
+		addr = g_strdup_printf ("user@b\xc3\xbc" "cher%d.example", n);
+		
+		ia = internet_address_mailbox_new (NULL, addr);
+		mailbox = (InternetAddressMailbox *) ia;
+		idn_addr = internet_address_mailbox_get_idn_addr (mailbox);
+		
+#ifdef LIBIDN
+		if (strncmp (idn_addr, "user@xn--", 9) != 0) {
+#else
+		/* without libidn2, the domain is left as-is */
+		if (strcmp (idn_addr, addr) != 0) {
+#endif
+			g_object_unref (ia);
+			g_free (addr);
+			return GINT_TO_POINTER (FALSE);
+		}
+		
+		/* the result is stored on the mailbox */
+		if (internet_address_mailbox_get_idn_addr (mailbox) != idn_addr) {
+			g_object_unref (ia);
+			g_free (addr);
+			return GINT_TO_POINTER (FALSE);
+		}
+		
+		ace = g_strdup (idn_addr);
+		g_object_unref (ia);
+		
+		/* parsing the ACE form should give us back the unicode domain */
+		list = internet_address_list_parse (NULL, ace);
+		ia = list ? internet_address_list_get_address (list, 0) : NULL;
+		
+		if (ia == NULL || strcmp (internet_address_mailbox_get_addr ((InternetAddressMailbox *) ia), addr) != 0) {
+			if (list)
+				g_object_unref (list);
+			g_free (addr);
+			g_free (ace);
+			return GINT_TO_POINTER (FALSE);
+		}
+		
+		g_object_unref (list);
+		g_free (addr);
+		g_free (ace);
+	}
+	
+	return GINT_TO_POINTER (TRUE);
+}
+
+static void
+test_idn_cache (void)
+{
+	InternetAddressMailbox *mailbox;
+	InternetAddress *ia;
+	gboolean success;
+	GThread *threads[4];
+	int i;
+	
+	testsuite_check ("ascii domains");
+	try {
+		ia = internet_address_mailbox_new (NULL, "user@Example.COM");
+		mailbox = (InternetAddressMailbox *) ia;
+		
+		if (internet_address_mailbox_get_idn_addr (mailbox) != internet_address_mailbox_get_addr (mailbox)) {
+			g_object_unref (ia);
+			throw (exception_new ("ascii domain was converted"));
+		}
+		
+		g_object_unref (ia);
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("ascii domains: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("round trips");
+	if (!GPOINTER_TO_INT (idn_round_trip (GINT_TO_POINTER (0))) || !GPOINTER_TO_INT (idn_round_trip (GINT_TO_POINTER (0))))
+		testsuite_check_failed ("round trips: IDN conversion failed");
+	else
+		testsuite_check_passed ();
+	
+	testsuite_check ("concurrent round trips");
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("idn", idn_round_trip, GINT_TO_POINTER (i * 97));
+	
+	success = TRUE;
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		success = GPOINTER_TO_INT (g_thread_join (threads[i])) && success;
+	
+	if (!success)
+		testsuite_check_failed ("concurrent round trips: IDN conversion failed");
+	else
+		testsuite_check_passed ();
+}
+
 static struct {
 	const char *in;
 	const char *out;
@@ -402,6 +688,78 @@ test_date_parser (void)
 	}
 }
 
+static const char *unix_dates[] = {
+	"Mon, 17 Jan 1994 11:14:55 -0500",
+	"17 Jan 1994 11:14:55 -0500",
+	"Thu, 01 Jan 1970 00:00:00 +0000",
+	"Wed, 31 Dec 1969 19:00:00 -0500",
+	"Tue, 29 Feb 2000 12:00 +0130",
+	"Wed, 29 Feb 2023 12:00:00 +0000",
+	"Sat, 1 mar 2008 23:59:59 -0930",
+	"Fri, 31 Dec 2038 23:59:59 +1400",
+	"Sat, 24 Mar 2007 21:23:03 EDT",
+	"Sat, 24 Mar 2007 21:23:03 UT",
+	"Sat, 24 Mar 2007 21:23:03 Z",
+	"Sat, 24 Mar 2007 21:23:03 A",
+	"Sat, 24 Mar 2007 21:23:03 +0000 (UTC)",
+	"Sat, 24 Mar 2007 21:23:03",
+	"  Sat,\r\n 24 Mar 2007\t21:23:03 -0000  ",
+	"Sat,24 Mar 2007 21:23:03 +0200",
+	"Saturday, 24 Mar 2007 21:23:03 +0200",
+	"Sat, 24 March 2007 21:23:03 +0200",
+	"Sat, 24 Mar 07 21:23:03 +0200",
+	"Sat, 24 Mar 2007 21:23:60 +0200",
+	"Sat, 24 Mar 2007 21:23:03 +0260",
+	"Sat, 24 Mar 2007 21:23:03 gmt",
+	"Sat, 24-Mar-2007 21:23:03 +0200",
+	"Sat, 32 Mar 2007 21:23:03 +0200",
+	"Sat, 24 Mar 1900 21:23:03 +0200",
+	"nonsense",
+};
+
+static void
+test_date_parser_unix (void)
+{
+	GDateTime *date;
+	gint64 expected_time, time;
+	int expected_tz, tz;
+	gboolean parsed;
+	guint i;
+	
+	for (i = 0; i < G_N_ELEMENTS (unix_dates); i++) {
+		testsuite_check ("Date: '%s'", unix_dates[i]);
+		try {
+			date = g_mime_utils_header_decode_date (unix_dates[i]);
+			parsed = g_mime_utils_header_decode_date_unix (unix_dates[i], &time, &tz);
+			
+			if (date == NULL) {
+				if (parsed)
+					throw (exception_new ("parsed a date that g_mime_utils_header_decode_date() rejected"));
+				
+				testsuite_check_passed ();
+				continue;
+			}
+			
+			expected_time = g_date_time_to_unix (date);
+			expected_tz = (int) (g_date_time_get_utc_offset (date) / G_TIME_SPAN_MINUTE);
+			g_date_time_unref (date);
+			
+			if (!parsed)
+				throw (exception_new ("failed to parse date"));
+			
+			if (time != expected_time)
+				throw (exception_new ("times do not match: actual: %" G_GINT64_FORMAT "; expected: %" G_GINT64_FORMAT, time, expected_time));
+			
+			if (tz != expected_tz)
+				throw (exception_new ("timezones do not match: actual: %d; expected: %d", tz, expected_tz));
+			
+			testsuite_check_passed ();
+		} catch (ex) {
+			testsuite_check_failed ("Date: '%s': %s", unix_dates[i], ex->message);
+		} finally;
+	}
+}
+
 static struct {
 	const char *input;
 	const char *decoded;
@@ -465,6 +823,20 @@ static struct {
 	  "OT - ich =?iso-8859-1?b?d2Vp3yw=?= trotzdem" },
 };
 
+static struct {
+	const char *input;
+	const char *decoded;
+} rfc2047_plain[] = {
+	{ "", "" },
+	{ "Hello world", "Hello world" },
+	{ "  Re: [list]\tsome\n  folded\r\n\tsubject  ", "  Re: [list]\tsome\n  folded\r\n\tsubject  " },
+	{ "\"Quoted, Name\" (comment) a=b c?d ?= =", "\"Quoted, Name\" (comment) a=b c?d ?= =" },
+	{ "trailing equals=", "trailing equals=" },
+	{ "not encoded =?", "not encoded =?" },
+	{ "not =?encoded either", "not =?encoded either" },
+	{ "Hello =?iso-8859-1?q?w=F6rld?=", "Hello w\xc3\xb6rld" },
+};
+
 #if 0
 static struct {
 	const char *input;
@@ -528,6 +900,27 @@ test_rfc2047 (GMimeParserOptions *options, gboolean test_broken)
 		g_free (enc);
 	}
 	
+	for (i = 0; i < G_N_ELEMENTS (rfc2047_plain); i++) {
+		dec = enc = NULL;
+		testsuite_check ("rfc2047_plain[%u]", i);
+		try {
+			dec = g_mime_utils_header_decode_text (options, rfc2047_plain[i].input);
+			if (strcmp (rfc2047_plain[i].decoded, dec) != 0)
+				throw (exception_new ("decoded text does not match: actual=\"%s\", expected=\"%s\"", dec, rfc2047_plain[i].decoded));
+			
+			enc = g_mime_utils_header_decode_phrase (options, rfc2047_plain[i].input);
+			if (strcmp (rfc2047_plain[i].decoded, enc) != 0)
+				throw (exception_new ("decoded phrase does not match: actual=\"%s\", expected=\"%s\"", enc, rfc2047_plain[i].decoded));
+			
+			testsuite_check_passed ();
+		} catch (ex) {
+			testsuite_check_failed ("rfc2047_plain[%u]: %s", i, ex->message);
+		} finally;
+		
+		g_free (dec);
+		g_free (enc);
+	}
+	
 #if 0
 	for (i = 0; i < G_N_ELEMENTS (rfc2047_phrase); i++) {
 		dec = enc = NULL;
@@ -713,6 +1106,146 @@ test_rfc2184 (GMimeParserOptions *options)
 }
 
 
+static void
+count_param_warnings (gint64 offset, GMimeParserWarning errcode, const gchar *item, gpointer user_data)
+{
+	if (errcode == GMIME_CRIT_CONFLICTING_PARAMETER)
+		(*((int *) user_data))++;
+}
+
+static void
+check_content_type (GMimeContentType *content_type, const char *type, const char *subtype, const char *charset)
+{
+	const char *value;
+	
+	if (strcmp (content_type->type, type) != 0 || strcmp (content_type->subtype, subtype) != 0)
+		throw (exception_new ("expected %s/%s, got %s/%s", type, subtype, content_type->type, content_type->subtype));
+	
+	if (!(value = g_mime_content_type_get_parameter (content_type, "charset")) || strcmp (value, charset) != 0)
+		throw (exception_new ("expected charset=%s, got %s", charset, value ? value : "(null)"));
+}
+
+static void
+test_param_cache (GMimeParserOptions *options)
+{
+	const char *ctype = "text/plain; charset=us-ascii; format=flowed";
+	const char *cdisp = "attachment; filename*0*=us-ascii'en'This%20is; filename*1*=%20fun.txt";
+	GMimeContentDisposition *disposition[2] = { NULL, NULL };
+	GMimeContentType *content_type[3] = { NULL, NULL, NULL };
+	GMimeParserOptions *warn;
+	const char *value;
+	char buf[64];
+	int warnings;
+	guint i;
+	
+	testsuite_check ("Content-Type");
+	try {
+		content_type[0] = g_mime_content_type_parse (options, ctype);
+		content_type[1] = g_mime_content_type_parse (options, ctype);
+		
+		if (content_type[0] == content_type[1] || content_type[0]->params == content_type[1]->params)
+			throw (exception_new ("cached content types are not private copies"));
+		
+		check_content_type (content_type[0], "text", "plain", "us-ascii");
+		check_content_type (content_type[1], "text", "plain", "us-ascii");
+		
+		if (!(value = g_mime_content_type_get_parameter (content_type[1], "format")) || strcmp (value, "flowed") != 0)
+			throw (exception_new ("cached format parameter does not match"));
+		
+		/* modifying a copy must not affect the cached value */
+		g_mime_content_type_set_media_subtype (content_type[1], "html");
+		g_mime_content_type_set_parameter (content_type[1], "charset", "utf-8");
+		
+		content_type[2] = g_mime_content_type_parse (options, ctype);
+		check_content_type (content_type[0], "text", "plain", "us-ascii");
+		check_content_type (content_type[1], "text", "html", "utf-8");
+		check_content_type (content_type[2], "text", "plain", "us-ascii");
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("Content-Type: %s", ex->message);
+	} finally;
+	
+	for (i = 0; i < G_N_ELEMENTS (content_type); i++) {
+		if (content_type[i] != NULL)
+			g_object_unref (content_type[i]);
+	}
+	
+	testsuite_check ("Content-Disposition");
+	try {
+		for (i = 0; i < G_N_ELEMENTS (disposition); i++) {
+			disposition[i] = g_mime_content_disposition_parse (options, cdisp);
+			
+			if (strcmp (disposition[i]->disposition, "attachment") != 0)
+				throw (exception_new ("disposition[%u] does not match: %s", i, disposition[i]->disposition));
+			
+			if (!(value = g_mime_content_disposition_get_parameter (disposition[i], "filename")) || strcmp (value, "This is fun.txt") != 0)
+				throw (exception_new ("disposition[%u] filename does not match: %s", i, value ? value : "(null)"));
+		}
+		
+		g_mime_content_disposition_set_disposition (disposition[0], "inline");
+		g_object_unref (disposition[0]);
+		
+		disposition[0] = g_mime_content_disposition_parse (options, cdisp);
+		if (strcmp (disposition[0]->disposition, "attachment") != 0)
+			throw (exception_new ("cached disposition was modified: %s", disposition[0]->disposition));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("Content-Disposition: %s", ex->message);
+	} finally;
+	
+	for (i = 0; i < G_N_ELEMENTS (disposition); i++) {
+		if (disposition[i] != NULL)
+			g_object_unref (disposition[i]);
+	}
+	
+	testsuite_check ("eviction");
+	try {
+		/* more distinct values than the cache can hold, twice over */
+		for (i = 0; i < 600; i++) {
+			g_snprintf (buf, sizeof (buf), "text/plain; charset=x-test-%u", i % 300);
+			content_type[0] = g_mime_content_type_parse (options, buf);
+			
+			value = g_mime_content_type_get_parameter (content_type[0], "charset");
+			if (value == NULL || strcmp (value, buf + strlen ("text/plain; charset=")) != 0) {
+				g_object_unref (content_type[0]);
+				throw (exception_new ("charset does not match for %s", buf));
+			}
+			
+			g_object_unref (content_type[0]);
+		}
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("eviction: %s", ex->message);
+	} finally;
+	
+	testsuite_check ("warnings");
+	warn = g_mime_parser_options_new ();
+	warnings = 0;
+	try {
+		/* populate the cache without a warning callback... */
+		content_type[0] = g_mime_content_type_parse (options, "text/plain; charset=utf-8; charset=us-ascii");
+		g_object_unref (content_type[0]);
+		
+		/* ...and make sure the warning isn't lost once one is set */
+		g_mime_parser_options_set_warning_callback (warn, count_param_warnings, &warnings, NULL);
+		content_type[0] = g_mime_content_type_parse (warn, "text/plain; charset=utf-8; charset=us-ascii");
+		g_object_unref (content_type[0]);
+		
+		if (warnings != 1)
+			throw (exception_new ("expected 1 conflicting parameter warning, got %d", warnings));
+		
+		testsuite_check_passed ();
+	} catch (ex) {
+		testsuite_check_failed ("warnings: %s", ex->message);
+	} finally;
+	
+	g_mime_parser_options_free (warn);
+}
+
+
 static struct {
 	const char *input;
 	const char *unquoted;
@@ -843,8 +1376,23 @@ int main (int argc, char **argv)
 	test_addrspec (options, TRUE);
 	testsuite_end ();
 	
+	testsuite_start ("address scanner (strict)");
+	g_mime_parser_options_set_address_compliance_mode (options, GMIME_RFC_COMPLIANCE_STRICT);
+	test_address_scanner (options);
+	testsuite_end ();
+	
+	testsuite_start ("address scanner (loose)");
+	g_mime_parser_options_set_address_compliance_mode (options, GMIME_RFC_COMPLIANCE_LOOSE);
+	test_address_scanner (options);
+	testsuite_end ();
+	
+	testsuite_start ("IDN conversion");
+	test_idn_cache ();
+	testsuite_end ();
+	
 	testsuite_start ("date parser");
 	test_date_parser ();
+	test_date_parser_unix ();
 	testsuite_end ();
 	
 	testsuite_start ("rfc2047 encoding/decoding (strict)");
@@ -861,6 +1409,10 @@ int main (int argc, char **argv)
 	test_rfc2184 (options);
 	testsuite_end ();
 	
+	testsuite_start ("Content-Type/Content-Disposition parse cache");
+	test_param_cache (options);
+	testsuite_end ();
+	
 	testsuite_start ("quoted-strings");
 	test_qstring ();
 	testsuite_end ();